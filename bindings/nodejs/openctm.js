@@ -68,6 +68,7 @@ exports.CTM_EXPORT = 0x0102;
 exports.CTM_METHOD_RAW = 0x0201;
 exports.CTM_METHOD_MG1 = 0x0202;
 exports.CTM_METHOD_MG2 = 0x0203;
+exports.CTM_METHOD_MG3 = 0x0204;
 exports.CTM_VERTEX_COUNT = 0x0301;
 exports.CTM_TRIANGLE_COUNT = 0x0302;
 exports.CTM_HAS_NORMALS = 0x0303;
@@ -34,6 +34,8 @@ elif method == CTM_METHOD_MG1:
     methodStr = "MG1"
 elif method == CTM_METHOD_MG2:
     methodStr = "MG2"
+elif method == CTM_METHOD_MG3:
+    methodStr = "MG3"
 else:
     methodStr = "Unknown"
 
@@ -42,6 +42,12 @@ CTMenum = c_uint32
 CTM_API_VERSION = 0x00000100
 CTM_TRUE = 1
 CTM_FALSE = 0
+CTM_ALL_TILES = 0xffffffff
+CTM_TILE_INDEX = 0xfffffffe
+CTM_LOAD_NORMALS = 0x00000001
+CTM_LOAD_UV_MAPS = 0x00000002
+CTM_LOAD_ATTRIB_MAPS = 0x00000004
+CTM_LOAD_ALL = 0x00000007
 
 # CTMenum
 CTM_NONE = 0x0000
@@ -60,6 +66,7 @@ CTM_EXPORT = 0x0102
 CTM_METHOD_RAW = 0x0201
 CTM_METHOD_MG1 = 0x0202
 CTM_METHOD_MG2 = 0x0203
+CTM_METHOD_MG3 = 0x0204
 CTM_VERTEX_COUNT = 0x0301
 CTM_TRIANGLE_COUNT = 0x0302
 CTM_HAS_NORMALS = 0x0303
@@ -69,6 +76,11 @@ CTM_VERTEX_PRECISION = 0x0306
 CTM_NORMAL_PRECISION = 0x0307
 CTM_COMPRESSION_METHOD = 0x0308
 CTM_FILE_COMMENT = 0x0309
+CTM_THREAD_COUNT = 0x030A
+CTM_TILE_COUNT = 0x030B
+CTM_LEVEL_COUNT = 0x030C
+CTM_SCRATCH_PEAK = 0x030D
+CTM_SECTION_COUNT = 0x030E
 CTM_NAME = 0x0501
 CTM_FILE_NAME = 0x0502
 CTM_PRECISION = 0x0503
@@ -91,6 +103,23 @@ CTM_ATTRIB_MAP_5 = 0x0804
 CTM_ATTRIB_MAP_6 = 0x0805
 CTM_ATTRIB_MAP_7 = 0x0806
 CTM_ATTRIB_MAP_8 = 0x0807
+CTM_FORMAT_FLOAT32 = 0x0901
+CTM_FORMAT_FLOAT16 = 0x0902
+CTM_FORMAT_SNORM16 = 0x0903
+CTM_LZMA_DICT_SIZE = 0x0A01
+CTM_LZMA_LITERAL_CONTEXT_BITS = 0x0A02
+CTM_LZMA_LITERAL_POS_BITS = 0x0A03
+CTM_LZMA_POS_BITS = 0x0A04
+CTM_LZMA_FAST_BYTES = 0x0A05
+CTM_LZMA_MATCH_FINDER = 0x0A06
+CTM_CODING_DELTA = 0x0B01
+CTM_CODING_CONNECTIVITY = 0x0B02
+CTM_CODING_PARALLELOGRAM = 0x0B03
+CTM_CODING_OCTAHEDRAL = 0x0B04
+CTM_SECTION_ID = 0x0C01
+CTM_SECTION_OFFSET = 0x0C02
+CTM_SECTION_SIZE = 0x0C03
+CTM_SECTION_UNPACKED_SIZE = 0x0C04
 
 
 def get_script_dir(follow_symlinks=True):
@@ -116,6 +145,16 @@ else:
 if not _lib:
     raise Exception('Could not open the OpenCTM shared library.')
 
+# Callback types (CTMCALL is __stdcall on Windows)
+if os.name == 'nt':
+    CTMlevelfn = WINFUNCTYPE(CTMint, CTMcontext, CTMuint, CTMuint, c_void_p)
+    CTMallocfn = WINFUNCTYPE(c_void_p, c_size_t, c_void_p)
+    CTMfreefn = WINFUNCTYPE(None, c_void_p, c_void_p)
+else:
+    CTMlevelfn = CFUNCTYPE(CTMint, CTMcontext, CTMuint, CTMuint, c_void_p)
+    CTMallocfn = CFUNCTYPE(c_void_p, c_size_t, c_void_p)
+    CTMfreefn = CFUNCTYPE(None, c_void_p, c_void_p)
+
 # Functions
 ctmNewContext = _lib.ctmNewContext
 ctmNewContext.argtypes = [CTMenum]
@@ -176,12 +215,41 @@ ctmGetString = _lib.ctmGetString
 ctmGetString.argtypes = [CTMcontext, CTMenum]
 ctmGetString.restype = c_char_p
 
+ctmGetTileInteger = _lib.ctmGetTileInteger
+ctmGetTileInteger.argtypes = [CTMcontext, CTMuint, CTMenum]
+ctmGetTileInteger.restype = CTMuint
+
+ctmGetTileBoundingBox = _lib.ctmGetTileBoundingBox
+ctmGetTileBoundingBox.argtypes = [CTMcontext, CTMuint, POINTER(CTMfloat), POINTER(CTMfloat)]
+
+ctmGetSectionInteger = _lib.ctmGetSectionInteger
+ctmGetSectionInteger.argtypes = [CTMcontext, CTMuint, CTMenum]
+ctmGetSectionInteger.restype = CTMuint
+
 ctmCompressionMethod = _lib.ctmCompressionMethod
 ctmCompressionMethod.argtypes = [CTMcontext, CTMenum]
 
 ctmCompressionLevel = _lib.ctmCompressionLevel
 ctmCompressionLevel.argtypes = [CTMcontext, CTMuint]
 
+ctmCompressionParameter = _lib.ctmCompressionParameter
+ctmCompressionParameter.argtypes = [CTMcontext, CTMenum, CTMenum, CTMint]
+
+ctmCompressionCoding = _lib.ctmCompressionCoding
+ctmCompressionCoding.argtypes = [CTMcontext, CTMenum, CTMenum]
+
+ctmThreadCount = _lib.ctmThreadCount
+ctmThreadCount.argtypes = [CTMcontext, CTMuint]
+
+ctmScratchMemory = _lib.ctmScratchMemory
+ctmScratchMemory.argtypes = [CTMcontext, CTMuint]
+
+ctmSetAllocator = _lib.ctmSetAllocator
+ctmSetAllocator.argtypes = [CTMcontext, CTMallocfn, CTMfreefn, c_void_p]
+
+ctmStreamBuffer = _lib.ctmStreamBuffer
+ctmStreamBuffer.argtypes = [CTMcontext, CTMuint]
+
 ctmVertexPrecision = _lib.ctmVertexPrecision
 ctmVertexPrecision.argtypes = [CTMcontext, CTMfloat]
 
@@ -200,6 +268,15 @@ ctmAttribPrecision.argtypes = [CTMcontext, CTMenum, CTMfloat]
 ctmFileComment = _lib.ctmFileComment
 ctmFileComment.argtypes = [CTMcontext, c_char_p]
 
+ctmTileGrid = _lib.ctmTileGrid
+ctmTileGrid.argtypes = [CTMcontext, CTMuint, CTMuint, CTMuint]
+
+ctmSectionDirectory = _lib.ctmSectionDirectory
+ctmSectionDirectory.argtypes = [CTMcontext, CTMint]
+
+ctmProgressiveLevels = _lib.ctmProgressiveLevels
+ctmProgressiveLevels.argtypes = [CTMcontext, CTMuint]
+
 ctmDefineMesh = _lib.ctmDefineMesh
 ctmDefineMesh.argtypes = [CTMcontext, POINTER(CTMfloat), CTMuint, POINTER(CTMuint), CTMuint, POINTER(CTMfloat)]
 
@@ -214,5 +291,35 @@ ctmAddAttribMap.restype = CTMenum
 ctmLoad = _lib.ctmLoad
 ctmLoad.argtypes = [CTMcontext, c_char_p]
 
+ctmLoadFromMemory = _lib.ctmLoadFromMemory
+ctmLoadFromMemory.argtypes = [CTMcontext, c_void_p, c_size_t]
+
+ctmLoadMapped = _lib.ctmLoadMapped
+ctmLoadMapped.argtypes = [CTMcontext, c_char_p]
+
+ctmProbe = _lib.ctmProbe
+ctmProbe.argtypes = [CTMcontext, c_char_p]
+
+ctmLoadInto = _lib.ctmLoadInto
+ctmLoadInto.argtypes = [CTMcontext, CTMenum, c_void_p, CTMuint, CTMuint]
+
+ctmVertexLayout = _lib.ctmVertexLayout
+ctmVertexLayout.argtypes = [CTMcontext, c_void_p, CTMuint, CTMuint]
+
+ctmVertexLayoutArray = _lib.ctmVertexLayoutArray
+ctmVertexLayoutArray.argtypes = [CTMcontext, CTMenum, CTMuint, CTMenum]
+
+ctmSelectTile = _lib.ctmSelectTile
+ctmSelectTile.argtypes = [CTMcontext, CTMuint]
+
+ctmLevelCallback = _lib.ctmLevelCallback
+ctmLevelCallback.argtypes = [CTMcontext, CTMlevelfn, c_void_p]
+
+ctmLoadSections = _lib.ctmLoadSections
+ctmLoadSections.argtypes = [CTMcontext, CTMuint]
+
 ctmSave = _lib.ctmSave
 ctmSave.argtypes = [CTMcontext, c_char_p]
+
+ctmAddChunk = _lib.ctmAddChunk
+ctmAddChunk.argtypes = [CTMcontext]
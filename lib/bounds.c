@@ -0,0 +1,241 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        bounds.c
+// Description: Bounding box calculation for vertex arrays (multi threaded,
+//              with SIMD optimized versions for SSE and NEON capable CPUs).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include "openctm.h"
+#include "internal.h"
+
+// Select which SIMD version to build (define OPENCTM_NO_SIMD to only build
+// the portable C version)
+#if !defined(OPENCTM_NO_SIMD)
+  #if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || \
+      (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+    #include <xmmintrin.h>
+    #define _CTM_USE_SSE
+  #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define _CTM_USE_NEON
+  #endif
+#endif
+
+// Minimum number of vertices per thread
+#define _CTM_BOUNDS_MIN_SPLIT 65536
+
+
+//-----------------------------------------------------------------------------
+// _CTMboundstask - Bounding box calculation for one part of a vertex array.
+//-----------------------------------------------------------------------------
+typedef struct {
+  const CTMfloat * mVertices;
+  CTMuint mCount;
+  CTMfloat mMin[3];
+  CTMfloat mMax[3];
+} _CTMboundstask;
+
+//-----------------------------------------------------------------------------
+// _ctmFirstZero() - Get the first zero (+0 or -0) component j of a vertex
+// array.
+//-----------------------------------------------------------------------------
+static CTMfloat _ctmFirstZero(const CTMfloat * aVertices, CTMuint aCount,
+  CTMuint j)
+{
+  CTMuint i;
+  for(i = 0; i < aCount; ++ i)
+  {
+    if(aVertices[i * 3 + j] == 0.0f)
+      return aVertices[i * 3 + j];
+  }
+  return 0.0f;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmBoundsTask() - Calculate the bounding box of one part of a vertex array.
+// The result is the same as for a sequential scan that only replaces the
+// min/max value with a strictly smaller/larger value (i.e. for equal values,
+// the first one is kept - this only makes a difference for +0 and -0).
+//-----------------------------------------------------------------------------
+static void _ctmBoundsTask(void * aItem)
+{
+  _CTMboundstask * task = (_CTMboundstask *) aItem;
+  const CTMfloat * v = task->mVertices;
+  CTMfloat * vmin = task->mMin;
+  CTMfloat * vmax = task->mMax;
+  CTMuint i, j;
+#if defined(_CTM_USE_SSE) || defined(_CTM_USE_NEON)
+  CTMfloat lo[12], hi[12];
+#endif
+
+  for(j = 0; j < 3; ++ j)
+    vmin[j] = vmax[j] = v[j];
+  i = 1;
+
+#if defined(_CTM_USE_SSE)
+  // Four vertices (three vectors) per iteration: the lanes hold the
+  // components x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+  if(task->mCount >= 8)
+  {
+    __m128 min0, min1, min2, max0, max1, max2, a, b, c;
+    min0 = max0 = _mm_loadu_ps(&v[0]);
+    min1 = max1 = _mm_loadu_ps(&v[4]);
+    min2 = max2 = _mm_loadu_ps(&v[8]);
+    for(i = 4; i + 4 <= task->mCount; i += 4)
+    {
+      a = _mm_loadu_ps(&v[i * 3]);
+      b = _mm_loadu_ps(&v[i * 3 + 4]);
+      c = _mm_loadu_ps(&v[i * 3 + 8]);
+      min0 = _mm_min_ps(min0, a);
+      min1 = _mm_min_ps(min1, b);
+      min2 = _mm_min_ps(min2, c);
+      max0 = _mm_max_ps(max0, a);
+      max1 = _mm_max_ps(max1, b);
+      max2 = _mm_max_ps(max2, c);
+    }
+    _mm_storeu_ps(&lo[0], min0);
+    _mm_storeu_ps(&lo[4], min1);
+    _mm_storeu_ps(&lo[8], min2);
+    _mm_storeu_ps(&hi[0], max0);
+    _mm_storeu_ps(&hi[4], max1);
+    _mm_storeu_ps(&hi[8], max2);
+    for(j = 0; j < 12; ++ j)
+    {
+      if(lo[j] < vmin[j % 3])
+        vmin[j % 3] = lo[j];
+      if(hi[j] > vmax[j % 3])
+        vmax[j % 3] = hi[j];
+    }
+  }
+#elif defined(_CTM_USE_NEON)
+  // Four vertices (three vectors) per iteration: the lanes hold the
+  // components x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+  if(task->mCount >= 8)
+  {
+    float32x4_t min0, min1, min2, max0, max1, max2, a, b, c;
+    min0 = max0 = vld1q_f32(&v[0]);
+    min1 = max1 = vld1q_f32(&v[4]);
+    min2 = max2 = vld1q_f32(&v[8]);
+    for(i = 4; i + 4 <= task->mCount; i += 4)
+    {
+      a = vld1q_f32(&v[i * 3]);
+      b = vld1q_f32(&v[i * 3 + 4]);
+      c = vld1q_f32(&v[i * 3 + 8]);
+      min0 = vminq_f32(min0, a);
+      min1 = vminq_f32(min1, b);
+      min2 = vminq_f32(min2, c);
+      max0 = vmaxq_f32(max0, a);
+      max1 = vmaxq_f32(max1, b);
+      max2 = vmaxq_f32(max2, c);
+    }
+    vst1q_f32(&lo[0], min0);
+    vst1q_f32(&lo[4], min1);
+    vst1q_f32(&lo[8], min2);
+    vst1q_f32(&hi[0], max0);
+    vst1q_f32(&hi[4], max1);
+    vst1q_f32(&hi[8], max2);
+    for(j = 0; j < 12; ++ j)
+    {
+      if(lo[j] < vmin[j % 3])
+        vmin[j % 3] = lo[j];
+      if(hi[j] > vmax[j % 3])
+        vmax[j % 3] = hi[j];
+    }
+  }
+#endif
+
+  // Remaining vertices
+  for(; i < task->mCount; ++ i)
+  {
+    for(j = 0; j < 3; ++ j)
+    {
+      if(v[i * 3 + j] < vmin[j])
+        vmin[j] = v[i * 3 + j];
+      else if(v[i * 3 + j] > vmax[j])
+        vmax[j] = v[i * 3 + j];
+    }
+  }
+
+  // The vector versions do not keep track of which zero came first
+  for(j = 0; j < 3; ++ j)
+  {
+    if(vmin[j] == 0.0f)
+      vmin[j] = _ctmFirstZero(v, task->mCount, j);
+    if(vmax[j] == 0.0f)
+      vmax[j] = _ctmFirstZero(v, task->mCount, j);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmBoundingBox() - Calculate the bounding box of aCount vertices (three
+// floats each). The result is exactly the same as for a sequential scan,
+// regardless of the number of threads.
+//-----------------------------------------------------------------------------
+void _ctmBoundingBox(_CTMcontext * self, const CTMfloat * aVertices,
+  CTMuint aCount, CTMfloat * aMin, CTMfloat * aMax)
+{
+  _CTMboundstask single, * tasks;
+  CTMuint taskCount, i, j, count;
+
+  // Split the array into one part per thread (if it is large enough)
+  taskCount = _ctmSplitCount(self, aCount, _CTM_BOUNDS_MIN_SPLIT);
+  tasks = (_CTMboundstask *) 0;
+  if(taskCount > 1)
+    tasks = (_CTMboundstask *) _ctmScratchAlloc(self->mScratch,
+      sizeof(_CTMboundstask) * taskCount);
+  if(!tasks)
+  {
+    tasks = &single;
+    taskCount = 1;
+  }
+  count = aCount / taskCount;
+  for(i = 0; i < taskCount; ++ i)
+  {
+    tasks[i].mVertices = &aVertices[(size_t) i * count * 3];
+    tasks[i].mCount = (i == taskCount - 1) ? aCount - i * count : count;
+  }
+  _ctmRunTasks(self, _ctmBoundsTask, (void *) tasks, taskCount,
+               sizeof(_CTMboundstask));
+
+  // Merge the results (in order, so that the first of equal values is kept)
+  for(j = 0; j < 3; ++ j)
+  {
+    aMin[j] = tasks[0].mMin[j];
+    aMax[j] = tasks[0].mMax[j];
+  }
+  for(i = 1; i < taskCount; ++ i)
+  {
+    for(j = 0; j < 3; ++ j)
+    {
+      if(tasks[i].mMin[j] < aMin[j])
+        aMin[j] = tasks[i].mMin[j];
+      if(tasks[i].mMax[j] > aMax[j])
+        aMax[j] = tasks[i].mMax[j];
+    }
+  }
+
+  if(tasks != &single)
+    _ctmScratchFree(self->mScratch, tasks);
+}
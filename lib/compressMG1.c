@@ -77,8 +77,10 @@ static void _ctmReArrangeTriangles(_CTMcontext * self, CTMuint * aIndices)
     }
   }
 
-  // Step 2: Sort the triangles based on the first triangle index
-  qsort((void *) aIndices, self->mTriangleCount, sizeof(CTMuint) * 3, _compareTriangle);
+  // Step 2: Sort the triangles based on the first triangle index (and secondly
+  // the second triangle index), with a radix sort if possible
+  if(!_ctmRadixSort(self->mScratch, (void *) aIndices, self->mTriangleCount, 3, 0, 1, CTM_FALSE))
+    qsort((void *) aIndices, self->mTriangleCount, sizeof(CTMuint) * 3, _compareTriangle);
 }
 
 //-----------------------------------------------------------------------------
@@ -110,9 +112,10 @@ static void _ctmMakeIndexDeltas(_CTMcontext * self, CTMuint * aIndices)
 
 //-----------------------------------------------------------------------------
 // _ctmRestoreIndices() - Restore original indices (inverse derivative
-// operation).
+// operation). aStride is the distance between two triangles in aIndices.
 //-----------------------------------------------------------------------------
-static void _ctmRestoreIndices(_CTMcontext * self, CTMuint * aIndices)
+static void _ctmRestoreIndices(_CTMcontext * self, CTMuint * aIndices,
+  CTMuint aStride)
 {
   CTMuint i;
 
@@ -120,19 +123,19 @@ static void _ctmRestoreIndices(_CTMcontext * self, CTMuint * aIndices)
   {
     // Step 1: Reverse derivative of the first triangle index
     if(i >= 1)
-      aIndices[i * 3] += aIndices[(i - 1) * 3];
+      aIndices[i * aStride] += aIndices[(i - 1) * aStride];
 
     // Step 2: Reverse delta from third triangle index to the first triangle
     // index
-    aIndices[i * 3 + 2] += aIndices[i * 3];
+    aIndices[i * aStride + 2] += aIndices[i * aStride];
 
     // Step 3: Reverse delta from second triangle index to the previous
     // second triangle index, if the previous triangle shares the same first
     // index, otherwise reverse the delta to the first triangle index
-    if((i >= 1) && (aIndices[i * 3] == aIndices[(i - 1) * 3]))
-      aIndices[i * 3 + 1] += aIndices[(i - 1) * 3 + 1];
+    if((i >= 1) && (aIndices[i * aStride] == aIndices[(i - 1) * aStride]))
+      aIndices[i * aStride + 1] += aIndices[(i - 1) * aStride + 1];
     else
-      aIndices[i * 3 + 1] += aIndices[i * 3];
+      aIndices[i * aStride + 1] += aIndices[i * aStride];
   }
 }
 
@@ -144,14 +147,15 @@ int _ctmCompressMesh_MG1(_CTMcontext * self)
 {
   CTMuint * indices;
   _CTMfloatmap * map;
-  CTMuint i;
+  CTMuint i, k;
 
 #ifdef __DEBUG_
   printf("COMPRESSION METHOD: MG1\n");
 #endif
 
   // Perpare (sort) indices
-  indices = (CTMuint *) malloc(sizeof(CTMuint) * self->mTriangleCount * 3);
+  indices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * self->mTriangleCount * 3);
   if(!indices)
   {
     self->mError = CTM_OUT_OF_MEMORY;
@@ -168,26 +172,23 @@ int _ctmCompressMesh_MG1(_CTMcontext * self)
 #ifdef __DEBUG_
   printf("Inidices: ");
 #endif
-  _ctmStreamWrite(self, (void *) "INDX", 4);
-  if(!_ctmStreamWritePackedInts(self, (CTMint *) indices, self->mTriangleCount, 3, CTM_FALSE))
+  _ctmStreamWriteSection(self, "INDX", (size_t) self->mTriangleCount * 3 * 4);
+  if(!_ctmStreamWritePackedInts(self, (CTMint *) indices, self->mTriangleCount, 3, CTM_FALSE, _CTM_DEST_INDICES))
   {
-    free((void *) indices);
+    _ctmScratchFree(self->mScratch, (void *) indices);
     return CTM_FALSE;
   }
 
   // Free temporary resources
-  free((void *) indices);
+  _ctmScratchFree(self->mScratch, (void *) indices);
 
   // Write vertices
 #ifdef __DEBUG_
   printf("Vertices: ");
 #endif
-  _ctmStreamWrite(self, (void *) "VERT", 4);
-  if(!_ctmStreamWritePackedFloats(self, self->mVertices, self->mVertexCount * 3, 1))
-  {
-    free((void *) indices);
+  _ctmStreamWriteSection(self, "VERT", (size_t) self->mVertexCount * 3 * 4);
+  if(!_ctmStreamWritePackedFloats(self, self->mVertices, self->mVertexCount * 3, 1, _CTM_DEST_VERTICES))
     return CTM_FALSE;
-  }
 
   // Write normals
   if(self->mNormals)
@@ -195,38 +196,42 @@ int _ctmCompressMesh_MG1(_CTMcontext * self)
 #ifdef __DEBUG_
     printf("Normals: ");
 #endif
-    _ctmStreamWrite(self, (void *) "NORM", 4);
-    if(!_ctmStreamWritePackedFloats(self, self->mNormals, self->mVertexCount, 3))
+    _ctmStreamWriteSection(self, "NORM", (size_t) self->mVertexCount * 3 * 4);
+    if(!_ctmStreamWritePackedFloats(self, self->mNormals, self->mVertexCount, 3, _CTM_DEST_NORMALS))
       return CTM_FALSE;
   }
 
   // Write UV maps
   map = self->mUVMaps;
+  k = 0;
   while(map)
   {
 #ifdef __DEBUG_
     printf("UV coordinates (%s): ", map->mName ? map->mName : "no name");
 #endif
-    _ctmStreamWrite(self, (void *) "TEXC", 4);
+    _ctmStreamWriteSection(self, "TEXC", (size_t) self->mVertexCount * 2 * 4);
     _ctmStreamWriteSTRING(self, map->mName);
     _ctmStreamWriteSTRING(self, map->mFileName);
-    if(!_ctmStreamWritePackedFloats(self, map->mValues, self->mVertexCount, 2))
+    if(!_ctmStreamWritePackedFloats(self, map->mValues, self->mVertexCount, 2, _CTM_MAP_SLOT(_CTM_DEST_UV_MAPS, k)))
       return CTM_FALSE;
     map = map->mNext;
+    ++ k;
   }
 
   // Write attribute maps
   map = self->mAttribMaps;
+  k = 0;
   while(map)
   {
 #ifdef __DEBUG_
     printf("Vertex attributes (%s): ", map->mName ? map->mName : "no name");
 #endif
-    _ctmStreamWrite(self, (void *) "ATTR", 4);
+    _ctmStreamWriteSection(self, "ATTR", (size_t) self->mVertexCount * 4 * 4);
     _ctmStreamWriteSTRING(self, map->mName);
-    if(!_ctmStreamWritePackedFloats(self, map->mValues, self->mVertexCount, 4))
+    if(!_ctmStreamWritePackedFloats(self, map->mValues, self->mVertexCount, 4, _CTM_MAP_SLOT(_CTM_DEST_ATTRIB_MAPS, k)))
       return CTM_FALSE;
     map = map->mNext;
+    ++ k;
   }
 
   return CTM_TRUE;
@@ -235,47 +240,56 @@ int _ctmCompressMesh_MG1(_CTMcontext * self)
 //-----------------------------------------------------------------------------
 // _ctmUncompressMesh_MG1() - Uncmpress the mesh from the input stream in the
 // CTM context, and store the resulting mesh in the CTM context.
+// All packed sections are read from the stream first, and then uncompressed
+// (concurrently, if the context allows more than one thread).
 //-----------------------------------------------------------------------------
 int _ctmUncompressMesh_MG1(_CTMcontext * self)
 {
-  CTMuint * indices;
+  _CTMpackjob * jobs, * job;
   _CTMfloatmap * map;
-  CTMuint i;
-
-  // Allocate memory for the indices
-  indices = (CTMuint *) malloc(sizeof(CTMuint) * self->mTriangleCount * 3);
-  if(!indices)
+  CTMfloat * vertices, * normals;
+  CTMuint jobCount, i, j;
+
+  // Allocate one pack job per section: INDX, VERT, NORM (optional), TEXC (one
+  // per UV map) and ATTR (one per attribute map)
+  jobCount = 2 + (self->mNormals ? 1 : 0) + self->mUVMapCount + self->mAttribMapCount;
+  jobs = (_CTMpackjob *) _ctmScratchCalloc(self->mScratch,
+    jobCount * sizeof(_CTMpackjob));
+  if(!jobs)
   {
     self->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
+  job = jobs;
 
   // Read triangle indices
   if(_ctmStreamReadUINT(self) != FOURCC("INDX"))
   {
     self->mError = CTM_BAD_FORMAT;
-    free(indices);
+    _ctmFreePackJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
-  if(!_ctmStreamReadPackedInts(self, (CTMint *) indices, self->mTriangleCount, 3, CTM_FALSE))
+  _ctmInitPackJob(self, job, (void *) self->mIndices, self->mTriangleCount, 3, CTM_FALSE, _CTM_DEST_INDICES);
+  job->mStride = self->mIndexStride;
+  if(!_ctmStreamReadPackJob(self, job ++))
+  {
+    _ctmFreePackJobs(self, jobs, jobCount);
     return CTM_FALSE;
-
-  // Restore indices
-  _ctmRestoreIndices(self, indices);
-  for(i = 0; i < self->mTriangleCount * 3; ++ i)
-    self->mIndices[i] = indices[i];
-
-  // Free temporary resources
-  free(indices);
+  }
 
   // Read vertices
   if(_ctmStreamReadUINT(self) != FOURCC("VERT"))
   {
     self->mError = CTM_BAD_FORMAT;
+    _ctmFreePackJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
-  if(!_ctmStreamReadPackedFloats(self, self->mVertices, self->mVertexCount * 3, 1))
+  _ctmInitPackJob(self, job, (void *) self->mVertices, self->mVertexCount * 3, 1, CTM_FALSE, _CTM_DEST_VERTICES);
+  if(!_ctmStreamReadPackJob(self, job ++))
+  {
+    _ctmFreePackJobs(self, jobs, jobCount);
     return CTM_FALSE;
+  }
 
   // Read normals
   if(self->mNormals)
@@ -283,10 +297,31 @@ int _ctmUncompressMesh_MG1(_CTMcontext * self)
     if(_ctmStreamReadUINT(self) != FOURCC("NORM"))
     {
       self->mError = CTM_BAD_FORMAT;
+      _ctmFreePackJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
-    if(!_ctmStreamReadPackedFloats(self, self->mNormals, self->mVertexCount, 3))
+    _ctmInitPackJob(self, job, (void *) self->mNormals, self->mVertexCount, 3, CTM_FALSE, _CTM_DEST_NORMALS);
+    job->mStride = self->mNormalStride;
+    if(!_ctmStreamReadPackJob(self, job ++))
+    {
+      _ctmFreePackJobs(self, jobs, jobCount);
       return CTM_FALSE;
+    }
+  }
+  else if(self->mSkipNormals && (self->mUVMapCount || self->mAttribMapCount))
+  {
+    // Skip normals (only if there are maps to load after them)
+    if(_ctmStreamReadUINT(self) != FOURCC("NORM"))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    if(!_ctmStreamSkipPacked(self))
+    {
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
   }
 
   // Read UV maps
@@ -296,29 +331,125 @@ int _ctmUncompressMesh_MG1(_CTMcontext * self)
     if(_ctmStreamReadUINT(self) != FOURCC("TEXC"))
     {
       self->mError = CTM_BAD_FORMAT;
-      return 0;
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
     }
     _ctmStreamReadSTRING(self, &map->mName);
     _ctmStreamReadSTRING(self, &map->mFileName);
-    if(!_ctmStreamReadPackedFloats(self, map->mValues, self->mVertexCount, 2))
+    _ctmInitPackJob(self, job, (void *) map->mValues, self->mVertexCount, 2, CTM_FALSE, _CTM_DEST_UV_MAPS);
+    job->mStride = map->mStride;
+    if(!_ctmStreamReadPackJob(self, job ++))
+    {
+      _ctmFreePackJobs(self, jobs, jobCount);
       return CTM_FALSE;
+    }
     map = map->mNext;
   }
 
-  // Read vertex attribute maps
+  // Skip UV maps (only if there are attribute maps to load after them)
+  for(i = 0; (i < self->mSkipUVMaps) && self->mAttribMapCount; ++ i)
+  {
+    if(_ctmStreamReadUINT(self) != FOURCC("TEXC"))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    if(!_ctmStreamSkipSTRING(self) || !_ctmStreamSkipSTRING(self) ||
+       !_ctmStreamSkipPacked(self))
+    {
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+  }
+
+  // Read vertex attribute maps (skipped attribute maps are last in the file,
+  // so they are simply not read)
   map = self->mAttribMaps;
   while(map)
   {
     if(_ctmStreamReadUINT(self) != FOURCC("ATTR"))
     {
       self->mError = CTM_BAD_FORMAT;
-      return 0;
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
     }
     _ctmStreamReadSTRING(self, &map->mName);
-    if(!_ctmStreamReadPackedFloats(self, map->mValues, self->mVertexCount, 4))
+    _ctmInitPackJob(self, job, (void *) map->mValues, self->mVertexCount, 4, CTM_FALSE, _CTM_DEST_ATTRIB_MAPS);
+    job->mStride = map->mStride;
+    if(!_ctmStreamReadPackJob(self, job ++))
+    {
+      _ctmFreePackJobs(self, jobs, jobCount);
       return CTM_FALSE;
+    }
     map = map->mNext;
   }
 
+  // The vertices are packed as one flat array, so a vertex array with a custom
+  // stride is uncompressed into a temporary array first
+  vertices = self->mVertices;
+  if(self->mVertexStride != 3)
+  {
+    vertices = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMfloat) * self->mVertexCount * 3);
+    if(!vertices)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    jobs[1].mData = (void *) vertices;
+  }
+
+  // Normals in a 16-bit format are uncompressed into a temporary float array
+  // first, and converted afterwards
+  normals = self->mNormals;
+  if(self->mNormals && (self->mNormalFormat != CTM_FORMAT_FLOAT32))
+  {
+    normals = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMfloat) * self->mVertexCount * 3);
+    if(!normals)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      if(vertices != self->mVertices)
+        _ctmScratchFree(self->mScratch, vertices);
+      _ctmFreePackJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    jobs[2].mData = (void *) normals;
+    jobs[2].mStride = 3;
+  }
+
+  // Uncompress all sections
+  if(!_ctmUnpackJobs(self, jobs, jobCount))
+  {
+    if(normals != self->mNormals)
+      _ctmScratchFree(self->mScratch, normals);
+    if(vertices != self->mVertices)
+      _ctmScratchFree(self->mScratch, vertices);
+    _ctmFreePackJobs(self, jobs, jobCount);
+    return CTM_FALSE;
+  }
+  _ctmFreePackJobs(self, jobs, jobCount);
+
+  // Convert the normals to the selected normal format
+  if(normals != self->mNormals)
+  {
+    _ctmWriteNormals(self, normals);
+    _ctmScratchFree(self->mScratch, normals);
+  }
+
+  // Copy the vertices to the custom stride vertex array
+  if(vertices != self->mVertices)
+  {
+    for(i = 0; i < self->mVertexCount; ++ i)
+      for(j = 0; j < 3; ++ j)
+        self->mVertices[i * self->mVertexStride + j] = vertices[i * 3 + j];
+    _ctmScratchFree(self->mScratch, vertices);
+  }
+
+  // Restore indices
+  _ctmRestoreIndices(self, self->mIndices, self->mIndexStride);
+
   return CTM_TRUE;
 }
@@ -34,26 +34,24 @@
 #include <stdio.h>
 #endif
 
+// Select which SIMD version to build (define OPENCTM_NO_SIMD to only build
+// the portable C version)
+#if !defined(OPENCTM_NO_SIMD)
+  #if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+      (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define _CTM_USE_SSE2
+  #endif
+#endif
+
 // We need PI
 #ifndef PI
 #define PI 3.141592653589793238462643f
 #endif
 
+// Minimum number of vertices per thread for the vertex setup passes
+#define _CTM_MG2_MIN_SPLIT 65536
 
-//-----------------------------------------------------------------------------
-// _CTMgrid - 3D space subdivision grid.
-//-----------------------------------------------------------------------------
-typedef struct {
-  // Axis-aligned boudning box for the grid.
-  CTMfloat mMin[3];
-  CTMfloat mMax[3];
-
-  // How many divisions per axis (minimum 1).
-  CTMuint mDivision[3];
-
-  // Size of each grid box.
-  CTMfloat mSize[3];
-} _CTMgrid;
 
 //-----------------------------------------------------------------------------
 // _CTMsortvertex - Vertex information.
@@ -78,24 +76,8 @@ static void _ctmSetupGrid(_CTMcontext * self, _CTMgrid * aGrid)
   CTMfloat factor[3], sum, wantedGrids;
 
   // Calculate the mesh bounding box
-  aGrid->mMin[0] = aGrid->mMax[0] = self->mVertices[0];
-  aGrid->mMin[1] = aGrid->mMax[1] = self->mVertices[1];
-  aGrid->mMin[2] = aGrid->mMax[2] = self->mVertices[2];
-  for(i = 1; i < self->mVertexCount; ++ i)
-  {
-    if(self->mVertices[i * 3] < aGrid->mMin[0])
-      aGrid->mMin[0] = self->mVertices[i * 3];
-    else if(self->mVertices[i * 3] > aGrid->mMax[0])
-      aGrid->mMax[0] = self->mVertices[i * 3];
-    if(self->mVertices[i * 3 + 1] < aGrid->mMin[1])
-      aGrid->mMin[1] = self->mVertices[i * 3 + 1];
-    else if(self->mVertices[i * 3 + 1] > aGrid->mMax[1])
-      aGrid->mMax[1] = self->mVertices[i * 3 + 1];
-    if(self->mVertices[i * 3 + 2] < aGrid->mMin[2])
-      aGrid->mMin[2] = self->mVertices[i * 3 + 2];
-    else if(self->mVertices[i * 3 + 2] > aGrid->mMax[2])
-      aGrid->mMax[2] = self->mVertices[i * 3 + 2];
-  }
+  _ctmBoundingBox(self, self->mVertices, self->mVertexCount, aGrid->mMin,
+                  aGrid->mMax);
 
   // Determine optimal grid resolution, based on the number of vertices and
   // the bounding box.
@@ -188,6 +170,35 @@ static int _compareVertex(const void * elem1, const void * elem2)
     return 0;
 }
 
+//-----------------------------------------------------------------------------
+// _CTMgridtask - Grid box assignment for a range of vertices.
+//-----------------------------------------------------------------------------
+typedef struct {
+  _CTMcontext * mContext;
+  _CTMgrid * mGrid;
+  _CTMsortvertex * mSortVertices;
+  CTMuint mStart;
+  CTMuint mEnd;
+} _CTMgridtask;
+
+//-----------------------------------------------------------------------------
+// _ctmGridTask() - Store the properties of a range of vertices in the sort
+// vertex array.
+//-----------------------------------------------------------------------------
+static void _ctmGridTask(void * aItem)
+{
+  _CTMgridtask * task = (_CTMgridtask *) aItem;
+  CTMfloat * vertices = task->mContext->mVertices;
+  CTMuint i;
+
+  for(i = task->mStart; i < task->mEnd; ++ i)
+  {
+    task->mSortVertices[i].x = vertices[i * 3];
+    task->mSortVertices[i].mGridIndex = _ctmPointToGridIdx(task->mGrid, &vertices[i * 3]);
+    task->mSortVertices[i].mOriginalIndex = i;
+  }
+}
+
 //-----------------------------------------------------------------------------
 // _ctmSortVertices() - Setup the vertex array. Assign each vertex to a grid
 // box, and sort all vertices.
@@ -195,20 +206,40 @@ static int _compareVertex(const void * elem1, const void * elem2)
 static void _ctmSortVertices(_CTMcontext * self, _CTMsortvertex * aSortVertices,
   _CTMgrid * aGrid)
 {
-  CTMuint i;
-
-  // Prepare sort vertex array
-  for(i = 0; i < self->mVertexCount; ++ i)
+  _CTMgridtask single, * tasks;
+  CTMuint taskCount, count, i;
+
+  // Prepare sort vertex array (split into one range per thread, if the mesh
+  // is large enough)
+  taskCount = _ctmSplitCount(self, self->mVertexCount, _CTM_MG2_MIN_SPLIT);
+  tasks = (_CTMgridtask *) 0;
+  if(taskCount > 1)
+    tasks = (_CTMgridtask *) _ctmScratchAlloc(self->mScratch,
+      sizeof(_CTMgridtask) * taskCount);
+  if(!tasks)
   {
-    // Store vertex properties in the sort vertex array
-    aSortVertices[i].x = self->mVertices[i * 3];
-    aSortVertices[i].mGridIndex = _ctmPointToGridIdx(aGrid, &self->mVertices[i * 3]);
-    aSortVertices[i].mOriginalIndex = i;
+    tasks = &single;
+    taskCount = 1;
   }
+  count = self->mVertexCount / taskCount;
+  for(i = 0; i < taskCount; ++ i)
+  {
+    tasks[i].mContext = self;
+    tasks[i].mGrid = aGrid;
+    tasks[i].mSortVertices = aSortVertices;
+    tasks[i].mStart = i * count;
+    tasks[i].mEnd = (i == taskCount - 1) ? self->mVertexCount : (i + 1) * count;
+  }
+  _ctmRunTasks(self, _ctmGridTask, (void *) tasks, taskCount,
+               sizeof(_CTMgridtask));
+  if(tasks != &single)
+    _ctmScratchFree(self->mScratch, tasks);
 
   // Sort vertices. The elements are first sorted by their grid indices, and
-  // scondly by their x coordinates.
-  qsort((void *) aSortVertices, self->mVertexCount, sizeof(_CTMsortvertex), _compareVertex);
+  // scondly by their x coordinates (with a radix sort if possible).
+  if(!_ctmRadixSort(self->mScratch, (void *) aSortVertices, self->mVertexCount,
+                    sizeof(_CTMsortvertex) / sizeof(CTMuint), 1, 0, CTM_TRUE))
+    qsort((void *) aSortVertices, self->mVertexCount, sizeof(_CTMsortvertex), _compareVertex);
 }
 
 //-----------------------------------------------------------------------------
@@ -220,7 +251,8 @@ static int _ctmReIndexIndices(_CTMcontext * self, _CTMsortvertex * aSortVertices
   CTMuint i, * indexLUT;
 
   // Create temporary lookup-array, O(n)
-  indexLUT = (CTMuint *) malloc(sizeof(CTMuint) * self->mVertexCount);
+  indexLUT = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * self->mVertexCount);
   if(!indexLUT)
   {
     self->mError = CTM_OUT_OF_MEMORY;
@@ -234,7 +266,7 @@ static int _ctmReIndexIndices(_CTMcontext * self, _CTMsortvertex * aSortVertices
     aIndices[i] = indexLUT[self->mIndices[i]];
 
   // Free temporary lookup-array
-  free((void *) indexLUT);
+  _ctmScratchFree(self->mScratch, (void *) indexLUT);
 
   return CTM_TRUE;
 }
@@ -281,8 +313,10 @@ static void _ctmReArrangeTriangles(_CTMcontext * self, CTMuint * aIndices)
     }
   }
 
-  // Step 2: Sort the triangles based on the first triangle index
-  qsort((void *) aIndices, self->mTriangleCount, sizeof(CTMuint) * 3, _compareTriangle);
+  // Step 2: Sort the triangles based on the first triangle index (and secondly
+  // the second triangle index), with a radix sort if possible
+  if(!_ctmRadixSort(self->mScratch, (void *) aIndices, self->mTriangleCount, 3, 0, 1, CTM_FALSE))
+    qsort((void *) aIndices, self->mTriangleCount, sizeof(CTMuint) * 3, _compareTriangle);
 }
 
 //-----------------------------------------------------------------------------
@@ -314,9 +348,10 @@ static void _ctmMakeIndexDeltas(_CTMcontext * self, CTMuint * aIndices)
 
 //-----------------------------------------------------------------------------
 // _ctmRestoreIndices() - Restore original indices (inverse derivative
-// operation).
+// operation). aStride is the distance between two triangles in aIndices.
 //-----------------------------------------------------------------------------
-static void _ctmRestoreIndices(_CTMcontext * self, CTMuint * aIndices)
+static void _ctmRestoreIndices(_CTMcontext * self, CTMuint * aIndices,
+  CTMuint aStride)
 {
   CTMuint i;
 
@@ -324,19 +359,19 @@ static void _ctmRestoreIndices(_CTMcontext * self, CTMuint * aIndices)
   {
     // Step 1: Reverse derivative of the first triangle index
     if(i >= 1)
-      aIndices[i * 3] += aIndices[(i - 1) * 3];
+      aIndices[i * aStride] += aIndices[(i - 1) * aStride];
 
     // Step 2: Reverse delta from third triangle index to the first triangle
     // index
-    aIndices[i * 3 + 2] += aIndices[i * 3];
+    aIndices[i * aStride + 2] += aIndices[i * aStride];
 
     // Step 3: Reverse delta from second triangle index to the previous
     // second triangle index, if the previous triangle shares the same first
     // index, otherwise reverse the delta to the first triangle index
-    if((i >= 1) && (aIndices[i * 3] == aIndices[(i - 1) * 3]))
-      aIndices[i * 3 + 1] += aIndices[(i - 1) * 3 + 1];
+    if((i >= 1) && (aIndices[i * aStride] == aIndices[(i - 1) * aStride]))
+      aIndices[i * aStride + 1] += aIndices[(i - 1) * aStride + 1];
     else
-      aIndices[i * 3 + 1] += aIndices[i * 3];
+      aIndices[i * aStride + 1] += aIndices[i * aStride];
   }
 }
 
@@ -383,9 +418,11 @@ static void _ctmMakeVertexDeltas(_CTMcontext * self, CTMint * aIntVertices,
 
 //-----------------------------------------------------------------------------
 // _ctmRestoreVertices() - Calculate inverse derivatives of the vertices.
+// aStride is the distance between two vertices in aVertices.
 //-----------------------------------------------------------------------------
 static void _ctmRestoreVertices(_CTMcontext * self, CTMint * aIntVertices,
-  CTMuint * aGridIndices, _CTMgrid * aGrid, CTMfloat * aVertices)
+  CTMuint * aGridIndices, _CTMgrid * aGrid, CTMfloat * aVertices,
+  CTMuint aStride)
 {
   CTMuint i, gridIdx, prevGridIndex;
   CTMfloat gridOrigin[3], scale;
@@ -405,9 +442,9 @@ static void _ctmRestoreVertices(_CTMcontext * self, CTMint * aIntVertices,
     deltaX = aIntVertices[i * 3];
     if(gridIdx == prevGridIndex)
       deltaX += prevDeltaX;
-    aVertices[i * 3] = scale * deltaX + gridOrigin[0];
-    aVertices[i * 3 + 1] = scale * aIntVertices[i * 3 + 1] + gridOrigin[1];
-    aVertices[i * 3 + 2] = scale * aIntVertices[i * 3 + 2] + gridOrigin[2];
+    aVertices[i * aStride] = scale * deltaX + gridOrigin[0];
+    aVertices[i * aStride + 1] = scale * aIntVertices[i * 3 + 1] + gridOrigin[1];
+    aVertices[i * aStride + 2] = scale * aIntVertices[i * 3 + 2] + gridOrigin[2];
 
     prevGridIndex = gridIdx;
     prevDeltaX = deltaX;
@@ -415,66 +452,327 @@ static void _ctmRestoreVertices(_CTMcontext * self, CTMint * aIntVertices,
 }
 
 //-----------------------------------------------------------------------------
-// _ctmCalcSmoothNormals() - Calculate the smooth normals for a given mesh.
-// These are used as the nominal normals for normal deltas & reconstruction.
+// _ctmMakeFixedVertices() - Convert the vertices to integers on one fixed point
+// grid for the whole mesh, with its origin at the minimum corner of the
+// bounding box (used with parallelogram prediction, which does not work with
+// one origin per grid box).
 //-----------------------------------------------------------------------------
-static void _ctmCalcSmoothNormals(_CTMcontext * self, CTMfloat * aVertices,
-  CTMuint * aIndices, CTMfloat * aSmoothNormals)
+static void _ctmMakeFixedVertices(_CTMcontext * self, CTMint * aIntVertices,
+  _CTMsortvertex * aSortVertices, _CTMgrid * aGrid)
 {
-  CTMuint i, j, k, tri[3];
-  CTMfloat len;
-  CTMfloat v1[3], v2[3], n[3];
-
-  // Clear smooth normals array
-  for(i = 0; i < 3 * self->mVertexCount; ++ i)
-    aSmoothNormals[i] = 0.0f;
+  CTMuint i, j, oldIdx;
+  CTMfloat scale;
 
-  // Calculate sums of all neigbouring triangle normals for each vertex
-  for(i = 0; i < self->mTriangleCount; ++ i)
+  scale = 1.0f / self->mVertexPrecision;
+  for(i = 0; i < self->mVertexCount; ++ i)
   {
-    // Get triangle corner indices
+    oldIdx = aSortVertices[i].mOriginalIndex;
     for(j = 0; j < 3; ++ j)
-      tri[j] = aIndices[i * 3 + j];
+      aIntVertices[i * 3 + j] = (CTMint) floorf(scale * (self->mVertices[oldIdx * 3 + j] - aGrid->mMin[j]) + 0.5f);
+  }
+}
 
-    // Calculate the normalized cross product of two triangle edges (i.e. the
-    // flat triangle normal)
-    for(j = 0; j < 3; ++ j)
-    {
-      v1[j] = aVertices[tri[1] * 3 + j] - aVertices[tri[0] * 3 + j];
-      v2[j] = aVertices[tri[2] * 3 + j] - aVertices[tri[0] * 3 + j];
-    }
-    n[0] = v1[1] * v2[2] - v1[2] * v2[1];
-    n[1] = v1[2] * v2[0] - v1[0] * v2[2];
-    n[2] = v1[0] * v2[1] - v1[1] * v2[0];
-    len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
-    if(len > 1e-10f)
-      len = 1.0f / len;
-    else
-      len = 1.0f;
+//-----------------------------------------------------------------------------
+// _ctmRestoreFixedVertices() - Convert fixed point vertices (see
+// _ctmMakeFixedVertices()) to floats. aStride is the distance between two
+// vertices in aVertices.
+//-----------------------------------------------------------------------------
+static void _ctmRestoreFixedVertices(_CTMcontext * self, CTMint * aIntVertices,
+  _CTMgrid * aGrid, CTMfloat * aVertices, CTMuint aStride)
+{
+  CTMuint i, j;
+  CTMfloat scale;
+
+  scale = self->mVertexPrecision;
+  for(i = 0; i < self->mVertexCount; ++ i)
+  {
     for(j = 0; j < 3; ++ j)
-      n[j] *= len;
+      aVertices[i * aStride + j] = scale * aIntVertices[i * 3 + j] + aGrid->mMin[j];
+  }
+}
+
+#if defined(_CTM_USE_SSE2)
+//-----------------------------------------------------------------------------
+// _ctmDeinterleave4() - Deinterleave four 3D vectors into one register per
+// component (one vector per lane). The input layout is:
+// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+//-----------------------------------------------------------------------------
+static void _ctmDeinterleave4(__m128 a, __m128 b, __m128 c, __m128 * aX,
+  __m128 * aY, __m128 * aZ)
+{
+  __m128 t, u;
+  t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+  *aX = _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0));
+  t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+  u = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+  *aY = _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0));
+  t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+  *aZ = _mm_shuffle_ps(t, c, _MM_SHUFFLE(3, 0, 2, 0));
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLoadVectors4() - Load and deinterleave four consecutive 3D vectors.
+//-----------------------------------------------------------------------------
+static void _ctmLoadVectors4(const CTMfloat * aVectors, __m128 * aX,
+  __m128 * aY, __m128 * aZ)
+{
+  _ctmDeinterleave4(_mm_loadu_ps(&aVectors[0]), _mm_loadu_ps(&aVectors[4]),
+                    _mm_loadu_ps(&aVectors[8]), aX, aY, aZ);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStoreVectors4() - Interleave and store four 3D vectors (the reverse of
+// _ctmLoadVectors4()).
+//-----------------------------------------------------------------------------
+static void _ctmStoreVectors4(CTMfloat * aVectors, __m128 aX, __m128 aY,
+  __m128 aZ)
+{
+  __m128 t, u;
+  t = _mm_shuffle_ps(aX, aY, _MM_SHUFFLE(0, 0, 0, 0));
+  u = _mm_shuffle_ps(aZ, aX, _MM_SHUFFLE(1, 1, 0, 0));
+  _mm_storeu_ps(&aVectors[0], _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+  t = _mm_shuffle_ps(aY, aZ, _MM_SHUFFLE(1, 1, 1, 1));
+  u = _mm_shuffle_ps(aX, aY, _MM_SHUFFLE(2, 2, 2, 2));
+  _mm_storeu_ps(&aVectors[4], _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+  t = _mm_shuffle_ps(aZ, aX, _MM_SHUFFLE(3, 3, 2, 2));
+  u = _mm_shuffle_ps(aY, aZ, _MM_SHUFFLE(3, 3, 3, 3));
+  _mm_storeu_ps(&aVectors[8], _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+//-----------------------------------------------------------------------------
+// _ctmNormalize4() - Normalize four vectors (one per lane), or leave them as
+// they are if they are shorter than 1e-10. This uses the same operations as
+// the C code in _ctmCalcFlatNormal() and _ctmSmoothNormalsTask().
+//-----------------------------------------------------------------------------
+static void _ctmNormalize4(__m128 * aX, __m128 * aY, __m128 * aZ)
+{
+  __m128 len, m;
+  len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(*aX, *aX),
+                                          _mm_mul_ps(*aY, *aY)),
+                               _mm_mul_ps(*aZ, *aZ)));
+  m = _mm_cmpgt_ps(len, _mm_set1_ps(1e-10f));
+  len = _mm_or_ps(_mm_and_ps(m, _mm_div_ps(_mm_set1_ps(1.0f), len)),
+                  _mm_andnot_ps(m, _mm_set1_ps(1.0f)));
+  *aX = _mm_mul_ps(*aX, len);
+  *aY = _mm_mul_ps(*aY, len);
+  *aZ = _mm_mul_ps(*aZ, len);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// _ctmCalcFlatNormal() - Calculate the normalized cross product of two
+// triangle edges (i.e. the flat triangle normal).
+//-----------------------------------------------------------------------------
+static void _ctmCalcFlatNormal(const CTMfloat * aVertices,
+  CTMuint aVertexStride, const CTMuint * aTri, CTMfloat * aNormal)
+{
+  CTMuint j;
+  CTMfloat len, v1[3], v2[3];
+
+  for(j = 0; j < 3; ++ j)
+  {
+    v1[j] = aVertices[aTri[1] * aVertexStride + j] - aVertices[aTri[0] * aVertexStride + j];
+    v2[j] = aVertices[aTri[2] * aVertexStride + j] - aVertices[aTri[0] * aVertexStride + j];
+  }
+  aNormal[0] = v1[1] * v2[2] - v1[2] * v2[1];
+  aNormal[1] = v1[2] * v2[0] - v1[0] * v2[2];
+  aNormal[2] = v1[0] * v2[1] - v1[1] * v2[0];
+  len = sqrtf(aNormal[0] * aNormal[0] + aNormal[1] * aNormal[1] + aNormal[2] * aNormal[2]);
+  if(len > 1e-10f)
+    len = 1.0f / len;
+  else
+    len = 1.0f;
+  for(j = 0; j < 3; ++ j)
+    aNormal[j] *= len;
+}
+
+#if defined(_CTM_USE_SSE2)
+//-----------------------------------------------------------------------------
+// _ctmCalcFlatNormals4() - SSE2 version of _ctmCalcFlatNormal() for four
+// triangles. The normals are stored as four consecutive 3D vectors.
+//-----------------------------------------------------------------------------
+static void _ctmCalcFlatNormals4(const CTMfloat * aVertices,
+  CTMuint aVertexStride, const CTMuint * const * aTris, CTMfloat * aNormals)
+{
+  CTMfloat p[9][4];
+  CTMuint i, j, k;
+  __m128 x0, y0, z0, x1, y1, z1, x2, y2, z2;
 
-    // Add the flat normal to all three triangle vertices
+  // Gather the triangle corners (one triangle per lane)
+  for(i = 0; i < 4; ++ i)
     for(k = 0; k < 3; ++ k)
       for(j = 0; j < 3; ++ j)
-        aSmoothNormals[tri[k] * 3 + j] += n[j];
+        p[k * 3 + j][i] = aVertices[aTris[i][k] * aVertexStride + j];
+
+  // Triangle edges
+  x0 = _mm_loadu_ps(p[0]);
+  y0 = _mm_loadu_ps(p[1]);
+  z0 = _mm_loadu_ps(p[2]);
+  x1 = _mm_sub_ps(_mm_loadu_ps(p[3]), x0);
+  y1 = _mm_sub_ps(_mm_loadu_ps(p[4]), y0);
+  z1 = _mm_sub_ps(_mm_loadu_ps(p[5]), z0);
+  x2 = _mm_sub_ps(_mm_loadu_ps(p[6]), x0);
+  y2 = _mm_sub_ps(_mm_loadu_ps(p[7]), y0);
+  z2 = _mm_sub_ps(_mm_loadu_ps(p[8]), z0);
+
+  // Cross product, normalized
+  x0 = _mm_sub_ps(_mm_mul_ps(y1, z2), _mm_mul_ps(z1, y2));
+  y0 = _mm_sub_ps(_mm_mul_ps(z1, x2), _mm_mul_ps(x1, z2));
+  z0 = _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(y1, x2));
+  _ctmNormalize4(&x0, &y0, &z0);
+  _ctmStoreVectors4(aNormals, x0, y0, z0);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// _CTMsmoothtask - Smooth normal calculation for a range of vertices.
+//-----------------------------------------------------------------------------
+typedef struct {
+  const CTMfloat * mVertices;
+  CTMuint mVertexStride;
+  const CTMuint * mIndices;
+  CTMuint mIndexStride;
+  CTMuint mTriangleCount;
+  CTMfloat * mSmoothNormals;
+  CTMuint mStart;
+  CTMuint mEnd;
+} _CTMsmoothtask;
+
+//-----------------------------------------------------------------------------
+// _ctmAddFlatNormals() - Add the flat normals of a batch of triangles to
+// those of their vertices that belong to the task.
+//-----------------------------------------------------------------------------
+static void _ctmAddFlatNormals(_CTMsmoothtask * aTask,
+  const CTMuint * const * aTris, CTMuint aCount)
+{
+  CTMfloat n[12];
+  CTMuint i, j, k, count;
+
+  i = 0;
+#if defined(_CTM_USE_SSE2)
+  if(aCount == 4)
+  {
+    _ctmCalcFlatNormals4(aTask->mVertices, aTask->mVertexStride, aTris, n);
+    i = 4;
+  }
+#endif
+  for(; i < aCount; ++ i)
+    _ctmCalcFlatNormal(aTask->mVertices, aTask->mVertexStride, aTris[i], &n[i * 3]);
+
+  count = aTask->mEnd - aTask->mStart;
+  for(i = 0; i < aCount; ++ i)
+    for(k = 0; k < 3; ++ k)
+      if(aTris[i][k] - aTask->mStart < count)
+        for(j = 0; j < 3; ++ j)
+          aTask->mSmoothNormals[aTris[i][k] * 3 + j] += n[i * 3 + j];
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSmoothNormalsTask() - Calculate the smooth normals for a range of
+// vertices. All the triangles are visited in order, so the flat normals are
+// added in the same order regardless of how the vertices are split between
+// the tasks.
+//-----------------------------------------------------------------------------
+static void _ctmSmoothNormalsTask(void * aItem)
+{
+  _CTMsmoothtask * task = (_CTMsmoothtask * ) aItem;
+  const CTMuint * tris[4], * tri;
+  CTMfloat len, * n;
+  CTMuint i, j, count, batch;
+
+  // Clear smooth normals array
+  for(i = task->mStart * 3; i < task->mEnd * 3; ++ i)
+    task->mSmoothNormals[i] = 0.0f;
+
+  // Calculate sums of all neigbouring triangle normals for each vertex (four
+  // triangles at a time)
+  count = task->mEnd - task->mStart;
+  batch = 0;
+  for(i = 0; i < task->mTriangleCount; ++ i)
+  {
+    tri = &task->mIndices[i * task->mIndexStride];
+    if((tri[0] - task->mStart < count) || (tri[1] - task->mStart < count) ||
+       (tri[2] - task->mStart < count))
+    {
+      tris[batch ++] = tri;
+      if(batch == 4)
+      {
+        _ctmAddFlatNormals(task, tris, batch);
+        batch = 0;
+      }
+    }
   }
+  _ctmAddFlatNormals(task, tris, batch);
 
   // Normalize the normal sums, which gives the unit length smooth normals
-  for(i = 0; i < self->mVertexCount; ++ i)
+  i = task->mStart;
+#if defined(_CTM_USE_SSE2)
+  for(; i + 4 <= task->mEnd; i += 4)
+  {
+    __m128 x, y, z;
+    _ctmLoadVectors4(&task->mSmoothNormals[i * 3], &x, &y, &z);
+    _ctmNormalize4(&x, &y, &z);
+    _ctmStoreVectors4(&task->mSmoothNormals[i * 3], x, y, z);
+  }
+#endif
+  for(; i < task->mEnd; ++ i)
   {
-    len = sqrtf(aSmoothNormals[i * 3] * aSmoothNormals[i * 3] + 
-                aSmoothNormals[i * 3 + 1] * aSmoothNormals[i * 3 + 1] +
-                aSmoothNormals[i * 3 + 2] * aSmoothNormals[i * 3 + 2]);
+    n = &task->mSmoothNormals[i * 3];
+    len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
     if(len > 1e-10f)
       len = 1.0f / len;
     else
       len = 1.0f;
     for(j = 0; j < 3; ++ j)
-      aSmoothNormals[i * 3 + j] *= len;
+      n[j] *= len;
   }
 }
 
+//-----------------------------------------------------------------------------
+// _ctmCalcSmoothNormals() - Calculate the smooth normals for a given mesh.
+// These are used as the nominal normals for normal deltas & reconstruction.
+// aVertexStride and aIndexStride are the distances between two vertices and
+// two triangles, respectively.
+// Note: The encoder and the decoder must get exactly the same smooth
+// normals, so the result must not depend on the number of threads. Each
+// thread handles a range of vertices, and visits all triangles in order.
+//-----------------------------------------------------------------------------
+static void _ctmCalcSmoothNormals(_CTMcontext * self, CTMfloat * aVertices,
+  CTMuint aVertexStride, CTMuint * aIndices, CTMuint aIndexStride,
+  CTMfloat * aSmoothNormals)
+{
+  _CTMsmoothtask single, * tasks;
+  CTMuint taskCount, count, i;
+
+  // Split the vertices into one range per thread (if the mesh is large enough)
+  taskCount = _ctmSplitCount(self, self->mVertexCount, _CTM_MG2_MIN_SPLIT);
+  tasks = (_CTMsmoothtask *) 0;
+  if(taskCount > 1)
+    tasks = (_CTMsmoothtask *) _ctmScratchAlloc(self->mScratch,
+      sizeof(_CTMsmoothtask) * taskCount);
+  if(!tasks)
+  {
+    tasks = &single;
+    taskCount = 1;
+  }
+  count = self->mVertexCount / taskCount;
+  for(i = 0; i < taskCount; ++ i)
+  {
+    tasks[i].mVertices = aVertices;
+    tasks[i].mVertexStride = aVertexStride;
+    tasks[i].mIndices = aIndices;
+    tasks[i].mIndexStride = aIndexStride;
+    tasks[i].mTriangleCount = self->mTriangleCount;
+    tasks[i].mSmoothNormals = aSmoothNormals;
+    tasks[i].mStart = i * count;
+    tasks[i].mEnd = (i == taskCount - 1) ? self->mVertexCount : (i + 1) * count;
+  }
+  _ctmRunTasks(self, _ctmSmoothNormalsTask, (void *) tasks, taskCount,
+               sizeof(_CTMsmoothtask));
+  if(tasks != &single)
+    _ctmScratchFree(self->mScratch, tasks);
+}
+
 //-----------------------------------------------------------------------------
 // _ctmMakeNormalCoordSys() - Create an ortho-normalized coordinate system
 // where the Z-axis is aligned with the given normal.
@@ -533,7 +831,8 @@ static CTMint _ctmMakeNormalDeltas(_CTMcontext * self, CTMint * aIntNormals,
   CTMfloat * smoothNormals, n[3], n2[3], basisAxes[9];
 
   // Allocate temporary memory for the nominal vertex normals
-  smoothNormals = (CTMfloat *) malloc(3 * sizeof(CTMfloat) * self->mVertexCount);
+  smoothNormals = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+    3 * sizeof(CTMfloat) * self->mVertexCount);
   if(!smoothNormals)
   {
     self->mError = CTM_OUT_OF_MEMORY;
@@ -542,7 +841,7 @@ static CTMint _ctmMakeNormalDeltas(_CTMcontext * self, CTMint * aIntNormals,
 
   // Calculate smooth normals (Note: aVertices and aIndices use the sorted
   // index space, so smoothNormals will too)
-  _ctmCalcSmoothNormals(self, aVertices, aIndices, smoothNormals);
+  _ctmCalcSmoothNormals(self, aVertices, 3, aIndices, 3, smoothNormals);
 
   // Normal scaling factor
   scale = 1.0f / self->mNormalPrecision;
@@ -601,7 +900,7 @@ static CTMint _ctmMakeNormalDeltas(_CTMcontext * self, CTMint * aIntNormals,
   }
 
   // Free temporary resources
-  free(smoothNormals);
+  _ctmScratchFree(self->mScratch, smoothNormals);
 
   return CTM_TRUE;
 }
@@ -616,7 +915,8 @@ static CTMint _ctmRestoreNormals(_CTMcontext * self, CTMint * aIntNormals)
   CTMfloat * smoothNormals, n[3], n2[3], basisAxes[9];
 
   // Allocate temporary memory for the nominal vertex normals
-  smoothNormals = (CTMfloat *) malloc(3 * sizeof(CTMfloat) * self->mVertexCount);
+  smoothNormals = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+    3 * sizeof(CTMfloat) * self->mVertexCount);
   if(!smoothNormals)
   {
     self->mError = CTM_OUT_OF_MEMORY;
@@ -624,7 +924,8 @@ static CTMint _ctmRestoreNormals(_CTMcontext * self, CTMint * aIntNormals)
   }
 
   // Calculate smooth normals (nominal normals)
-  _ctmCalcSmoothNormals(self, self->mVertices, self->mIndices, smoothNormals);
+  _ctmCalcSmoothNormals(self, self->mVertices, self->mVertexStride,
+                        self->mIndices, self->mIndexStride, smoothNormals);
 
   // Normal scaling factor
   scale = self->mNormalPrecision;
@@ -658,11 +959,277 @@ static CTMint _ctmRestoreNormals(_CTMcontext * self, CTMint * aIntNormals)
 
     // Apply normal magnitude, and output to the normals array
     for(j = 0; j < 3; ++ j)
-      self->mNormals[i * 3 + j] = n[j] * magn;
+      n[j] *= magn;
+    _ctmWriteNormal(self, i, n);
+  }
+
+  // Free temporary resources
+  _ctmScratchFree(self->mScratch, smoothNormals);
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmMakeOctahedralBasis() - Create the ortho-normalized coordinate system
+// for octahedral normals, where the Z-axis is aligned with the given smooth
+// normal. This is the same system as _ctmMakeNormalCoordSys() gives, except
+// that a zero smooth normal (a vertex that is not used by any triangle) gives
+// the Z-axis (0,0,1), and that the X-axis is (0,1,0) where the usual X-axis
+// vanishes. The SIMD version in _ctmRestoreOctahedralNormals() must use
+// exactly the same operations.
+//-----------------------------------------------------------------------------
+static void _ctmMakeOctahedralBasis(const CTMfloat * aNormal,
+  CTMfloat * aBasisAxes)
+{
+  CTMfloat len, * x, * y, * z;
+  CTMuint i;
+
+  // Pointers to the basis axes (aBasisAxes is a 3x3 matrix)
+  x = aBasisAxes;
+  y = &aBasisAxes[3];
+  z = &aBasisAxes[6];
+
+  // Z = normal (unit length, or zero)
+  if(aNormal[0] * aNormal[0] + aNormal[1] * aNormal[1] +
+     aNormal[2] * aNormal[2] < 0.5f)
+  {
+    z[0] = 0.0f;
+    z[1] = 0.0f;
+    z[2] = 1.0f;
+  }
+  else
+  {
+    for(i = 0; i < 3; ++ i)
+      z[i] = aNormal[i];
+  }
+
+  // X = (0,0,1) x normal + (1,0,0) x normal, normalized
+  x[0] = -z[1];
+  x[1] = z[0] - z[2];
+  x[2] = z[1];
+  len = 2.0f * x[0] * x[0] + x[1] * x[1];
+  if(len > 1.0e-20f)
+  {
+    len = 1.0f / sqrtf(len);
+    x[0] *= len;
+    x[1] *= len;
+    x[2] *= len;
+  }
+  else
+  {
+    x[0] = 0.0f;
+    x[1] = 1.0f;
+    x[2] = 0.0f;
+  }
+
+  // Let Y = Z x X  (no normalization needed, since |Z| = |X| = 1)
+  y[0] = z[1] * x[2] - z[2] * x[1];
+  y[1] = z[2] * x[0] - z[0] * x[2];
+  y[2] = z[0] * x[1] - z[1] * x[0];
+}
+
+//-----------------------------------------------------------------------------
+// _ctmMakeOctahedralNormals() - Convert the normals to a new representation:
+// magnitude, u, v, where (u, v) is the octahedral mapping of the normal in a
+// coordinate system where the predicted smooth normal is the Z-axis.
+//-----------------------------------------------------------------------------
+static CTMint _ctmMakeOctahedralNormals(_CTMcontext * self,
+  CTMint * aIntNormals, CTMfloat * aVertices, CTMuint * aIndices,
+  _CTMsortvertex * aSortVertices)
+{
+  CTMuint i, j, oldIdx;
+  CTMfloat magn, sum, scale;
+  CTMfloat * smoothNormals, n[3], n2[3], basisAxes[9];
+
+  // Allocate temporary memory for the nominal vertex normals
+  smoothNormals = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+    3 * sizeof(CTMfloat) * self->mVertexCount);
+  if(!smoothNormals)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+
+  // Calculate smooth normals (Note: aVertices and aIndices use the sorted
+  // index space, so smoothNormals will too)
+  _ctmCalcSmoothNormals(self, aVertices, 3, aIndices, 3, smoothNormals);
+
+  // Normal scaling factor
+  scale = 1.0f / self->mNormalPrecision;
+
+  for(i = 0; i < self->mVertexCount; ++ i)
+  {
+    // Get old normal index (before vertex sorting)
+    oldIdx = aSortVertices[i].mOriginalIndex;
+    for(j = 0; j < 3; ++ j)
+      n[j] = self->mNormals[oldIdx * 3 + j];
+    _ctmMakeOctahedralBasis(&smoothNormals[i * 3], basisAxes);
+
+    // Calculate normal magnitude, and invert it if the normal is negative
+    // compared to the predicted smooth normal (so that the normal always
+    // ends up in the upper half of the octahedron)
+    magn = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if(magn < 1e-10f)
+      magn = 1.0f;
+    if(basisAxes[6] * n[0] + basisAxes[7] * n[1] + basisAxes[8] * n[2] < 0.0f)
+      magn = -magn;
+    aIntNormals[i * 3] = (CTMint) floorf(scale * magn + 0.5f);
+
+    // Rotate the normal into the smooth normal coordinate system, and project
+    // it onto the octahedron |x| + |y| + |z| = 1
+    for(j = 0; j < 3; ++ j)
+      n2[j] = basisAxes[j * 3] * n[0] +
+              basisAxes[j * 3 + 1] * n[1] +
+              basisAxes[j * 3 + 2] * n[2];
+    sum = fabsf(n2[0]) + fabsf(n2[1]) + fabsf(n2[2]);
+    if(sum < 1e-20f)
+      sum = 1.0f;
+    sum = scale / sum;
+    if(magn < 0.0f)
+      sum = -sum;
+    aIntNormals[i * 3 + 1] = (CTMint) floorf(n2[0] * sum + 0.5f);
+    aIntNormals[i * 3 + 2] = (CTMint) floorf(n2[1] * sum + 0.5f);
+  }
+
+  // Free temporary resources
+  _ctmScratchFree(self->mScratch, smoothNormals);
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmRestoreOctahedralNormal() - Convert one octahedral normal back to
+// cartesian coordinates, overwriting its smooth normal.
+//-----------------------------------------------------------------------------
+static void _ctmRestoreOctahedralNormal(CTMfloat * aNormal,
+  const CTMint * aIntNormal, CTMfloat aScale)
+{
+  CTMfloat magn, u, v, c, a, b, basisAxes[9];
+  CTMuint j;
+
+  _ctmMakeOctahedralBasis(aNormal, basisAxes);
+  magn = (CTMfloat) aIntNormal[0] * aScale;
+  u = (CTMfloat) aIntNormal[1] * aScale;
+  v = (CTMfloat) aIntNormal[2] * aScale;
+
+  // Unfold the octahedron (upper half only), and normalize
+  c = 1.0f - fabsf(u) - fabsf(v);
+  magn = magn / sqrtf(u * u + v * v + c * c);
+  a = u * magn;
+  b = v * magn;
+  c = c * magn;
+  for(j = 0; j < 3; ++ j)
+    aNormal[j] = basisAxes[j] * a + basisAxes[3 + j] * b + basisAxes[6 + j] * c;
+}
+
+#if defined(_CTM_USE_SSE2)
+//-----------------------------------------------------------------------------
+// _ctmRestoreOctahedralNormals4() - SSE2 version of
+// _ctmRestoreOctahedralNormal() for four consecutive normals (the lanes hold
+// one vertex each).
+//-----------------------------------------------------------------------------
+static void _ctmRestoreOctahedralNormals4(CTMfloat * aNormals,
+  const CTMint * aIntNormals, __m128 aScale)
+{
+  __m128 a, b, c, m, one, sign, z0, z1, z2, x0, x1, x2, y0, y1, y2;
+  __m128 magn, nu, nv, len;
+
+  one = _mm_set1_ps(1.0f);
+  sign = _mm_set1_ps(-0.0f);
+
+  // Load and deinterleave the smooth normals and the integer normals
+  _ctmLoadVectors4(aNormals, &z0, &z1, &z2);
+  a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &aIntNormals[0])), aScale);
+  b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &aIntNormals[4])), aScale);
+  c = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &aIntNormals[8])), aScale);
+  _ctmDeinterleave4(a, b, c, &magn, &nu, &nv);
+
+  // Z = smooth normal, or (0,0,1) for zero smooth normals
+  len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z0, z0), _mm_mul_ps(z1, z1)),
+                   _mm_mul_ps(z2, z2));
+  m = _mm_cmplt_ps(len, _mm_set1_ps(0.5f));
+  z0 = _mm_andnot_ps(m, z0);
+  z1 = _mm_andnot_ps(m, z1);
+  z2 = _mm_or_ps(_mm_andnot_ps(m, z2), _mm_and_ps(m, one));
+
+  // X = (-z1, z0 - z2, z1), normalized, or (0,1,0) where it vanishes
+  x0 = _mm_xor_ps(z1, sign);
+  x1 = _mm_sub_ps(z0, z2);
+  x2 = z1;
+  len = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), x0), x0),
+                   _mm_mul_ps(x1, x1));
+  m = _mm_cmpgt_ps(len, _mm_set1_ps(1.0e-20f));
+  len = _mm_div_ps(one, _mm_sqrt_ps(len));
+  x0 = _mm_and_ps(m, _mm_mul_ps(x0, len));
+  x1 = _mm_or_ps(_mm_and_ps(m, _mm_mul_ps(x1, len)), _mm_andnot_ps(m, one));
+  x2 = _mm_and_ps(m, _mm_mul_ps(x2, len));
+
+  // Y = Z x X
+  y0 = _mm_sub_ps(_mm_mul_ps(z1, x2), _mm_mul_ps(z2, x1));
+  y1 = _mm_sub_ps(_mm_mul_ps(z2, x0), _mm_mul_ps(z0, x2));
+  y2 = _mm_sub_ps(_mm_mul_ps(z0, x1), _mm_mul_ps(z1, x0));
+
+  // Unfold the octahedron (upper half only), and normalize
+  c = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, nu)), _mm_andnot_ps(sign, nv));
+  len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nu, nu), _mm_mul_ps(nv, nv)),
+                   _mm_mul_ps(c, c));
+  magn = _mm_div_ps(magn, _mm_sqrt_ps(len));
+  nu = _mm_mul_ps(nu, magn);
+  nv = _mm_mul_ps(nv, magn);
+  c = _mm_mul_ps(c, magn);
+
+  // Rotate back to the global coordinate system
+  x0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, nu), _mm_mul_ps(y0, nv)), _mm_mul_ps(z0, c));
+  x1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, nu), _mm_mul_ps(y1, nv)), _mm_mul_ps(z1, c));
+  x2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x2, nu), _mm_mul_ps(y2, nv)), _mm_mul_ps(z2, c));
+
+  // Interleave and store the normals
+  _ctmStoreVectors4(aNormals, x0, x1, x2);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// _ctmRestoreOctahedralNormals() - Convert octahedral normals back to
+// cartesian coordinates. Unlike _ctmRestoreNormals(), this needs no
+// trigonometric functions, and no branches per normal.
+//-----------------------------------------------------------------------------
+static CTMint _ctmRestoreOctahedralNormals(_CTMcontext * self,
+  CTMint * aIntNormals)
+{
+  CTMuint i;
+  CTMfloat * normals;
+
+  // Allocate temporary memory for the nominal vertex normals (these are
+  // replaced by the restored normals)
+  normals = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+    3 * sizeof(CTMfloat) * self->mVertexCount);
+  if(!normals)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+
+  // Calculate smooth normals (nominal normals)
+  _ctmCalcSmoothNormals(self, self->mVertices, self->mVertexStride,
+                        self->mIndices, self->mIndexStride, normals);
+
+  i = 0;
+#if defined(_CTM_USE_SSE2)
+  {
+    __m128 scale = _mm_set1_ps(self->mNormalPrecision);
+    for(; i + 4 <= self->mVertexCount; i += 4)
+      _ctmRestoreOctahedralNormals4(&normals[i * 3], &aIntNormals[i * 3], scale);
   }
+#endif
+  for(; i < self->mVertexCount; ++ i)
+    _ctmRestoreOctahedralNormal(&normals[i * 3], &aIntNormals[i * 3],
+                                self->mNormalPrecision);
+
+  // Output to the normals array
+  _ctmWriteNormals(self, normals);
 
   // Free temporary resources
-  free(smoothNormals);
+  _ctmScratchFree(self->mScratch, normals);
 
   return CTM_TRUE;
 }
@@ -724,8 +1291,8 @@ static void _ctmRestoreUVCoords(_CTMcontext * self, _CTMfloatmap * aMap,
     v = aIntUVCoords[i * 2 + 1] + prevV;
 
     // Convert to floating point
-    aMap->mValues[i * 2] = (CTMfloat) u * scale;
-    aMap->mValues[i * 2 + 1] = (CTMfloat) v * scale;
+    aMap->mValues[i * aMap->mStride] = (CTMfloat) u * scale;
+    aMap->mValues[i * aMap->mStride + 1] = (CTMfloat) v * scale;
 
     prevU = u;
     prevV = v;
@@ -791,35 +1358,158 @@ static void _ctmRestoreAttribs(_CTMcontext * self, _CTMfloatmap * aMap,
     for(j = 0; j < 4; ++ j)
     {
       value[j] = aIntAttribs[i * 4 + j] + prev[j];
-      aMap->mValues[i * 4 + j] = (CTMfloat) value[j] * scale;
+      aMap->mValues[i * aMap->mStride + j] = (CTMfloat) value[j] * scale;
       prev[j] = value[j];
     }
   }
 }
 
 //-----------------------------------------------------------------------------
-// _ctmCompressMesh_MG2() - Compress the mesh that is stored in the CTM
-// context, and write it the the output stream in the CTM context.
+// _ctmFreeSectionJobs() - Free an array of pack jobs, including the data
+// arrays that the jobs refer to.
 //-----------------------------------------------------------------------------
-int _ctmCompressMesh_MG2(_CTMcontext * self)
+static void _ctmFreeSectionJobs(_CTMcontext * self, _CTMpackjob * aJobs,
+  CTMuint aCount)
 {
-  _CTMgrid grid;
-  _CTMsortvertex * sortVertices;
-  _CTMfloatmap * map;
-  CTMuint * indices, * deltaIndices, * gridIndices;
-  CTMint * intVertices, * intNormals, * intUVCoords, * intAttribs;
-  CTMfloat * restoredVertices;
   CTMuint i;
-
-#ifdef __DEBUG_
+  for(i = 0; i < aCount; ++ i)
+  {
+    if(aJobs[i].mData)
+      _ctmScratchFree(self->mScratch, aJobs[i].mData);
+    _ctmFreePackJob(&aJobs[i]);
+  }
+  _ctmScratchFree(self->mScratch, (void *) aJobs);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWriteSectionJobs() - Write the sections of the pack jobs aJobs[*aWritten
+// ..aEnd-1] to the stream (the jobs are in file order: VERT, GIDX, INDX, NORM,
+// TEXC and ATTR), and free their data arrays. *aWritten is advanced past the
+// written jobs.
+//-----------------------------------------------------------------------------
+static int _ctmWriteSectionJobs(_CTMcontext * self, _CTMpackjob * aJobs,
+  CTMuint * aWritten, CTMuint aEnd, CTMuint aFlags)
+{
+  _CTMfloatmap * map;
+  _CTMpackjob * job;
+  CTMuint i, k, indexJob, firstMap;
+
+  indexJob = (aFlags & _CTM_MG2_PARALLELOGRAM_BIT) ? 1 : 2;
+  firstMap = indexJob + 1 + (self->mNormals ? 1 : 0);
+  for(i = *aWritten; i < aEnd; ++ i)
+  {
+    job = &aJobs[i];
+    if(i == 0)
+    {
+      // Write vertices
+#ifdef __DEBUG_
+      printf("Vertices: ");
+#endif
+      _ctmStreamWriteSection(self, "VERT", (size_t) job->mCount * job->mSize * 4);
+    }
+    else if(i < indexJob)
+    {
+      // Write grid indices
+#ifdef __DEBUG_
+      printf("Grid indices: ");
+#endif
+      _ctmStreamWriteSection(self, "GIDX", (size_t) job->mCount * job->mSize * 4);
+    }
+    else if(i == indexJob)
+    {
+      // Write triangle indices
+#ifdef __DEBUG_
+      printf("Indices: ");
+#endif
+      _ctmStreamWriteSection(self, "INDX", (size_t) job->mCount * job->mSize * 4);
+      if(aFlags & _CTM_MG2_CONNECTIVITY_BIT)
+        _ctmStreamWriteUINT(self, job->mCount);
+    }
+    else if(i < firstMap)
+    {
+      // Write normals
+#ifdef __DEBUG_
+      printf("Normals: ");
+#endif
+      _ctmStreamWriteSection(self, "NORM", (size_t) job->mCount * job->mSize * 4);
+    }
+    else if(i < firstMap + self->mUVMapCount)
+    {
+      // Write UV map
+      for(map = self->mUVMaps, k = firstMap; k < i; map = map->mNext, ++ k);
+#ifdef __DEBUG_
+      printf("Texture coordinates (%s): ", map->mName ? map->mName : "no name");
+#endif
+      _ctmStreamWriteSection(self, "TEXC", (size_t) job->mCount * job->mSize * 4);
+      _ctmStreamWriteSTRING(self, map->mName);
+      _ctmStreamWriteSTRING(self, map->mFileName);
+      _ctmStreamWriteFLOAT(self, map->mPrecision);
+    }
+    else
+    {
+      // Write vertex attribute map
+      for(map = self->mAttribMaps, k = firstMap + self->mUVMapCount; k < i;
+          map = map->mNext, ++ k);
+#ifdef __DEBUG_
+      printf("Vertex attributes (%s): ", map->mName ? map->mName : "no name");
+#endif
+      _ctmStreamWriteSection(self, "ATTR", (size_t) job->mCount * job->mSize * 4);
+      _ctmStreamWriteSTRING(self, map->mName);
+      _ctmStreamWriteFLOAT(self, map->mPrecision);
+    }
+    if(!_ctmStreamWritePackJob(self, job))
+      return CTM_FALSE;
+    _ctmScratchFree(self->mScratch, job->mData);
+    job->mData = (void *) 0;
+    *aWritten = i + 1;
+  }
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmCompressMesh_MG2() - Compress the mesh that is stored in the CTM
+// context, and write it the the output stream in the CTM context.
+// With several threads, all data arrays are prepared up front, so that the
+// (independent) LZMA compression of the different sections can be done
+// concurrently. With one thread, each section is written (and its data array
+// freed) as soon as it can be, which keeps the memory usage down. The
+// sections are always written in the same order. This is also used for the MG3
+// method, which only differs in how the sections are packed (see
+// _ctmInitPackJob()).
+//-----------------------------------------------------------------------------
+int _ctmCompressMesh_MG2(_CTMcontext * self)
+{
+  _CTMgrid grid;
+  _CTMsortvertex * sortVertices, * traversalVertices;
+  _CTMfloatmap * map;
+  _CTMpackjob * jobs, * job, * indexJob;
+  CTMuint * indices, * deltaIndices, * gridIndices, * cellIndices, * vertexMap,
+          * opposite;
+  CTMint * intVertices, * fixedVertices, * intNormals, * intUVCoords, * intAttribs;
+  CTMfloat * restoredVertices;
+  CTMuint i, k, jobCount, flags, codeCount, written;
+  CTMint serial;
+
+#ifdef __DEBUG_
   printf("COMPRESSION METHOD: MG2\n");
 #endif
 
   // Setup 3D space subdivision grid
   _ctmSetupGrid(self, &grid);
 
+  // Which codings to use (the plain MG2 header is used when there are no
+  // coding flags, so that such files can be read by older versions)
+  flags = 0;
+  if(self->mIndexCoding == CTM_CODING_CONNECTIVITY)
+    flags |= _CTM_MG2_CONNECTIVITY_BIT;
+  if(self->mVertexCoding == CTM_CODING_PARALLELOGRAM)
+    flags |= _CTM_MG2_CONNECTIVITY_BIT | _CTM_MG2_PARALLELOGRAM_BIT;
+  if(self->mNormals && (self->mNormalCoding == CTM_CODING_OCTAHEDRAL))
+    flags |= _CTM_MG2_OCTAHEDRAL_BIT;
+
   // Write MG2-specific header information to the stream
-  _ctmStreamWrite(self, (void *) "MG2H", 4);
+  _ctmStreamWriteSection(self, flags ? "MG2X" : "MG2H", 0);
   _ctmStreamWriteFLOAT(self, self->mVertexPrecision);
   _ctmStreamWriteFLOAT(self, self->mNormalPrecision);
   _ctmStreamWriteFLOAT(self, grid.mMin[0]);
@@ -831,265 +1521,554 @@ int _ctmCompressMesh_MG2(_CTMcontext * self)
   _ctmStreamWriteUINT(self, grid.mDivision[0]);
   _ctmStreamWriteUINT(self, grid.mDivision[1]);
   _ctmStreamWriteUINT(self, grid.mDivision[2]);
+  if(flags)
+    _ctmStreamWriteUINT(self, flags);
+
+  // Allocate one pack job per section: VERT, GIDX (not used with
+  // parallelogram prediction), INDX, NORM (optional), TEXC (one per UV map)
+  // and ATTR (one per attribute map)
+  jobCount = ((flags & _CTM_MG2_PARALLELOGRAM_BIT) ? 2 : 3) +
+             (self->mNormals ? 1 : 0) + self->mUVMapCount + self->mAttribMapCount;
+  jobs = (_CTMpackjob *) _ctmScratchCalloc(self->mScratch,
+    jobCount * sizeof(_CTMpackjob));
+  if(!jobs)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  indexJob = &jobs[(flags & _CTM_MG2_PARALLELOGRAM_BIT) ? 1 : 2];
+  written = 0;
+  serial = (self->mThreadCount == 1) ? CTM_TRUE : CTM_FALSE;
 
   // Prepare (sort) vertices
-  sortVertices = (_CTMsortvertex *) malloc(sizeof(_CTMsortvertex) * self->mVertexCount);
+  sortVertices = (_CTMsortvertex *) _ctmScratchAlloc(self->mScratch,
+    sizeof(_CTMsortvertex) * self->mVertexCount);
   if(!sortVertices)
   {
     self->mError = CTM_OUT_OF_MEMORY;
+    _ctmFreeSectionJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
   _ctmSortVertices(self, sortVertices, &grid);
 
-  // Convert vertices to integers and calculate vertex deltas (entropy-reduction)
-  intVertices = (CTMint *) malloc(sizeof(CTMint) * 3 * self->mVertexCount);
-  if(!intVertices)
+  // Perpare (sort) indices
+  indices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * self->mTriangleCount * 3);
+  if(!indices)
   {
     self->mError = CTM_OUT_OF_MEMORY;
-    free((void *) sortVertices);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    _ctmFreeSectionJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
-  _ctmMakeVertexDeltas(self, intVertices, sortVertices, &grid);
-
-  // Write vertices
-#ifdef __DEBUG_
-  printf("Vertices: ");
-#endif
-  _ctmStreamWrite(self, (void *) "VERT", 4);
-  if(!_ctmStreamWritePackedInts(self, intVertices, self->mVertexCount, 3, CTM_FALSE))
+  if(!_ctmReIndexIndices(self, sortVertices, indices))
   {
-    free((void *) intVertices);
-    free((void *) sortVertices);
+    _ctmScratchFree(self->mScratch, (void *) indices);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    _ctmFreeSectionJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
 
-  // Prepare grid indices (deltas)
-  gridIndices = (CTMuint *) malloc(sizeof(CTMuint) * self->mVertexCount);
-  if(!gridIndices)
+  opposite = (CTMuint *) 0;
+  if(flags & _CTM_MG2_CONNECTIVITY_BIT)
   {
-    self->mError = CTM_OUT_OF_MEMORY;
-    free((void *) intVertices);
-    free((void *) sortVertices);
-    return CTM_FALSE;
+    // Code the indices by traversing the mesh. The vertices are then stored
+    // in the order in which they are reached, and the triangles in the order
+    // in which they are decoded.
+    // For parallelogram prediction we also need the opposite vertex of the
+    // gate of each triangle.
+    vertexMap = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMuint) * self->mVertexCount);
+    traversalVertices = (_CTMsortvertex *) _ctmScratchAlloc(self->mScratch,
+      sizeof(_CTMsortvertex) * self->mVertexCount);
+    if(flags & _CTM_MG2_PARALLELOGRAM_BIT)
+      opposite = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMuint) * (self->mTriangleCount ? self->mTriangleCount : 1));
+    if(!vertexMap || !traversalVertices ||
+       ((flags & _CTM_MG2_PARALLELOGRAM_BIT) && !opposite))
+      self->mError = CTM_OUT_OF_MEMORY;
+    if(!vertexMap || !traversalVertices ||
+       ((flags & _CTM_MG2_PARALLELOGRAM_BIT) && !opposite) ||
+       !_ctmEncodeConnectivity(self, indices, self->mVertexCount,
+                               self->mTriangleCount, vertexMap, opposite,
+                               &deltaIndices, &codeCount))
+    {
+      if(opposite)
+        _ctmScratchFree(self->mScratch, (void *) opposite);
+      if(traversalVertices)
+        _ctmScratchFree(self->mScratch, (void *) traversalVertices);
+      if(vertexMap)
+        _ctmScratchFree(self->mScratch, (void *) vertexMap);
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    for(i = 0; i < self->mVertexCount; ++ i)
+      traversalVertices[vertexMap[i]] = sortVertices[i];
+    _ctmScratchFree(self->mScratch, (void *) vertexMap);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    sortVertices = traversalVertices;
+    _ctmInitPackJob(self, indexJob, (void *) deltaIndices, codeCount, 1, CTM_FALSE, _CTM_DEST_INDICES);
   }
-  gridIndices[0] = sortVertices[0].mGridIndex;
-  for(i = 1; i < self->mVertexCount; ++ i)
-    gridIndices[i] = sortVertices[i].mGridIndex - sortVertices[i - 1].mGridIndex;
-  
-  // Write grid indices
-#ifdef __DEBUG_
-  printf("Grid indices: ");
-#endif
-  _ctmStreamWrite(self, (void *) "GIDX", 4);
-  if(!_ctmStreamWritePackedInts(self, (CTMint *) gridIndices, self->mVertexCount, 1, CTM_FALSE))
+  else
   {
-    free((void *) gridIndices);
-    free((void *) intVertices);
-    free((void *) sortVertices);
-    return CTM_FALSE;
+    _ctmReArrangeTriangles(self, indices);
+
+    // Calculate index deltas (entropy-reduction)
+    deltaIndices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMuint) * self->mTriangleCount * 3);
+    if(!deltaIndices)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    for(i = 0; i < self->mTriangleCount * 3; ++ i)
+      deltaIndices[i] = indices[i];
+    _ctmMakeIndexDeltas(self, deltaIndices);
+    _ctmInitPackJob(self, indexJob, (void *) deltaIndices, self->mTriangleCount, 3, CTM_FALSE, _CTM_DEST_INDICES);
   }
+  job = jobs;
 
   // Calculate the result of the compressed -> decompressed vertices, in order
   // to use the same vertex data for calculating nominal normals as the
   // decompression routine (i.e. compensate for the vertex error when
   // calculating the normals)
-  restoredVertices = (CTMfloat *) malloc(sizeof(CTMfloat) * 3 * self->mVertexCount);
+  restoredVertices = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMfloat) * 3 * self->mVertexCount);
   if(!restoredVertices)
   {
     self->mError = CTM_OUT_OF_MEMORY;
-    free((void *) gridIndices);
-    free((void *) intVertices);
-    free((void *) sortVertices);
+    if(opposite)
+      _ctmScratchFree(self->mScratch, (void *) opposite);
+    _ctmScratchFree(self->mScratch, (void *) indices);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    _ctmFreeSectionJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
-  for(i = 1; i < self->mVertexCount; ++ i)
-    gridIndices[i] += gridIndices[i - 1];
-  _ctmRestoreVertices(self, intVertices, gridIndices, &grid, restoredVertices);
-
-  // Free temporary resources
-  free((void *) gridIndices);
-  free((void *) intVertices);
 
-  // Perpare (sort) indices
-  indices = (CTMuint *) malloc(sizeof(CTMuint) * self->mTriangleCount * 3);
-  if(!indices)
+  // Convert vertices to integers and calculate vertex deltas (entropy-reduction)
+  intVertices = (CTMint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMint) * 3 * self->mVertexCount);
+  if(!intVertices)
   {
     self->mError = CTM_OUT_OF_MEMORY;
-    free((void *) restoredVertices);
-    free((void *) sortVertices);
+    if(opposite)
+      _ctmScratchFree(self->mScratch, (void *) opposite);
+    _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+    _ctmScratchFree(self->mScratch, (void *) indices);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    _ctmFreeSectionJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
-  if(!_ctmReIndexIndices(self, sortVertices, indices))
+  _ctmInitPackJob(self, job ++, (void *) intVertices, self->mVertexCount, 3, (flags & _CTM_MG2_CONNECTIVITY_BIT) ? CTM_TRUE : CTM_FALSE, _CTM_DEST_VERTICES);
+
+  if(flags & _CTM_MG2_PARALLELOGRAM_BIT)
   {
-    free((void *) indices);
-    free((void *) restoredVertices);
-    free((void *) sortVertices);
-    return CTM_FALSE;
+    // Predict the vertices from the triangles (no grid indices are needed,
+    // since all vertices use the same fixed point grid)
+    fixedVertices = (CTMint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMint) * 3 * self->mVertexCount);
+    if(!fixedVertices)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      _ctmScratchFree(self->mScratch, (void *) opposite);
+      _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    _ctmMakeFixedVertices(self, fixedVertices, sortVertices, &grid);
+    _ctmRestoreFixedVertices(self, fixedVertices, &grid, restoredVertices, 3);
+    _ctmMakeParallelogramDeltas(fixedVertices, intVertices, indices, opposite,
+                                self->mVertexCount, self->mTriangleCount);
+    _ctmScratchFree(self->mScratch, (void *) fixedVertices);
+    _ctmScratchFree(self->mScratch, (void *) opposite);
   }
-  _ctmReArrangeTriangles(self, indices);
-
-  // Calculate index deltas (entropy-reduction)
-  deltaIndices = (CTMuint *) malloc(sizeof(CTMuint) * self->mTriangleCount * 3);
-  if(!indices)
+  else
   {
-    self->mError = CTM_OUT_OF_MEMORY;
-    free((void *) indices);
-    free((void *) restoredVertices);
-    free((void *) sortVertices);
-    return CTM_FALSE;
+    _ctmMakeVertexDeltas(self, intVertices, sortVertices, &grid);
+
+    // Prepare grid indices (deltas)
+    gridIndices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMuint) * self->mVertexCount);
+    if(!gridIndices)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    gridIndices[0] = sortVertices[0].mGridIndex;
+    for(i = 1; i < self->mVertexCount; ++ i)
+      gridIndices[i] = sortVertices[i].mGridIndex - sortVertices[i - 1].mGridIndex;
+    _ctmInitPackJob(self, job ++, (void *) gridIndices, self->mVertexCount, 1, (flags & _CTM_MG2_CONNECTIVITY_BIT) ? CTM_TRUE : CTM_FALSE, _CTM_DEST_VERTICES);
+
+    cellIndices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMuint) * self->mVertexCount);
+    if(!cellIndices)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
+      return CTM_FALSE;
+    }
+    for(i = 0; i < self->mVertexCount; ++ i)
+      cellIndices[i] = sortVertices[i].mGridIndex;
+    _ctmRestoreVertices(self, intVertices, cellIndices, &grid, restoredVertices, 3);
+    _ctmScratchFree(self->mScratch, (void *) cellIndices);
   }
-  for(i = 0; i < self->mTriangleCount * 3; ++ i)
-    deltaIndices[i] = indices[i];
-  _ctmMakeIndexDeltas(self, deltaIndices);
+  ++ job;
 
-  // Write triangle indices
-#ifdef __DEBUG_
-  printf("Indices: ");
-#endif
-  _ctmStreamWrite(self, (void *) "INDX", 4);
-  if(!_ctmStreamWritePackedInts(self, (CTMint *) deltaIndices, self->mTriangleCount, 3, CTM_FALSE))
+  // Write the vertices, grid indices and triangle indices (one thread)
+  if(serial && !_ctmWriteSectionJobs(self, jobs, &written,
+                                     (CTMuint) (job - jobs), flags))
   {
-    free((void *) deltaIndices);
-    free((void *) indices);
-    free((void *) restoredVertices);
-    free((void *) sortVertices);
+    _ctmScratchFree(self->mScratch, (void *) indices);
+    _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    _ctmFreeSectionJobs(self, jobs, jobCount);
     return CTM_FALSE;
   }
 
-  // Free temporary data for the indices
-  free((void *) deltaIndices);
-
   if(self->mNormals)
   {
     // Convert normals to integers and calculate deltas (entropy-reduction)
-    intNormals = (CTMint *) malloc(sizeof(CTMint) * 3 * self->mVertexCount);
+    intNormals = (CTMint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMint) * 3 * self->mVertexCount);
     if(!intNormals)
     {
       self->mError = CTM_OUT_OF_MEMORY;
-      free((void *) indices);
-      free((void *) restoredVertices);
-      free((void *) sortVertices);
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
-    if(!_ctmMakeNormalDeltas(self, intNormals, restoredVertices, indices, sortVertices))
+    _ctmInitPackJob(self, job ++, (void *) intNormals, self->mVertexCount, 3, (flags & _CTM_MG2_OCTAHEDRAL_BIT) ? CTM_TRUE : CTM_FALSE, _CTM_DEST_NORMALS);
+    if((flags & _CTM_MG2_OCTAHEDRAL_BIT) ?
+       !_ctmMakeOctahedralNormals(self, intNormals, restoredVertices, indices, sortVertices) :
+       !_ctmMakeNormalDeltas(self, intNormals, restoredVertices, indices, sortVertices))
     {
-      free((void *) indices);
-      free((void *) intNormals);
-      free((void *) restoredVertices);
-      free((void *) sortVertices);
-      return CTM_FALSE;
-    }
-
-    // Write normals
-#ifdef __DEBUG_
-    printf("Normals: ");
-#endif
-    _ctmStreamWrite(self, (void *) "NORM", 4);
-    if(!_ctmStreamWritePackedInts(self, intNormals, self->mVertexCount, 3, CTM_FALSE))
-    {
-      free((void *) indices);
-      free((void *) intNormals);
-      free((void *) restoredVertices);
-      free((void *) sortVertices);
+      _ctmScratchFree(self->mScratch, (void *) indices);
+      _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
+  }
 
-    // Free temporary normal data
-    free((void *) intNormals);
+  // Write the normals (one thread)
+  if(serial && !_ctmWriteSectionJobs(self, jobs, &written,
+                                     (CTMuint) (job - jobs), flags))
+  {
+    _ctmScratchFree(self->mScratch, (void *) indices);
+    _ctmScratchFree(self->mScratch, (void *) restoredVertices);
+    _ctmScratchFree(self->mScratch, (void *) sortVertices);
+    _ctmFreeSectionJobs(self, jobs, jobCount);
+    return CTM_FALSE;
   }
 
   // Free restored indices and vertices
-  free((void *) indices);
-  free((void *) restoredVertices);
+  _ctmScratchFree(self->mScratch, (void *) indices);
+  _ctmScratchFree(self->mScratch, (void *) restoredVertices);
 
-  // Write UV maps
-  map = self->mUVMaps;
-  while(map)
+  // Convert UV coordinates to integers and calculate deltas (entropy-reduction)
+  for(map = self->mUVMaps, k = 0; map; map = map->mNext, ++ k)
   {
-    // Convert UV coordinates to integers and calculate deltas (entropy-reduction)
-    intUVCoords = (CTMint *) malloc(sizeof(CTMint) * 2 * self->mVertexCount);
+    intUVCoords = (CTMint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMint) * 2 * self->mVertexCount);
     if(!intUVCoords)
     {
       self->mError = CTM_OUT_OF_MEMORY;
-      free((void *) sortVertices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
     _ctmMakeUVCoordDeltas(self, map, intUVCoords, sortVertices);
+    _ctmInitPackJob(self, job ++, (void *) intUVCoords, self->mVertexCount, 2, CTM_TRUE,
+                    _CTM_MAP_SLOT(_CTM_DEST_UV_MAPS, k));
 
-    // Write UV coordinates
-#ifdef __DEBUG_
-    printf("Texture coordinates (%s): ", map->mName ? map->mName : "no name");
-#endif
-    _ctmStreamWrite(self, (void *) "TEXC", 4);
-    _ctmStreamWriteSTRING(self, map->mName);
-    _ctmStreamWriteSTRING(self, map->mFileName);
-    _ctmStreamWriteFLOAT(self, map->mPrecision);
-    if(!_ctmStreamWritePackedInts(self, intUVCoords, self->mVertexCount, 2, CTM_TRUE))
+    // Write the map (one thread)
+    if(serial && !_ctmWriteSectionJobs(self, jobs, &written,
+                                       (CTMuint) (job - jobs), flags))
     {
-      free((void *) intUVCoords);
-      free((void *) sortVertices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
-
-    // Free temporary UV coordinate data
-    free((void *) intUVCoords);
-
-    map = map->mNext;
   }
 
-  // Write vertex attribute maps
-  map = self->mAttribMaps;
-  while(map)
+  // Convert vertex attributes to integers and calculate deltas (entropy-reduction)
+  for(map = self->mAttribMaps, k = 0; map; map = map->mNext, ++ k)
   {
-    // Convert vertex attributes to integers and calculate deltas (entropy-reduction)
-    intAttribs = (CTMint *) malloc(sizeof(CTMint) * 4 * self->mVertexCount);
+    intAttribs = (CTMint *) _ctmScratchAlloc(self->mScratch,
+      sizeof(CTMint) * 4 * self->mVertexCount);
     if(!intAttribs)
     {
       self->mError = CTM_OUT_OF_MEMORY;
-      free((void *) sortVertices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
     _ctmMakeAttribDeltas(self, map, intAttribs, sortVertices);
+    _ctmInitPackJob(self, job ++, (void *) intAttribs, self->mVertexCount, 4, CTM_TRUE,
+                    _CTM_MAP_SLOT(_CTM_DEST_ATTRIB_MAPS, k));
 
-    // Write vertex attributes
-#ifdef __DEBUG_
-    printf("Vertex attributes (%s): ", map->mName ? map->mName : "no name");
-#endif
-    _ctmStreamWrite(self, (void *) "ATTR", 4);
-    _ctmStreamWriteSTRING(self, map->mName);
-    _ctmStreamWriteFLOAT(self, map->mPrecision);
-    if(!_ctmStreamWritePackedInts(self, intAttribs, self->mVertexCount, 4, CTM_TRUE))
+    // Write the map (one thread)
+    if(serial && !_ctmWriteSectionJobs(self, jobs, &written,
+                                       (CTMuint) (job - jobs), flags))
     {
-      free((void *) intAttribs);
-      free((void *) sortVertices);
+      _ctmScratchFree(self->mScratch, (void *) sortVertices);
+      _ctmFreeSectionJobs(self, jobs, jobCount);
       return CTM_FALSE;
     }
+  }
 
-    // Free temporary vertex attribute data
-    free((void *) intAttribs);
+  // Free temporary data
+  _ctmScratchFree(self->mScratch, (void *) sortVertices);
 
-    map = map->mNext;
-  }
+  // Pack the remaining sections (all of them when several threads are used,
+  // concurrently), and write them
+  _ctmPackJobs(self, &jobs[written], jobCount - written);
+  i = _ctmWriteSectionJobs(self, jobs, &written, jobCount, flags);
 
   // Free temporary data
-  free((void *) sortVertices);
+  _ctmFreeSectionJobs(self, jobs, jobCount);
 
-  return CTM_TRUE;
+  return i;
 }
 
 //-----------------------------------------------------------------------------
-// _ctmUncompressMesh_MG2() - Uncmpress the mesh from the input stream in the
-// CTM context, and store the resulting mesh in the CTM context.
+// Section types for _CTMdecodetask.
 //-----------------------------------------------------------------------------
-int _ctmUncompressMesh_MG2(_CTMcontext * self)
+#define _CTM_MG2_VERTICES 1
+#define _CTM_MG2_INDICES  2
+#define _CTM_MG2_NORMALS  3
+#define _CTM_MG2_UVMAP    4
+#define _CTM_MG2_ATTRIBS  5
+#define _CTM_MG2_CONNECTIVITY 6
+#define _CTM_MG2_PREDICTED_VERTICES 7
+#define _CTM_MG2_RESTORE  8
+
+//-----------------------------------------------------------------------------
+// _CTMdecodetask - One independent part of the MG2 decoding work: uncompress
+// the packed array(s) of a section and restore the values.
+//-----------------------------------------------------------------------------
+typedef struct {
+  // The CTM context (only read from within a task)
+  _CTMcontext * mContext;
+
+  // Section type (_CTM_MG2_VERTICES, _CTM_MG2_INDICES, ...)
+  CTMuint mSection;
+
+  // Packed data (the vertex section uses two arrays: VERT + GIDX, unless the
+  // vertices are predicted)
+  _CTMpackjob mJob[2];
+
+  // 3D space subdivision grid (vertex section)
+  _CTMgrid * mGrid;
+
+  // UV/attribute map (UV map and attribute map sections)
+  _CTMfloatmap * mMap;
+
+  // Opposite vertex of the gate of each triangle (connectivity section, only
+  // with parallelogram prediction)
+  CTMuint * mOpposite;
+
+  // Restore section: the uncompressed predicted vertices and normals of the
+  // other tasks (NULL if none), which are restored once the vertices and the
+  // indices are done
+  CTMint * mIntVertices;
+  CTMint * mIntNormals;
+  const CTMuint * mGateOpposite;
+  CTMint mOctahedral;
+
+  // Error code (CTM_NONE if everything went well)
+  CTMenum mError;
+} _CTMdecodetask;
+
+//-----------------------------------------------------------------------------
+// _ctmDecodeSection() - Work item function for decoding an MG2 section.
+//-----------------------------------------------------------------------------
+static void _ctmDecodeSection(void * aItem)
 {
+  _CTMdecodetask * task = (_CTMdecodetask *) aItem;
+  _CTMcontext * self = task->mContext;
   CTMuint * gridIndices, i;
-  CTMint * intVertices, * intNormals, * intUVCoords, * intAttribs;
-  _CTMfloatmap * map;
-  _CTMgrid grid;
+  CTMint * intVertices, * intValues;
 
-  // Read MG2-specific header information from the stream
-  if(_ctmStreamReadUINT(self) != FOURCC("MG2H"))
+  switch(task->mSection)
+  {
+    case _CTM_MG2_VERTICES:
+      // Uncompress vertices and grid indices
+      intVertices = (CTMint *) _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMint) * self->mVertexCount * 3);
+      gridIndices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMuint) * self->mVertexCount);
+      task->mJob[0].mData = (void *) intVertices;
+      task->mJob[1].mData = (void *) gridIndices;
+      if(!intVertices || !gridIndices)
+        task->mError = CTM_OUT_OF_MEMORY;
+      else if(!_ctmUnpackData(&task->mJob[0]))
+        task->mError = task->mJob[0].mError;
+      else if(!_ctmUnpackData(&task->mJob[1]))
+        task->mError = task->mJob[1].mError;
+      else
+      {
+        // Restore grid indices (deltas)
+        for(i = 1; i < self->mVertexCount; ++ i)
+          gridIndices[i] += gridIndices[i - 1];
+
+        // Restore vertices
+        _ctmRestoreVertices(self, intVertices, gridIndices, task->mGrid,
+                            self->mVertices, self->mVertexStride);
+      }
+
+      // Free temporary resources
+      if(gridIndices)
+        _ctmScratchFree(self->mScratch, (void *) gridIndices);
+      if(intVertices)
+        _ctmScratchFree(self->mScratch, (void *) intVertices);
+      task->mJob[0].mData = task->mJob[1].mData = (void *) 0;
+      break;
+
+    case _CTM_MG2_INDICES:
+      // Uncompress indices (directly into the mesh index array)
+      if(!_ctmUnpackData(&task->mJob[0]))
+      {
+        task->mError = task->mJob[0].mError;
+        break;
+      }
+
+      // Restore indices
+      _ctmRestoreIndices(self, self->mIndices, self->mIndexStride);
+
+      // Check that all indices are within range
+      for(i = 0; (i < self->mTriangleCount) && (task->mError == CTM_NONE); ++ i)
+      {
+        if((self->mIndices[i * self->mIndexStride] >= self->mVertexCount) ||
+           (self->mIndices[i * self->mIndexStride + 1] >= self->mVertexCount) ||
+           (self->mIndices[i * self->mIndexStride + 2] >= self->mVertexCount))
+          task->mError = CTM_INVALID_MESH;
+      }
+      break;
+
+    case _CTM_MG2_CONNECTIVITY:
+      // Uncompress the connectivity codes, and decode the indices (directly
+      // into the mesh index array)
+      task->mJob[0].mData = _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMuint) * task->mJob[0].mCount);
+      if(!task->mJob[0].mData)
+        task->mError = CTM_OUT_OF_MEMORY;
+      else if(!_ctmUnpackData(&task->mJob[0]))
+        task->mError = task->mJob[0].mError;
+      else
+        task->mError = _ctmDecodeConnectivity(self->mScratch,
+          (CTMuint *) task->mJob[0].mData, task->mJob[0].mCount, self->mVertexCount, self->mTriangleCount,
+          self->mIndices, self->mIndexStride, task->mOpposite);
+
+      // Free temporary data
+      if(task->mJob[0].mData)
+        _ctmScratchFree(self->mScratch, task->mJob[0].mData);
+      task->mJob[0].mData = (void *) 0;
+      break;
+
+    case _CTM_MG2_NORMALS:
+    case _CTM_MG2_PREDICTED_VERTICES:
+      // Uncompress normals / predicted vertices (they are restored once the
+      // indices are available, so we keep the integer array)
+      task->mJob[0].mData = _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMint) * self->mVertexCount * 3);
+      if(!task->mJob[0].mData)
+        task->mError = CTM_OUT_OF_MEMORY;
+      else if(!_ctmUnpackData(&task->mJob[0]))
+        task->mError = task->mJob[0].mError;
+      break;
+
+    case _CTM_MG2_UVMAP:
+    case _CTM_MG2_ATTRIBS:
+      // Uncompress UV coordinates / vertex attributes
+      intValues = (CTMint *) _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMint) * self->mVertexCount * task->mJob[0].mSize);
+      task->mJob[0].mData = (void *) intValues;
+      if(!intValues)
+        task->mError = CTM_OUT_OF_MEMORY;
+      else if(!_ctmUnpackData(&task->mJob[0]))
+        task->mError = task->mJob[0].mError;
+      else if(task->mSection == _CTM_MG2_UVMAP)
+        _ctmRestoreUVCoords(self, task->mMap, intValues);
+      else
+        _ctmRestoreAttribs(self, task->mMap, intValues);
+
+      // Free temporary data
+      if(intValues)
+        _ctmScratchFree(self->mScratch, (void *) intValues);
+      task->mJob[0].mData = (void *) 0;
+      break;
+
+    case _CTM_MG2_RESTORE:
+      // Restore predicted vertices (needs the restored indices)
+      if(task->mIntVertices)
+      {
+        _ctmRestoreParallelogramDeltas(task->mIntVertices, self->mIndices,
+          self->mIndexStride, task->mGateOpposite, self->mVertexCount,
+          self->mTriangleCount);
+        _ctmRestoreFixedVertices(self, task->mIntVertices, task->mGrid,
+                                 self->mVertices, self->mVertexStride);
+      }
+
+      // Restore normals (needs the restored vertices and indices)
+      if(task->mIntNormals &&
+         (task->mOctahedral ?
+          !_ctmRestoreOctahedralNormals(self, task->mIntNormals) :
+          !_ctmRestoreNormals(self, task->mIntNormals)))
+        task->mError = CTM_OUT_OF_MEMORY;
+      break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFreeDecodeTasks() - Free an array of decode tasks.
+//-----------------------------------------------------------------------------
+static void _ctmFreeDecodeTasks(_CTMcontext * self, _CTMdecodetask * aTasks,
+  CTMuint aCount)
+{
+  CTMuint i;
+  for(i = 0; i < aCount; ++ i)
+  {
+    _ctmFreePackJob(&aTasks[i].mJob[0]);
+    _ctmFreePackJob(&aTasks[i].mJob[1]);
+    if(((aTasks[i].mSection == _CTM_MG2_NORMALS) ||
+        (aTasks[i].mSection == _CTM_MG2_PREDICTED_VERTICES)) &&
+       aTasks[i].mJob[0].mData)
+      _ctmScratchFree(self->mScratch, aTasks[i].mJob[0].mData);
+    if(aTasks[i].mOpposite)
+      _ctmScratchFree(self->mScratch, (void *) aTasks[i].mOpposite);
+  }
+  _ctmScratchFree(self->mScratch, (void *) aTasks);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReadHeader_MG2() - Read the MG2 header ("MG2H", or the extended header
+// "MG2X" that has a coding flags field at the end) from the stream. The
+// precisions are stored in the context, the grid in aGrid and the coding
+// flags in aFlags.
+//-----------------------------------------------------------------------------
+int _ctmReadHeader_MG2(_CTMcontext * self, _CTMgrid * aGrid, CTMuint * aFlags)
+{
+  CTMuint i, id;
+
+  id = _ctmStreamReadUINT(self);
+  if((id != FOURCC("MG2H")) && (id != FOURCC("MG2X")))
   {
     self->mError = CTM_BAD_FORMAT;
     return CTM_FALSE;
@@ -1106,23 +2085,31 @@ int _ctmUncompressMesh_MG2(_CTMcontext * self)
     self->mError = CTM_BAD_FORMAT;
     return CTM_FALSE;
   }
-  grid.mMin[0] = _ctmStreamReadFLOAT(self);
-  grid.mMin[1] = _ctmStreamReadFLOAT(self);
-  grid.mMin[2] = _ctmStreamReadFLOAT(self);
-  grid.mMax[0] = _ctmStreamReadFLOAT(self);
-  grid.mMax[1] = _ctmStreamReadFLOAT(self);
-  grid.mMax[2] = _ctmStreamReadFLOAT(self);
-  if((grid.mMax[0] < grid.mMin[0]) ||
-     (grid.mMax[1] < grid.mMin[1]) ||
-     (grid.mMax[2] < grid.mMin[2]))
+  aGrid->mMin[0] = _ctmStreamReadFLOAT(self);
+  aGrid->mMin[1] = _ctmStreamReadFLOAT(self);
+  aGrid->mMin[2] = _ctmStreamReadFLOAT(self);
+  aGrid->mMax[0] = _ctmStreamReadFLOAT(self);
+  aGrid->mMax[1] = _ctmStreamReadFLOAT(self);
+  aGrid->mMax[2] = _ctmStreamReadFLOAT(self);
+  if((aGrid->mMax[0] < aGrid->mMin[0]) ||
+     (aGrid->mMax[1] < aGrid->mMin[1]) ||
+     (aGrid->mMax[2] < aGrid->mMin[2]))
   {
     self->mError = CTM_BAD_FORMAT;
     return CTM_FALSE;
   }
-  grid.mDivision[0] = _ctmStreamReadUINT(self);
-  grid.mDivision[1] = _ctmStreamReadUINT(self);
-  grid.mDivision[2] = _ctmStreamReadUINT(self);
-  if((grid.mDivision[0] < 1) || (grid.mDivision[1] < 1) || (grid.mDivision[2] < 1))
+  aGrid->mDivision[0] = _ctmStreamReadUINT(self);
+  aGrid->mDivision[1] = _ctmStreamReadUINT(self);
+  aGrid->mDivision[2] = _ctmStreamReadUINT(self);
+  if((aGrid->mDivision[0] < 1) || (aGrid->mDivision[1] < 1) || (aGrid->mDivision[2] < 1))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  *aFlags = (id == FOURCC("MG2X")) ? _ctmStreamReadUINT(self) : 0;
+  if((*aFlags & ~(_CTM_MG2_CONNECTIVITY_BIT | _CTM_MG2_PARALLELOGRAM_BIT |
+                  _CTM_MG2_OCTAHEDRAL_BIT)) ||
+     ((*aFlags & _CTM_MG2_PARALLELOGRAM_BIT) && !(*aFlags & _CTM_MG2_CONNECTIVITY_BIT)))
   {
     self->mError = CTM_BAD_FORMAT;
     return CTM_FALSE;
@@ -1130,126 +2117,174 @@ int _ctmUncompressMesh_MG2(_CTMcontext * self)
 
   // Initialize 3D space subdivision grid
   for(i = 0; i < 3; ++ i)
-    grid.mSize[i] = (grid.mMax[i] - grid.mMin[i]) / grid.mDivision[i];
+    aGrid->mSize[i] = (aGrid->mMax[i] - aGrid->mMin[i]) / aGrid->mDivision[i];
 
-  // Read vertices
-  if(_ctmStreamReadUINT(self) != FOURCC("VERT"))
-  {
-    self->mError = CTM_BAD_FORMAT;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmUncompressMesh_MG2() - Uncmpress the mesh from the input stream in the
+// CTM context, and store the resulting mesh in the CTM context.
+// All sections are read from the stream first. The sections are then
+// uncompressed and restored in two waves (each wave concurrently, if the
+// context allows more than one thread): first the vertices, the indices and
+// the normals, and then the UV and attribute maps, together with the
+// restoring of the predicted vertices and the normals, which depend on the
+// vertices and the indices. This is also used for the MG3 method.
+//-----------------------------------------------------------------------------
+int _ctmUncompressMesh_MG2(_CTMcontext * self)
+{
+  _CTMdecodetask * tasks, * task, * vertexTask, * indexTask, * normalTask,
+                 * restoreTask;
+  _CTMfloatmap * map;
+  _CTMgrid grid;
+  CTMuint i, taskCount, firstWave, flags, codeCount;
+
+  // Read MG2-specific header information from the stream
+  if(!_ctmReadHeader_MG2(self, &grid, &flags))
     return CTM_FALSE;
-  }
-  intVertices = (CTMint *) malloc(sizeof(CTMint) * self->mVertexCount * 3);
-  if(!intVertices)
+
+  // Allocate one decode task per section: vertices (VERT + GIDX), indices,
+  // normals (optional), UV maps and attribute maps, and a task that restores
+  // the predicted vertices and the normals (before the maps)
+  taskCount = 3 + (self->mNormals ? 1 : 0) + self->mUVMapCount + self->mAttribMapCount;
+  tasks = (_CTMdecodetask *) _ctmScratchCalloc(self->mScratch,
+    taskCount * sizeof(_CTMdecodetask));
+  if(!tasks)
   {
     self->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
-  if(!_ctmStreamReadPackedInts(self, intVertices, self->mVertexCount, 3, CTM_FALSE))
+  for(i = 0; i < taskCount; ++ i)
   {
-    free((void *) intVertices);
-    return CTM_FALSE;
+    tasks[i].mContext = self;
+    tasks[i].mError = CTM_NONE;
   }
+  task = tasks;
 
-  // Read grid indices
-  if(_ctmStreamReadUINT(self) != FOURCC("GIDX"))
+  // Read vertices
+  if(_ctmStreamReadUINT(self) != FOURCC("VERT"))
   {
-    free((void *) intVertices);
     self->mError = CTM_BAD_FORMAT;
+    _ctmFreeDecodeTasks(self, tasks, taskCount);
     return CTM_FALSE;
   }
-  gridIndices = (CTMuint *) malloc(sizeof(CTMuint) * self->mVertexCount);
-  if(!gridIndices)
+  task->mSection = (flags & _CTM_MG2_PARALLELOGRAM_BIT) ? _CTM_MG2_PREDICTED_VERTICES : _CTM_MG2_VERTICES;
+  task->mGrid = &grid;
+  _ctmInitPackJob(self, &task->mJob[0], (void *) 0, self->mVertexCount, 3, (flags & _CTM_MG2_CONNECTIVITY_BIT) ? CTM_TRUE : CTM_FALSE, _CTM_DEST_VERTICES);
+  if(!_ctmStreamReadPackJob(self, &task->mJob[0]))
   {
-    self->mError = CTM_OUT_OF_MEMORY;
-    free((void *) intVertices);
+    _ctmFreeDecodeTasks(self, tasks, taskCount);
     return CTM_FALSE;
   }
-  if(!_ctmStreamReadPackedInts(self, (CTMint *) gridIndices, self->mVertexCount, 1, CTM_FALSE))
+
+  // Read grid indices (not used with parallelogram prediction)
+  if(!(flags & _CTM_MG2_PARALLELOGRAM_BIT))
   {
-    free((void *) gridIndices);
-    free((void *) intVertices);
-    return CTM_FALSE;
+    if(_ctmStreamReadUINT(self) != FOURCC("GIDX"))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
+      return CTM_FALSE;
+    }
+    _ctmInitPackJob(self, &task->mJob[1], (void *) 0, self->mVertexCount, 1, (flags & _CTM_MG2_CONNECTIVITY_BIT) ? CTM_TRUE : CTM_FALSE, _CTM_DEST_VERTICES);
+    if(!_ctmStreamReadPackJob(self, &task->mJob[1]))
+    {
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
+      return CTM_FALSE;
+    }
   }
-
-  // Restore grid indices (deltas)
-  for(i = 1; i < self->mVertexCount; ++ i)
-    gridIndices[i] += gridIndices[i - 1];
-
-  // Restore vertices
-  _ctmRestoreVertices(self, intVertices, gridIndices, &grid, self->mVertices);
-
-  // Free temporary resources
-  free((void *) gridIndices);
-  free((void *) intVertices);
+  vertexTask = task ++;
 
   // Read triangle indices
   if(_ctmStreamReadUINT(self) != FOURCC("INDX"))
   {
     self->mError = CTM_BAD_FORMAT;
+    _ctmFreeDecodeTasks(self, tasks, taskCount);
     return CTM_FALSE;
   }
-  if(!_ctmStreamReadPackedInts(self, (CTMint *) self->mIndices, self->mTriangleCount, 3, CTM_FALSE))
-    return CTM_FALSE;
-
-  // Restore indices
-  _ctmRestoreIndices(self, self->mIndices);
-
-  // Check that all indices are within range
-  for(i = 0; i < (self->mTriangleCount * 3); ++ i)
+  if(flags & _CTM_MG2_CONNECTIVITY_BIT)
   {
-    if(self->mIndices[i] >= self->mVertexCount)
+    // Connectivity codes (at least one, and at most twelve per triangle)
+    codeCount = _ctmStreamReadUINT(self);
+    if((codeCount < self->mTriangleCount) || ((codeCount - 1) / 12 >= self->mTriangleCount))
     {
-      self->mError = CTM_INVALID_MESH;
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
+    task->mSection = _CTM_MG2_CONNECTIVITY;
+    _ctmInitPackJob(self, &task->mJob[0], (void *) 0, codeCount, 1, CTM_FALSE, _CTM_DEST_INDICES);
+    if(flags & _CTM_MG2_PARALLELOGRAM_BIT)
+    {
+      task->mOpposite = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+        sizeof(CTMuint) * (self->mTriangleCount ? self->mTriangleCount : 1));
+      if(!task->mOpposite)
+      {
+        self->mError = CTM_OUT_OF_MEMORY;
+        _ctmFreeDecodeTasks(self, tasks, taskCount);
+        return CTM_FALSE;
+      }
+    }
+  }
+  else
+  {
+    task->mSection = _CTM_MG2_INDICES;
+    _ctmInitPackJob(self, &task->mJob[0], (void *) self->mIndices, self->mTriangleCount, 3, CTM_FALSE, _CTM_DEST_INDICES);
+    task->mJob[0].mStride = self->mIndexStride;
+  }
+  if(!_ctmStreamReadPackJob(self, &task->mJob[0]))
+  {
+    _ctmFreeDecodeTasks(self, tasks, taskCount);
+    return CTM_FALSE;
   }
+  indexTask = task ++;
 
   // Read normals
+  normalTask = (_CTMdecodetask *) 0;
   if(self->mNormals)
   {
-    intNormals = (CTMint *) malloc(sizeof(CTMint) * self->mVertexCount * 3);
-    if(!intNormals)
+    if(_ctmStreamReadUINT(self) != FOURCC("NORM"))
     {
-      self->mError = CTM_OUT_OF_MEMORY;
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-    if(_ctmStreamReadUINT(self) != FOURCC("NORM"))
+    task->mSection = _CTM_MG2_NORMALS;
+    _ctmInitPackJob(self, &task->mJob[0], (void *) 0, self->mVertexCount, 3, (flags & _CTM_MG2_OCTAHEDRAL_BIT) ? CTM_TRUE : CTM_FALSE, _CTM_DEST_NORMALS);
+    if(!_ctmStreamReadPackJob(self, &task->mJob[0]))
     {
-      self->mError = CTM_BAD_FORMAT;
-      free((void *) intNormals);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-    if(!_ctmStreamReadPackedInts(self, intNormals, self->mVertexCount, 3, CTM_FALSE))
+    normalTask = task ++;
+  }
+  else if(self->mSkipNormals && (self->mUVMapCount || self->mAttribMapCount))
+  {
+    // Skip normals (only if there are maps to load after them)
+    if(_ctmStreamReadUINT(self) != FOURCC("NORM"))
     {
-      free((void *) intNormals);
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-
-    // Restore normals
-    if(!_ctmRestoreNormals(self, intNormals))
+    if(!_ctmStreamSkipPacked(self))
     {
-      free((void *) intNormals);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-
-    // Free temporary normals data
-    free((void *) intNormals);
   }
+  task->mSection = _CTM_MG2_RESTORE;
+  restoreTask = task ++;
 
   // Read UV maps
   map = self->mUVMaps;
   while(map)
   {
-    intUVCoords = (CTMint *) malloc(sizeof(CTMint) * self->mVertexCount * 2);
-    if(!intUVCoords)
-    {
-      self->mError = CTM_OUT_OF_MEMORY;
-      return CTM_FALSE;
-    }
     if(_ctmStreamReadUINT(self) != FOURCC("TEXC"))
     {
       self->mError = CTM_BAD_FORMAT;
-      free((void *) intUVCoords);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
     _ctmStreamReadSTRING(self, &map->mName);
@@ -1258,38 +2293,48 @@ int _ctmUncompressMesh_MG2(_CTMcontext * self)
     if(map->mPrecision <= 0.0f)
     {
       self->mError = CTM_BAD_FORMAT;
-      free((void *) intUVCoords);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-    if(!_ctmStreamReadPackedInts(self, intUVCoords, self->mVertexCount, 2, CTM_TRUE))
+    task->mSection = _CTM_MG2_UVMAP;
+    task->mMap = map;
+    _ctmInitPackJob(self, &task->mJob[0], (void *) 0, self->mVertexCount, 2, CTM_TRUE, _CTM_DEST_UV_MAPS);
+    if(!_ctmStreamReadPackJob(self, &task->mJob[0]))
     {
-      free((void *) intUVCoords);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-
-    // Restore UV coordinates
-    _ctmRestoreUVCoords(self, map, intUVCoords);
-
-    // Free temporary UV coordinate data
-    free((void *) intUVCoords);
-
+    ++ task;
     map = map->mNext;
   }
 
-  // Read vertex attribute maps
-  map = self->mAttribMaps;
-  while(map)
+  // Skip UV maps (only if there are attribute maps to load after them)
+  for(i = 0; (i < self->mSkipUVMaps) && self->mAttribMapCount; ++ i)
   {
-    intAttribs = (CTMint *) malloc(sizeof(CTMint) * self->mVertexCount * 4);
-    if(!intAttribs)
+    if(_ctmStreamReadUINT(self) != FOURCC("TEXC"))
     {
-      self->mError = CTM_OUT_OF_MEMORY;
+      self->mError = CTM_BAD_FORMAT;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
+    // Name, file name, precision and packed data
+    if(!_ctmStreamSkipSTRING(self) || !_ctmStreamSkipSTRING(self) ||
+       !_ctmStreamSkip(self, 4) || !_ctmStreamSkipPacked(self))
+    {
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
+      return CTM_FALSE;
+    }
+  }
+
+  // Read vertex attribute maps (skipped attribute maps are last in the file,
+  // so they are simply not read)
+  map = self->mAttribMaps;
+  while(map)
+  {
     if(_ctmStreamReadUINT(self) != FOURCC("ATTR"))
     {
       self->mError = CTM_BAD_FORMAT;
-      free((void *) intAttribs);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
     _ctmStreamReadSTRING(self, &map->mName);
@@ -1297,23 +2342,60 @@ int _ctmUncompressMesh_MG2(_CTMcontext * self)
     if(map->mPrecision <= 0.0f)
     {
       self->mError = CTM_BAD_FORMAT;
-      free((void *) intAttribs);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
-    if(!_ctmStreamReadPackedInts(self, intAttribs, self->mVertexCount, 4, CTM_TRUE))
+    task->mSection = _CTM_MG2_ATTRIBS;
+    task->mMap = map;
+    _ctmInitPackJob(self, &task->mJob[0], (void *) 0, self->mVertexCount, 4, CTM_TRUE, _CTM_DEST_ATTRIB_MAPS);
+    if(!_ctmStreamReadPackJob(self, &task->mJob[0]))
     {
-      free((void *) intAttribs);
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
       return CTM_FALSE;
     }
+    ++ task;
+    map = map->mNext;
+  }
 
-    // Restore vertex attributes
-    _ctmRestoreAttribs(self, map, intAttribs);
-
-    // Free temporary vertex attribute data
-    free((void *) intAttribs);
+  // Uncompress and restore the vertices and the indices, and uncompress the
+  // normals
+  firstWave = (CTMuint) (restoreTask - tasks);
+  _ctmRunTasks(self, _ctmDecodeSection, (void *) tasks, firstWave, sizeof(_CTMdecodetask));
+  for(i = 0; i < firstWave; ++ i)
+  {
+    if(tasks[i].mError != CTM_NONE)
+    {
+      self->mError = tasks[i].mError;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
+      return CTM_FALSE;
+    }
+  }
 
-    map = map->mNext;
+  // Restore the predicted vertices and the normals, while the maps are
+  // uncompressed and restored
+  restoreTask->mGrid = &grid;
+  if(vertexTask->mSection == _CTM_MG2_PREDICTED_VERTICES)
+  {
+    restoreTask->mIntVertices = (CTMint *) vertexTask->mJob[0].mData;
+    restoreTask->mGateOpposite = indexTask->mOpposite;
+  }
+  if(normalTask)
+    restoreTask->mIntNormals = (CTMint *) normalTask->mJob[0].mData;
+  restoreTask->mOctahedral = (flags & _CTM_MG2_OCTAHEDRAL_BIT) ? CTM_TRUE : CTM_FALSE;
+  _ctmRunTasks(self, _ctmDecodeSection, (void *) restoreTask,
+               taskCount - firstWave, sizeof(_CTMdecodetask));
+  for(i = firstWave; i < taskCount; ++ i)
+  {
+    if(tasks[i].mError != CTM_NONE)
+    {
+      self->mError = tasks[i].mError;
+      _ctmFreeDecodeTasks(self, tasks, taskCount);
+      return CTM_FALSE;
+    }
   }
 
+  // Free temporary data
+  _ctmFreeDecodeTasks(self, tasks, taskCount);
+
   return CTM_TRUE;
 }
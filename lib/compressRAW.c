@@ -40,7 +40,6 @@
 //-----------------------------------------------------------------------------
 int _ctmCompressMesh_RAW(_CTMcontext * self)
 {
-  CTMuint i;
   _CTMfloatmap * map;
 
 #ifdef __DEBUG_
@@ -51,17 +50,17 @@ int _ctmCompressMesh_RAW(_CTMcontext * self)
 #ifdef __DEBUG_
   printf("Inidices: %d bytes\n", (CTMuint)(self->mTriangleCount * 3 * sizeof(CTMuint)));
 #endif
-  _ctmStreamWrite(self, (void *) "INDX", 4);
-  for(i = 0; i < self->mTriangleCount * 3; ++ i)
-    _ctmStreamWriteUINT(self, self->mIndices[i]);
+  _ctmStreamWriteSection(self, "INDX", (size_t) self->mTriangleCount * 3 * 4);
+  if(!_ctmStreamWriteArray(self, self->mIndices, self->mTriangleCount, 3, 3))
+    return 0;
 
   // Write vertices
 #ifdef __DEBUG_
   printf("Vertices: %d bytes\n", (CTMuint)(self->mVertexCount * 3 * sizeof(CTMfloat)));
 #endif
-  _ctmStreamWrite(self, (void *) "VERT", 4);
-  for(i = 0; i < self->mVertexCount * 3; ++ i)
-    _ctmStreamWriteFLOAT(self, self->mVertices[i]);
+  _ctmStreamWriteSection(self, "VERT", (size_t) self->mVertexCount * 3 * 4);
+  if(!_ctmStreamWriteArray(self, self->mVertices, self->mVertexCount, 3, 3))
+    return 0;
 
   // Write normals
   if(self->mNormals)
@@ -69,9 +68,9 @@ int _ctmCompressMesh_RAW(_CTMcontext * self)
 #ifdef __DEBUG_
     printf("Normals: %d bytes\n", (CTMuint)(self->mVertexCount * 3 * sizeof(CTMfloat)));
 #endif
-    _ctmStreamWrite(self, (void *) "NORM", 4);
-    for(i = 0; i < self->mVertexCount * 3; ++ i)
-      _ctmStreamWriteFLOAT(self, self->mNormals[i]);
+    _ctmStreamWriteSection(self, "NORM", (size_t) self->mVertexCount * 3 * 4);
+    if(!_ctmStreamWriteArray(self, self->mNormals, self->mVertexCount, 3, 3))
+      return 0;
   }
 
   // Write UV maps
@@ -81,11 +80,11 @@ int _ctmCompressMesh_RAW(_CTMcontext * self)
 #ifdef __DEBUG_
     printf("UV coordinates (%s): %d bytes\n", map->mName ? map->mName : "no name", (CTMuint)(self->mVertexCount * 2 * sizeof(CTMfloat)));
 #endif
-    _ctmStreamWrite(self, (void *) "TEXC", 4);
+    _ctmStreamWriteSection(self, "TEXC", (size_t) self->mVertexCount * 2 * 4);
     _ctmStreamWriteSTRING(self, map->mName);
     _ctmStreamWriteSTRING(self, map->mFileName);
-    for(i = 0; i < self->mVertexCount * 2; ++ i)
-      _ctmStreamWriteFLOAT(self, map->mValues[i]);
+    if(!_ctmStreamWriteArray(self, map->mValues, self->mVertexCount, 2, 2))
+      return 0;
     map = map->mNext;
   }
 
@@ -96,10 +95,10 @@ int _ctmCompressMesh_RAW(_CTMcontext * self)
 #ifdef __DEBUG_
     printf("Vertex attributes (%s): %d bytes\n", map->mName ? map->mName : "no name", (CTMuint)(self->mVertexCount * 4 * sizeof(CTMfloat)));
 #endif
-    _ctmStreamWrite(self, (void *) "ATTR", 4);
+    _ctmStreamWriteSection(self, "ATTR", (size_t) self->mVertexCount * 4 * 4);
     _ctmStreamWriteSTRING(self, map->mName);
-    for(i = 0; i < self->mVertexCount * 4; ++ i)
-      _ctmStreamWriteFLOAT(self, map->mValues[i]);
+    if(!_ctmStreamWriteArray(self, map->mValues, self->mVertexCount, 4, 4))
+      return 0;
     map = map->mNext;
   }
 
@@ -113,7 +112,8 @@ int _ctmCompressMesh_RAW(_CTMcontext * self)
 //-----------------------------------------------------------------------------
 int _ctmUncompressMesh_RAW(_CTMcontext * self)
 {
-  CTMuint i;
+  CTMuint i, j, count;
+  CTMfloat n[256 * 3];
   _CTMfloatmap * map;
 
   // Read triangle indices
@@ -122,8 +122,9 @@ int _ctmUncompressMesh_RAW(_CTMcontext * self)
     self->mError = CTM_BAD_FORMAT;
     return 0;
   }
-  for(i = 0; i < self->mTriangleCount * 3; ++ i)
-    self->mIndices[i] = _ctmStreamReadUINT(self);
+  if(!_ctmStreamReadArray(self, self->mIndices, self->mTriangleCount, 3,
+                          self->mIndexStride))
+    return 0;
 
   // Read vertices
   if(_ctmStreamReadUINT(self) != FOURCC("VERT"))
@@ -131,8 +132,9 @@ int _ctmUncompressMesh_RAW(_CTMcontext * self)
     self->mError = CTM_BAD_FORMAT;
     return 0;
   }
-  for(i = 0; i < self->mVertexCount * 3; ++ i)
-    self->mVertices[i] = _ctmStreamReadFLOAT(self);
+  if(!_ctmStreamReadArray(self, self->mVertices, self->mVertexCount, 3,
+                          self->mVertexStride))
+    return 0;
 
   // Read normals
   if(self->mNormals)
@@ -142,8 +144,35 @@ int _ctmUncompressMesh_RAW(_CTMcontext * self)
       self->mError = CTM_BAD_FORMAT;
       return 0;
     }
-    for(i = 0; i < self->mVertexCount * 3; ++ i)
-      self->mNormals[i] = _ctmStreamReadFLOAT(self);
+    if(self->mNormalFormat == CTM_FORMAT_FLOAT32)
+    {
+      if(!_ctmStreamReadArray(self, self->mNormals, self->mVertexCount, 3,
+                              self->mNormalStride))
+        return 0;
+    }
+    else
+    {
+      // Convert the normals to the selected format, a block at a time
+      for(i = 0; i < self->mVertexCount; i += count)
+      {
+        count = self->mVertexCount - i < 256 ? self->mVertexCount - i : 256;
+        if(!_ctmStreamReadArray(self, n, count, 3, 3))
+          return 0;
+        for(j = 0; j < count; ++ j)
+          _ctmWriteNormal(self, i + j, &n[j * 3]);
+      }
+    }
+  }
+  else if(self->mSkipNormals && (self->mUVMapCount || self->mAttribMapCount))
+  {
+    // Skip normals (only if there are maps to load after them)
+    if(_ctmStreamReadUINT(self) != FOURCC("NORM"))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return 0;
+    }
+    if(!_ctmStreamSkipArray(self, self->mVertexCount, 3))
+      return 0;
   }
 
   // Read UV maps
@@ -157,12 +186,27 @@ int _ctmUncompressMesh_RAW(_CTMcontext * self)
     }
     _ctmStreamReadSTRING(self, &map->mName);
     _ctmStreamReadSTRING(self, &map->mFileName);
-    for(i = 0; i < self->mVertexCount * 2; ++ i)
-      map->mValues[i] = _ctmStreamReadFLOAT(self);
+    if(!_ctmStreamReadArray(self, map->mValues, self->mVertexCount, 2,
+                            map->mStride))
+      return 0;
     map = map->mNext;
   }
 
-  // Read attribute maps
+  // Skip UV maps (only if there are attribute maps to load after them)
+  for(i = 0; (i < self->mSkipUVMaps) && self->mAttribMapCount; ++ i)
+  {
+    if(_ctmStreamReadUINT(self) != FOURCC("TEXC"))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return 0;
+    }
+    if(!_ctmStreamSkipSTRING(self) || !_ctmStreamSkipSTRING(self) ||
+       !_ctmStreamSkipArray(self, self->mVertexCount, 2))
+      return 0;
+  }
+
+  // Read attribute maps (skipped attribute maps are last in the file, so they
+  // are simply not read)
   map = self->mAttribMaps;
   while(map)
   {
@@ -172,8 +216,9 @@ int _ctmUncompressMesh_RAW(_CTMcontext * self)
       return 0;
     }
     _ctmStreamReadSTRING(self, &map->mName);
-    for(i = 0; i < self->mVertexCount * 4; ++ i)
-      map->mValues[i] = _ctmStreamReadFLOAT(self);
+    if(!_ctmStreamReadArray(self, map->mValues, self->mVertexCount, 4,
+                            map->mStride))
+      return 0;
     map = map->mNext;
   }
 
@@ -0,0 +1,734 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        connectivity.c
+// Description: Connectivity coding of triangle indices and parallelogram
+//              prediction of vertices (used by the MG2 and MG3 methods when
+//              CTM_CODING_CONNECTIVITY or CTM_CODING_PARALLELOGRAM is
+//              selected).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+// The triangles are coded in the order of a traversal over shared edges.
+// Each coded triangle pushes its two other edges ("gates") to a stack, and the
+// triangle on the other side of the most recent gate is coded next. Only the
+// third vertex of that triangle needs to be stored, and the vertices are
+// numbered in the order in which they are first used, so that a vertex that
+// has not been used before is given by a single code. Already used vertices
+// are usually found among the latest neighbours of one of the gate vertices.
+//
+// The code stream holds one code per gate (gates whose opposite edge is
+// already known to be coded are skipped), and three codes for the first
+// triangle of each connected part of the mesh (a "seed"):
+//
+//   0        No triangle across the gate.
+//   1        A new vertex (the next unused vertex number).
+//   2, n     An already used vertex, given by n = (vertices used) - 1 - index.
+//   3 + 2k   Neighbour k of the first gate vertex (the most recent first).
+//   4 + 2k   Neighbour k of the second gate vertex.
+//
+// The decoder runs exactly the same traversal, so the coder works for any
+// triangle set (including non-manifold and degenerate triangles), although
+// the codes are only small for well connected meshes.
+//
+// The vertices can also be predicted from the traversal (parallelogram
+// prediction, see _ctmParallelogram()).
+
+#include <stdlib.h>
+#include "openctm.h"
+#include "internal.h"
+
+
+// Code values
+#define _CTM_CONN_CLOSED    0
+#define _CTM_CONN_NEW       1
+#define _CTM_CONN_EXPLICIT  2
+#define _CTM_CONN_NEIGHBOUR 3
+
+// Number of neighbours per vertex that are searched for references
+#define _CTM_CONN_MAX_NEIGHBOURS 16
+
+// Unused entry / end of list marker
+#define _CTM_CONN_NONE 0xffffffff
+
+//-----------------------------------------------------------------------------
+// _CTMconnstate - Traversal state that is identical in the encoder and the
+// decoder.
+//-----------------------------------------------------------------------------
+typedef struct {
+  // Vertex neighbour lists. Each coded edge u->v adds the entry 2n (the
+  // neighbour v of u) and the entry 2n+1 (the neighbour u of v), so the
+  // direction of an entry is given by its index. New entries are put first.
+  CTMuint * mFirst;      // First entry per vertex
+  CTMuint * mNeighbour;  // Neighbour vertex per entry
+  CTMuint * mNext;       // Next entry (of the same vertex) per entry
+  CTMuint mEntryCount;
+
+  // Gate stack (the two vertices of each gate, and the third vertex of the
+  // triangle that pushed it)
+  CTMuint * mGates;
+  CTMuint mGateCount;
+
+  // Number of vertices that have been used so far
+  CTMuint mVertexCount;
+
+  // Scratch memory that the arrays are taken from
+  _CTMscratch * mScratch;
+} _CTMconnstate;
+
+//-----------------------------------------------------------------------------
+// _ctmConnInit() - Allocate the traversal state for the given mesh size.
+//-----------------------------------------------------------------------------
+static int _ctmConnInit(_CTMconnstate * aState, _CTMscratch * aScratch,
+  CTMuint aVertexCount, CTMuint aTriangleCount)
+{
+  CTMuint i;
+  size_t entries = (size_t) aTriangleCount * 6;
+
+  aState->mFirst = (CTMuint *) 0;
+  aState->mNeighbour = (CTMuint *) 0;
+  aState->mNext = (CTMuint *) 0;
+  aState->mGates = (CTMuint *) 0;
+  aState->mEntryCount = 0;
+  aState->mGateCount = 0;
+  aState->mVertexCount = 0;
+  aState->mScratch = aScratch;
+  aState->mFirst = (CTMuint *) _ctmScratchAlloc(aScratch,
+    sizeof(CTMuint) * (aVertexCount ? aVertexCount : 1));
+  aState->mNeighbour = (CTMuint *) _ctmScratchAlloc(aScratch,
+    sizeof(CTMuint) * (entries ? entries : 1));
+  aState->mNext = (CTMuint *) _ctmScratchAlloc(aScratch,
+    sizeof(CTMuint) * (entries ? entries : 1));
+  aState->mGates = (CTMuint *) _ctmScratchAlloc(aScratch,
+    sizeof(CTMuint) * (entries ? entries / 2 * 3 : 1));
+  if(!aState->mFirst || !aState->mNeighbour || !aState->mNext || !aState->mGates)
+    return CTM_FALSE;
+  for(i = 0; i < aVertexCount; ++ i)
+    aState->mFirst[i] = _CTM_CONN_NONE;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmConnFree() - Free the traversal state.
+//-----------------------------------------------------------------------------
+static void _ctmConnFree(_CTMconnstate * aState)
+{
+  _ctmScratchFree(aState->mScratch, (void *) aState->mGates);
+  _ctmScratchFree(aState->mScratch, (void *) aState->mNext);
+  _ctmScratchFree(aState->mScratch, (void *) aState->mNeighbour);
+  _ctmScratchFree(aState->mScratch, (void *) aState->mFirst);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmConnAddTriangle() - Add the edges of a coded triangle to the neighbour
+// lists. If aGates is 2, the edges b->c and c->a are pushed to the gate stack
+// (c->a is the next gate). If aGates is 3, all three edges are pushed.
+//-----------------------------------------------------------------------------
+static void _ctmConnAddTriangle(_CTMconnstate * aState, CTMuint a, CTMuint b,
+  CTMuint c, CTMuint aGates)
+{
+  CTMuint tri[3], i, u, v, e;
+
+  tri[0] = a;
+  tri[1] = b;
+  tri[2] = c;
+  for(i = 0; i < 3; ++ i)
+  {
+    u = tri[i];
+    v = tri[(i + 1) % 3];
+    e = aState->mEntryCount;
+    aState->mNeighbour[e] = v;
+    aState->mNext[e] = aState->mFirst[u];
+    aState->mFirst[u] = e;
+    aState->mNeighbour[e + 1] = u;
+    aState->mNext[e + 1] = aState->mFirst[v];
+    aState->mFirst[v] = e + 1;
+    aState->mEntryCount = e + 2;
+  }
+
+  if(aGates == 3)
+  {
+    aState->mGates[aState->mGateCount ++] = a;
+    aState->mGates[aState->mGateCount ++] = b;
+    aState->mGates[aState->mGateCount ++] = c;
+  }
+  aState->mGates[aState->mGateCount ++] = b;
+  aState->mGates[aState->mGateCount ++] = c;
+  aState->mGates[aState->mGateCount ++] = a;
+  aState->mGates[aState->mGateCount ++] = c;
+  aState->mGates[aState->mGateCount ++] = a;
+  aState->mGates[aState->mGateCount ++] = b;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmConnHasEdge() - Check if the edge u->v is known to be coded (only the
+// latest neighbours of u are searched).
+//-----------------------------------------------------------------------------
+static int _ctmConnHasEdge(_CTMconnstate * aState, CTMuint u, CTMuint v)
+{
+  CTMuint e, n;
+  for(e = aState->mFirst[u], n = 0; (e != _CTM_CONN_NONE) &&
+      (n < _CTM_CONN_MAX_NEIGHBOURS); e = aState->mNext[e], ++ n)
+  {
+    if(!(e & 1) && (aState->mNeighbour[e] == v))
+      return CTM_TRUE;
+  }
+  return CTM_FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmConnFindNeighbour() - Find v among the latest neighbours of u. Returns
+// the position in the neighbour list, or _CTM_CONN_NONE if it was not found.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmConnFindNeighbour(_CTMconnstate * aState, CTMuint u,
+  CTMuint v)
+{
+  CTMuint e, n;
+  for(e = aState->mFirst[u], n = 0; (e != _CTM_CONN_NONE) &&
+      (n < _CTM_CONN_MAX_NEIGHBOURS); e = aState->mNext[e], ++ n)
+  {
+    if(aState->mNeighbour[e] == v)
+      return n;
+  }
+  return _CTM_CONN_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmConnGetNeighbour() - Get neighbour number k of u (_CTM_CONN_NONE if u
+// has no such neighbour).
+//-----------------------------------------------------------------------------
+static CTMuint _ctmConnGetNeighbour(_CTMconnstate * aState, CTMuint u,
+  CTMuint k)
+{
+  CTMuint e;
+  for(e = aState->mFirst[u]; (e != _CTM_CONN_NONE) && (k > 0); e = aState->mNext[e])
+    -- k;
+  return (e != _CTM_CONN_NONE) ? aState->mNeighbour[e] : _CTM_CONN_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// _CTMcodebuf - A growing array of codes (it is allocated after all other
+// working memory, so that it can grow in place at the top of the scratch
+// memory).
+//-----------------------------------------------------------------------------
+typedef struct {
+  CTMuint * mData;
+  CTMuint mCount;
+  CTMuint mCapacity;
+  _CTMscratch * mScratch;
+} _CTMcodebuf;
+
+//-----------------------------------------------------------------------------
+// _ctmPutCode() - Append a code to a code buffer.
+//-----------------------------------------------------------------------------
+static int _ctmPutCode(_CTMcodebuf * aBuf, CTMuint aCode)
+{
+  CTMuint * data;
+  CTMuint capacity;
+
+  if(aBuf->mCount >= aBuf->mCapacity)
+  {
+    capacity = aBuf->mCapacity + (aBuf->mCapacity >> 1) + 1024;
+    if(capacity < aBuf->mCapacity)
+      return CTM_FALSE;
+    data = (CTMuint *) _ctmScratchRealloc(aBuf->mScratch, (void *) aBuf->mData,
+                                          sizeof(CTMuint) * capacity);
+    if(!data)
+      return CTM_FALSE;
+    aBuf->mData = data;
+    aBuf->mCapacity = capacity;
+  }
+  aBuf->mData[aBuf->mCount ++] = aCode;
+  return CTM_TRUE;
+}
+
+
+//-----------------------------------------------------------------------------
+// _ctmEncodeVertex() - Append the code of the vertex aVertex (original index)
+// to the code buffer, and give it a new index if it has not been used before.
+// aGate holds the gate vertices (new indices), or is NULL for seeds. Returns
+// the new index of the vertex, or _CTM_CONN_NONE if we ran out of memory.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmEncodeVertex(_CTMconnstate * aState, CTMuint * aVertexMap,
+  CTMuint aVertex, const CTMuint * aGate, _CTMcodebuf * aBuf)
+{
+  CTMuint v, ka, kb;
+  int ok;
+
+  // New vertex?
+  v = aVertexMap[aVertex];
+  if(v == _CTM_CONN_NONE)
+  {
+    v = aVertexMap[aVertex] = aState->mVertexCount ++;
+    ok = _ctmPutCode(aBuf, _CTM_CONN_NEW);
+  }
+  else
+  {
+    // Neighbour of one of the gate vertices, or an explicit reference?
+    ka = kb = _CTM_CONN_NONE;
+    if(aGate)
+    {
+      ka = _ctmConnFindNeighbour(aState, aGate[0], v);
+      kb = _ctmConnFindNeighbour(aState, aGate[1], v);
+    }
+    if((ka != _CTM_CONN_NONE) && ((kb == _CTM_CONN_NONE) || (ka <= kb)))
+      ok = _ctmPutCode(aBuf, _CTM_CONN_NEIGHBOUR + 2 * ka);
+    else if(kb != _CTM_CONN_NONE)
+      ok = _ctmPutCode(aBuf, _CTM_CONN_NEIGHBOUR + 2 * kb + 1);
+    else
+      ok = _ctmPutCode(aBuf, _CTM_CONN_EXPLICIT) &&
+           _ctmPutCode(aBuf, aState->mVertexCount - 1 - v);
+  }
+
+  return ok ? v : _CTM_CONN_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmEdgeHash() - Hash function for the directed edge u->v.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmEdgeHash(CTMuint u, CTMuint v)
+{
+  return (u * 0x9e3779b1) ^ (v * 0x85ebca77);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmNextCorner() - Get the corner that follows corner c in its triangle.
+//-----------------------------------------------------------------------------
+#define _ctmNextCorner(c) ((c) % 3 == 2 ? (c) - 2 : (c) + 1)
+
+//-----------------------------------------------------------------------------
+// _ctmEncodeConnectivity() - Code the triangles aIndices[0..aTriangleCount-1]
+// of a mesh with aVertexCount vertices. The vertices are given new indices in
+// the order in which they are first used (vertices that are not used by any
+// triangle get the last indices, in their original order), and the new index
+// of each vertex is returned in aVertexMap. The triangles are returned in
+// aIndices, in the order in which they are decoded and with the new vertex
+// indices. If aOpposite is given, the third vertex of the triangle on the
+// other side of the gate of each returned triangle (_CTM_CONN_NONE for seeds)
+// is stored there. The codes are returned in *aCodes (allocated from the
+// scratch memory of the context), and the number of codes in *aCodeCount.
+//-----------------------------------------------------------------------------
+int _ctmEncodeConnectivity(_CTMcontext * self, CTMuint * aIndices,
+  CTMuint aVertexCount, CTMuint aTriangleCount, CTMuint * aVertexMap,
+  CTMuint * aOpposite, CTMuint ** aCodes, CTMuint * aCodeCount)
+{
+  _CTMconnstate state;
+  _CTMcodebuf codes;
+  CTMuint * table, * chain, * original, * triangles, * tri, cornerCount,
+          tableSize, mask, c, h, u, v, j, t, count, seed, gate[2];
+  unsigned char * coded;
+  int result = CTM_FALSE;
+
+  codes.mData = (CTMuint *) 0;
+  codes.mCount = codes.mCapacity = 0;
+  codes.mScratch = self->mScratch;
+  if(aTriangleCount > 0x7fffffff / 6)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  cornerCount = aTriangleCount * 3;
+
+  // Allocate working memory
+  for(tableSize = 1024; (tableSize < cornerCount) && (tableSize < 0x80000000); tableSize <<= 1);
+  tableSize <<= 1;
+  mask = tableSize - 1;
+  table = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * tableSize);
+  chain = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * (cornerCount ? cornerCount : 1));
+  triangles = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * (cornerCount ? cornerCount : 1));
+  original = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * (aVertexCount ? aVertexCount : 1));
+  coded = (unsigned char *) _ctmScratchCalloc(self->mScratch,
+    aTriangleCount ? aTriangleCount : 1);
+  if(!_ctmConnInit(&state, self->mScratch, aVertexCount, aTriangleCount) ||
+     !table || !chain || !triangles || !original || !coded)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+
+  // Build a hash table with one chain of corners per directed edge (corner c
+  // is the edge from aIndices[c] to the next vertex of the triangle). The
+  // corners are added last to first, so that each chain is in triangle order.
+  for(h = 0; h < tableSize; ++ h)
+    table[h] = _CTM_CONN_NONE;
+  for(c = cornerCount; c-- > 0; )
+  {
+    u = aIndices[c];
+    v = aIndices[_ctmNextCorner(c)];
+    for(h = _ctmEdgeHash(u, v) & mask; table[h] != _CTM_CONN_NONE; h = (h + 1) & mask)
+    {
+      j = table[h];
+      if((aIndices[j] == u) && (aIndices[_ctmNextCorner(j)] == v))
+        break;
+    }
+    chain[c] = table[h];
+    table[h] = c;
+  }
+
+  for(v = 0; v < aVertexCount; ++ v)
+    aVertexMap[v] = _CTM_CONN_NONE;
+
+  // Traverse the mesh
+  count = 0;
+  seed = 0;
+  while(count < aTriangleCount)
+  {
+    tri = &triangles[count * 3];
+
+    if(state.mGateCount == 0)
+    {
+      // Start a new part of the mesh with the first triangle that has not
+      // been coded yet
+      while(coded[seed])
+        ++ seed;
+      for(j = 0; j < 3; ++ j)
+      {
+        tri[j] = _ctmEncodeVertex(&state, aVertexMap, aIndices[seed * 3 + j], (CTMuint *) 0, &codes);
+        if(tri[j] == _CTM_CONN_NONE)
+        {
+          self->mError = CTM_OUT_OF_MEMORY;
+          goto cleanup;
+        }
+        original[tri[j]] = aIndices[seed * 3 + j];
+      }
+      coded[seed] = 1;
+      if(aOpposite)
+        aOpposite[count] = _CTM_CONN_NONE;
+      _ctmConnAddTriangle(&state, tri[0], tri[1], tri[2], 3);
+      ++ count;
+      continue;
+    }
+
+    // Pop the next gate a->b. Skip it if the edge b->a is already coded.
+    state.mGateCount -= 3;
+    gate[0] = state.mGates[state.mGateCount];
+    gate[1] = state.mGates[state.mGateCount + 1];
+    if(_ctmConnHasEdge(&state, gate[1], gate[0]))
+      continue;
+
+    // Find the first triangle with the edge b->a that has not been coded yet
+    // (coded triangles are removed from the front of the chain)
+    u = original[gate[1]];
+    v = original[gate[0]];
+    for(h = _ctmEdgeHash(u, v) & mask; table[h] != _CTM_CONN_NONE; h = (h + 1) & mask)
+    {
+      j = table[h];
+      if((aIndices[j] == u) && (aIndices[_ctmNextCorner(j)] == v))
+        break;
+    }
+    for(c = table[h]; (c != _CTM_CONN_NONE) && coded[c / 3]; c = chain[c])
+    {
+      if(chain[c] != _CTM_CONN_NONE)
+        table[h] = chain[c];
+    }
+    if(c == _CTM_CONN_NONE)
+    {
+      if(!_ctmPutCode(&codes, _CTM_CONN_CLOSED))
+      {
+        self->mError = CTM_OUT_OF_MEMORY;
+        goto cleanup;
+      }
+      continue;
+    }
+
+    // Code the third vertex of the triangle
+    t = c / 3;
+    c = _ctmNextCorner(_ctmNextCorner(c));
+    tri[0] = gate[1];
+    tri[1] = gate[0];
+    tri[2] = _ctmEncodeVertex(&state, aVertexMap, aIndices[c], gate, &codes);
+    if(tri[2] == _CTM_CONN_NONE)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+    original[tri[2]] = aIndices[c];
+    coded[t] = 1;
+    if(aOpposite)
+      aOpposite[count] = state.mGates[state.mGateCount + 2];
+    _ctmConnAddTriangle(&state, tri[0], tri[1], tri[2], 2);
+    ++ count;
+  }
+
+  // Unused vertices get the last indices
+  for(v = 0; v < aVertexCount; ++ v)
+  {
+    if(aVertexMap[v] == _CTM_CONN_NONE)
+      aVertexMap[v] = state.mVertexCount ++;
+  }
+
+  // Return the triangles in decoding order
+  for(c = 0; c < cornerCount; ++ c)
+    aIndices[c] = triangles[c];
+  result = CTM_TRUE;
+
+cleanup:
+  _ctmConnFree(&state);
+  _ctmScratchFree(self->mScratch, (void *) coded);
+  _ctmScratchFree(self->mScratch, (void *) original);
+  _ctmScratchFree(self->mScratch, (void *) triangles);
+  _ctmScratchFree(self->mScratch, (void *) chain);
+  _ctmScratchFree(self->mScratch, (void *) table);
+  if(result)
+  {
+    *aCodes = codes.mData;
+    *aCodeCount = codes.mCount;
+  }
+  else
+    _ctmScratchFree(self->mScratch, (void *) codes.mData);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDecodeVertex() - Decode the next vertex from the code stream. aGate
+// holds the gate vertices, or is NULL for seeds. Returns the vertex index, or
+// _CTM_CONN_NONE if the code stream is corrupt.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmDecodeVertex(_CTMconnstate * aState, const CTMuint * aCodes,
+  CTMuint aCodeCount, CTMuint * aPos, CTMuint aVertexCount,
+  const CTMuint * aGate)
+{
+  CTMuint code, n;
+
+  if(*aPos >= aCodeCount)
+    return _CTM_CONN_NONE;
+  code = aCodes[(*aPos) ++];
+
+  switch(code)
+  {
+    case _CTM_CONN_CLOSED:
+      return _CTM_CONN_NONE;
+
+    case _CTM_CONN_NEW:
+      if(aState->mVertexCount >= aVertexCount)
+        return _CTM_CONN_NONE;
+      return aState->mVertexCount ++;
+
+    case _CTM_CONN_EXPLICIT:
+      if(*aPos >= aCodeCount)
+        return _CTM_CONN_NONE;
+      n = aCodes[(*aPos) ++];
+      if(n >= aState->mVertexCount)
+        return _CTM_CONN_NONE;
+      return aState->mVertexCount - 1 - n;
+
+    default:
+      code -= _CTM_CONN_NEIGHBOUR;
+      if(!aGate || (code >= 2 * _CTM_CONN_MAX_NEIGHBOURS))
+        return _CTM_CONN_NONE;
+      return _ctmConnGetNeighbour(aState, aGate[code & 1], code >> 1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDecodeConnectivity() - Decode aTriangleCount triangles from the code
+// stream aCodes[0..aCodeCount-1] (see _ctmEncodeConnectivity()), and store
+// them in aIndices. aStride is the distance between two triangles in
+// aIndices. If aOpposite is given, it is filled in as by
+// _ctmEncodeConnectivity(). The traversal state is taken from aScratch.
+// Returns CTM_NONE on success, or an error code.
+//-----------------------------------------------------------------------------
+CTMenum _ctmDecodeConnectivity(_CTMscratch * aScratch, const CTMuint * aCodes,
+  CTMuint aCodeCount, CTMuint aVertexCount, CTMuint aTriangleCount,
+  CTMuint * aIndices, CTMuint aStride, CTMuint * aOpposite)
+{
+  _CTMconnstate state;
+  CTMuint * tri, count, pos, j, gate[2];
+  CTMenum error = CTM_NONE;
+
+  if(aTriangleCount > 0x7fffffff / 6)
+    return CTM_BAD_FORMAT;
+  if(!_ctmConnInit(&state, aScratch, aVertexCount, aTriangleCount))
+  {
+    _ctmConnFree(&state);
+    return CTM_OUT_OF_MEMORY;
+  }
+
+  // Run the same traversal as the encoder
+  count = 0;
+  pos = 0;
+  while((count < aTriangleCount) && (error == CTM_NONE))
+  {
+    tri = &aIndices[(size_t) count * aStride];
+
+    if(state.mGateCount == 0)
+    {
+      // Seed triangle
+      for(j = 0; (j < 3) && (error == CTM_NONE); ++ j)
+      {
+        tri[j] = _ctmDecodeVertex(&state, aCodes, aCodeCount, &pos, aVertexCount, (CTMuint *) 0);
+        if(tri[j] == _CTM_CONN_NONE)
+          error = CTM_BAD_FORMAT;
+      }
+      if(error == CTM_NONE)
+      {
+        if(aOpposite)
+          aOpposite[count] = _CTM_CONN_NONE;
+        _ctmConnAddTriangle(&state, tri[0], tri[1], tri[2], 3);
+        ++ count;
+      }
+      continue;
+    }
+
+    // Pop the next gate a->b (skipped if the edge b->a is already decoded)
+    state.mGateCount -= 3;
+    gate[0] = state.mGates[state.mGateCount];
+    gate[1] = state.mGates[state.mGateCount + 1];
+    if(_ctmConnHasEdge(&state, gate[1], gate[0]))
+      continue;
+
+    // No triangle across the gate?
+    if(pos >= aCodeCount)
+    {
+      error = CTM_BAD_FORMAT;
+      break;
+    }
+    if(aCodes[pos] == _CTM_CONN_CLOSED)
+    {
+      ++ pos;
+      continue;
+    }
+
+    // Decode the third vertex of the triangle b, a, c
+    tri[0] = gate[1];
+    tri[1] = gate[0];
+    tri[2] = _ctmDecodeVertex(&state, aCodes, aCodeCount, &pos, aVertexCount, gate);
+    if(tri[2] == _CTM_CONN_NONE)
+    {
+      error = CTM_BAD_FORMAT;
+      break;
+    }
+    if(aOpposite)
+      aOpposite[count] = state.mGates[state.mGateCount + 2];
+    _ctmConnAddTriangle(&state, tri[0], tri[1], tri[2], 2);
+    ++ count;
+  }
+
+  _ctmConnFree(&state);
+  return error;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmParallelogram() - Parallelogram prediction of the integer vertices
+// aIntVertices (three values per vertex), using the triangles aIndices in the
+// order in which they are decoded, and the opposite vertices aOpposite (see
+// _ctmEncodeConnectivity()). A new vertex c of a triangle b, a, c that is
+// reached over the gate a->b of the triangle a, b, w is predicted as
+// a + b - w. The new vertices of seed triangles are predicted from the
+// previous corner of the triangle, and the first corner and any unused
+// vertices are predicted from the previous vertex.
+// If aDeltas is given, the prediction errors are stored there. Otherwise
+// aIntVertices holds the prediction errors, which are restored in place.
+//-----------------------------------------------------------------------------
+static void _ctmParallelogram(CTMint * aIntVertices, CTMint * aDeltas,
+  const CTMuint * aIndices, CTMuint aStride, const CTMuint * aOpposite,
+  CTMuint aVertexCount, CTMuint aTriangleCount)
+{
+  CTMuint next, t, i, j, v, pred[3];
+  const CTMuint * tri;
+  const CTMint * p, * q, * w;
+
+  next = 0;
+  for(t = 0; t < aTriangleCount; ++ t)
+  {
+    tri = &aIndices[(size_t) t * aStride];
+    for(j = 0; j < 3; ++ j)
+    {
+      v = tri[j];
+      if(v != next)
+        continue;
+
+      // Predict the vertex
+      if(aOpposite[t] != _CTM_CONN_NONE)
+      {
+        p = &aIntVertices[tri[0] * 3];
+        q = &aIntVertices[tri[1] * 3];
+        w = &aIntVertices[aOpposite[t] * 3];
+        for(i = 0; i < 3; ++ i)
+          pred[i] = (CTMuint) p[i] + (CTMuint) q[i] - (CTMuint) w[i];
+      }
+      else if(j > 0 || v > 0)
+      {
+        p = &aIntVertices[(j > 0 ? tri[j - 1] : v - 1) * 3];
+        for(i = 0; i < 3; ++ i)
+          pred[i] = (CTMuint) p[i];
+      }
+      else
+        pred[0] = pred[1] = pred[2] = 0;
+
+      if(aDeltas)
+      {
+        for(i = 0; i < 3; ++ i)
+          aDeltas[v * 3 + i] = (CTMint) ((CTMuint) aIntVertices[v * 3 + i] - pred[i]);
+      }
+      else
+      {
+        for(i = 0; i < 3; ++ i)
+          aIntVertices[v * 3 + i] = (CTMint) ((CTMuint) aIntVertices[v * 3 + i] + pred[i]);
+      }
+      ++ next;
+    }
+  }
+
+  // Vertices that are not used by any triangle
+  for(v = next; v < aVertexCount; ++ v)
+  {
+    for(i = 0; i < 3; ++ i)
+    {
+      pred[i] = v ? (CTMuint) aIntVertices[(v - 1) * 3 + i] : 0;
+      if(aDeltas)
+        aDeltas[v * 3 + i] = (CTMint) ((CTMuint) aIntVertices[v * 3 + i] - pred[i]);
+      else
+        aIntVertices[v * 3 + i] = (CTMint) ((CTMuint) aIntVertices[v * 3 + i] + pred[i]);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmMakeParallelogramDeltas() - Calculate the parallelogram prediction
+// errors aDeltas of the integer vertices aIntVertices (see
+// _ctmParallelogram()).
+//-----------------------------------------------------------------------------
+void _ctmMakeParallelogramDeltas(const CTMint * aIntVertices, CTMint * aDeltas,
+  const CTMuint * aIndices, const CTMuint * aOpposite, CTMuint aVertexCount,
+  CTMuint aTriangleCount)
+{
+  _ctmParallelogram((CTMint *) aIntVertices, aDeltas, aIndices, 3, aOpposite,
+                    aVertexCount, aTriangleCount);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmRestoreParallelogramDeltas() - Restore the integer vertices from the
+// parallelogram prediction errors in aIntVertices (in place). aStride is the
+// distance between two triangles in aIndices.
+//-----------------------------------------------------------------------------
+void _ctmRestoreParallelogramDeltas(CTMint * aIntVertices,
+  const CTMuint * aIndices, CTMuint aStride, const CTMuint * aOpposite,
+  CTMuint aVertexCount, CTMuint aTriangleCount)
+{
+  _ctmParallelogram(aIntVertices, (CTMint *) 0, aIndices, aStride, aOpposite,
+                    aVertexCount, aTriangleCount);
+}
@@ -0,0 +1,214 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        filemap.c
+// Description: Read-only memory mapping of files (with a plain read-to-memory
+//              fallback for systems without memory mapping support).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "openctm.h"
+#include "internal.h"
+
+#if defined(OPENCTM_NO_MMAP)
+  // Memory mapping disabled at build time
+#elif defined(_WIN32)
+  #include <windows.h>
+  #define _CTM_WIN32_MMAP
+#elif defined(__unix__) || defined(__unix) || defined(__APPLE__)
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define _CTM_POSIX_MMAP
+#endif
+
+
+#if defined(_CTM_WIN32_MMAP)
+
+//-----------------------------------------------------------------------------
+// _ctmMapFile() - Map a file into memory (Win32 version).
+//-----------------------------------------------------------------------------
+int _ctmMapFile(const char * aFileName, _CTMfilemap * aMap,
+  _CTMallocator * aAllocator)
+{
+  HANDLE file, mapping;
+  LARGE_INTEGER size;
+
+  aMap->mData = (const unsigned char *) 0;
+  aMap->mSize = 0;
+  aMap->mHandle = (void *) 0;
+  aMap->mAllocator = aAllocator;
+
+  file = CreateFileA(aFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file == INVALID_HANDLE_VALUE)
+    return CTM_FALSE;
+  if(!GetFileSizeEx(file, &size) || (size.QuadPart <= 0) ||
+     ((ULONGLONG) size.QuadPart > (ULONGLONG) ((size_t) -1)))
+  {
+    CloseHandle(file);
+    return CTM_FALSE;
+  }
+  mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if(mapping == NULL)
+    return CTM_FALSE;
+  aMap->mData = (const unsigned char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(!aMap->mData)
+  {
+    CloseHandle(mapping);
+    return CTM_FALSE;
+  }
+  aMap->mSize = (size_t) size.QuadPart;
+  aMap->mHandle = (void *) mapping;
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmUnmapFile() - Unmap a file that was mapped with _ctmMapFile().
+//-----------------------------------------------------------------------------
+void _ctmUnmapFile(_CTMfilemap * aMap)
+{
+  if(aMap->mData)
+    UnmapViewOfFile((LPCVOID) aMap->mData);
+  if(aMap->mHandle)
+    CloseHandle((HANDLE) aMap->mHandle);
+  aMap->mData = (const unsigned char *) 0;
+  aMap->mSize = 0;
+  aMap->mHandle = (void *) 0;
+}
+
+#elif defined(_CTM_POSIX_MMAP)
+
+//-----------------------------------------------------------------------------
+// _ctmMapFile() - Map a file into memory (POSIX version).
+//-----------------------------------------------------------------------------
+int _ctmMapFile(const char * aFileName, _CTMfilemap * aMap,
+  _CTMallocator * aAllocator)
+{
+  struct stat st;
+  void * data;
+  int fd;
+
+  aMap->mData = (const unsigned char *) 0;
+  aMap->mSize = 0;
+  aMap->mHandle = (void *) 0;
+  aMap->mAllocator = aAllocator;
+
+  fd = open(aFileName, O_RDONLY);
+  if(fd < 0)
+    return CTM_FALSE;
+  if((fstat(fd, &st) != 0) || (st.st_size <= 0) ||
+     ((unsigned long long) st.st_size > (unsigned long long) ((size_t) -1)))
+  {
+    close(fd);
+    return CTM_FALSE;
+  }
+  data = mmap((void *) 0, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED)
+    return CTM_FALSE;
+  aMap->mData = (const unsigned char *) data;
+  aMap->mSize = (size_t) st.st_size;
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmUnmapFile() - Unmap a file that was mapped with _ctmMapFile().
+//-----------------------------------------------------------------------------
+void _ctmUnmapFile(_CTMfilemap * aMap)
+{
+  if(aMap->mData)
+    munmap((void *) aMap->mData, aMap->mSize);
+  aMap->mData = (const unsigned char *) 0;
+  aMap->mSize = 0;
+  aMap->mHandle = (void *) 0;
+}
+
+#else
+
+//-----------------------------------------------------------------------------
+// _ctmMapFile() - Read an entire file into memory that is taken from
+// aAllocator (fallback for systems without memory mapping support).
+//-----------------------------------------------------------------------------
+int _ctmMapFile(const char * aFileName, _CTMfilemap * aMap,
+  _CTMallocator * aAllocator)
+{
+  FILE * f;
+  long size;
+  unsigned char * data;
+
+  aMap->mData = (const unsigned char *) 0;
+  aMap->mSize = 0;
+  aMap->mHandle = (void *) 0;
+  aMap->mAllocator = aAllocator;
+
+  f = fopen(aFileName, "rb");
+  if(!f)
+    return CTM_FALSE;
+  if((fseek(f, 0, SEEK_END) != 0) || ((size = ftell(f)) <= 0) ||
+     (fseek(f, 0, SEEK_SET) != 0))
+  {
+    fclose(f);
+    return CTM_FALSE;
+  }
+  data = (unsigned char *) _ctmAlloc(aAllocator, (size_t) size);
+  if(!data)
+  {
+    fclose(f);
+    return CTM_FALSE;
+  }
+  if(fread(data, 1, (size_t) size, f) != (size_t) size)
+  {
+    _ctmFree(aAllocator, data);
+    fclose(f);
+    return CTM_FALSE;
+  }
+  fclose(f);
+  aMap->mData = data;
+  aMap->mSize = (size_t) size;
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmUnmapFile() - Free a file that was read with _ctmMapFile().
+//-----------------------------------------------------------------------------
+void _ctmUnmapFile(_CTMfilemap * aMap)
+{
+  if(aMap->mData)
+    _ctmFree(aMap->mAllocator, (void *) aMap->mData);
+  aMap->mData = (const unsigned char *) 0;
+  aMap->mSize = 0;
+}
+
+#endif
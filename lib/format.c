@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        format.c
+// Description: Conversion of decoded vertex data to compact output formats
+//              (half-float and 16-bit signed normalized normals).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include <math.h>
+#include "openctm.h"
+#include "internal.h"
+
+
+//-----------------------------------------------------------------------------
+// _ctmFloatToHalf() - Convert a single precision float to a half precision
+// (IEEE 754 binary16) float, rounding to nearest even. Values that are too
+// large become infinity, and NaN is preserved.
+//-----------------------------------------------------------------------------
+static unsigned short _ctmFloatToHalf(CTMfloat aValue)
+{
+  union {
+    CTMfloat f;
+    CTMuint i;
+  } u;
+  CTMuint sign, exponent, mantissa, shift, rest, half, h;
+
+  u.f = aValue;
+  sign = (u.i >> 16) & 0x8000;
+  exponent = (u.i >> 23) & 0xff;
+  mantissa = u.i & 0x007fffff;
+
+  // Infinity / NaN
+  if(exponent == 0xff)
+    return (unsigned short) (sign | 0x7c00 | (mantissa ? 0x0200 : 0));
+
+  // Too large (overflows to infinity)
+  if(exponent > 142)
+    return (unsigned short) (sign | 0x7c00);
+
+  // Normalized half float
+  if(exponent >= 113)
+  {
+    h = ((exponent - 112) << 10) | (mantissa >> 13);
+    rest = mantissa & 0x1fff;
+    if((rest > 0x1000) || ((rest == 0x1000) && (h & 1)))
+      ++ h; // (a carry into the exponent is correct, up to infinity)
+    return (unsigned short) (sign | h);
+  }
+
+  // Too small (underflows to zero)
+  if(exponent < 102)
+    return (unsigned short) sign;
+
+  // Denormalized half float
+  mantissa |= 0x00800000;
+  shift = 126 - exponent;
+  h = mantissa >> shift;
+  rest = mantissa & ((1 << shift) - 1);
+  half = 1 << (shift - 1);
+  if((rest > half) || ((rest == half) && (h & 1)))
+    ++ h;
+  return (unsigned short) (sign | h);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFloatToSnorm16() - Convert a float to a 16-bit signed normalized
+// integer (the range [-1, 1] maps to [-32767, 32767]).
+//-----------------------------------------------------------------------------
+static short _ctmFloatToSnorm16(CTMfloat aValue)
+{
+  if(aValue != aValue)
+    return 0;
+  if(aValue >= 1.0f)
+    return 32767;
+  if(aValue <= -1.0f)
+    return -32767;
+  return (short) floorf(aValue * 32767.0f + 0.5f);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmIsFiniteHalf() - Check if a (possibly unaligned) half float is finite.
+//-----------------------------------------------------------------------------
+CTMint _ctmIsFiniteHalf(const void * aValue)
+{
+  unsigned short h;
+  memcpy(&h, aValue, sizeof(h));
+  return (h & 0x7c00) != 0x7c00;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWriteNormal() - Store normal number aIndex in the normal array of the
+// context, in the selected normal format (self->mNormalFormat). Normals in
+// a 16-bit format may be only 2-byte aligned within an interleaved buffer.
+//-----------------------------------------------------------------------------
+void _ctmWriteNormal(_CTMcontext * self, CTMuint aIndex,
+  const CTMfloat * aNormal)
+{
+  unsigned char * dst;
+  unsigned short h[3];
+  short s[3];
+  CTMuint j;
+
+  dst = (unsigned char *) self->mNormals +
+        (size_t) aIndex * self->mNormalStride * 4;
+  switch(self->mNormalFormat)
+  {
+    case CTM_FORMAT_FLOAT16:
+      for(j = 0; j < 3; ++ j)
+        h[j] = _ctmFloatToHalf(aNormal[j]);
+      memcpy(dst, h, sizeof(h));
+      break;
+
+    case CTM_FORMAT_SNORM16:
+      for(j = 0; j < 3; ++ j)
+        s[j] = _ctmFloatToSnorm16(aNormal[j]);
+      memcpy(dst, s, sizeof(s));
+      break;
+
+    default:
+      memcpy(dst, aNormal, 3 * sizeof(CTMfloat));
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWriteNormals() - Store all the normals of a tightly packed float array
+// (three floats per vertex) in the normal array of the context.
+//-----------------------------------------------------------------------------
+void _ctmWriteNormals(_CTMcontext * self, const CTMfloat * aNormals)
+{
+  CTMuint i;
+
+  for(i = 0; i < self->mVertexCount; ++ i)
+    _ctmWriteNormal(self, i, &aNormals[i * 3]);
+}
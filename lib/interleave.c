@@ -0,0 +1,594 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        interleave.c
+// Description: Byte plane interleaving/deinterleaving of 32-bit word arrays
+//              (used for packed data streams), with SIMD optimized versions
+//              for SSE2, AVX2 and NEON capable CPUs.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+// Select which SIMD versions to build (define OPENCTM_NO_SIMD to only build
+// the portable C version)
+#if !defined(OPENCTM_NO_SIMD)
+  #if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+      (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define _CTM_USE_SSE2
+    #if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+      #include <immintrin.h>
+      #define _CTM_USE_AVX2
+      #define _CTM_AVX2_TARGET __attribute__((target("avx2")))
+    #elif defined(_MSC_VER) && (_MSC_VER >= 1700)
+      #include <immintrin.h>
+      #include <intrin.h>
+      #define _CTM_USE_AVX2
+      #define _CTM_AVX2_TARGET
+    #endif
+  #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define _CTM_USE_NEON
+  #endif
+#endif
+
+
+//-----------------------------------------------------------------------------
+// The byte plane layout
+// ---------------------
+// An array of aCount elements, with aSize 32-bit words per element, is stored
+// as four byte planes (most significant byte first), where each plane holds
+// one byte of every word. Within a plane, the words are ordered by element
+// component (all first components, then all second components, etc).
+// Optionally, signed integers are stored in signed magnitude form (the sign
+// in the least significant bit), which keeps small negative numbers small.
+//
+// The functions below handle one element component at a time: aSrc/aDst
+// points to the first word of the component, aStride is the distance between
+// two consecutive words of the component (i.e. the element stride, in words),
+// and the plane data for the component starts at aPlanes, with aPlaneSize
+// bytes between the planes.
+//-----------------------------------------------------------------------------
+
+
+//-----------------------------------------------------------------------------
+// _ctmInterleaveC() - Portable C version of the interleave operation, for
+// the elements aStart to aCount-1.
+//-----------------------------------------------------------------------------
+static void _ctmInterleaveC(unsigned char * aPlanes, const unsigned char * aSrc,
+  CTMuint aStart, CTMuint aCount, CTMuint aStride, size_t aPlaneSize,
+  CTMint aSignedInts)
+{
+  unsigned char * p0, * p1, * p2, * p3;
+  CTMuint i, x;
+
+  p0 = aPlanes;
+  p1 = p0 + aPlaneSize;
+  p2 = p1 + aPlaneSize;
+  p3 = p2 + aPlaneSize;
+  for(i = aStart; i < aCount; ++ i)
+  {
+    memcpy(&x, &aSrc[(size_t) i * aStride * 4], 4);
+    // Convert two's complement to signed magnitude?
+    if(aSignedInts)
+      x = (x << 1) ^ (CTMuint) -(CTMint) (x >> 31);
+    p0[i] = (unsigned char) (x >> 24);
+    p1[i] = (unsigned char) (x >> 16);
+    p2[i] = (unsigned char) (x >> 8);
+    p3[i] = (unsigned char) x;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDeinterleaveC() - Portable C version of the deinterleave operation, for
+// the elements aStart to aCount-1.
+//-----------------------------------------------------------------------------
+static void _ctmDeinterleaveC(unsigned char * aDst, const unsigned char * aPlanes,
+  CTMuint aStart, CTMuint aCount, CTMuint aStride, size_t aPlaneSize,
+  CTMint aSignedInts)
+{
+  const unsigned char * p0, * p1, * p2, * p3;
+  CTMuint i, x;
+
+  p0 = aPlanes;
+  p1 = p0 + aPlaneSize;
+  p2 = p1 + aPlaneSize;
+  p3 = p2 + aPlaneSize;
+  for(i = aStart; i < aCount; ++ i)
+  {
+    x = ((CTMuint) p0[i] << 24) | ((CTMuint) p1[i] << 16) |
+        ((CTMuint) p2[i] << 8) | (CTMuint) p3[i];
+    // Convert signed magnitude to two's complement?
+    if(aSignedInts)
+      x = (x >> 1) ^ (CTMuint) -(CTMint) (x & 1);
+    memcpy(&aDst[(size_t) i * aStride * 4], &x, 4);
+  }
+}
+
+#if defined(_CTM_USE_SSE2)
+
+//-----------------------------------------------------------------------------
+// _ctmLoad4_SSE2() - Load four (possibly strided) words.
+//-----------------------------------------------------------------------------
+static __m128i _ctmLoad4_SSE2(const unsigned char * aSrc, CTMuint aStride)
+{
+  CTMint w[4];
+  if(aStride == 1)
+    return _mm_loadu_si128((const __m128i *) aSrc);
+  memcpy(&w[0], aSrc, 4);
+  memcpy(&w[1], aSrc + aStride * 4, 4);
+  memcpy(&w[2], aSrc + aStride * 8, 4);
+  memcpy(&w[3], aSrc + aStride * 12, 4);
+  return _mm_set_epi32(w[3], w[2], w[1], w[0]);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStore4_SSE2() - Store four (possibly strided) words.
+//-----------------------------------------------------------------------------
+static void _ctmStore4_SSE2(unsigned char * aDst, CTMuint aStride, __m128i aValue)
+{
+  CTMint w[4];
+  if(aStride == 1)
+  {
+    _mm_storeu_si128((__m128i *) aDst, aValue);
+    return;
+  }
+  _mm_storeu_si128((__m128i *) w, aValue);
+  memcpy(aDst, &w[0], 4);
+  memcpy(aDst + aStride * 4, &w[1], 4);
+  memcpy(aDst + aStride * 8, &w[2], 4);
+  memcpy(aDst + aStride * 12, &w[3], 4);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmInterleave_SSE2() - SSE2 version of the interleave operation (16
+// elements per iteration).
+//-----------------------------------------------------------------------------
+static void _ctmInterleave_SSE2(unsigned char * aPlanes, const unsigned char * aSrc,
+  CTMuint aCount, CTMuint aStride, size_t aPlaneSize, CTMint aSignedInts)
+{
+  __m128i v[4], mask, lo, hi;
+  CTMuint i, j, b;
+
+  mask = _mm_set1_epi32(0xff);
+  for(i = 0; i + 16 <= aCount; i += 16)
+  {
+    for(j = 0; j < 4; ++ j)
+    {
+      v[j] = _ctmLoad4_SSE2(&aSrc[(size_t) (i + j * 4) * aStride * 4], aStride);
+      // Convert two's complement to signed magnitude?
+      if(aSignedInts)
+        v[j] = _mm_xor_si128(_mm_slli_epi32(v[j], 1), _mm_srai_epi32(v[j], 31));
+    }
+
+    // Extract one byte from each word and pack them into a plane (the byte
+    // values are in the range 0-255, so the saturating packs are lossless)
+    for(b = 0; b < 4; ++ b)
+    {
+      lo = _mm_packs_epi32(_mm_and_si128(v[0], mask), _mm_and_si128(v[1], mask));
+      hi = _mm_packs_epi32(_mm_and_si128(v[2], mask), _mm_and_si128(v[3], mask));
+      _mm_storeu_si128((__m128i *) &aPlanes[(3 - b) * aPlaneSize + i],
+                       _mm_packus_epi16(lo, hi));
+      for(j = 0; j < 4; ++ j)
+        v[j] = _mm_srli_epi32(v[j], 8);
+    }
+  }
+
+  // Remaining elements
+  _ctmInterleaveC(aPlanes, aSrc, i, aCount, aStride, aPlaneSize, aSignedInts);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDeinterleave_SSE2() - SSE2 version of the deinterleave operation (16
+// elements per iteration).
+//-----------------------------------------------------------------------------
+static void _ctmDeinterleave_SSE2(unsigned char * aDst, const unsigned char * aPlanes,
+  CTMuint aCount, CTMuint aStride, size_t aPlaneSize, CTMint aSignedInts)
+{
+  __m128i p0, p1, p2, p3, lo, hi, v[4], one;
+  CTMuint i, j;
+
+  one = _mm_set1_epi32(1);
+  for(i = 0; i + 16 <= aCount; i += 16)
+  {
+    p0 = _mm_loadu_si128((const __m128i *) &aPlanes[i]);
+    p1 = _mm_loadu_si128((const __m128i *) &aPlanes[aPlaneSize + i]);
+    p2 = _mm_loadu_si128((const __m128i *) &aPlanes[2 * aPlaneSize + i]);
+    p3 = _mm_loadu_si128((const __m128i *) &aPlanes[3 * aPlaneSize + i]);
+
+    // Combine the planes into 16-bit halves, and then into 32-bit words
+    lo = _mm_unpacklo_epi8(p3, p2);
+    hi = _mm_unpacklo_epi8(p1, p0);
+    v[0] = _mm_unpacklo_epi16(lo, hi);
+    v[1] = _mm_unpackhi_epi16(lo, hi);
+    lo = _mm_unpackhi_epi8(p3, p2);
+    hi = _mm_unpackhi_epi8(p1, p0);
+    v[2] = _mm_unpacklo_epi16(lo, hi);
+    v[3] = _mm_unpackhi_epi16(lo, hi);
+
+    for(j = 0; j < 4; ++ j)
+    {
+      // Convert signed magnitude to two's complement?
+      if(aSignedInts)
+        v[j] = _mm_xor_si128(_mm_srli_epi32(v[j], 1),
+          _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v[j], one)));
+      _ctmStore4_SSE2(&aDst[(size_t) (i + j * 4) * aStride * 4], aStride, v[j]);
+    }
+  }
+
+  // Remaining elements
+  _ctmDeinterleaveC(aDst, aPlanes, i, aCount, aStride, aPlaneSize, aSignedInts);
+}
+
+#endif // _CTM_USE_SSE2
+
+#if defined(_CTM_USE_AVX2)
+
+//-----------------------------------------------------------------------------
+// _ctmHasAVX2() - Check if the CPU (and OS) supports AVX2.
+//-----------------------------------------------------------------------------
+static int _ctmHasAVX2(void)
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0] < 7)
+    return 0;
+  __cpuid(info, 1);
+  // OSXSAVE and AVX, and the OS saves the YMM registers
+  if((info[2] & 0x18000000) != 0x18000000)
+    return 0;
+  if((_xgetbv(0) & 6) != 6)
+    return 0;
+  __cpuidex(info, 7, 0);
+  return (info[1] & 0x20) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLoad8_AVX2() - Load eight (possibly strided) words.
+//-----------------------------------------------------------------------------
+_CTM_AVX2_TARGET
+static __m256i _ctmLoad8_AVX2(const unsigned char * aSrc, CTMuint aStride)
+{
+  CTMint w[8];
+  CTMuint j;
+  if(aStride == 1)
+    return _mm256_loadu_si256((const __m256i *) aSrc);
+  for(j = 0; j < 8; ++ j)
+    memcpy(&w[j], aSrc + j * aStride * 4, 4);
+  return _mm256_loadu_si256((const __m256i *) w);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStore8_AVX2() - Store eight (possibly strided) words.
+//-----------------------------------------------------------------------------
+_CTM_AVX2_TARGET
+static void _ctmStore8_AVX2(unsigned char * aDst, CTMuint aStride, __m256i aValue)
+{
+  CTMint w[8];
+  CTMuint j;
+  if(aStride == 1)
+  {
+    _mm256_storeu_si256((__m256i *) aDst, aValue);
+    return;
+  }
+  _mm256_storeu_si256((__m256i *) w, aValue);
+  for(j = 0; j < 8; ++ j)
+    memcpy(aDst + j * aStride * 4, &w[j], 4);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmInterleave_AVX2() - AVX2 version of the interleave operation (32
+// elements per iteration).
+//-----------------------------------------------------------------------------
+_CTM_AVX2_TARGET
+static void _ctmInterleave_AVX2(unsigned char * aPlanes, const unsigned char * aSrc,
+  CTMuint aCount, CTMuint aStride, size_t aPlaneSize, CTMint aSignedInts)
+{
+  __m256i v[4], t0, t1, t2, t3, shuf, perm;
+  CTMuint i, j;
+
+  // Group the bytes of each 128-bit lane by significance (MSB first), then
+  // gather the groups of the two lanes into 64-bit units (one per plane)
+  shuf = _mm256_setr_epi8(3, 7, 11, 15, 2, 6, 10, 14, 1, 5, 9, 13, 0, 4, 8, 12,
+                          3, 7, 11, 15, 2, 6, 10, 14, 1, 5, 9, 13, 0, 4, 8, 12);
+  perm = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  for(i = 0; i + 32 <= aCount; i += 32)
+  {
+    for(j = 0; j < 4; ++ j)
+    {
+      v[j] = _ctmLoad8_AVX2(&aSrc[(size_t) (i + j * 8) * aStride * 4], aStride);
+      // Convert two's complement to signed magnitude?
+      if(aSignedInts)
+        v[j] = _mm256_xor_si256(_mm256_slli_epi32(v[j], 1), _mm256_srai_epi32(v[j], 31));
+      v[j] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v[j], shuf), perm);
+    }
+
+    // Collect the 64-bit units of each plane from the four vectors
+    t0 = _mm256_unpacklo_epi64(v[0], v[1]);
+    t1 = _mm256_unpackhi_epi64(v[0], v[1]);
+    t2 = _mm256_unpacklo_epi64(v[2], v[3]);
+    t3 = _mm256_unpackhi_epi64(v[2], v[3]);
+    _mm256_storeu_si256((__m256i *) &aPlanes[i],
+                        _mm256_permute2x128_si256(t0, t2, 0x20));
+    _mm256_storeu_si256((__m256i *) &aPlanes[aPlaneSize + i],
+                        _mm256_permute2x128_si256(t1, t3, 0x20));
+    _mm256_storeu_si256((__m256i *) &aPlanes[2 * aPlaneSize + i],
+                        _mm256_permute2x128_si256(t0, t2, 0x31));
+    _mm256_storeu_si256((__m256i *) &aPlanes[3 * aPlaneSize + i],
+                        _mm256_permute2x128_si256(t1, t3, 0x31));
+  }
+
+  // Remaining elements
+  _ctmInterleaveC(aPlanes, aSrc, i, aCount, aStride, aPlaneSize, aSignedInts);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDeinterleave_AVX2() - AVX2 version of the deinterleave operation (32
+// elements per iteration).
+//-----------------------------------------------------------------------------
+_CTM_AVX2_TARGET
+static void _ctmDeinterleave_AVX2(unsigned char * aDst, const unsigned char * aPlanes,
+  CTMuint aCount, CTMuint aStride, size_t aPlaneSize, CTMint aSignedInts)
+{
+  __m256i p0, p1, p2, p3, t0, t1, t2, t3, v[4], shuf, perm, one;
+  CTMuint i, j;
+
+  // Inverse of the shuffle/permutation in _ctmInterleave_AVX2()
+  shuf = _mm256_setr_epi8(12, 8, 4, 0, 13, 9, 5, 1, 14, 10, 6, 2, 15, 11, 7, 3,
+                          12, 8, 4, 0, 13, 9, 5, 1, 14, 10, 6, 2, 15, 11, 7, 3);
+  perm = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  one = _mm256_set1_epi32(1);
+  for(i = 0; i + 32 <= aCount; i += 32)
+  {
+    p0 = _mm256_loadu_si256((const __m256i *) &aPlanes[i]);
+    p1 = _mm256_loadu_si256((const __m256i *) &aPlanes[aPlaneSize + i]);
+    p2 = _mm256_loadu_si256((const __m256i *) &aPlanes[2 * aPlaneSize + i]);
+    p3 = _mm256_loadu_si256((const __m256i *) &aPlanes[3 * aPlaneSize + i]);
+
+    // Distribute the 64-bit units of each plane to the four vectors
+    t0 = _mm256_permute2x128_si256(p0, p2, 0x20);
+    t1 = _mm256_permute2x128_si256(p1, p3, 0x20);
+    t2 = _mm256_permute2x128_si256(p0, p2, 0x31);
+    t3 = _mm256_permute2x128_si256(p1, p3, 0x31);
+    v[0] = _mm256_unpacklo_epi64(t0, t1);
+    v[1] = _mm256_unpackhi_epi64(t0, t1);
+    v[2] = _mm256_unpacklo_epi64(t2, t3);
+    v[3] = _mm256_unpackhi_epi64(t2, t3);
+
+    for(j = 0; j < 4; ++ j)
+    {
+      v[j] = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v[j], perm), shuf);
+      // Convert signed magnitude to two's complement?
+      if(aSignedInts)
+        v[j] = _mm256_xor_si256(_mm256_srli_epi32(v[j], 1),
+          _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(v[j], one)));
+      _ctmStore8_AVX2(&aDst[(size_t) (i + j * 8) * aStride * 4], aStride, v[j]);
+    }
+  }
+
+  // Remaining elements
+  _ctmDeinterleaveC(aDst, aPlanes, i, aCount, aStride, aPlaneSize, aSignedInts);
+}
+
+#endif // _CTM_USE_AVX2
+
+#if defined(_CTM_USE_NEON)
+
+//-----------------------------------------------------------------------------
+// _ctmLoad4_NEON() - Load four (possibly strided) words.
+//-----------------------------------------------------------------------------
+static uint32x4_t _ctmLoad4_NEON(const unsigned char * aSrc, CTMuint aStride)
+{
+  uint32_t w[4];
+  if(aStride == 1)
+    return vreinterpretq_u32_u8(vld1q_u8(aSrc));
+  memcpy(&w[0], aSrc, 4);
+  memcpy(&w[1], aSrc + aStride * 4, 4);
+  memcpy(&w[2], aSrc + aStride * 8, 4);
+  memcpy(&w[3], aSrc + aStride * 12, 4);
+  return vld1q_u32(w);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStore4_NEON() - Store four (possibly strided) words.
+//-----------------------------------------------------------------------------
+static void _ctmStore4_NEON(unsigned char * aDst, CTMuint aStride, uint32x4_t aValue)
+{
+  uint32_t w[4];
+  if(aStride == 1)
+  {
+    vst1q_u8(aDst, vreinterpretq_u8_u32(aValue));
+    return;
+  }
+  vst1q_u32(w, aValue);
+  memcpy(aDst, &w[0], 4);
+  memcpy(aDst + aStride * 4, &w[1], 4);
+  memcpy(aDst + aStride * 8, &w[2], 4);
+  memcpy(aDst + aStride * 12, &w[3], 4);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmInterleave_NEON() - NEON version of the interleave operation (16
+// elements per iteration).
+//-----------------------------------------------------------------------------
+static void _ctmInterleave_NEON(unsigned char * aPlanes, const unsigned char * aSrc,
+  CTMuint aCount, CTMuint aStride, size_t aPlaneSize, CTMint aSignedInts)
+{
+  uint32x4_t v[4];
+  uint8x16x2_t ab, cd, even, odd;
+  CTMuint i, j;
+
+  for(i = 0; i + 16 <= aCount; i += 16)
+  {
+    for(j = 0; j < 4; ++ j)
+    {
+      v[j] = _ctmLoad4_NEON(&aSrc[(size_t) (i + j * 4) * aStride * 4], aStride);
+      // Convert two's complement to signed magnitude?
+      if(aSignedInts)
+        v[j] = veorq_u32(vshlq_n_u32(v[j], 1),
+          vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(v[j]), 31)));
+    }
+
+    // Two rounds of unzipping separate the bytes by significance (the words
+    // are little endian: byte 0 is the least significant byte)
+    ab = vuzpq_u8(vreinterpretq_u8_u32(v[0]), vreinterpretq_u8_u32(v[1]));
+    cd = vuzpq_u8(vreinterpretq_u8_u32(v[2]), vreinterpretq_u8_u32(v[3]));
+    even = vuzpq_u8(ab.val[0], cd.val[0]);
+    odd = vuzpq_u8(ab.val[1], cd.val[1]);
+    vst1q_u8(&aPlanes[i], odd.val[1]);
+    vst1q_u8(&aPlanes[aPlaneSize + i], even.val[1]);
+    vst1q_u8(&aPlanes[2 * aPlaneSize + i], odd.val[0]);
+    vst1q_u8(&aPlanes[3 * aPlaneSize + i], even.val[0]);
+  }
+
+  // Remaining elements
+  _ctmInterleaveC(aPlanes, aSrc, i, aCount, aStride, aPlaneSize, aSignedInts);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDeinterleave_NEON() - NEON version of the deinterleave operation (16
+// elements per iteration).
+//-----------------------------------------------------------------------------
+static void _ctmDeinterleave_NEON(unsigned char * aDst, const unsigned char * aPlanes,
+  CTMuint aCount, CTMuint aStride, size_t aPlaneSize, CTMint aSignedInts)
+{
+  uint8x16_t p0, p1, p2, p3;
+  uint8x16x2_t even, odd, ab, cd;
+  uint32x4_t v[4], one;
+  CTMuint i, j;
+
+  one = vdupq_n_u32(1);
+  for(i = 0; i + 16 <= aCount; i += 16)
+  {
+    p0 = vld1q_u8(&aPlanes[i]);
+    p1 = vld1q_u8(&aPlanes[aPlaneSize + i]);
+    p2 = vld1q_u8(&aPlanes[2 * aPlaneSize + i]);
+    p3 = vld1q_u8(&aPlanes[3 * aPlaneSize + i]);
+
+    // Inverse of the unzipping in _ctmInterleave_NEON()
+    even = vzipq_u8(p3, p1);
+    odd = vzipq_u8(p2, p0);
+    ab = vzipq_u8(even.val[0], odd.val[0]);
+    cd = vzipq_u8(even.val[1], odd.val[1]);
+    v[0] = vreinterpretq_u32_u8(ab.val[0]);
+    v[1] = vreinterpretq_u32_u8(ab.val[1]);
+    v[2] = vreinterpretq_u32_u8(cd.val[0]);
+    v[3] = vreinterpretq_u32_u8(cd.val[1]);
+
+    for(j = 0; j < 4; ++ j)
+    {
+      // Convert signed magnitude to two's complement?
+      if(aSignedInts)
+        v[j] = veorq_u32(vshrq_n_u32(v[j], 1),
+          vreinterpretq_u32_s32(vnegq_s32(vreinterpretq_s32_u32(vandq_u32(v[j], one)))));
+      _ctmStore4_NEON(&aDst[(size_t) (i + j * 4) * aStride * 4], aStride, v[j]);
+    }
+  }
+
+  // Remaining elements
+  _ctmDeinterleaveC(aDst, aPlanes, i, aCount, aStride, aPlaneSize, aSignedInts);
+}
+
+#endif // _CTM_USE_NEON
+
+//-----------------------------------------------------------------------------
+// _ctmInterleaveWords() - Split an array of aCount elements (aSize 32-bit
+// words each, aStride words apart) into four byte planes (see above). aDst
+// must have room for aCount * aSize * 4 bytes.
+//-----------------------------------------------------------------------------
+void _ctmInterleaveWords(unsigned char * aDst, const void * aSrc,
+  CTMuint aCount, CTMuint aSize, CTMuint aStride, CTMint aSignedInts)
+{
+  const unsigned char * src = (const unsigned char *) aSrc;
+  size_t planeSize = (size_t) aCount * aSize;
+  CTMuint k;
+#if defined(_CTM_USE_AVX2)
+  int hasAVX2 = _ctmHasAVX2();
+#endif
+
+  for(k = 0; k < aSize; ++ k)
+  {
+#if defined(_CTM_USE_AVX2)
+    if(hasAVX2)
+    {
+      _ctmInterleave_AVX2(&aDst[(size_t) k * aCount], &src[k * 4], aCount,
+                          aStride, planeSize, aSignedInts);
+      continue;
+    }
+#endif
+#if defined(_CTM_USE_SSE2)
+    _ctmInterleave_SSE2(&aDst[(size_t) k * aCount], &src[k * 4], aCount,
+                        aStride, planeSize, aSignedInts);
+#elif defined(_CTM_USE_NEON)
+    _ctmInterleave_NEON(&aDst[(size_t) k * aCount], &src[k * 4], aCount,
+                        aStride, planeSize, aSignedInts);
+#else
+    _ctmInterleaveC(&aDst[(size_t) k * aCount], &src[k * 4], 0, aCount,
+                    aStride, planeSize, aSignedInts);
+#endif
+  }
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDeinterleaveWords() - Join four byte planes (see above) into an array
+// of aCount elements (aSize 32-bit words each, aStride words apart).
+//-----------------------------------------------------------------------------
+void _ctmDeinterleaveWords(void * aDst, const unsigned char * aSrc,
+  CTMuint aCount, CTMuint aSize, CTMuint aStride, CTMint aSignedInts)
+{
+  unsigned char * dst = (unsigned char *) aDst;
+  size_t planeSize = (size_t) aCount * aSize;
+  CTMuint k;
+#if defined(_CTM_USE_AVX2)
+  int hasAVX2 = _ctmHasAVX2();
+#endif
+
+  for(k = 0; k < aSize; ++ k)
+  {
+#if defined(_CTM_USE_AVX2)
+    if(hasAVX2)
+    {
+      _ctmDeinterleave_AVX2(&dst[k * 4], &aSrc[(size_t) k * aCount], aCount,
+                            aStride, planeSize, aSignedInts);
+      continue;
+    }
+#endif
+#if defined(_CTM_USE_SSE2)
+    _ctmDeinterleave_SSE2(&dst[k * 4], &aSrc[(size_t) k * aCount], aCount,
+                          aStride, planeSize, aSignedInts);
+#elif defined(_CTM_USE_NEON)
+    _ctmDeinterleave_NEON(&dst[k * 4], &aSrc[(size_t) k * aCount], aCount,
+                          aStride, planeSize, aSignedInts);
+#else
+    _ctmDeinterleaveC(&dst[k * 4], &aSrc[(size_t) k * aCount], 0, aCount,
+                      aStride, planeSize, aSignedInts);
+#endif
+  }
+}
@@ -37,6 +37,20 @@
 // Flags for the Mesh flags field of the file header
 #define _CTM_HAS_NORMALS_BIT 0x00000001
 
+// Flags for the coding flags field of the extended MG2 header ("MG2X")
+#define _CTM_MG2_CONNECTIVITY_BIT 0x00000001
+#define _CTM_MG2_PARALLELOGRAM_BIT 0x00000002
+#define _CTM_MG2_OCTAHEDRAL_BIT 0x00000004
+
+// Octree depth of the finest clustering grid of progressive files (bits per
+// axis), and the maximum number of levels in a file (coarse levels + the full
+// mesh)
+#define _CTM_LEVEL_MAX_DEPTH 16
+#define _CTM_LEVEL_MAX_COUNT (_CTM_LEVEL_MAX_DEPTH + 1)
+
+// Default size of the stream buffer (see ctmStreamBuffer())
+#define _CTM_STREAM_BUFFER_SIZE 65536
+
 //-----------------------------------------------------------------------------
 // _CTMfloatmap - Internal representation of a floating point based vertex map
 // (used for UV maps and attribute maps).
@@ -47,9 +61,160 @@ struct _CTMfloatmap_struct {
   char * mFileName;     // File name reference (used only for UV maps)
   CTMfloat mPrecision;  // Precision for this map
   CTMfloat * mValues;   // Attribute/UV coordinate values (per vertex)
+  CTMuint mStride;      // Distance between two vertices in mValues (floats)
   _CTMfloatmap * mNext; // Pointer to the next map in the list (linked list)
 };
 
+//-----------------------------------------------------------------------------
+// _CTMdest - A caller provided destination buffer for a mesh array (see
+// ctmLoadInto() and ctmVertexLayoutArray()).
+//-----------------------------------------------------------------------------
+typedef struct {
+  void * mBuffer;       // Destination buffer (NULL = allocate internally)
+  CTMuint mCapacity;    // Number of elements that fit in the buffer
+  CTMuint mStride;      // Distance between two elements (32-bit words)
+  CTMenum mFormat;      // Element component format (CTM_FORMAT_FLOAT32, ...)
+} _CTMdest;
+
+// Destination buffer slots (indices into _CTMcontext::mDest). The slots are
+// also used as section ids for the per section LZMA encoder parameters.
+#define _CTM_DEST_INDICES     0
+#define _CTM_DEST_VERTICES    1
+#define _CTM_DEST_NORMALS     2
+#define _CTM_DEST_UV_MAPS     3
+#define _CTM_DEST_ATTRIB_MAPS (_CTM_DEST_UV_MAPS + 8)
+#define _CTM_DEST_COUNT       (_CTM_DEST_ATTRIB_MAPS + 8)
+
+// Slot of map number aIdx in a UV/attribute map list starting at slot aBase
+// (maps beyond the eighth share the slot of the eighth map)
+#define _CTM_MAP_SLOT(aBase, aIdx) ((aBase) + ((aIdx) < 8 ? (aIdx) : 7))
+
+//-----------------------------------------------------------------------------
+// _CTMlzmaparams - LZMA encoder parameters for one section (-1 = use the
+// default value for the selected compression level).
+//-----------------------------------------------------------------------------
+typedef struct {
+  CTMint mDictSize;     // Dictionary size (bytes)
+  CTMint mLitContext;   // Number of literal context bits (lc)
+  CTMint mLitPos;       // Number of literal position bits (lp)
+  CTMint mPosBits;      // Number of position bits (pb)
+  CTMint mFastBytes;    // Number of fast bytes (fb)
+  CTMint mMatchFinder;  // Match finder (0 = hash chain, 1 = binary tree)
+} _CTMlzmaparams;
+
+//-----------------------------------------------------------------------------
+// _CTMtile - One entry of the tile index of a tiled file (see ctmTileGrid()).
+//-----------------------------------------------------------------------------
+typedef struct {
+  CTMuint mVertexCount;
+  CTMuint mTriangleCount;
+  CTMfloat mMin[3];     // Bounding box of the tile vertices
+  CTMfloat mMax[3];
+  CTMuint mSize;        // Size of the tile data (bytes)
+} _CTMtile;
+
+//-----------------------------------------------------------------------------
+// _CTMgrid - 3D space subdivision grid.
+//-----------------------------------------------------------------------------
+typedef struct {
+  // Axis-aligned boudning box for the grid.
+  CTMfloat mMin[3];
+  CTMfloat mMax[3];
+
+  // How many divisions per axis (minimum 1).
+  CTMuint mDivision[3];
+
+  // Size of each grid box.
+  CTMfloat mSize[3];
+} _CTMgrid;
+
+//-----------------------------------------------------------------------------
+// _CTMallocator - Memory allocation functions of a context (see
+// ctmSetAllocator()). NULL functions mean malloc() and free().
+//-----------------------------------------------------------------------------
+typedef struct {
+  CTMallocfn mAllocFn;
+  CTMfreefn mFreeFn;
+  void * mUserData;
+} _CTMallocator;
+
+//-----------------------------------------------------------------------------
+// _CTMfilemap - A read-only memory mapped file.
+//-----------------------------------------------------------------------------
+typedef struct {
+  const unsigned char * mData;
+  size_t mSize;
+  void * mHandle;
+  _CTMallocator * mAllocator; // Allocator of mData (if the file is read)
+} _CTMfilemap;
+
+//-----------------------------------------------------------------------------
+// _CTMsection - One entry of the section directory of a probed file (see
+// ctmProbe()).
+//-----------------------------------------------------------------------------
+typedef struct {
+  CTMuint mID;          // Section id (four character code, e.g. "VERT")
+  size_t mOffset;       // Offset of the section in the file (bytes)
+  size_t mSize;         // Stored size of the section (bytes)
+  size_t mUnpackedSize; // Size of the data array of the section (bytes)
+} _CTMsection;
+
+//-----------------------------------------------------------------------------
+// _CTMstreambuf - Read-ahead (import) or write-behind (export) buffer between
+// the stream functions and the read() or write() function of the caller (see
+// ctmStreamBuffer()).
+//-----------------------------------------------------------------------------
+typedef struct {
+  unsigned char * mData;  // Buffer memory (NULL = the stream is not buffered)
+  CTMuint mSize;          // Size of the buffer memory
+  CTMuint mPos;           // Read position (import)
+  CTMuint mFill;          // Number of bytes in the buffer
+} _CTMstreambuf;
+
+//-----------------------------------------------------------------------------
+// _CTMmembuf - A growing memory buffer that a sub mesh is saved to (see
+// _ctmMemBufWrite()).
+//-----------------------------------------------------------------------------
+typedef struct {
+  unsigned char * mData;
+  size_t mSize;
+  size_t mCapacity;
+  _CTMallocator * mAllocator;
+} _CTMmembuf;
+
+//-----------------------------------------------------------------------------
+// _CTMchunks - The chunks of a mesh that is saved in parts (see
+// ctmAddChunk()). Each chunk is kept in memory as a saved sub mesh until the
+// file is written as a tiled file (one tile per chunk).
+//-----------------------------------------------------------------------------
+typedef struct {
+  _CTMtile * mTiles;        // Tile index entries of the chunks
+  _CTMmembuf * mBufs;       // Saved chunks
+  CTMuint mCount;
+  CTMuint mCapacity;
+  CTMuint mVertexCount;     // Total counts of the chunks
+  CTMuint mTriangleCount;
+  CTMuint mUVMapCount;      // Map counts and mesh flags (the same for all
+  CTMuint mAttribMapCount;  // chunks)
+  CTMuint mFlags;
+} _CTMchunks;
+
+//-----------------------------------------------------------------------------
+// _CTMscratch - Memory for the temporary arrays of ctmSave()/ctmLoad() (see
+// ctmScratchMemory()). Blocks are taken from the reserved memory as from a
+// stack, and from the heap when the reserved memory is used up.
+//-----------------------------------------------------------------------------
+typedef struct {
+  unsigned char * mBase;  // Reserved memory (NULL = none)
+  size_t mSize;           // Size of the reserved memory
+  size_t mUsed;           // Used part of the reserved memory (top of stack)
+  size_t mTop;            // Offset of the top block in the reserved memory
+  size_t mHeapUsed;       // Size of the live blocks on the heap
+  size_t mPeak;           // Largest total size of the live blocks so far
+  void * mLock;           // Lock for concurrent use (see _ctmNewLock())
+  _CTMallocator * mAllocator; // Allocator for the reserved and heap memory
+} _CTMscratch;
+
 //-----------------------------------------------------------------------------
 // _CTMcontext - Internal CTM context structure.
 //-----------------------------------------------------------------------------
@@ -60,13 +225,17 @@ typedef struct {
   // Vertices
   CTMfloat * mVertices;
   CTMuint mVertexCount;
+  CTMuint mVertexStride;  // Distance between two vertices (floats)
 
   // Indices
   CTMuint * mIndices;
   CTMuint mTriangleCount;
+  CTMuint mIndexStride;   // Distance between two triangles (integers)
 
   // Normals (optional)
   CTMfloat * mNormals;
+  CTMuint mNormalStride;  // Distance between two normals (32-bit words)
+  CTMenum mNormalFormat;  // Normal component format (CTM_FORMAT_FLOAT32, ...)
 
   // Multiple sets of UV coordinate maps (optional)
   CTMuint mUVMapCount;
@@ -85,12 +254,24 @@ typedef struct {
   // The selected compression level
   CTMuint mCompressionLevel;
 
+  // LZMA encoder parameters, per section (one per _CTM_DEST_* slot)
+  _CTMlzmaparams mLZMAParams[_CTM_DEST_COUNT];
+
+  // Triangle index, vertex and normal codings for MG2/MG3 (see
+  // ctmCompressionCoding())
+  CTMenum mIndexCoding;
+  CTMenum mVertexCoding;
+  CTMenum mNormalCoding;
+
   // Vertex coordinate precision
   CTMfloat mVertexPrecision;
 
   // Normal precision (angular + magnitude)
   CTMfloat mNormalPrecision;
 
+  // Number of threads to use for compression/decompression (0 = automatic)
+  CTMuint mThreadCount;
+
   // File comment
   char * mFileComment;
 
@@ -102,29 +283,266 @@ typedef struct {
 
   // User data (for stream read/write - usually the stream handle)
   void * mUserData;
+
+  // Seek() function pointer (optional, see ctmLoadSeekable())
+  CTMseekfn mSeekFn;
+
+  // Position of the stream (bytes from the start of the file), when it is
+  // not a memory stream
+  size_t mStreamPos;
+
+  // Stream buffer (allocated while a file is loaded or saved), the size of
+  // the buffer to use, and CTM_TRUE if the size was set with ctmStreamBuffer()
+  // (loads from a stream that can not seek are only buffered if it was)
+  _CTMstreambuf mStreamBuf;
+  CTMuint mStreamBufSize;
+  CTMint mStreamBufSet;
+
+  // Caller provided destination buffers for the mesh arrays (import)
+  _CTMdest mDest[_CTM_DEST_COUNT];
+
+  // Bit mask of the mesh arrays that live in caller provided buffers (one bit
+  // per _CTM_DEST_* slot) - these must not be freed
+  CTMuint mCallerArrays;
+
+  // Interleaved vertex buffer (see ctmVertexLayout())
+  unsigned char * mLayoutBuffer;
+  CTMuint mLayoutCapacity;
+  CTMuint mLayoutStride;
+
+  // Memory stream (when loading from memory, this is used instead of mReadFn)
+  const unsigned char * mMemory;
+  size_t mMemorySize;
+  size_t mMemoryPos;
+
+  // Tile grid used when saving (see ctmTileGrid())
+  CTMuint mTileGrid[3];
+
+  // Which tile(s) to load (see ctmSelectTile())
+  CTMuint mTileSelect;
+
+  // Tile index of the last loaded tiled file
+  _CTMtile * mTiles;
+  CTMuint mTileCount;
+
+  // Chunks of the mesh that is being saved in parts (see ctmAddChunk())
+  _CTMchunks mChunks;
+
+  // Number of coarse levels to save before the full mesh (see
+  // ctmProgressiveLevels())
+  CTMuint mProgressiveLevels;
+
+  // Number of levels of the last loaded progressive file
+  CTMuint mLevelCount;
+
+  // Level callback used when loading progressive files (see ctmLevelCallback())
+  CTMlevelfn mLevelFn;
+  void * mLevelUserData;
+
+  // CTM_TRUE while a sub mesh (a tile of a tiled file, or a level of a
+  // progressive file) is loaded - sub meshes can not be tiled or progressive
+  // themselves
+  CTMint mInSubMesh;
+
+  // The vertex, triangle, UV map and attribute map counts that the sub mesh
+  // must have (they are checked before any memory is allocated for it)
+  CTMuint mSubMeshCounts[4];
+
+  // Which of the optional sections to load (CTM_LOAD_* bits, see
+  // ctmLoadSections())
+  CTMuint mLoadSections;
+
+  // The optional sections of the loaded mesh that were skipped: the normals
+  // (CTM_TRUE if the file has normals), and the number of UV maps and
+  // attribute maps (they are not included in the map counts)
+  CTMint mSkipNormals;
+  CTMuint mSkipUVMaps;
+  CTMuint mSkipAttribMaps;
+
+  // CTM_TRUE if the context holds the header information of a probed file
+  // (see ctmProbe()), and the mesh flags of that file
+  CTMint mProbed;
+  CTMuint mProbeFlags;
+
+  // The probed file (mapped until the section directory has been read), and
+  // its section directory (NULL until it is asked for). When saving, this is
+  // the section directory of the file that is being written.
+  _CTMfilemap mProbeMap;
+  _CTMsection * mSections;
+  CTMuint mSectionCount;
+  CTMuint mSectionCapacity;
+
+  // CTM_TRUE if a section directory is written at the end of saved files (see
+  // ctmSectionDirectory())
+  CTMint mSaveSections;
+
+  // Memory allocation functions (see ctmSetAllocator())
+  _CTMallocator mAllocator;
+
+  // Scratch memory for temporary arrays (mScratch points to mScratchPool, or
+  // to the scratch memory of the parent context for sub meshes)
+  _CTMscratch mScratchPool;
+  _CTMscratch * mScratch;
 } _CTMcontext;
 
+// Packed data coders (see _CTMpackjob)
+#define _CTM_CODER_LZMA 0     // LZMA (MG1 and MG2)
+#define _CTM_CODER_LZ   1     // Fast LZ block coder (MG3)
+
+//-----------------------------------------------------------------------------
+// _CTMpackjob - A packed (LZMA compressed) data array. This holds everything
+// that is needed for packing/unpacking one array, so that several arrays can
+// be processed concurrently (on save as well as on load).
+//-----------------------------------------------------------------------------
+typedef struct {
+  // Unpacked data (aCount elements of aSize 32-bit words each)
+  void * mData;
+  CTMuint mCount;
+  CTMuint mSize;
+  CTMuint mStride;      // Distance between two elements in mData (words)
+  CTMint mSignedInts;
+
+  // Packed data coder (_CTM_CODER_LZMA or _CTM_CODER_LZ)
+  CTMuint mCoder;
+
+  // Compression level (0-9) and LZMA encoder parameters
+  CTMuint mLevel;
+  _CTMlzmaparams mParams;
+
+  // Number of LZMA encoder threads (2 = separate match finder thread, which
+  // requires a library that is built with COMPRESS_MF_MT)
+  CTMuint mLzmaThreads;
+
+  // Packed data and LZMA compression props (only used by the LZMA coder)
+  unsigned char * mPacked;
+  size_t mPackedSize;
+  unsigned char mProps[5];
+
+  // CTM_TRUE if mPacked points into a memory stream (not owned by the job)
+  CTMint mPackedIsRef;
+
+  // Scratch memory for mPacked and temporary arrays
+  _CTMscratch * mScratch;
+
+  // Error code (CTM_NONE if everything went well)
+  CTMenum mError;
+} _CTMpackjob;
+
+//-----------------------------------------------------------------------------
+// _CTMtaskfn - Work item function (see _ctmRunTasks()).
+//-----------------------------------------------------------------------------
+typedef void (*_CTMtaskfn)(void * aItem);
+
 //-----------------------------------------------------------------------------
 // Macros
 //-----------------------------------------------------------------------------
 #define FOURCC(str) (((CTMuint) str[0]) | (((CTMuint) str[1]) << 8) | \
                     (((CTMuint) str[2]) << 16) | (((CTMuint) str[3]) << 24))
 
+//-----------------------------------------------------------------------------
+// Funcion prototypes for openctm.c
+//-----------------------------------------------------------------------------
+int _ctmAllocateMesh(_CTMcontext * self, CTMuint aFlags);
+int _ctmReadHeader(_CTMcontext * self, CTMuint * aMethod, CTMuint * aFlags);
+int _ctmSaveMesh(_CTMcontext * self);
+
 //-----------------------------------------------------------------------------
 // Funcion prototypes for stream.c
 //-----------------------------------------------------------------------------
+int _ctmStreamBegin(_CTMcontext * self);
+int _ctmStreamEnd(_CTMcontext * self);
+CTMuint _ctmStreamBufRead(_CTMstreambuf * aBuf, CTMreadfn aReadFn, void * aUserData, void * aData, CTMuint aCount);
+int _ctmStreamBufSeek(_CTMstreambuf * aBuf, CTMseekfn aSeekFn, void * aUserData, size_t aPos, size_t aOffset);
 CTMuint _ctmStreamRead(_CTMcontext * self, void * aBuf, CTMuint aCount);
+int _ctmStreamSkip(_CTMcontext * self, CTMuint aCount);
 CTMuint _ctmStreamWrite(_CTMcontext * self, void * aBuf, CTMuint aCount);
 CTMuint _ctmStreamReadUINT(_CTMcontext * self);
 void _ctmStreamWriteUINT(_CTMcontext * self, CTMuint aValue);
+void _ctmStreamWriteSection(_CTMcontext * self, const char * aID, size_t aUnpackedSize);
 CTMfloat _ctmStreamReadFLOAT(_CTMcontext * self);
 void _ctmStreamWriteFLOAT(_CTMcontext * self, CTMfloat aValue);
+int _ctmStreamReadArray(_CTMcontext * self, void * aData, CTMuint aCount, CTMuint aSize, CTMuint aStride);
+int _ctmStreamSkipArray(_CTMcontext * self, CTMuint aCount, CTMuint aSize);
+int _ctmStreamWriteArray(_CTMcontext * self, const void * aData, CTMuint aCount, CTMuint aSize, CTMuint aStride);
 void _ctmStreamReadSTRING(_CTMcontext * self, char ** aValue);
 void _ctmStreamWriteSTRING(_CTMcontext * self, const char * aValue);
+int _ctmStreamSkipSTRING(_CTMcontext * self);
 int _ctmStreamReadPackedInts(_CTMcontext * self, CTMint * aData, CTMuint aCount, CTMuint aSize, CTMint aSignedInts);
-int _ctmStreamWritePackedInts(_CTMcontext * self, CTMint * aData, CTMuint aCount, CTMuint aSize, CTMint aSignedInts);
+int _ctmStreamWritePackedInts(_CTMcontext * self, CTMint * aData, CTMuint aCount, CTMuint aSize, CTMint aSignedInts, CTMuint aSection);
 int _ctmStreamReadPackedFloats(_CTMcontext * self, CTMfloat * aData, CTMuint aCount, CTMuint aSize);
-int _ctmStreamWritePackedFloats(_CTMcontext * self, CTMfloat * aData, CTMuint aCount, CTMuint aSize);
+int _ctmStreamWritePackedFloats(_CTMcontext * self, CTMfloat * aData, CTMuint aCount, CTMuint aSize, CTMuint aSection);
+void _ctmInitPackJob(_CTMcontext * self, _CTMpackjob * aJob, void * aData, CTMuint aCount, CTMuint aSize, CTMint aSignedInts, CTMuint aSection);
+int _ctmPackData(_CTMpackjob * aJob);
+void _ctmPackJobs(_CTMcontext * self, _CTMpackjob * aJobs, CTMuint aCount);
+int _ctmStreamWritePackJob(_CTMcontext * self, _CTMpackjob * aJob);
+int _ctmStreamReadPackJob(_CTMcontext * self, _CTMpackjob * aJob);
+int _ctmStreamSkipPacked(_CTMcontext * self);
+int _ctmUnpackData(_CTMpackjob * aJob);
+int _ctmUnpackJobs(_CTMcontext * self, _CTMpackjob * aJobs, CTMuint aCount);
+void _ctmFreePackJob(_CTMpackjob * aJob);
+void _ctmFreePackJobs(_CTMcontext * self, _CTMpackjob * aJobs, CTMuint aCount);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for interleave.c
+//-----------------------------------------------------------------------------
+void _ctmInterleaveWords(unsigned char * aDst, const void * aSrc, CTMuint aCount, CTMuint aSize, CTMuint aStride, CTMint aSignedInts);
+void _ctmDeinterleaveWords(void * aDst, const unsigned char * aSrc, CTMuint aCount, CTMuint aSize, CTMuint aStride, CTMint aSignedInts);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for lzblock.c
+//-----------------------------------------------------------------------------
+size_t _ctmLZBlockBound(size_t aSize);
+size_t _ctmLZBlockCompress(_CTMscratch * aScratch, unsigned char * aDst, const unsigned char * aSrc, size_t aSrcSize, CTMuint aLevel);
+int _ctmLZBlockUncompress(unsigned char * aDst, size_t aDstSize, const unsigned char * aSrc, size_t aSrcSize);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for sort.c
+//-----------------------------------------------------------------------------
+int _ctmRadixSort(_CTMscratch * aScratch, void * aRecords, CTMuint aCount, CTMuint aSize, CTMuint aKey1, CTMuint aKey2, CTMint aFloatKey2);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for bounds.c
+//-----------------------------------------------------------------------------
+void _ctmBoundingBox(_CTMcontext * self, const CTMfloat * aVertices, CTMuint aCount, CTMfloat * aMin, CTMfloat * aMax);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for format.c
+//-----------------------------------------------------------------------------
+void _ctmWriteNormal(_CTMcontext * self, CTMuint aIndex, const CTMfloat * aNormal);
+void _ctmWriteNormals(_CTMcontext * self, const CTMfloat * aNormals);
+CTMint _ctmIsFiniteHalf(const void * aValue);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for filemap.c
+//-----------------------------------------------------------------------------
+int _ctmMapFile(const char * aFileName, _CTMfilemap * aMap, _CTMallocator * aAllocator);
+void _ctmUnmapFile(_CTMfilemap * aMap);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for thread.c
+//-----------------------------------------------------------------------------
+CTMuint _ctmProcessorCount(void);
+CTMuint _ctmSplitCount(_CTMcontext * self, CTMuint aCount, CTMuint aMinSize);
+void _ctmRunTasks(_CTMcontext * self, _CTMtaskfn aFunc, void * aItems, CTMuint aCount, size_t aItemSize);
+void * _ctmNewLock(void);
+void _ctmFreeLock(void * aLock);
+void _ctmLock(void * aLock);
+void _ctmUnlock(void * aLock);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for scratch.c
+//-----------------------------------------------------------------------------
+void * _ctmAlloc(_CTMallocator * aAllocator, size_t aSize);
+void * _ctmCalloc(_CTMallocator * aAllocator, size_t aSize);
+void * _ctmRealloc(_CTMallocator * aAllocator, void * aPtr, size_t aOldSize, size_t aSize);
+void _ctmFree(_CTMallocator * aAllocator, void * aPtr);
+int _ctmInitScratch(_CTMscratch * aScratch, _CTMallocator * aAllocator);
+void _ctmFreeScratch(_CTMscratch * aScratch);
+int _ctmReserveScratch(_CTMscratch * aScratch, size_t aSize);
+void * _ctmScratchAlloc(_CTMscratch * aScratch, size_t aSize);
+void * _ctmScratchCalloc(_CTMscratch * aScratch, size_t aSize);
+void * _ctmScratchRealloc(_CTMscratch * aScratch, void * aPtr, size_t aSize);
+void _ctmScratchFree(_CTMscratch * aScratch, void * aPtr);
 
 //-----------------------------------------------------------------------------
 // Funcion prototypes for compressRAW.c
@@ -143,5 +561,50 @@ int _ctmUncompressMesh_MG1(_CTMcontext * self);
 //-----------------------------------------------------------------------------
 int _ctmCompressMesh_MG2(_CTMcontext * self);
 int _ctmUncompressMesh_MG2(_CTMcontext * self);
+int _ctmReadHeader_MG2(_CTMcontext * self, _CTMgrid * aGrid, CTMuint * aFlags);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for connectivity.c
+//-----------------------------------------------------------------------------
+int _ctmEncodeConnectivity(_CTMcontext * self, CTMuint * aIndices, CTMuint aVertexCount, CTMuint aTriangleCount, CTMuint * aVertexMap, CTMuint * aOpposite, CTMuint ** aCodes, CTMuint * aCodeCount);
+CTMenum _ctmDecodeConnectivity(_CTMscratch * aScratch, const CTMuint * aCodes, CTMuint aCodeCount, CTMuint aVertexCount, CTMuint aTriangleCount, CTMuint * aIndices, CTMuint aStride, CTMuint * aOpposite);
+void _ctmMakeParallelogramDeltas(const CTMint * aIntVertices, CTMint * aDeltas, const CTMuint * aIndices, const CTMuint * aOpposite, CTMuint aVertexCount, CTMuint aTriangleCount);
+void _ctmRestoreParallelogramDeltas(CTMint * aIntVertices, const CTMuint * aIndices, CTMuint aStride, const CTMuint * aOpposite, CTMuint aVertexCount, CTMuint aTriangleCount);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for tiles.c
+//-----------------------------------------------------------------------------
+int _ctmSaveTiles(_CTMcontext * self);
+int _ctmReadTileIndex(_CTMcontext * self);
+int _ctmLoadTiles(_CTMcontext * self, CTMuint aFlags);
+void _ctmFreeTiles(_CTMcontext * self);
+int _ctmAddChunk(_CTMcontext * self);
+int _ctmSaveChunks(_CTMcontext * self);
+void _ctmFreeChunks(_CTMcontext * self);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for submesh.c
+//-----------------------------------------------------------------------------
+CTMuint CTMCALL _ctmMemBufWrite(const void * aBuf, CTMuint aCount, void * aUserData);
+int _ctmCopyString(_CTMcontext * self, char ** aDst, const char * aSrc);
+int _ctmSaveSubMesh(_CTMcontext * self, const CTMuint * aVertexMap, CTMuint aVertexCount, const CTMfloat * aVertices, const CTMuint * aIndices, CTMuint aTriangleCount, CTMfloat aVertexPrecision, CTMfloat * aMin, CTMfloat * aMax, _CTMmembuf * aBuf);
+int _ctmLoadSubMesh(_CTMcontext * self, _CTMcontext * aTarget, CTMuint aSize, CTMuint aVertexCount, CTMuint aTriangleCount);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for progressive.c
+//-----------------------------------------------------------------------------
+int _ctmSaveLevels(_CTMcontext * self);
+CTMuint _ctmReadLevelIndex(_CTMcontext * self, CTMuint * aIndex);
+int _ctmLoadLevels(_CTMcontext * self);
+
+//-----------------------------------------------------------------------------
+// Funcion prototypes for probe.c
+//-----------------------------------------------------------------------------
+int _ctmProbeFile(_CTMcontext * self);
+int _ctmReadSections(_CTMcontext * self);
+void _ctmAddSection(_CTMcontext * self, CTMuint aID, size_t aOffset, size_t aUnpackedSize);
+int _ctmBeginSections(_CTMcontext * self);
+int _ctmWriteSections(_CTMcontext * self);
+void _ctmFreeProbe(_CTMcontext * self);
 
 #endif // __OPENCTM_INTERNAL_H_
@@ -0,0 +1,256 @@
+/* LzFindMt.c -- Multithreaded match finder for LZ algorithms
+Public domain */
+
+#include "LzFindMt.h"
+
+/*
+The match finder thread calls the normal (single threaded) match finder for
+every position of the stream, and stores the results in blocks that the
+encoder thread picks up. The encoder only skips or copies the ready results,
+so the output is the same as with the single threaded match finder.
+
+The window buffer is shared: the encoder reads the data at its (lagging)
+position, while the match finder may read new data into the buffer and move
+it. The encoder holds "cs" all the time, except when it waits for the next
+block, and the match finder thread enters "cs" around every call that can
+read from the stream or move the buffer.
+*/
+
+void MatchFinderMt_Construct(CMatchFinderMt *p)
+{
+  p->MatchFinder = 0;
+  p->blocks = 0;
+  p->curRec = p->recLimit = 0;
+  p->haveBlock = False;
+  p->csWasInitialized = False;
+  p->csWasEntered = False;
+  Thread_Construct(&p->thread);
+  Semaphore_Construct(&p->freeSemaphore);
+  Semaphore_Construct(&p->filledSemaphore);
+}
+
+/* Fill one block with match finder records. Returns True when the end of the
+   stream has been reached (the last record has zero available bytes). */
+static Bool MtFillBlock(CMatchFinderMt *p, UInt32 *block, UInt32 *size, Bool threaded)
+{
+  CMatchFinder *mf = p->MatchFinder;
+  UInt32 *cur = block;
+  UInt32 *limit = block + kMtBlockSize - p->maxRecordSize;
+  Bool finished = False;
+  while (cur <= limit)
+  {
+    UInt32 numAvail = Inline_MatchFinder_GetNumAvailableBytes(mf);
+    cur[0] = numAvail;
+    if (numAvail == 0)
+    {
+      cur[1] = 0;
+      cur += 2;
+      finished = True;
+      break;
+    }
+    if (!mf->streamEndWasReached && numAvail <= mf->keepSizeAfter + 1)
+    {
+      /* This position may read from the stream and move the buffer */
+      const Byte *before = mf->buffer;
+      if (threaded)
+        CriticalSection_Enter(&p->cs);
+      cur[1] = p->mfVTable.GetMatches(mf, cur + 2);
+      p->pointerToCurPos -= (before + 1) - mf->buffer;
+      if (threaded)
+        CriticalSection_Leave(&p->cs);
+    }
+    else
+      cur[1] = p->mfVTable.GetMatches(mf, cur + 2);
+    cur += 2 + cur[1];
+  }
+  *size = (UInt32)(cur - block);
+  return finished;
+}
+
+static THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE MtThreadFunc(void *pp)
+{
+  CMatchFinderMt *p = (CMatchFinderMt *)pp;
+  for (;;)
+  {
+    UInt32 index = p->produceIndex;
+    Bool stop, finished;
+    Semaphore_Wait(&p->freeSemaphore);
+    CriticalSection_Enter(&p->stopCs);
+    stop = p->stopWriting;
+    CriticalSection_Leave(&p->stopCs);
+    if (stop)
+      break;
+    finished = MtFillBlock(p, p->blocks + index * kMtBlockSize, &p->blockSizes[index], True);
+    p->produceIndex = (index + 1) % kMtNumBlocks;
+    Semaphore_Release1(&p->filledSemaphore);
+    if (finished)
+      break;
+  }
+  return 0;
+}
+
+static void MtGetNextBlock(CMatchFinderMt *p)
+{
+  UInt32 index = p->consumeIndex;
+  if (!Thread_WasCreated(&p->thread))
+  {
+    /* No match finder thread: fill the block here */
+    index = 0;
+    MtFillBlock(p, p->blocks, &p->blockSizes[0], False);
+  }
+  else
+  {
+    if (p->haveBlock)
+      Semaphore_Release1(&p->freeSemaphore);
+    CriticalSection_Leave(&p->cs);
+    Semaphore_Wait(&p->filledSemaphore);
+    CriticalSection_Enter(&p->cs);
+    p->consumeIndex = (index + 1) % kMtNumBlocks;
+  }
+  p->curRec = p->blocks + index * kMtBlockSize;
+  p->recLimit = p->curRec + p->blockSizes[index];
+  p->haveBlock = True;
+}
+
+#define MT_GET_RECORD(p) if ((p)->curRec == (p)->recLimit) MtGetNextBlock(p)
+
+static void MatchFinderMt_Init(CMatchFinderMt *p)
+{
+  CMatchFinder *mf = p->MatchFinder;
+  MatchFinderMt_ReleaseStream(p);
+  MatchFinder_Init(mf);
+  p->pointerToCurPos = Inline_MatchFinder_GetPointerToCurrentPos(mf);
+  p->curRec = p->recLimit = p->blocks;
+  p->produceIndex = p->consumeIndex = 0;
+  p->haveBlock = False;
+  p->stopWriting = False;
+  if (Semaphore_Create(&p->freeSemaphore, kMtNumBlocks, kMtNumBlocks + 1) == 0 &&
+      Semaphore_Create(&p->filledSemaphore, 0, kMtNumBlocks) == 0)
+  {
+    CriticalSection_Enter(&p->cs);
+    p->csWasEntered = True;
+    if (Thread_Create(&p->thread, MtThreadFunc, p) == 0)
+      return;
+    CriticalSection_Leave(&p->cs);
+    p->csWasEntered = False;
+  }
+  /* The thread could not be started, so the blocks are filled on demand */
+  Semaphore_Close(&p->freeSemaphore);
+  Semaphore_Close(&p->filledSemaphore);
+}
+
+void MatchFinderMt_ReleaseStream(CMatchFinderMt *p)
+{
+  if (Thread_WasCreated(&p->thread))
+  {
+    CriticalSection_Enter(&p->stopCs);
+    p->stopWriting = True;
+    CriticalSection_Leave(&p->stopCs);
+    Semaphore_Release1(&p->freeSemaphore);
+    if (p->csWasEntered)
+    {
+      CriticalSection_Leave(&p->cs);
+      p->csWasEntered = False;
+    }
+    Thread_Wait(&p->thread);
+    Thread_Close(&p->thread);
+    Semaphore_Close(&p->freeSemaphore);
+    Semaphore_Close(&p->filledSemaphore);
+  }
+}
+
+void MatchFinderMt_Destruct(CMatchFinderMt *p, ISzAlloc *alloc)
+{
+  MatchFinderMt_ReleaseStream(p);
+  if (p->csWasInitialized)
+  {
+    CriticalSection_Delete(&p->cs);
+    CriticalSection_Delete(&p->stopCs);
+    p->csWasInitialized = False;
+  }
+  alloc->Free(alloc, p->blocks);
+  p->blocks = 0;
+}
+
+SRes MatchFinderMt_Create(CMatchFinderMt *p, UInt32 historySize, UInt32 keepAddBufferBefore,
+    UInt32 matchMaxLen, UInt32 keepAddBufferAfter, ISzAlloc *alloc)
+{
+  CMatchFinder *mf = p->MatchFinder;
+  p->maxRecordSize = 2 + (matchMaxLen + 1) * 2;
+  if (kMtBlockSize <= p->maxRecordSize * 4)
+    return SZ_ERROR_PARAM;
+  if (p->blocks == 0)
+  {
+    p->blocks = (UInt32 *)alloc->Alloc(alloc, (size_t)kMtNumBlocks * kMtBlockSize * sizeof(UInt32));
+    if (p->blocks == 0)
+      return SZ_ERROR_MEM;
+  }
+  if (!p->csWasInitialized)
+  {
+    if (CriticalSection_Init(&p->cs) != 0)
+      return SZ_ERROR_THREAD;
+    if (CriticalSection_Init(&p->stopCs) != 0)
+    {
+      CriticalSection_Delete(&p->cs);
+      return SZ_ERROR_THREAD;
+    }
+    p->csWasInitialized = True;
+  }
+  /* The encoder may lag behind the match finder by all the records of the
+     ring (at least two values per position) */
+  keepAddBufferBefore += kMtNumBlocks * kMtBlockSize / 2;
+  if (!MatchFinder_Create(mf, historySize, keepAddBufferBefore, matchMaxLen, keepAddBufferAfter, alloc))
+    return SZ_ERROR_MEM;
+  return SZ_OK;
+}
+
+static Byte MatchFinderMt_GetIndexByte(CMatchFinderMt *p, Int32 index)
+{
+  return p->pointerToCurPos[index];
+}
+
+static UInt32 MatchFinderMt_GetNumAvailableBytes(CMatchFinderMt *p)
+{
+  MT_GET_RECORD(p);
+  return p->curRec[0];
+}
+
+static const Byte * MatchFinderMt_GetPointerToCurrentPos(CMatchFinderMt *p)
+{
+  return p->pointerToCurPos;
+}
+
+static UInt32 MatchFinderMt_GetMatches(CMatchFinderMt *p, UInt32 *distances)
+{
+  const UInt32 *rec;
+  UInt32 i, num;
+  MT_GET_RECORD(p);
+  rec = p->curRec + 2;
+  num = p->curRec[1];
+  for (i = 0; i < num; i++)
+    distances[i] = rec[i];
+  p->curRec = rec + num;
+  p->pointerToCurPos++;
+  return num;
+}
+
+static void MatchFinderMt_Skip(CMatchFinderMt *p, UInt32 num)
+{
+  while (num-- != 0)
+  {
+    MT_GET_RECORD(p);
+    p->curRec += 2 + p->curRec[1];
+    p->pointerToCurPos++;
+  }
+}
+
+void MatchFinderMt_CreateVTable(CMatchFinderMt *p, IMatchFinder *vTable)
+{
+  MatchFinder_CreateVTable(p->MatchFinder, &p->mfVTable);
+  vTable->Init = (Mf_Init_Func)MatchFinderMt_Init;
+  vTable->GetIndexByte = (Mf_GetIndexByte_Func)MatchFinderMt_GetIndexByte;
+  vTable->GetNumAvailableBytes = (Mf_GetNumAvailableBytes_Func)MatchFinderMt_GetNumAvailableBytes;
+  vTable->GetPointerToCurrentPos = (Mf_GetPointerToCurrentPos_Func)MatchFinderMt_GetPointerToCurrentPos;
+  vTable->GetMatches = (Mf_GetMatches_Func)MatchFinderMt_GetMatches;
+  vTable->Skip = (Mf_Skip_Func)MatchFinderMt_Skip;
+}
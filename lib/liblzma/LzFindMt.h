@@ -0,0 +1,52 @@
+/* LzFindMt.h -- Multithreaded match finder for LZ algorithms
+Public domain */
+
+#ifndef __LZFINDMT_H
+#define __LZFINDMT_H
+
+#include "Threads.h"
+#include "LzFind.h"
+
+/* The match finder thread runs ahead of the encoder and hands over its
+   results in a ring of blocks. Each block holds one record per position:
+   the number of available bytes, the number of distance values and the
+   distance values themselves (as returned by GetMatches). */
+#define kMtNumBlocks (1 << 3)
+#define kMtBlockSize (1 << 14)
+
+typedef struct _CMatchFinderMt
+{
+  /* Encoder side */
+  const Byte *pointerToCurPos;
+  const UInt32 *curRec;
+  const UInt32 *recLimit;
+  UInt32 consumeIndex;
+  Bool haveBlock;
+
+  /* Match finder side */
+  CMatchFinder *MatchFinder;
+  IMatchFinder mfVTable;
+  UInt32 produceIndex;
+  UInt32 maxRecordSize;
+  Bool stopWriting;
+
+  UInt32 *blocks;
+  UInt32 blockSizes[kMtNumBlocks];
+
+  CThread thread;
+  CSemaphore freeSemaphore;
+  CSemaphore filledSemaphore;
+  CCriticalSection cs;      /* held by the encoder while it uses the window */
+  CCriticalSection stopCs;  /* guards stopWriting */
+  Bool csWasInitialized;
+  Bool csWasEntered;
+} CMatchFinderMt;
+
+void MatchFinderMt_Construct(CMatchFinderMt *p);
+void MatchFinderMt_Destruct(CMatchFinderMt *p, ISzAlloc *alloc);
+SRes MatchFinderMt_Create(CMatchFinderMt *p, UInt32 historySize, UInt32 keepAddBufferBefore,
+    UInt32 matchMaxLen, UInt32 keepAddBufferAfter, ISzAlloc *alloc);
+void MatchFinderMt_CreateVTable(CMatchFinderMt *p, IMatchFinder *vTable);
+void MatchFinderMt_ReleaseStream(CMatchFinderMt *p);
+
+#endif
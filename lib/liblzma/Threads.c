@@ -0,0 +1,169 @@
+/* Threads.c -- Multithreading primitives (Win32 threads or pthreads)
+Public domain */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "Threads.h"
+
+#ifdef _WIN32
+
+#include <process.h>
+
+static WRes GetError(void)
+{
+  DWORD res = GetLastError();
+  return (res) ? (WRes)(res) : 1;
+}
+
+static WRes BoolToWRes(BOOL v) { return v ? 0 : GetError(); }
+
+static WRes MyCloseHandle(HANDLE *h)
+{
+  if (*h != NULL)
+    if (!CloseHandle(*h))
+      return GetError();
+  *h = NULL;
+  return 0;
+}
+
+void Thread_Construct(CThread *p) { p->handle = NULL; }
+Bool Thread_WasCreated(const CThread *p) { return p->handle != NULL; }
+
+WRes Thread_Create(CThread *p, THREAD_FUNC_TYPE func, void *param)
+{
+  unsigned threadId;
+  p->handle = (HANDLE)_beginthreadex(NULL, 0, func, param, 0, &threadId);
+  return (p->handle != NULL) ? 0 : GetError();
+}
+
+WRes Thread_Wait(CThread *p)
+{
+  if (p->handle == NULL)
+    return 1;
+  return (WaitForSingleObject(p->handle, INFINITE) == WAIT_OBJECT_0) ? 0 : GetError();
+}
+
+WRes Thread_Close(CThread *p) { return MyCloseHandle(&p->handle); }
+
+WRes CriticalSection_Init(CCriticalSection *p)
+{
+  InitializeCriticalSection(p);
+  return 0;
+}
+
+void CriticalSection_Delete(CCriticalSection *p) { DeleteCriticalSection(p); }
+void CriticalSection_Enter(CCriticalSection *p) { EnterCriticalSection(p); }
+void CriticalSection_Leave(CCriticalSection *p) { LeaveCriticalSection(p); }
+
+void Semaphore_Construct(CSemaphore *p) { p->handle = NULL; }
+
+WRes Semaphore_Create(CSemaphore *p, UInt32 initCount, UInt32 maxCount)
+{
+  p->handle = CreateSemaphore(NULL, (LONG)initCount, (LONG)maxCount, NULL);
+  return (p->handle != NULL) ? 0 : GetError();
+}
+
+WRes Semaphore_Release1(CSemaphore *p)
+{
+  return BoolToWRes(ReleaseSemaphore(p->handle, 1, NULL));
+}
+
+WRes Semaphore_Wait(CSemaphore *p)
+{
+  return (WaitForSingleObject(p->handle, INFINITE) == WAIT_OBJECT_0) ? 0 : GetError();
+}
+
+WRes Semaphore_Close(CSemaphore *p) { return MyCloseHandle(&p->handle); }
+
+
+#else
+
+void Thread_Construct(CThread *p) { p->created = 0; }
+Bool Thread_WasCreated(const CThread *p) { return p->created != 0; }
+
+WRes Thread_Create(CThread *p, THREAD_FUNC_TYPE func, void *param)
+{
+  WRes res = pthread_create(&p->thread, NULL, func, param);
+  p->created = (res == 0);
+  return res;
+}
+
+WRes Thread_Wait(CThread *p)
+{
+  if (!p->created)
+    return 1;
+  return pthread_join(p->thread, NULL);
+}
+
+WRes Thread_Close(CThread *p)
+{
+  p->created = 0;
+  return 0;
+}
+
+WRes CriticalSection_Init(CCriticalSection *p) { return pthread_mutex_init(p, NULL); }
+void CriticalSection_Delete(CCriticalSection *p) { pthread_mutex_destroy(p); }
+void CriticalSection_Enter(CCriticalSection *p) { pthread_mutex_lock(p); }
+void CriticalSection_Leave(CCriticalSection *p) { pthread_mutex_unlock(p); }
+
+/* The semaphore is built from a mutex and a condition variable, since
+   unnamed POSIX semaphores are not available everywhere. */
+
+void Semaphore_Construct(CSemaphore *p) { p->created = 0; }
+
+WRes Semaphore_Create(CSemaphore *p, UInt32 initCount, UInt32 maxCount)
+{
+  WRes res = pthread_mutex_init(&p->mutex, NULL);
+  if (res != 0)
+    return res;
+  res = pthread_cond_init(&p->cond, NULL);
+  if (res != 0)
+  {
+    pthread_mutex_destroy(&p->mutex);
+    return res;
+  }
+  p->count = initCount;
+  p->maxCount = maxCount;
+  p->created = 1;
+  return 0;
+}
+
+WRes Semaphore_Release1(CSemaphore *p)
+{
+  WRes res = 0;
+  pthread_mutex_lock(&p->mutex);
+  if (p->count < p->maxCount)
+  {
+    p->count++;
+    pthread_cond_signal(&p->cond);
+  }
+  else
+    res = 1;
+  pthread_mutex_unlock(&p->mutex);
+  return res;
+}
+
+WRes Semaphore_Wait(CSemaphore *p)
+{
+  pthread_mutex_lock(&p->mutex);
+  while (p->count == 0)
+    pthread_cond_wait(&p->cond, &p->mutex);
+  p->count--;
+  pthread_mutex_unlock(&p->mutex);
+  return 0;
+}
+
+WRes Semaphore_Close(CSemaphore *p)
+{
+  if (p->created)
+  {
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    p->created = 0;
+  }
+  return 0;
+}
+
+#endif
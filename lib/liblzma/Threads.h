@@ -0,0 +1,73 @@
+/* Threads.h -- Multithreading primitives (Win32 threads or pthreads)
+Public domain */
+
+#ifndef __7Z_THREADS_H
+#define __7Z_THREADS_H
+
+#include "Types.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+
+#define THREAD_FUNC_RET_TYPE unsigned
+#define THREAD_FUNC_CALL_TYPE MY_STD_CALL
+
+typedef struct
+{
+  HANDLE handle;
+} CThread;
+
+typedef CRITICAL_SECTION CCriticalSection;
+
+typedef struct
+{
+  HANDLE handle;
+} CSemaphore;
+
+#else
+
+#define THREAD_FUNC_RET_TYPE void *
+#define THREAD_FUNC_CALL_TYPE
+
+typedef struct
+{
+  pthread_t thread;
+  int created;
+} CThread;
+
+typedef pthread_mutex_t CCriticalSection;
+
+typedef struct
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  UInt32 count;
+  UInt32 maxCount;
+  int created;
+} CSemaphore;
+
+#endif
+
+typedef THREAD_FUNC_RET_TYPE (THREAD_FUNC_CALL_TYPE * THREAD_FUNC_TYPE)(void *);
+
+void Thread_Construct(CThread *p);
+Bool Thread_WasCreated(const CThread *p);
+WRes Thread_Create(CThread *p, THREAD_FUNC_TYPE func, void *param);
+WRes Thread_Wait(CThread *p);
+WRes Thread_Close(CThread *p);
+
+WRes CriticalSection_Init(CCriticalSection *p);
+void CriticalSection_Delete(CCriticalSection *p);
+void CriticalSection_Enter(CCriticalSection *p);
+void CriticalSection_Leave(CCriticalSection *p);
+
+void Semaphore_Construct(CSemaphore *p);
+WRes Semaphore_Create(CSemaphore *p, UInt32 initCount, UInt32 maxCount);
+WRes Semaphore_Release1(CSemaphore *p);
+WRes Semaphore_Wait(CSemaphore *p);
+WRes Semaphore_Close(CSemaphore *p);
+
+#endif
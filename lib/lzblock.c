@@ -0,0 +1,328 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        lzblock.c
+// Description: Fast LZ77 block coder (LZ4 block format), used for the packed
+//              data arrays of the MG3 compression method.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+// A packed block is a series of sequences. Each sequence is a token byte (high
+// nibble = literal count, low nibble = match length - 4), an optional literal
+// count extension, the literals, a 16-bit little endian match offset and an
+// optional match length extension. A nibble value of 15 means that extension
+// bytes follow (each byte is added to the length, and a byte below 255 ends
+// the extension). The last sequence only has literals.
+
+// Minimum match length
+#define _CTM_LZ_MIN_MATCH 4
+
+// The last match must start at least this many bytes before the end of the
+// block, and the last bytes of the block are always literals
+#define _CTM_LZ_MF_LIMIT 12
+#define _CTM_LZ_LAST_LITERALS 5
+
+// Largest match offset
+#define _CTM_LZ_MAX_OFFSET 65535
+
+// Size of the match finder hash table and position chain
+#define _CTM_LZ_HASH_BITS 16
+#define _CTM_LZ_HASH_SIZE (1 << _CTM_LZ_HASH_BITS)
+#define _CTM_LZ_CHAIN_SIZE 65536
+
+//-----------------------------------------------------------------------------
+// _ctmLZRead32() - Read four bytes as an (endian dependent) integer.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmLZRead32(const unsigned char * aPtr)
+{
+  CTMuint x;
+  memcpy(&x, aPtr, 4);
+  return x;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZHash() - Hash the four bytes at the given position.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmLZHash(const unsigned char * aPtr)
+{
+  return (_ctmLZRead32(aPtr) * 2654435761U) >> (32 - _CTM_LZ_HASH_BITS);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZWriteLength() - Write the extension bytes of a length (the part that
+// did not fit in the token nibble).
+//-----------------------------------------------------------------------------
+static unsigned char * _ctmLZWriteLength(unsigned char * aDst, size_t aLength)
+{
+  while(aLength >= 255)
+  {
+    *aDst ++ = 255;
+    aLength -= 255;
+  }
+  *aDst ++ = (unsigned char) aLength;
+  return aDst;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZWriteSequence() - Write one sequence: the literals from aLiterals to
+// the match, and the match (skipped if aMatchLength is zero).
+//-----------------------------------------------------------------------------
+static unsigned char * _ctmLZWriteSequence(unsigned char * aDst,
+  const unsigned char * aLiterals, size_t aLiteralCount, CTMuint aOffset,
+  size_t aMatchLength)
+{
+  unsigned char * token = aDst ++;
+  size_t matchCode;
+
+  // Literals
+  if(aLiteralCount >= 15)
+  {
+    *token = 15 << 4;
+    aDst = _ctmLZWriteLength(aDst, aLiteralCount - 15);
+  }
+  else
+    *token = (unsigned char) (aLiteralCount << 4);
+  memcpy(aDst, aLiterals, aLiteralCount);
+  aDst += aLiteralCount;
+
+  // Last sequence?
+  if(aMatchLength == 0)
+    return aDst;
+
+  // Match offset and length
+  *aDst ++ = (unsigned char) (aOffset & 0xff);
+  *aDst ++ = (unsigned char) (aOffset >> 8);
+  matchCode = aMatchLength - _CTM_LZ_MIN_MATCH;
+  if(matchCode >= 15)
+  {
+    *token |= 15;
+    aDst = _ctmLZWriteLength(aDst, matchCode - 15);
+  }
+  else
+    *token |= (unsigned char) matchCode;
+
+  return aDst;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZBlockBound() - Largest possible packed size of aSize bytes.
+//-----------------------------------------------------------------------------
+size_t _ctmLZBlockBound(size_t aSize)
+{
+  return aSize + aSize / 255 + 16;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZBlockCompress() - Pack aSrcSize bytes into aDst, which must hold at
+// least _ctmLZBlockBound(aSrcSize) bytes. The compression level (0-9) selects
+// how many earlier positions the match finder tries. The match finder memory
+// is taken from aScratch. Returns the packed size, or zero if the match finder
+// memory could not be allocated.
+//-----------------------------------------------------------------------------
+size_t _ctmLZBlockCompress(_CTMscratch * aScratch, unsigned char * aDst,
+  const unsigned char * aSrc, size_t aSrcSize, CTMuint aLevel)
+{
+  const unsigned char * ip, * anchor, * mfLimit, * matchLimit, * ref, * p;
+  unsigned char * op;
+  CTMint * head, * chain, candidate;
+  CTMuint attempts, maxAttempts, h;
+  size_t pos, len, bestLen, bestOffset, i;
+
+  op = aDst;
+
+  // Small blocks are stored as literals only
+  if(aSrcSize < _CTM_LZ_MF_LIMIT + 1)
+    return (size_t) (_ctmLZWriteSequence(op, aSrc, aSrcSize, 0, 0) - aDst);
+
+  // Allocate the hash table and the position chain
+  head = (CTMint *) _ctmScratchAlloc(aScratch,
+    sizeof(CTMint) * (_CTM_LZ_HASH_SIZE + _CTM_LZ_CHAIN_SIZE));
+  if(!head)
+    return 0;
+  chain = &head[_CTM_LZ_HASH_SIZE];
+  for(i = 0; i < _CTM_LZ_HASH_SIZE; ++ i)
+    head[i] = -1;
+
+  // Number of match candidates to try per position (1 - 32)
+  maxAttempts = 1 << ((aLevel > 9 ? 9 : aLevel + 1) / 2);
+
+  ip = anchor = aSrc;
+  mfLimit = aSrc + aSrcSize - _CTM_LZ_MF_LIMIT;
+  matchLimit = aSrc + aSrcSize - _CTM_LZ_LAST_LITERALS;
+  while(ip < mfLimit)
+  {
+    // Find the longest match among the most recent positions with the same
+    // hash
+    pos = (size_t) (ip - aSrc);
+    h = _ctmLZHash(ip);
+    bestLen = 0;
+    bestOffset = 0;
+    attempts = 0;
+    for(candidate = head[h];
+        (candidate >= 0) && (pos - (size_t) candidate <= _CTM_LZ_MAX_OFFSET) &&
+        (attempts < maxAttempts);
+        candidate = chain[candidate & (_CTM_LZ_CHAIN_SIZE - 1)], ++ attempts)
+    {
+      ref = aSrc + candidate;
+      if((ref[bestLen] == ip[bestLen]) && (_ctmLZRead32(ref) == _ctmLZRead32(ip)))
+      {
+        p = ip + _CTM_LZ_MIN_MATCH;
+        ref += _CTM_LZ_MIN_MATCH;
+        while((p < matchLimit) && (*p == *ref))
+        {
+          ++ p;
+          ++ ref;
+        }
+        len = (size_t) (p - ip);
+        if(len > bestLen)
+        {
+          bestLen = len;
+          bestOffset = pos - (size_t) candidate;
+          if(p >= matchLimit)
+            break;
+        }
+      }
+    }
+
+    // Insert the current position into the hash chain
+    chain[pos & (_CTM_LZ_CHAIN_SIZE - 1)] = head[h];
+    head[h] = (CTMint) pos;
+
+    if(bestLen < _CTM_LZ_MIN_MATCH)
+    {
+      ++ ip;
+      continue;
+    }
+
+    // Emit the literals and the match
+    op = _ctmLZWriteSequence(op, anchor, (size_t) (ip - anchor),
+                             (CTMuint) bestOffset, bestLen);
+
+    // Insert the positions that the match covers
+    for(i = 1; (i < bestLen) && (ip + i < mfLimit); ++ i)
+    {
+      h = _ctmLZHash(ip + i);
+      chain[(pos + i) & (_CTM_LZ_CHAIN_SIZE - 1)] = head[h];
+      head[h] = (CTMint) (pos + i);
+    }
+
+    ip += bestLen;
+    anchor = ip;
+  }
+
+  // Emit the last literals
+  op = _ctmLZWriteSequence(op, anchor, (size_t) (aSrc + aSrcSize - anchor), 0, 0);
+
+  _ctmScratchFree(aScratch, head);
+
+  return (size_t) (op - aDst);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZReadLength() - Read the extension bytes of a length. Returns CTM_FALSE
+// if the packed data ends before the length does.
+//-----------------------------------------------------------------------------
+static int _ctmLZReadLength(const unsigned char ** aSrc,
+  const unsigned char * aSrcEnd, size_t * aLength)
+{
+  const unsigned char * ip = *aSrc;
+  CTMuint b;
+  do {
+    if(ip >= aSrcEnd)
+      return CTM_FALSE;
+    b = *ip ++;
+    *aLength += b;
+  } while(b == 255);
+  *aSrc = ip;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLZBlockUncompress() - Unpack a packed block into exactly aDstSize bytes.
+// Returns CTM_FALSE if the packed data is corrupt (all reads and writes are
+// range checked).
+//-----------------------------------------------------------------------------
+int _ctmLZBlockUncompress(unsigned char * aDst, size_t aDstSize,
+  const unsigned char * aSrc, size_t aSrcSize)
+{
+  const unsigned char * ip, * ipEnd, * ref;
+  unsigned char * op, * opEnd;
+  size_t len, offset;
+  CTMuint token;
+
+  ip = aSrc;
+  ipEnd = aSrc + aSrcSize;
+  op = aDst;
+  opEnd = aDst + aDstSize;
+  for(;;)
+  {
+    if(ip >= ipEnd)
+      return CTM_FALSE;
+    token = *ip ++;
+
+    // Copy the literals
+    len = token >> 4;
+    if((len == 15) && !_ctmLZReadLength(&ip, ipEnd, &len))
+      return CTM_FALSE;
+    if((len > (size_t) (ipEnd - ip)) || (len > (size_t) (opEnd - op)))
+      return CTM_FALSE;
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+
+    // The last sequence has no match
+    if(ip == ipEnd)
+      break;
+
+    // Copy the match (which may overlap the output)
+    if(ipEnd - ip < 2)
+      return CTM_FALSE;
+    offset = ((size_t) ip[0]) | (((size_t) ip[1]) << 8);
+    ip += 2;
+    if((offset == 0) || (offset > (size_t) (op - aDst)))
+      return CTM_FALSE;
+    len = token & 15;
+    if((len == 15) && !_ctmLZReadLength(&ip, ipEnd, &len))
+      return CTM_FALSE;
+    len += _CTM_LZ_MIN_MATCH;
+    if(len > (size_t) (opEnd - op))
+      return CTM_FALSE;
+    ref = op - offset;
+    if(offset >= len)
+    {
+      memcpy(op, ref, len);
+      op += len;
+    }
+    else
+    {
+      while(len --)
+        *op ++ = *ref ++;
+    }
+  }
+
+  return op == opEnd;
+}
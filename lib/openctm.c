@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include <math.h>
 #include "openctm.h"
 #include "internal.h"
@@ -42,29 +43,35 @@
 
 
 //-----------------------------------------------------------------------------
-// _ctmFreeMapList() - Free a float map list.
+// _ctmFreeMapList() - Free a float map list. aDest is the destination buffer
+// slot of the first map in the list (_CTM_DEST_UV_MAPS/_CTM_DEST_ATTRIB_MAPS).
 //-----------------------------------------------------------------------------
-static void _ctmFreeMapList(_CTMcontext * self, _CTMfloatmap * aMapList)
+static void _ctmFreeMapList(_CTMcontext * self, _CTMfloatmap * aMapList,
+  CTMuint aDest)
 {
   _CTMfloatmap * map, * nextMap;
+  CTMuint i;
   map = aMapList;
+  i = 0;
   while(map)
   {
     // Free internally allocated array (if we are in import mode)
-    if((self->mMode == CTM_IMPORT) && map->mValues)
-      free(map->mValues);
+    if((self->mMode == CTM_IMPORT) && map->mValues &&
+       !((i < 8) && (self->mCallerArrays & (1 << (aDest + i)))))
+      _ctmFree(&self->mAllocator, map->mValues);
 
     // Free map name
     if(map->mName)
-      free(map->mName);
+      _ctmFree(&self->mAllocator, map->mName);
 
     // Free file name
     if(map->mFileName)
-      free(map->mFileName);
+      _ctmFree(&self->mAllocator, map->mFileName);
 
     nextMap = map->mNext;
-    free(map);
+    _ctmFree(&self->mAllocator, map);
     map = nextMap;
+    ++ i;
   }
 }
 
@@ -73,33 +80,42 @@ static void _ctmFreeMapList(_CTMcontext * self, _CTMfloatmap * aMapList)
 //-----------------------------------------------------------------------------
 static void _ctmClearMesh(_CTMcontext * self)
 {
-  // Free internally allocated mesh arrays
+  // Free internally allocated mesh arrays (but not caller provided buffers)
   if(self->mMode == CTM_IMPORT)
   {
-    if(self->mVertices)
-      free(self->mVertices);
-    if(self->mIndices)
-      free(self->mIndices);
-    if(self->mNormals)
-      free(self->mNormals);
+    if(self->mVertices && !(self->mCallerArrays & (1 << _CTM_DEST_VERTICES)))
+      _ctmFree(&self->mAllocator, self->mVertices);
+    if(self->mIndices && !(self->mCallerArrays & (1 << _CTM_DEST_INDICES)))
+      _ctmFree(&self->mAllocator, self->mIndices);
+    if(self->mNormals && !(self->mCallerArrays & (1 << _CTM_DEST_NORMALS)))
+      _ctmFree(&self->mAllocator, self->mNormals);
   }
 
   // Clear externally assigned mesh arrays
   self->mVertices = (CTMfloat *) 0;
   self->mVertexCount = 0;
+  self->mVertexStride = 3;
   self->mIndices = (CTMuint *) 0;
   self->mTriangleCount = 0;
+  self->mIndexStride = 3;
   self->mNormals = (CTMfloat *) 0;
+  self->mNormalStride = 3;
+  self->mNormalFormat = CTM_FORMAT_FLOAT32;
 
   // Free UV coordinate map list
-  _ctmFreeMapList(self, self->mUVMaps);
+  _ctmFreeMapList(self, self->mUVMaps, _CTM_DEST_UV_MAPS);
   self->mUVMaps = (_CTMfloatmap *) 0;
   self->mUVMapCount = 0;
 
   // Free attribute map list
-  _ctmFreeMapList(self, self->mAttribMaps);
+  _ctmFreeMapList(self, self->mAttribMaps, _CTM_DEST_ATTRIB_MAPS);
   self->mAttribMaps = (_CTMfloatmap *) 0;
   self->mAttribMapCount = 0;
+
+  self->mCallerArrays = 0;
+  self->mSkipNormals = CTM_FALSE;
+  self->mSkipUVMaps = 0;
+  self->mSkipAttribMaps = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -109,7 +125,7 @@ static void _ctmClearMesh(_CTMcontext * self)
 
 static CTMint _ctmCheckMeshIntegrity(_CTMcontext * self)
 {
-  CTMuint i;
+  CTMuint i, j;
   _CTMfloatmap * map;
 
   // Check that we have all the mandatory data
@@ -120,31 +136,54 @@ static CTMint _ctmCheckMeshIntegrity(_CTMcontext * self)
   }
 
   // Check that all indices are within range
-  for(i = 0; i < (self->mTriangleCount * 3); ++ i)
+  for(i = 0; i < self->mTriangleCount; ++ i)
   {
-    if(self->mIndices[i] >= self->mVertexCount)
+    for(j = 0; j < 3; ++ j)
     {
-      return CTM_FALSE;
+      if(self->mIndices[i * self->mIndexStride + j] >= self->mVertexCount)
+      {
+        return CTM_FALSE;
+      }
     }
   }
 
   // Check that all vertices are finite (non-NaN, non-inf)
-  for(i = 0; i < self->mVertexCount * 3; ++ i)
+  for(i = 0; i < self->mVertexCount; ++ i)
   {
-    if(!isfinite(self->mVertices[i]))
+    for(j = 0; j < 3; ++ j)
     {
-      return CTM_FALSE;
+      if(!isfinite(self->mVertices[i * self->mVertexStride + j]))
+      {
+        return CTM_FALSE;
+      }
     }
   }
 
   // Check that all normals are finite (non-NaN, non-inf)
-  if(self->mNormals)
+  if(self->mNormals && (self->mNormalFormat == CTM_FORMAT_FLOAT16))
   {
-    for(i = 0; i < self->mVertexCount * 3; ++ i)
+    for(i = 0; i < self->mVertexCount; ++ i)
     {
-      if(!isfinite(self->mNormals[i]))
+      for(j = 0; j < 3; ++ j)
       {
-        return CTM_FALSE;
+        if(!_ctmIsFiniteHalf((const unsigned char *) self->mNormals +
+                             i * self->mNormalStride * 4 + j * 2))
+        {
+          return CTM_FALSE;
+        }
+      }
+    }
+  }
+  else if(self->mNormals && (self->mNormalFormat == CTM_FORMAT_FLOAT32))
+  {
+    for(i = 0; i < self->mVertexCount; ++ i)
+    {
+      for(j = 0; j < 3; ++ j)
+      {
+        if(!isfinite(self->mNormals[i * self->mNormalStride + j]))
+        {
+          return CTM_FALSE;
+        }
       }
     }
   }
@@ -153,11 +192,14 @@ static CTMint _ctmCheckMeshIntegrity(_CTMcontext * self)
   map = self->mUVMaps;
   while(map)
   {
-    for(i = 0; i < self->mVertexCount * 2; ++ i)
+    for(i = 0; i < self->mVertexCount; ++ i)
     {
-      if(!isfinite(map->mValues[i]))
+      for(j = 0; j < 2; ++ j)
       {
-        return CTM_FALSE;
+        if(!isfinite(map->mValues[i * map->mStride + j]))
+        {
+          return CTM_FALSE;
+        }
       }
     }
     map = map->mNext;
@@ -167,11 +209,14 @@ static CTMint _ctmCheckMeshIntegrity(_CTMcontext * self)
   map = self->mAttribMaps;
   while(map)
   {
-    for(i = 0; i < self->mVertexCount * 4; ++ i)
+    for(i = 0; i < self->mVertexCount; ++ i)
     {
-      if(!isfinite(map->mValues[i]))
+      for(j = 0; j < 4; ++ j)
       {
-        return CTM_FALSE;
+        if(!isfinite(map->mValues[i * map->mStride + j]))
+        {
+          return CTM_FALSE;
+        }
       }
     }
     map = map->mNext;
@@ -180,6 +225,43 @@ static CTMint _ctmCheckMeshIntegrity(_CTMcontext * self)
   return CTM_TRUE;
 }
 
+//-----------------------------------------------------------------------------
+// _ctmGetDestSlot() - Get the destination buffer slot (_CTM_DEST_*) and the
+// element size (in 32-bit words) of a mesh array.
+//-----------------------------------------------------------------------------
+static CTMint _ctmGetDestSlot(CTMenum aArray, CTMuint * aDest, CTMuint * aSize)
+{
+  if((aArray >= CTM_UV_MAP_1) && (aArray <= CTM_UV_MAP_8))
+  {
+    *aDest = _CTM_DEST_UV_MAPS + (aArray - CTM_UV_MAP_1);
+    *aSize = 2;
+  }
+  else if((aArray >= CTM_ATTRIB_MAP_1) && (aArray <= CTM_ATTRIB_MAP_8))
+  {
+    *aDest = _CTM_DEST_ATTRIB_MAPS + (aArray - CTM_ATTRIB_MAP_1);
+    *aSize = 4;
+  }
+  else if(aArray == CTM_INDICES)
+  {
+    *aDest = _CTM_DEST_INDICES;
+    *aSize = 3;
+  }
+  else if(aArray == CTM_VERTICES)
+  {
+    *aDest = _CTM_DEST_VERTICES;
+    *aSize = 3;
+  }
+  else if(aArray == CTM_NORMALS)
+  {
+    *aDest = _CTM_DEST_NORMALS;
+    *aSize = 3;
+  }
+  else
+    return CTM_FALSE;
+
+  return CTM_TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // ctmNewContext()
 //-----------------------------------------------------------------------------
@@ -189,15 +271,36 @@ CTMEXPORT CTMcontext CTMCALL ctmNewContext(CTMenum aMode)
 
   // Allocate memory for the new structure
   self = (_CTMcontext *) malloc(sizeof(_CTMcontext));
+  if(!self)
+    return (CTMcontext) 0;
 
   // Initialize structure (set null pointers and zero array lengths)
   memset(self, 0, sizeof(_CTMcontext));
+  if(!_ctmInitScratch(&self->mScratchPool, &self->mAllocator))
+  {
+    free(self);
+    return (CTMcontext) 0;
+  }
+  self->mScratch = &self->mScratchPool;
   self->mMode = aMode;
   self->mError = CTM_NONE;
   self->mMethod = CTM_METHOD_MG1;
   self->mCompressionLevel = 1;
   self->mVertexPrecision = 1.0f / 1024.0f;
   self->mNormalPrecision = 1.0f / 256.0f;
+  self->mThreadCount = 1;
+  self->mVertexStride = 3;
+  self->mIndexStride = 3;
+  self->mNormalStride = 3;
+  self->mNormalFormat = CTM_FORMAT_FLOAT32;
+  memset(self->mLZMAParams, 0xff, sizeof(self->mLZMAParams));
+  self->mIndexCoding = CTM_CODING_DELTA;
+  self->mVertexCoding = CTM_CODING_DELTA;
+  self->mNormalCoding = CTM_CODING_DELTA;
+  self->mTileGrid[0] = self->mTileGrid[1] = self->mTileGrid[2] = 1;
+  self->mTileSelect = CTM_ALL_TILES;
+  self->mLoadSections = CTM_LOAD_ALL;
+  self->mStreamBufSize = _CTM_STREAM_BUFFER_SIZE;
 
   return (CTMcontext) self;
 }
@@ -215,7 +318,19 @@ CTMEXPORT void CTMCALL ctmFreeContext(CTMcontext aContext)
 
   // Free the file comment
   if(self->mFileComment)
-    free(self->mFileComment);
+    _ctmFree(&self->mAllocator, self->mFileComment);
+
+  // Free the tile index
+  _ctmFreeTiles(self);
+
+  // Free the chunks of a mesh that was not saved
+  _ctmFreeChunks(self);
+
+  // Free the probed file
+  _ctmFreeProbe(self);
+
+  // Free the scratch memory
+  _ctmFreeScratch(&self->mScratchPool);
 
   // Free the context
   free(self);
@@ -292,11 +407,30 @@ CTMEXPORT CTMuint CTMCALL ctmGetInteger(CTMcontext aContext, CTMenum aProperty)
       return self->mAttribMapCount;
 
     case CTM_HAS_NORMALS:
-      return self->mNormals ? CTM_TRUE : CTM_FALSE;
+      return (self->mNormals || (self->mProbed &&
+             (self->mProbeFlags & _CTM_HAS_NORMALS_BIT))) ? CTM_TRUE : CTM_FALSE;
 
     case CTM_COMPRESSION_METHOD:
       return (CTMuint) self->mMethod;
 
+    case CTM_THREAD_COUNT:
+      return self->mThreadCount;
+
+    case CTM_TILE_COUNT:
+      return self->mTileCount;
+
+    case CTM_LEVEL_COUNT:
+      return self->mLevelCount;
+
+    case CTM_SCRATCH_PEAK:
+      return self->mScratch->mPeak > 0xffffffff ? 0xffffffff :
+             (CTMuint) self->mScratch->mPeak;
+
+    case CTM_SECTION_COUNT:
+      if(self->mProbed)
+        _ctmReadSections(self);
+      return self->mSectionCount;
+
     default:
       self->mError = CTM_INVALID_ARGUMENT;
   }
@@ -638,6 +772,109 @@ CTMEXPORT const char * CTMCALL ctmGetString(CTMcontext aContext,
   return (const char *) 0;
 }
 
+//-----------------------------------------------------------------------------
+// ctmGetTileInteger()
+//-----------------------------------------------------------------------------
+CTMEXPORT CTMuint CTMCALL ctmGetTileInteger(CTMcontext aContext, CTMuint aTile,
+  CTMenum aProperty)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return 0;
+
+  // Check the tile number
+  if(aTile >= self->mTileCount)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return 0;
+  }
+
+  switch(aProperty)
+  {
+    case CTM_VERTEX_COUNT:
+      return self->mTiles[aTile].mVertexCount;
+
+    case CTM_TRIANGLE_COUNT:
+      return self->mTiles[aTile].mTriangleCount;
+
+    default:
+      self->mError = CTM_INVALID_ARGUMENT;
+  }
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+// ctmGetTileBoundingBox()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmGetTileBoundingBox(CTMcontext aContext,
+  CTMuint aTile, CTMfloat * aMin, CTMfloat * aMax)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  CTMuint i;
+  if(!self) return;
+
+  // Check arguments
+  if((aTile >= self->mTileCount) || !aMin || !aMax)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  for(i = 0; i < 3; ++ i)
+  {
+    aMin[i] = self->mTiles[aTile].mMin[i];
+    aMax[i] = self->mTiles[aTile].mMax[i];
+  }
+}
+
+//-----------------------------------------------------------------------------
+// ctmGetSectionInteger()
+//-----------------------------------------------------------------------------
+CTMEXPORT CTMuint CTMCALL ctmGetSectionInteger(CTMcontext aContext,
+  CTMuint aSection, CTMenum aProperty)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  _CTMsection * section;
+  size_t value;
+  if(!self) return 0;
+
+  // Read the section directory of the probed file, if necessary
+  if(self->mProbed && !_ctmReadSections(self))
+    return 0;
+
+  // Check the section number
+  if(aSection >= self->mSectionCount)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return 0;
+  }
+  section = &self->mSections[aSection];
+
+  switch(aProperty)
+  {
+    case CTM_SECTION_ID:
+      return section->mID;
+
+    case CTM_SECTION_OFFSET:
+      value = section->mOffset;
+      break;
+
+    case CTM_SECTION_SIZE:
+      value = section->mSize;
+      break;
+
+    case CTM_SECTION_UNPACKED_SIZE:
+      value = section->mUnpackedSize;
+      break;
+
+    default:
+      self->mError = CTM_INVALID_ARGUMENT;
+      return 0;
+  }
+
+  return value > 0xffffffff ? 0xffffffff : (CTMuint) value;
+}
+
 //-----------------------------------------------------------------------------
 // ctmCompressionMethod()
 //-----------------------------------------------------------------------------
@@ -656,7 +893,7 @@ CTMEXPORT void CTMCALL ctmCompressionMethod(CTMcontext aContext,
 
   // Check arguments
   if((aMethod != CTM_METHOD_RAW) && (aMethod != CTM_METHOD_MG1) &&
-     (aMethod != CTM_METHOD_MG2))
+     (aMethod != CTM_METHOD_MG2) && (aMethod != CTM_METHOD_MG3))
   {
     self->mError = CTM_INVALID_ARGUMENT;
     return;
@@ -693,6 +930,218 @@ CTMEXPORT void CTMCALL ctmCompressionLevel(CTMcontext aContext,
   self->mCompressionLevel = aLevel;
 }
 
+//-----------------------------------------------------------------------------
+// ctmCompressionParameter()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmCompressionParameter(CTMcontext aContext,
+  CTMenum aSection, CTMenum aParameter, CTMint aValue)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  CTMuint first, last, i;
+  CTMint minValue, maxValue;
+  if(!self) return;
+
+  // You are only allowed to change compression attributes in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Which section(s)?
+  if(aSection == CTM_NONE)
+  {
+    first = 0;
+    last = _CTM_DEST_COUNT - 1;
+  }
+  else if(_ctmGetDestSlot(aSection, &first, &i))
+    last = first;
+  else
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // Check the parameter range (-1 selects the default value)
+  switch(aParameter)
+  {
+    case CTM_LZMA_DICT_SIZE:
+      minValue = 1 << 12;
+      maxValue = 1 << 27;
+      break;
+    case CTM_LZMA_LITERAL_CONTEXT_BITS:
+      minValue = 0;
+      maxValue = 8;
+      break;
+    case CTM_LZMA_LITERAL_POS_BITS:
+    case CTM_LZMA_POS_BITS:
+      minValue = 0;
+      maxValue = 4;
+      break;
+    case CTM_LZMA_FAST_BYTES:
+      minValue = 5;
+      maxValue = 273;
+      break;
+    case CTM_LZMA_MATCH_FINDER:
+      minValue = 0;
+      maxValue = 1;
+      break;
+    default:
+      self->mError = CTM_INVALID_ARGUMENT;
+      return;
+  }
+  if((aValue != -1) && ((aValue < minValue) || (aValue > maxValue)))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // Set the parameter
+  for(i = first; i <= last; ++ i)
+  {
+    switch(aParameter)
+    {
+      case CTM_LZMA_DICT_SIZE:
+        self->mLZMAParams[i].mDictSize = aValue;
+        break;
+      case CTM_LZMA_LITERAL_CONTEXT_BITS:
+        self->mLZMAParams[i].mLitContext = aValue;
+        break;
+      case CTM_LZMA_LITERAL_POS_BITS:
+        self->mLZMAParams[i].mLitPos = aValue;
+        break;
+      case CTM_LZMA_POS_BITS:
+        self->mLZMAParams[i].mPosBits = aValue;
+        break;
+      case CTM_LZMA_FAST_BYTES:
+        self->mLZMAParams[i].mFastBytes = aValue;
+        break;
+      case CTM_LZMA_MATCH_FINDER:
+        self->mLZMAParams[i].mMatchFinder = aValue;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// ctmCompressionCoding()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmCompressionCoding(CTMcontext aContext,
+  CTMenum aArray, CTMenum aCoding)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to change compression attributes in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Check arguments, and set the coding
+  if((aArray == CTM_INDICES) &&
+     ((aCoding == CTM_CODING_DELTA) || (aCoding == CTM_CODING_CONNECTIVITY)))
+    self->mIndexCoding = aCoding;
+  else if((aArray == CTM_VERTICES) &&
+          ((aCoding == CTM_CODING_DELTA) || (aCoding == CTM_CODING_PARALLELOGRAM)))
+    self->mVertexCoding = aCoding;
+  else if((aArray == CTM_NORMALS) &&
+          ((aCoding == CTM_CODING_DELTA) || (aCoding == CTM_CODING_OCTAHEDRAL)))
+    self->mNormalCoding = aCoding;
+  else
+    self->mError = CTM_INVALID_ARGUMENT;
+}
+
+//-----------------------------------------------------------------------------
+// ctmThreadCount()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmThreadCount(CTMcontext aContext, CTMuint aCount)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // Check arguments
+  if(aCount > 64)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // Set the thread count (0 = use all available processors)
+  self->mThreadCount = aCount;
+}
+
+//-----------------------------------------------------------------------------
+// ctmScratchMemory()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmScratchMemory(CTMcontext aContext, CTMuint aSize)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // The reserved memory can not be replaced while it is in use (e.g. from a
+  // level callback)
+  if(self->mScratch->mUsed > 0)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Replace the reserved scratch memory
+  if(!_ctmReserveScratch(self->mScratch, (size_t) aSize))
+    self->mError = CTM_OUT_OF_MEMORY;
+}
+
+//-----------------------------------------------------------------------------
+// ctmSetAllocator()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmSetAllocator(CTMcontext aContext,
+  CTMallocfn aAllocFn, CTMfreefn aFreeFn, void * aUserData)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // Either both or none of the functions must be given
+  if((aAllocFn && !aFreeFn) || (!aAllocFn && aFreeFn))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // The allocator can not be changed once the context holds any memory that
+  // was allocated with the current allocator (sub contexts use the allocator
+  // of their parent)
+  if(self->mVertices || self->mIndices || self->mNormals || self->mUVMaps ||
+     self->mAttribMaps || self->mFileComment || self->mTiles ||
+     self->mProbeMap.mData || self->mSections || self->mScratchPool.mBase ||
+     self->mChunks.mCount || self->mChunks.mTiles || self->mChunks.mBufs ||
+     (self->mScratch != &self->mScratchPool))
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  self->mAllocator.mAllocFn = aAllocFn;
+  self->mAllocator.mFreeFn = aFreeFn;
+  self->mAllocator.mUserData = aUserData;
+}
+
+//-----------------------------------------------------------------------------
+// ctmStreamBuffer()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmStreamBuffer(CTMcontext aContext, CTMuint aSize)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // The buffer is allocated when a file is loaded or saved
+  self->mStreamBufSize = aSize;
+  self->mStreamBufSet = CTM_TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // ctmVertexPrecision()
 //-----------------------------------------------------------------------------
@@ -906,7 +1355,7 @@ CTMEXPORT void CTMCALL ctmFileComment(CTMcontext aContext,
   // Free the old comment string, if necessary
   if(self->mFileComment)
   {
-    free(self->mFileComment);
+    _ctmFree(&self->mAllocator, self->mFileComment);
     self->mFileComment = (char *) 0;
   }
 
@@ -918,7 +1367,7 @@ CTMEXPORT void CTMCALL ctmFileComment(CTMcontext aContext,
     return;
 
   // Copy the string
-  self->mFileComment = (char *) malloc(len + 1);
+  self->mFileComment = (char *) _ctmAlloc(&self->mAllocator, len + 1);
   if(!self->mFileComment)
   {
     self->mError = CTM_OUT_OF_MEMORY;
@@ -928,16 +1377,15 @@ CTMEXPORT void CTMCALL ctmFileComment(CTMcontext aContext,
 }
 
 //-----------------------------------------------------------------------------
-// ctmDefineMesh()
+// ctmTileGrid()
 //-----------------------------------------------------------------------------
-CTMEXPORT void CTMCALL ctmDefineMesh(CTMcontext aContext,
-  const CTMfloat * aVertices, CTMuint aVertexCount, const CTMuint * aIndices,
-  CTMuint aTriangleCount, const CTMfloat * aNormals)
+CTMEXPORT void CTMCALL ctmTileGrid(CTMcontext aContext, CTMuint aX,
+  CTMuint aY, CTMuint aZ)
 {
   _CTMcontext * self = (_CTMcontext *) aContext;
   if(!self) return;
 
-  // You are only allowed to (re)define the mesh in export mode
+  // You are only allowed to change file attributes in export mode
   if(self->mMode != CTM_EXPORT)
   {
     self->mError = CTM_INVALID_OPERATION;
@@ -945,29 +1393,104 @@ CTMEXPORT void CTMCALL ctmDefineMesh(CTMcontext aContext,
   }
 
   // Check arguments
-  if(!aVertices || !aIndices || !aVertexCount || !aTriangleCount)
+  if((aX < 1) || (aX > 256) || (aY < 1) || (aY > 256) || (aZ < 1) ||
+     (aZ > 256))
   {
     self->mError = CTM_INVALID_ARGUMENT;
     return;
   }
 
-  // Clear the old mesh, if any
-  _ctmClearMesh(self);
-
-  // Set vertex array pointer
-  self->mVertices = (CTMfloat *) aVertices;
-  self->mVertexCount = aVertexCount;
-
-  // Set index array pointer
-  self->mIndices = (CTMuint *) aIndices;
-  self->mTriangleCount = aTriangleCount;
-
-  // Set normal array pointer
-  self->mNormals = (CTMfloat *) aNormals;
+  self->mTileGrid[0] = aX;
+  self->mTileGrid[1] = aY;
+  self->mTileGrid[2] = aZ;
 }
 
 //-----------------------------------------------------------------------------
-// _ctmAddFloatMap()
+// ctmSectionDirectory()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmSectionDirectory(CTMcontext aContext,
+  CTMint aEnable)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to change file attributes in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  self->mSaveSections = aEnable ? CTM_TRUE : CTM_FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// ctmProgressiveLevels()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmProgressiveLevels(CTMcontext aContext,
+  CTMuint aLevels)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to change file attributes in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Check arguments
+  if(aLevels > 16)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  self->mProgressiveLevels = aLevels;
+}
+
+//-----------------------------------------------------------------------------
+// ctmDefineMesh()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmDefineMesh(CTMcontext aContext,
+  const CTMfloat * aVertices, CTMuint aVertexCount, const CTMuint * aIndices,
+  CTMuint aTriangleCount, const CTMfloat * aNormals)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to (re)define the mesh in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Check arguments
+  if(!aVertices || !aIndices || !aVertexCount || !aTriangleCount)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // Clear the old mesh, if any
+  _ctmClearMesh(self);
+
+  // Set vertex array pointer
+  self->mVertices = (CTMfloat *) aVertices;
+  self->mVertexCount = aVertexCount;
+
+  // Set index array pointer
+  self->mIndices = (CTMuint *) aIndices;
+  self->mTriangleCount = aTriangleCount;
+
+  // Set normal array pointer
+  self->mNormals = (CTMfloat *) aNormals;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmAddFloatMap()
 //-----------------------------------------------------------------------------
 static _CTMfloatmap * _ctmAddFloatMap(_CTMcontext * self,
   const CTMfloat * aValues, const char * aName, const char * aFileName,
@@ -979,7 +1502,8 @@ static _CTMfloatmap * _ctmAddFloatMap(_CTMcontext * self,
   // Allocate memory for a new map list item and append it to the list
   if(!*aList)
   {
-    *aList = (_CTMfloatmap *) malloc(sizeof(_CTMfloatmap));
+    *aList = (_CTMfloatmap *) _ctmAlloc(&self->mAllocator,
+                                        sizeof(_CTMfloatmap));
     map = *aList;
   }
   else
@@ -987,7 +1511,8 @@ static _CTMfloatmap * _ctmAddFloatMap(_CTMcontext * self,
     map = *aList;
     while(map->mNext)
       map = map->mNext;
-    map->mNext = (_CTMfloatmap *) malloc(sizeof(_CTMfloatmap));
+    map->mNext = (_CTMfloatmap *) _ctmAlloc(&self->mAllocator,
+                                            sizeof(_CTMfloatmap));
     map = map->mNext;
   }
   if(!map)
@@ -1009,11 +1534,11 @@ static _CTMfloatmap * _ctmAddFloatMap(_CTMcontext * self,
     if(len)
     {
       // Copy the string
-      map->mName = (char *) malloc(len + 1);
+      map->mName = (char *) _ctmAlloc(&self->mAllocator, len + 1);
       if(!map->mName)
       {
         self->mError = CTM_OUT_OF_MEMORY;
-        free(map);
+        _ctmFree(&self->mAllocator, map);
         return (_CTMfloatmap *) 0;
       }
       strcpy(map->mName, aName);
@@ -1028,13 +1553,13 @@ static _CTMfloatmap * _ctmAddFloatMap(_CTMcontext * self,
     if(len)
     {
       // Copy the string
-      map->mFileName = (char *) malloc(len + 1);
+      map->mFileName = (char *) _ctmAlloc(&self->mAllocator, len + 1);
       if(!map->mFileName)
       {
         self->mError = CTM_OUT_OF_MEMORY;
         if(map->mName)
-          free(map->mName);
-        free(map);
+          _ctmFree(&self->mAllocator, map->mName);
+        _ctmFree(&self->mAllocator, map);
         return (_CTMfloatmap *) 0;
       }
       strcpy(map->mFileName, aFileName);
@@ -1062,6 +1587,7 @@ CTMEXPORT CTMenum CTMCALL ctmAddUVMap(CTMcontext aContext,
   {
     // The default UV coordinate precision is 2^-12
     map->mPrecision = 1.0f / 4096.0f;
+    map->mStride = 2;
     ++ self->mUVMapCount;
     return CTM_UV_MAP_1 + self->mUVMapCount - 1;
   }
@@ -1086,6 +1612,7 @@ CTMEXPORT CTMenum CTMCALL ctmAddAttribMap(CTMcontext aContext,
   {
     // The default vertex attribute precision is 2^-8
     map->mPrecision = 1.0f / 256.0f;
+    map->mStride = 4;
     ++ self->mAttribMapCount;
     return CTM_ATTRIB_MAP_1 + self->mAttribMapCount - 1;
   }
@@ -1100,6 +1627,17 @@ static CTMuint CTMCALL _ctmDefaultRead(void * aBuf, CTMuint aCount,
   return (CTMuint) fread(aBuf, 1, (size_t) aCount, (FILE *) aUserData);
 }
 
+//-----------------------------------------------------------------------------
+// _ctmDefaultSeek()
+//-----------------------------------------------------------------------------
+static CTMint CTMCALL _ctmDefaultSeek(size_t aOffset, void * aUserData)
+{
+  if(aOffset > (size_t) LONG_MAX)
+    return CTM_FALSE;
+  return fseek((FILE *) aUserData, (long) aOffset, SEEK_SET) == 0 ?
+    CTM_TRUE : CTM_FALSE;
+}
+
 //-----------------------------------------------------------------------------
 // ctmLoad()
 //-----------------------------------------------------------------------------
@@ -1125,26 +1663,76 @@ CTMEXPORT void CTMCALL ctmLoad(CTMcontext aContext, const char * aFileName)
   }
 
   // Load the file
-  ctmLoadCustom(self, _ctmDefaultRead, (void *) f);
+  ctmLoadSeekable(self, _ctmDefaultRead, _ctmDefaultSeek, (void *) f);
 
   // Close file stream
   fclose(f);
 }
 
+//-----------------------------------------------------------------------------
+// _ctmAllocateArray() - Get the storage for a mesh array of aCount elements
+// (aSize 32-bit words each) that is about to be loaded. If the caller has
+// provided a destination buffer for the array (destination slot aDest), that
+// buffer is used, otherwise the array is allocated. The distance between two
+// elements (in words) is returned in aStride.
+//-----------------------------------------------------------------------------
+static void * _ctmAllocateArray(_CTMcontext * self, CTMuint aDest,
+  CTMuint aCount, CTMuint aSize, CTMuint * aStride)
+{
+  _CTMdest * dest;
+  void * array;
+
+  // Caller provided buffer?
+  if(aDest < _CTM_DEST_COUNT)
+  {
+    dest = &self->mDest[aDest];
+    if(dest->mBuffer)
+    {
+      // Does the mesh fit in the buffer?
+      if(aCount > dest->mCapacity)
+      {
+        self->mError = CTM_OUT_OF_MEMORY;
+        return (void *) 0;
+      }
+      self->mCallerArrays |= 1 << aDest;
+      *aStride = dest->mStride ? dest->mStride : aSize;
+      return dest->mBuffer;
+    }
+  }
+
+  // Allocate & clear memory for the array (the size must fit in a size_t)
+  if((size_t) aCount > ((size_t) -1) / (aSize * 4))
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return (void *) 0;
+  }
+  array = _ctmAlloc(&self->mAllocator, (size_t) aCount * aSize * 4);
+  if(!array)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return (void *) 0;
+  }
+  memset(array, 0, (size_t) aCount * aSize * 4);
+  *aStride = aSize;
+  return array;
+}
+
 //-----------------------------------------------------------------------------
 // _ctmAllocateFloatMaps()
 //-----------------------------------------------------------------------------
 static CTMuint _ctmAllocateFloatMaps(_CTMcontext * self,
-  _CTMfloatmap ** aMapListPtr, CTMuint aCount, CTMuint aChannels)
+  _CTMfloatmap ** aMapListPtr, CTMuint aCount, CTMuint aChannels,
+  CTMuint aDest)
 {
   _CTMfloatmap ** mapListPtr;
-  CTMuint i, size;
+  CTMuint i;
 
   mapListPtr = aMapListPtr;
   for(i = 0; i < aCount; ++ i)
   {
     // Allocate & clear memory for this map
-    *mapListPtr = (_CTMfloatmap *) malloc(sizeof(_CTMfloatmap));
+    *mapListPtr = (_CTMfloatmap *) _ctmAlloc(&self->mAllocator,
+                                             sizeof(_CTMfloatmap));
     if(!*mapListPtr)
     {
       self->mError = CTM_OUT_OF_MEMORY;
@@ -1152,15 +1740,12 @@ static CTMuint _ctmAllocateFloatMaps(_CTMcontext * self,
     }
     memset(*mapListPtr, 0, sizeof(_CTMfloatmap));
 
-    // Allocate & clear memory for the float array
-    size = aChannels * sizeof(CTMfloat) * self->mVertexCount;
-    (*mapListPtr)->mValues = (CTMfloat *) malloc(size);
+    // Get memory for the float array
+    (*mapListPtr)->mValues = (CTMfloat *) _ctmAllocateArray(self,
+      i < 8 ? aDest + i : _CTM_DEST_COUNT, self->mVertexCount, aChannels,
+      &(*mapListPtr)->mStride);
     if(!(*mapListPtr)->mValues)
-    {
-      self->mError = CTM_OUT_OF_MEMORY;
       return CTM_FALSE;
-    }
-    memset((*mapListPtr)->mValues, 0, size);
 
     // Next map...
     mapListPtr = &(*mapListPtr)->mNext;
@@ -1170,40 +1755,86 @@ static CTMuint _ctmAllocateFloatMaps(_CTMcontext * self,
 }
 
 //-----------------------------------------------------------------------------
-// ctmLoadCustom()
+// _ctmAllocateMesh() - Get the storage for all the mesh arrays of a mesh that
+// is about to be loaded (the counts in the context must be set). aFlags are
+// the mesh flags from the file header. The optional sections that are not
+// selected with ctmLoadSections() are left out of the mesh (and recorded in
+// mSkipNormals, mSkipUVMaps and mSkipAttribMaps, so that the decoder skips
+// them).
 //-----------------------------------------------------------------------------
-CTMEXPORT void CTMCALL ctmLoadCustom(CTMcontext aContext, CTMreadfn aReadFn,
-  void * aUserData)
+int _ctmAllocateMesh(_CTMcontext * self, CTMuint aFlags)
 {
-  _CTMcontext * self = (_CTMcontext *) aContext;
-  CTMuint formatVersion, flags, method;
-  if(!self) return;
+  // Leave out the sections that are not to be loaded
+  self->mSkipNormals = CTM_FALSE;
+  if(!(self->mLoadSections & CTM_LOAD_NORMALS) &&
+     (aFlags & _CTM_HAS_NORMALS_BIT))
+  {
+    self->mSkipNormals = CTM_TRUE;
+    aFlags &= ~_CTM_HAS_NORMALS_BIT;
+  }
+  self->mSkipUVMaps = 0;
+  if(!(self->mLoadSections & CTM_LOAD_UV_MAPS))
+  {
+    self->mSkipUVMaps = self->mUVMapCount;
+    self->mUVMapCount = 0;
+  }
+  self->mSkipAttribMaps = 0;
+  if(!(self->mLoadSections & CTM_LOAD_ATTRIB_MAPS))
+  {
+    self->mSkipAttribMaps = self->mAttribMapCount;
+    self->mAttribMapCount = 0;
+  }
 
-  // You are only allowed to load data in import mode
-  if(self->mMode != CTM_IMPORT)
+  // Allocate memory for the mesh arrays (or use caller provided buffers)
+  self->mVertices = (CTMfloat *) _ctmAllocateArray(self, _CTM_DEST_VERTICES,
+    self->mVertexCount, 3, &self->mVertexStride);
+  if(!self->mVertices)
+    return CTM_FALSE;
+  self->mIndices = (CTMuint *) _ctmAllocateArray(self, _CTM_DEST_INDICES,
+    self->mTriangleCount, 3, &self->mIndexStride);
+  if(!self->mIndices)
+    return CTM_FALSE;
+  if(aFlags & _CTM_HAS_NORMALS_BIT)
   {
-    self->mError = CTM_INVALID_OPERATION;
-    return;
+    self->mNormals = (CTMfloat *) _ctmAllocateArray(self, _CTM_DEST_NORMALS,
+      self->mVertexCount, 3, &self->mNormalStride);
+    if(!self->mNormals)
+      return CTM_FALSE;
+    if(self->mCallerArrays & (1 << _CTM_DEST_NORMALS))
+      self->mNormalFormat = self->mDest[_CTM_DEST_NORMALS].mFormat;
   }
 
-  // Initialize stream
-  self->mReadFn = aReadFn;
-  self->mUserData = aUserData;
+  // Allocate memory for the UV and attribute maps (if any)
+  if(!_ctmAllocateFloatMaps(self, &self->mUVMaps, self->mUVMapCount, 2,
+                            _CTM_DEST_UV_MAPS))
+    return CTM_FALSE;
+  if(!_ctmAllocateFloatMaps(self, &self->mAttribMaps, self->mAttribMapCount, 4,
+                            _CTM_DEST_ATTRIB_MAPS))
+    return CTM_FALSE;
 
-  // Clear any old mesh arrays
-  _ctmClearMesh(self);
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReadHeader() - Read the file header from the stream of the context. The
+// counts and the file comment are stored in the context, and the method of a
+// single mesh file in mMethod. The method id of the file (e.g. "MG2\0" or
+// "TILE") is returned in aMethod, and the mesh flags in aFlags.
+//-----------------------------------------------------------------------------
+int _ctmReadHeader(_CTMcontext * self, CTMuint * aMethod, CTMuint * aFlags)
+{
+  CTMuint formatVersion, method;
 
-  // Read header from stream
   if(_ctmStreamReadUINT(self) != FOURCC("OCTM"))
   {
     self->mError = CTM_BAD_FORMAT;
-    return;
+    return CTM_FALSE;
   }
   formatVersion = _ctmStreamReadUINT(self);
   if(formatVersion != _CTM_FORMAT_VERSION)
   {
     self->mError = CTM_UNSUPPORTED_FORMAT_VERSION;
-    return;
+    return CTM_FALSE;
   }
   method = _ctmStreamReadUINT(self);
   if(method == FOURCC("RAW\0"))
@@ -1212,84 +1843,110 @@ CTMEXPORT void CTMCALL ctmLoadCustom(CTMcontext aContext, CTMreadfn aReadFn,
     self->mMethod = CTM_METHOD_MG1;
   else if(method == FOURCC("MG2\0"))
     self->mMethod = CTM_METHOD_MG2;
-  else
+  else if(method == FOURCC("MG3\0"))
+    self->mMethod = CTM_METHOD_MG3;
+  else if(((method != FOURCC("TILE")) && (method != FOURCC("PROG"))) ||
+          self->mInSubMesh)
   {
     self->mError = CTM_BAD_FORMAT;
-    return;
+    return CTM_FALSE;
   }
   self->mVertexCount = _ctmStreamReadUINT(self);
   if(self->mVertexCount == 0)
   {
     self->mError = CTM_BAD_FORMAT;
-    return;
+    return CTM_FALSE;
   }
   self->mTriangleCount = _ctmStreamReadUINT(self);
   if(self->mTriangleCount == 0)
   {
     self->mError = CTM_BAD_FORMAT;
-    return;
+    return CTM_FALSE;
   }
   self->mUVMapCount = _ctmStreamReadUINT(self);
   self->mAttribMapCount = _ctmStreamReadUINT(self);
-  flags = _ctmStreamReadUINT(self);
-  _ctmStreamReadSTRING(self, &self->mFileComment);
+  *aFlags = _ctmStreamReadUINT(self);
 
-  // Allocate memory for the mesh arrays
-  self->mVertices = (CTMfloat *) malloc(self->mVertexCount * sizeof(CTMfloat) * 3);
-  if(!self->mVertices)
+  // A sub mesh must match the index and the header of its file
+  if(self->mInSubMesh &&
+     ((self->mVertexCount != self->mSubMeshCounts[0]) ||
+      (self->mTriangleCount != self->mSubMeshCounts[1]) ||
+      (self->mUVMapCount != self->mSubMeshCounts[2]) ||
+      (self->mAttribMapCount != self->mSubMeshCounts[3])))
   {
-    self->mError = CTM_OUT_OF_MEMORY;
-    return;
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
   }
-  self->mIndices = (CTMuint *) malloc(self->mTriangleCount * sizeof(CTMuint) * 3);
-  if(!self->mIndices)
-  {
-    _ctmClearMesh(self);
-    self->mError = CTM_OUT_OF_MEMORY;
+  _ctmStreamReadSTRING(self, &self->mFileComment);
+
+  *aMethod = method;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLoadStream() - Load a file from the stream of this context (the stream
+// has been initialized, and any old mesh cleared).
+//-----------------------------------------------------------------------------
+static void _ctmLoadStream(_CTMcontext * self)
+{
+  CTMuint flags, method;
+  CTMint tiled, progressive;
+
+  // Read header from stream
+  if(!_ctmReadHeader(self, &method, &flags))
     return;
-  }
-  if(flags & _CTM_HAS_NORMALS_BIT)
+  tiled = (method == FOURCC("TILE"));
+  progressive = (method == FOURCC("PROG"));
+
+  // Tiled file?
+  if(tiled)
   {
-    self->mNormals = (CTMfloat *) malloc(self->mVertexCount * sizeof(CTMfloat) * 3);
-    if(!self->mNormals)
+    if(!_ctmLoadTiles(self, flags))
     {
       _ctmClearMesh(self);
-      self->mError = CTM_OUT_OF_MEMORY;
       return;
     }
-  }
 
-  // Allocate memory for the UV and attribute maps (if any)
-  if(!_ctmAllocateFloatMaps(self, &self->mUVMaps, self->mUVMapCount, 2))
-  {
-    _ctmClearMesh(self);
-    self->mError = CTM_OUT_OF_MEMORY;
-    return;
+    // Only the tile index was loaded?
+    if(!self->mVertexCount)
+      return;
   }
-  if(!_ctmAllocateFloatMaps(self, &self->mAttribMaps, self->mAttribMapCount, 4))
+  else if(progressive)
   {
-    _ctmClearMesh(self);
-    self->mError = CTM_OUT_OF_MEMORY;
-    return;
+    if(!_ctmLoadLevels(self))
+    {
+      _ctmClearMesh(self);
+      return;
+    }
   }
-
-  // Uncompress from stream
-  switch(self->mMethod)
+  else
   {
-    case CTM_METHOD_RAW:
-      _ctmUncompressMesh_RAW(self);
-      break;
+    // Allocate memory for the mesh arrays (or use caller provided buffers)
+    if(!_ctmAllocateMesh(self, flags))
+    {
+      _ctmClearMesh(self);
+      return;
+    }
 
-    case CTM_METHOD_MG1:
-      _ctmUncompressMesh_MG1(self);
-      break;
+    // Uncompress from stream
+    switch(self->mMethod)
+    {
+      case CTM_METHOD_RAW:
+        _ctmUncompressMesh_RAW(self);
+        break;
 
-    case CTM_METHOD_MG2:
-      _ctmUncompressMesh_MG2(self);
-      break;
+      case CTM_METHOD_MG1:
+        _ctmUncompressMesh_MG1(self);
+        break;
 
-    default:
-      self->mError = CTM_INTERNAL_ERROR;
+      case CTM_METHOD_MG2:
+      case CTM_METHOD_MG3:
+        _ctmUncompressMesh_MG2(self);
+        break;
+
+      default:
+        self->mError = CTM_INTERNAL_ERROR;
+    }
   }
 
   // Check mesh integrity
@@ -1301,63 +1958,432 @@ CTMEXPORT void CTMCALL ctmLoadCustom(CTMcontext aContext, CTMreadfn aReadFn,
 }
 
 //-----------------------------------------------------------------------------
-// _ctmDefaultWrite()
+// ctmLoadCustom()
 //-----------------------------------------------------------------------------
-static CTMuint CTMCALL _ctmDefaultWrite(const void * aBuf, CTMuint aCount,
+CTMEXPORT void CTMCALL ctmLoadCustom(CTMcontext aContext, CTMreadfn aReadFn,
   void * aUserData)
 {
-  return (CTMuint) fwrite(aBuf, 1, (size_t) aCount, (FILE *) aUserData);
+  ctmLoadSeekable(aContext, aReadFn, (CTMseekfn) 0, aUserData);
 }
 
 //-----------------------------------------------------------------------------
-// ctmSave()
+// ctmLoadSeekable()
 //-----------------------------------------------------------------------------
-CTMEXPORT void CTMCALL ctmSave(CTMcontext aContext, const char * aFileName)
+CTMEXPORT void CTMCALL ctmLoadSeekable(CTMcontext aContext, CTMreadfn aReadFn,
+  CTMseekfn aSeekFn, void * aUserData)
 {
   _CTMcontext * self = (_CTMcontext *) aContext;
-  FILE * f;
   if(!self) return;
 
-  // You are only allowed to save data in export mode
-  if(self->mMode != CTM_EXPORT)
+  // You are only allowed to load data in import mode
+  if(self->mMode != CTM_IMPORT)
   {
     self->mError = CTM_INVALID_OPERATION;
     return;
   }
 
-  // Open file stream
-  f = fopen(aFileName, "wb");
-  if(!f)
+  // Initialize stream
+  self->mReadFn = aReadFn;
+  self->mSeekFn = aSeekFn;
+  self->mUserData = aUserData;
+  self->mStreamPos = 0;
+
+  // Clear any old mesh arrays (and the tile index and level count, unless
+  // this is a sub mesh of the file that they belong to)
+  _ctmClearMesh(self);
+  if(!self->mInSubMesh)
   {
-    self->mError = CTM_FILE_ERROR;
-    return;
+    _ctmFreeTiles(self);
+    self->mLevelCount = 0;
+    _ctmFreeProbe(self);
   }
 
-  // Save the file
-  ctmSaveCustom(self, _ctmDefaultWrite, (void *) f);
-
-  // Close file stream
-  fclose(f);
+  // Load the file (through the stream buffer)
+  if(!_ctmStreamBegin(self))
+    return;
+  _ctmLoadStream(self);
+  _ctmStreamEnd(self);
 }
 
 //-----------------------------------------------------------------------------
-// _ctmWriteToBuffer()
+// ctmLoadFromMemory()
 //-----------------------------------------------------------------------------
-
-typedef struct {
-    size_t size;
-    size_t capacity;
-    void * buffer;
-} _CTMdynbuf;
-
-static CTMuint CTMCALL _ctmWriteToBuffer(const void * aBuf, CTMuint aCount,
-  void * aUserData)
+CTMEXPORT void CTMCALL ctmLoadFromMemory(CTMcontext aContext,
+  const void * aData, size_t aSize)
 {
-  _CTMdynbuf *dynBuf = (_CTMdynbuf*)aUserData;
-  void * newBuf = NULL;
-  // if there enough space ?
-  size_t needSpace = dynBuf->size + aCount;
-  if (dynBuf->capacity < needSpace)
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to load data in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Check arguments
+  if(!aData || !aSize)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // Initialize memory stream
+  self->mMemory = (const unsigned char *) aData;
+  self->mMemorySize = aSize;
+  self->mMemoryPos = 0;
+
+  // Load the mesh (packed sections are uncompressed directly from memory)
+  ctmLoadCustom(self, (CTMreadfn) 0, (void *) 0);
+
+  // Detach the memory stream
+  self->mMemory = (const unsigned char *) 0;
+  self->mMemorySize = 0;
+  self->mMemoryPos = 0;
+}
+
+//-----------------------------------------------------------------------------
+// ctmLoadMapped()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmLoadMapped(CTMcontext aContext,
+  const char * aFileName)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  _CTMfilemap map;
+  if(!self) return;
+
+  // You are only allowed to load data in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Map the file into memory
+  if(!_ctmMapFile(aFileName, &map, &self->mAllocator))
+  {
+    self->mError = CTM_FILE_ERROR;
+    return;
+  }
+
+  // Load the file
+  ctmLoadFromMemory(self, (const void *) map.mData, map.mSize);
+
+  // Unmap the file
+  _ctmUnmapFile(&map);
+}
+
+//-----------------------------------------------------------------------------
+// ctmProbe()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmProbe(CTMcontext aContext, const char * aFileName)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to probe files in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Clear any old mesh arrays, tile index, level count and probed file
+  _ctmClearMesh(self);
+  _ctmFreeTiles(self);
+  self->mLevelCount = 0;
+  _ctmFreeProbe(self);
+
+  // Map the file into memory (it stays mapped until the section directory
+  // has been read, or the context is used for something else)
+  if(!_ctmMapFile(aFileName, &self->mProbeMap, &self->mAllocator))
+  {
+    self->mError = CTM_FILE_ERROR;
+    return;
+  }
+
+  // Read the header information (only the pages that hold it are touched)
+  self->mMemory = self->mProbeMap.mData;
+  self->mMemorySize = self->mProbeMap.mSize;
+  self->mMemoryPos = 0;
+  self->mProbed = _ctmProbeFile(self);
+  self->mMemory = (const unsigned char *) 0;
+  self->mMemorySize = 0;
+  self->mMemoryPos = 0;
+
+  if(!self->mProbed)
+  {
+    _ctmClearMesh(self);
+    _ctmFreeTiles(self);
+    self->mLevelCount = 0;
+    _ctmFreeProbe(self);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// ctmLoadInto()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmLoadInto(CTMcontext aContext, CTMenum aArray,
+  void * aBuffer, CTMuint aCapacity, CTMuint aStride)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  CTMuint dest, size;
+  if(!self) return;
+
+  // You are only allowed to set destination buffers in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Which array?
+  if(!_ctmGetDestSlot(aArray, &dest, &size))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // The stride must be a whole number of 32-bit words, and elements must not
+  // overlap
+  if((aStride & 3) || (aStride && (aStride < size * 4)))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  self->mDest[dest].mBuffer = aBuffer;
+  self->mDest[dest].mCapacity = aBuffer ? aCapacity : 0;
+  self->mDest[dest].mStride = aBuffer ? aStride / 4 : 0;
+  self->mDest[dest].mFormat = CTM_FORMAT_FLOAT32;
+}
+
+//-----------------------------------------------------------------------------
+// ctmVertexLayout()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmVertexLayout(CTMcontext aContext, void * aBuffer,
+  CTMuint aCapacity, CTMuint aStride)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  CTMuint i;
+  if(!self) return;
+
+  // You are only allowed to set destination buffers in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // The stride must be a non-zero, whole number of 32-bit words
+  if(aBuffer && ((aStride == 0) || (aStride & 3)))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // The layout replaces any previous per-vertex destination buffers
+  for(i = _CTM_DEST_VERTICES; i < _CTM_DEST_COUNT; ++ i)
+  {
+    self->mDest[i].mBuffer = (void *) 0;
+    self->mDest[i].mCapacity = 0;
+    self->mDest[i].mStride = 0;
+    self->mDest[i].mFormat = CTM_FORMAT_FLOAT32;
+  }
+
+  self->mLayoutBuffer = (unsigned char *) aBuffer;
+  self->mLayoutCapacity = aBuffer ? aCapacity : 0;
+  self->mLayoutStride = aBuffer ? aStride : 0;
+}
+
+//-----------------------------------------------------------------------------
+// ctmVertexLayoutArray()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmVertexLayoutArray(CTMcontext aContext,
+  CTMenum aArray, CTMuint aOffset, CTMenum aFormat)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  CTMuint dest, size, bytes;
+  if(!self) return;
+
+  // You are only allowed to set destination buffers in import mode, and only
+  // after a vertex layout has been defined
+  if((self->mMode != CTM_IMPORT) || !self->mLayoutBuffer)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Which array? (only per-vertex arrays are allowed)
+  if(!_ctmGetDestSlot(aArray, &dest, &size) || (dest == _CTM_DEST_INDICES))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  // Check the element format (16-bit formats are only supported for normals),
+  // and the alignment of the element within the vertex
+  switch(aFormat)
+  {
+    case CTM_FORMAT_FLOAT32:
+      bytes = size * 4;
+      if(aOffset & 3)
+      {
+        self->mError = CTM_INVALID_ARGUMENT;
+        return;
+      }
+      break;
+
+    case CTM_FORMAT_FLOAT16:
+    case CTM_FORMAT_SNORM16:
+      bytes = size * 2;
+      if((dest != _CTM_DEST_NORMALS) || (aOffset & 1))
+      {
+        self->mError = CTM_INVALID_ARGUMENT;
+        return;
+      }
+      break;
+
+    default:
+      self->mError = CTM_INVALID_ARGUMENT;
+      return;
+  }
+
+  // The element must fit within the vertex
+  if((aOffset > self->mLayoutStride) ||
+     (bytes > self->mLayoutStride - aOffset))
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  self->mDest[dest].mBuffer = (void *) (self->mLayoutBuffer + aOffset);
+  self->mDest[dest].mCapacity = self->mLayoutCapacity;
+  self->mDest[dest].mStride = self->mLayoutStride / 4;
+  self->mDest[dest].mFormat = aFormat;
+}
+
+//-----------------------------------------------------------------------------
+// ctmSelectTile()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmSelectTile(CTMcontext aContext, CTMuint aTile)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to select tiles in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  self->mTileSelect = aTile;
+}
+
+//-----------------------------------------------------------------------------
+// ctmLevelCallback()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmLevelCallback(CTMcontext aContext,
+  CTMlevelfn aCallback, void * aUserData)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to set the level callback in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  self->mLevelFn = aCallback;
+  self->mLevelUserData = aUserData;
+}
+
+//-----------------------------------------------------------------------------
+// ctmLoadSections()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmLoadSections(CTMcontext aContext, CTMuint aSections)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to select sections in import mode
+  if(self->mMode != CTM_IMPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Check arguments
+  if(aSections & ~CTM_LOAD_ALL)
+  {
+    self->mError = CTM_INVALID_ARGUMENT;
+    return;
+  }
+
+  self->mLoadSections = aSections;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmDefaultWrite()
+//-----------------------------------------------------------------------------
+static CTMuint CTMCALL _ctmDefaultWrite(const void * aBuf, CTMuint aCount,
+  void * aUserData)
+{
+  return (CTMuint) fwrite(aBuf, 1, (size_t) aCount, (FILE *) aUserData);
+}
+
+//-----------------------------------------------------------------------------
+// ctmSave()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmSave(CTMcontext aContext, const char * aFileName)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  FILE * f;
+  if(!self) return;
+
+  // You are only allowed to save data in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Open file stream
+  f = fopen(aFileName, "wb");
+  if(!f)
+  {
+    self->mError = CTM_FILE_ERROR;
+    return;
+  }
+
+  // Save the file
+  ctmSaveCustom(self, _ctmDefaultWrite, (void *) f);
+
+  // Close file stream
+  fclose(f);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWriteToBuffer()
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    size_t size;
+    size_t capacity;
+    void * buffer;
+} _CTMdynbuf;
+
+static CTMuint CTMCALL _ctmWriteToBuffer(const void * aBuf, CTMuint aCount,
+  void * aUserData)
+{
+  _CTMdynbuf *dynBuf = (_CTMdynbuf*)aUserData;
+  void * newBuf = NULL;
+  // if there enough space ?
+  size_t needSpace = dynBuf->size + aCount;
+  if (dynBuf->capacity < needSpace)
   {
     // create new buffer twice as big as required
     size_t newSize = dynBuf->capacity * 2;
@@ -1409,32 +2435,12 @@ CTMEXPORT void CTMCALL ctmFreeBuffer(void *buffer)
 }
 
 //-----------------------------------------------------------------------------
-// ctmSaveCustom()
+// _ctmSaveMesh() - Save a single (non-tiled, non-progressive) mesh to the
+// stream.
 //-----------------------------------------------------------------------------
-void CTMCALL ctmSaveCustom(CTMcontext aContext, CTMwritefn aWriteFn,
-  void * aUserData)
+int _ctmSaveMesh(_CTMcontext * self)
 {
-  _CTMcontext * self = (_CTMcontext *) aContext;
   CTMuint flags;
-  if(!self) return;
-
-  // You are only allowed to save data in export mode
-  if(self->mMode != CTM_EXPORT)
-  {
-    self->mError = CTM_INVALID_OPERATION;
-    return;
-  }
-
-  // Check mesh integrity
-  if(!_ctmCheckMeshIntegrity(self))
-  {
-    self->mError = CTM_INVALID_MESH;
-    return;
-  }
-
-  // Initialize stream
-  self->mWriteFn = aWriteFn;
-  self->mUserData = aUserData;
 
   // Determine flags
   flags = 0;
@@ -1458,9 +2464,13 @@ void CTMCALL ctmSaveCustom(CTMcontext aContext, CTMwritefn aWriteFn,
       _ctmStreamWrite(self, (void *) "MG2\0", 4);
       break;
 
+    case CTM_METHOD_MG3:
+      _ctmStreamWrite(self, (void *) "MG3\0", 4);
+      break;
+
     default:
       self->mError = CTM_INTERNAL_ERROR;
-      return;
+      return CTM_FALSE;
   }
   _ctmStreamWriteUINT(self, self->mVertexCount);
   _ctmStreamWriteUINT(self, self->mTriangleCount);
@@ -1473,19 +2483,118 @@ void CTMCALL ctmSaveCustom(CTMcontext aContext, CTMwritefn aWriteFn,
   switch(self->mMethod)
   {
     case CTM_METHOD_RAW:
-      _ctmCompressMesh_RAW(self);
-      break;
+      return _ctmCompressMesh_RAW(self);
 
     case CTM_METHOD_MG1:
-      _ctmCompressMesh_MG1(self);
-      break;
+      return _ctmCompressMesh_MG1(self);
 
     case CTM_METHOD_MG2:
-      _ctmCompressMesh_MG2(self);
-      break;
+    case CTM_METHOD_MG3:
+      return _ctmCompressMesh_MG2(self);
 
     default:
       self->mError = CTM_INTERNAL_ERROR;
+      return CTM_FALSE;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// ctmSaveCustom()
+//-----------------------------------------------------------------------------
+void CTMCALL ctmSaveCustom(CTMcontext aContext, CTMwritefn aWriteFn,
+  void * aUserData)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  int result;
+  if(!self) return;
+
+  // You are only allowed to save data in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // A mesh that is saved in parts ends with the current mesh (if any)
+  if((self->mChunks.mCount > 0) && self->mVertices)
+  {
+    if(!_ctmCheckMeshIntegrity(self))
+    {
+      self->mError = CTM_INVALID_MESH;
+      return;
+    }
+    if(!_ctmAddChunk(self))
       return;
+    _ctmClearMesh(self);
   }
+
+  // Check mesh integrity
+  if((self->mChunks.mCount == 0) && !_ctmCheckMeshIntegrity(self))
+  {
+    self->mError = CTM_INVALID_MESH;
+    return;
+  }
+
+  // Initialize stream
+  self->mWriteFn = aWriteFn;
+  self->mUserData = aUserData;
+  self->mStreamPos = 0;
+  if(!_ctmStreamBegin(self))
+    return;
+
+  // Collect the sections as they are written, if a directory was requested
+  if(self->mSaveSections && !_ctmBeginSections(self))
+  {
+    _ctmStreamEnd(self);
+    return;
+  }
+
+  // Mesh saved in parts, tiled file, progressive file or single mesh?
+  if(self->mChunks.mCount > 0)
+  {
+    result = _ctmSaveChunks(self);
+    _ctmFreeChunks(self);
+  }
+  else if(self->mTileGrid[0] * self->mTileGrid[1] * self->mTileGrid[2] > 1)
+    result = _ctmSaveTiles(self);
+  else if(self->mProgressiveLevels > 0)
+    result = _ctmSaveLevels(self);
+  else
+    result = _ctmSaveMesh(self);
+
+  // Append the section directory (and free it)
+  if(result && self->mSections)
+    _ctmWriteSections(self);
+  _ctmFreeProbe(self);
+
+  // Write what is left in the stream buffer
+  _ctmStreamEnd(self);
+}
+
+//-----------------------------------------------------------------------------
+// ctmAddChunk()
+//-----------------------------------------------------------------------------
+CTMEXPORT void CTMCALL ctmAddChunk(CTMcontext aContext)
+{
+  _CTMcontext * self = (_CTMcontext *) aContext;
+  if(!self) return;
+
+  // You are only allowed to save data in export mode
+  if(self->mMode != CTM_EXPORT)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return;
+  }
+
+  // Check mesh integrity
+  if(!_ctmCheckMeshIntegrity(self))
+  {
+    self->mError = CTM_INVALID_MESH;
+    return;
+  }
+
+  // Save the mesh as the next chunk, and forget it (the caller may reuse or
+  // free its arrays)
+  if(_ctmAddChunk(self))
+    _ctmClearMesh(self);
 }
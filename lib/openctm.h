@@ -174,6 +174,24 @@ extern "C" {
 /// Boolean FALSE.
 #define CTM_FALSE 0
 
+/// Tile selection for ctmSelectTile(): load all the tiles as one mesh.
+#define CTM_ALL_TILES 0xffffffff
+
+/// Tile selection for ctmSelectTile(): only load the tile index.
+#define CTM_TILE_INDEX 0xfffffffe
+
+/// Section selection for ctmLoadSections(): load the normals.
+#define CTM_LOAD_NORMALS 0x00000001
+
+/// Section selection for ctmLoadSections(): load the UV maps.
+#define CTM_LOAD_UV_MAPS 0x00000002
+
+/// Section selection for ctmLoadSections(): load the attribute maps.
+#define CTM_LOAD_ATTRIB_MAPS 0x00000004
+
+/// Section selection for ctmLoadSections(): load all the sections (default).
+#define CTM_LOAD_ALL 0x00000007
+
 /// Single precision floating point type (IEEE 754 32 bits wide).
 typedef float CTMfloat;
 
@@ -215,6 +233,7 @@ typedef enum {
   CTM_METHOD_RAW        = 0x0201, ///< Just store the raw data.
   CTM_METHOD_MG1        = 0x0202, ///< Lossless compression (floating point).
   CTM_METHOD_MG2        = 0x0203, ///< Lossless compression (fixed point).
+  CTM_METHOD_MG3        = 0x0204, ///< Fast decompression (fixed point, like MG2).
 
   // Context queries
   CTM_VERTEX_COUNT      = 0x0301, ///< Number of vertices in the mesh (integer).
@@ -226,6 +245,11 @@ typedef enum {
   CTM_NORMAL_PRECISION  = 0x0307, ///< Normal precision - for MG2 (float).
   CTM_COMPRESSION_METHOD = 0x0308, ///< Compression method (integer).
   CTM_FILE_COMMENT      = 0x0309, ///< File comment (string).
+  CTM_THREAD_COUNT      = 0x030A, ///< Number of threads used for (de)compression (integer).
+  CTM_TILE_COUNT        = 0x030B, ///< Number of tiles in a tiled file (integer).
+  CTM_LEVEL_COUNT       = 0x030C, ///< Number of levels in a progressive file (integer).
+  CTM_SCRATCH_PEAK      = 0x030D, ///< Largest scratch memory need so far, in bytes (integer).
+  CTM_SECTION_COUNT     = 0x030E, ///< Number of sections in a probed file (integer).
 
   // UV/attribute map queries
   CTM_NAME              = 0x0501, ///< Unique name (UV/attrib map string).
@@ -251,7 +275,32 @@ typedef enum {
   CTM_ATTRIB_MAP_5      = 0x0804, ///< Per vertex attribute map 5 (float array).
   CTM_ATTRIB_MAP_6      = 0x0805, ///< Per vertex attribute map 6 (float array).
   CTM_ATTRIB_MAP_7      = 0x0806, ///< Per vertex attribute map 7 (float array).
-  CTM_ATTRIB_MAP_8      = 0x0807  ///< Per vertex attribute map 8 (float array).
+  CTM_ATTRIB_MAP_8      = 0x0807, ///< Per vertex attribute map 8 (float array).
+
+  // Array element formats (see ctmVertexLayoutArray())
+  CTM_FORMAT_FLOAT32    = 0x0901, ///< 32-bit floats.
+  CTM_FORMAT_FLOAT16    = 0x0902, ///< 16-bit (half precision) floats.
+  CTM_FORMAT_SNORM16    = 0x0903, ///< 16-bit signed normalized integers.
+
+  // LZMA encoder parameters (see ctmCompressionParameter())
+  CTM_LZMA_DICT_SIZE    = 0x0A01, ///< Dictionary size in bytes (4 KB - 128 MB).
+  CTM_LZMA_LITERAL_CONTEXT_BITS = 0x0A02, ///< Literal context bits (0-8).
+  CTM_LZMA_LITERAL_POS_BITS = 0x0A03, ///< Literal position bits (0-4).
+  CTM_LZMA_POS_BITS     = 0x0A04, ///< Position bits (0-4).
+  CTM_LZMA_FAST_BYTES   = 0x0A05, ///< Number of fast bytes (5-273).
+  CTM_LZMA_MATCH_FINDER = 0x0A06, ///< Match finder (0 = hash chain, 1 = binary tree).
+
+  // Array codings (see ctmCompressionCoding())
+  CTM_CODING_DELTA      = 0x0B01, ///< Deltas between sorted elements (default).
+  CTM_CODING_CONNECTIVITY = 0x0B02, ///< Mesh traversal (MG2/MG3 triangle indices).
+  CTM_CODING_PARALLELOGRAM = 0x0B03, ///< Parallelogram prediction (MG2/MG3 vertices).
+  CTM_CODING_OCTAHEDRAL = 0x0B04, ///< Octahedral mapping (MG2/MG3 normals).
+
+  // Section properties (see ctmGetSectionInteger())
+  CTM_SECTION_ID        = 0x0C01, ///< Four character code of the section, e.g. "VERT" (integer).
+  CTM_SECTION_OFFSET    = 0x0C02, ///< Offset of the section in the file, in bytes (integer).
+  CTM_SECTION_SIZE      = 0x0C03, ///< Stored size of the section, in bytes (integer).
+  CTM_SECTION_UNPACKED_SIZE = 0x0C04 ///< Size of the section data array when uncompressed, in bytes (integer).
 } CTMenum;
 
 /// Stream read() function pointer.
@@ -273,6 +322,44 @@ typedef CTMuint (CTMCALL * CTMreadfn)(void * aBuf, CTMuint aCount, void * aUserD
 ///         indicates that an error occured).
 typedef CTMuint (CTMCALL * CTMwritefn)(const void * aBuf, CTMuint aCount, void * aUserData);
 
+/// Stream seek() function pointer.
+/// @param[in] aOffset The new stream position, in bytes from the start of the
+///            file.
+/// @param[in] aUserData The custom user data that was passed to the
+///            ctmLoadSeekable() function.
+/// @return CTM_TRUE if the stream was moved to the new position, or CTM_FALSE
+///         if it could not be moved (the stream position must then be left
+///         unchanged, and the data is read instead).
+typedef CTMint (CTMCALL * CTMseekfn)(size_t aOffset, void * aUserData);
+
+/// Level callback function pointer (see ctmLevelCallback()). It is called
+/// each time a level of a progressive file has been loaded, and the level
+/// mesh can then be read from the context with the usual query functions.
+/// @param[in] aContext The OpenCTM context that is loading the file.
+/// @param[in] aLevel The level that was loaded (0 is the coarsest level, and
+///            aLevelCount - 1 is the full resolution mesh).
+/// @param[in] aLevelCount The number of levels in the file.
+/// @param[in] aUserData The custom user data that was passed to the
+///            ctmLevelCallback() function.
+/// @return CTM_TRUE to continue loading, or CTM_FALSE to stop loading (the
+///         level that was just loaded is then the loaded mesh).
+typedef CTMint (CTMCALL * CTMlevelfn)(CTMcontext aContext, CTMuint aLevel, CTMuint aLevelCount, void * aUserData);
+
+/// Memory allocation function pointer (see ctmSetAllocator()).
+/// @param[in] aSize The number of bytes to allocate.
+/// @param[in] aUserData The custom user data that was passed to the
+///            ctmSetAllocator() function.
+/// @return A pointer to the allocated memory (aligned as by malloc()), or NULL
+///         if the memory could not be allocated.
+typedef void * (CTMCALL * CTMallocfn)(size_t aSize, void * aUserData);
+
+/// Memory free function pointer (see ctmSetAllocator()).
+/// @param[in] aPtr A pointer to memory that was returned by the corresponding
+///            CTMallocfn function (never NULL).
+/// @param[in] aUserData The custom user data that was passed to the
+///            ctmSetAllocator() function.
+typedef void (CTMCALL * CTMfreefn)(void * aPtr, void * aUserData);
+
 /// Create a new OpenCTM context. The context is used for all subsequent
 /// OpenCTM function calls. Several contexts can coexist at the same time.
 /// @param[in] aMode An OpenCTM context mode. Set this to CTM_IMPORT if the
@@ -450,28 +537,206 @@ CTMEXPORT CTMfloat CTMCALL ctmGetAttribMapFloat(CTMcontext aContext,
 CTMEXPORT const char * CTMCALL ctmGetString(CTMcontext aContext,
   CTMenum aProperty);
 
+/// Get information about one tile of a tiled file (see ctmTileGrid()). The
+/// tile index is available after any load of a tiled file, regardless of
+/// which tiles were selected with ctmSelectTile().
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aTile The tile number (0 to CTM_TILE_COUNT - 1).
+/// @param[in] aProperty Which tile property to return (CTM_VERTEX_COUNT or
+///            CTM_TRIANGLE_COUNT).
+/// @return An integer value, representing the tile property given by
+///         \c aProperty.
+CTMEXPORT CTMuint CTMCALL ctmGetTileInteger(CTMcontext aContext, CTMuint aTile,
+  CTMenum aProperty);
+
+/// Get the bounding box of the vertices of one tile of a tiled file. For the
+/// MG2 and MG3 methods, the box is extended by the vertex precision, so that
+/// it holds the loaded (rounded) vertices.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aTile The tile number (0 to CTM_TILE_COUNT - 1).
+/// @param[out] aMin The smallest x, y and z coordinates (three floats).
+/// @param[out] aMax The largest x, y and z coordinates (three floats).
+/// @see ctmGetTileInteger().
+CTMEXPORT void CTMCALL ctmGetTileBoundingBox(CTMcontext aContext,
+  CTMuint aTile, CTMfloat * aMin, CTMfloat * aMax);
+
+/// Get information about one section of a file that was probed with
+/// ctmProbe(). The sections are listed in file order, starting with the
+/// first section after the file header: for MG2 and MG3 files the MG2 header
+/// ("MG2H" or "MG2X"), followed by the mesh arrays ("VERT", "GIDX", "INDX",
+/// "NORM", "TEXC" and "ATTR"), and for tiled and progressive files the index
+/// ("TIDX" or "LIDX"), followed by one "OCTM" section per tile or level.
+/// The section directory is read the first time that it is asked for (which
+/// is also when CTM_SECTION_COUNT is read with ctmGetInteger()).
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aSection The section number (0 to CTM_SECTION_COUNT - 1).
+/// @param[in] aProperty Which section property to return (CTM_SECTION_ID,
+///            CTM_SECTION_OFFSET, CTM_SECTION_SIZE or
+///            CTM_SECTION_UNPACKED_SIZE).
+/// @return An integer value, representing the section property given by
+///         \c aProperty. Section ids are four character codes with the first
+///         character in the lowest byte (as they are stored in the file).
+///         The unpacked size is zero for sections without a mesh array.
+CTMEXPORT CTMuint CTMCALL ctmGetSectionInteger(CTMcontext aContext,
+  CTMuint aSection, CTMenum aProperty);
+
 /// Set which compression method to use for the given OpenCTM context.
 /// The selected compression method will be used when calling the ctmSave()
 /// function.
 /// @param[in] aContext An OpenCTM context that has been created by
 ///            ctmNewContext().
 /// @param[in] aMethod Which compression method to use: CTM_METHOD_RAW,
-///            CTM_METHOD_MG1 or CTM_METHOD_MG2 (the default method is
-///            CTM_METHOD_MG1).
-/// @see CTM_METHOD_RAW, CTM_METHOD_MG1, CTM_METHOD_MG2
+///            CTM_METHOD_MG1, CTM_METHOD_MG2 or CTM_METHOD_MG3 (the default
+///            method is CTM_METHOD_MG1).
+/// @note CTM_METHOD_MG3 stores the same data as CTM_METHOD_MG2, but packs it
+///       with a fast LZ coder instead of LZMA. The files are somewhat larger,
+///       but they load several times faster.
+/// @see CTM_METHOD_RAW, CTM_METHOD_MG1, CTM_METHOD_MG2, CTM_METHOD_MG3
 CTMEXPORT void CTMCALL ctmCompressionMethod(CTMcontext aContext,
   CTMenum aMethod);
 
 /// Set which LZMA compression level to use for the given OpenCTM context.
 /// The compression level can be between 0 (fastest) and 9 (best). The higher
 /// the compression level, the more memory is required for compression and
-/// decompression. The default compression level is 1.
+/// decompression. The default compression level is 1. For the MG3 method, the
+/// level controls how hard the LZ coder searches for matches.
 /// @param[in] aContext An OpenCTM context that has been created by
 ///            ctmNewContext().
 /// @param[in] aLevel Which compression level to use (0 to 9).
 CTMEXPORT void CTMCALL ctmCompressionLevel(CTMcontext aContext,
   CTMuint aLevel);
 
+/// Fine tune the LZMA encoder for one type of data section (for MG1 and MG2
+/// compression). By default, all encoder parameters are given by the
+/// compression level (see ctmCompressionLevel()), but since the different
+/// sections of a file (e.g. triangle indices and vertex coordinates) compress
+/// quite differently, it can pay off to tune them individually. The
+/// parameters only affect compression: any file can be read regardless of the
+/// parameters that were used when it was saved.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aSection Which section to tune: CTM_INDICES, CTM_VERTICES
+///            (including the MG2 grid indices), CTM_NORMALS,
+///            CTM_UV_MAP_1..CTM_UV_MAP_8, CTM_ATTRIB_MAP_1..CTM_ATTRIB_MAP_8,
+///            or CTM_NONE for all sections.
+/// @param[in] aParameter Which parameter to set: CTM_LZMA_DICT_SIZE,
+///            CTM_LZMA_LITERAL_CONTEXT_BITS, CTM_LZMA_LITERAL_POS_BITS,
+///            CTM_LZMA_POS_BITS, CTM_LZMA_FAST_BYTES or
+///            CTM_LZMA_MATCH_FINDER.
+/// @param[in] aValue The new parameter value, or -1 to go back to the value
+///            that is given by the compression level.
+/// @note MG3 ignores these parameters.
+CTMEXPORT void CTMCALL ctmCompressionParameter(CTMcontext aContext,
+  CTMenum aSection, CTMenum aParameter, CTMint aValue);
+
+/// Select how a mesh array is coded by the MG2 and MG3 compression methods
+/// (the setting is ignored by the other methods). With
+/// CTM_CODING_CONNECTIVITY, the triangle indices are coded while walking from
+/// triangle to triangle over shared edges, so that most triangles only need a
+/// small code for their third vertex. The vertices are then stored in the
+/// order in which the walk reaches them. This makes the triangle index
+/// section several times smaller for well connected meshes, but files that
+/// use it can not be read by older versions of OpenCTM.
+///
+/// With CTM_CODING_PARALLELOGRAM, each vertex is predicted from the triangle
+/// on the other side of the edge over which the walk reaches it (the fourth
+/// corner of the parallelogram), and only the prediction error is stored.
+/// This implies CTM_CODING_CONNECTIVITY for the triangle indices.
+///
+/// With CTM_CODING_OCTAHEDRAL, each normal is mapped onto an octahedron that
+/// is turned towards the smooth normal of the vertex, instead of being stored
+/// as two angles. The angular precision is about the same, but the normals
+/// can be restored much faster when loading the file.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aArray Which array: CTM_INDICES, CTM_VERTICES or CTM_NORMALS.
+/// @param[in] aCoding CTM_CODING_DELTA (the default) or
+///            CTM_CODING_CONNECTIVITY for CTM_INDICES, CTM_CODING_DELTA
+///            (the default) or CTM_CODING_PARALLELOGRAM for CTM_VERTICES, and
+///            CTM_CODING_DELTA (the default) or CTM_CODING_OCTAHEDRAL for
+///            CTM_NORMALS.
+CTMEXPORT void CTMCALL ctmCompressionCoding(CTMcontext aContext,
+  CTMenum aArray, CTMenum aCoding);
+
+/// Set the number of threads that may be used for compressing and
+/// decompressing mesh data. With more than one thread, the independent data
+/// sections of the mesh (vertices, indices, normals, UV maps etc) are
+/// compressed concurrently when saving, and uncompressed concurrently when
+/// loading (MG1, MG2 and MG3). If the library is built with the OPENCTM_LZMA_MT
+/// option, large data sections are also given a separate LZMA match finder
+/// thread. The file contents are identical regardless of the
+/// number of threads. Note that the memory usage increases with the
+/// number of threads, especially for high compression levels.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aCount The maximum number of threads to use (1 to 64), or 0
+///            to use one thread per available processor. The default
+///            thread count is 1.
+CTMEXPORT void CTMCALL ctmThreadCount(CTMcontext aContext, CTMuint aCount);
+
+/// Reserve scratch memory for the temporary arrays that are needed while
+/// saving and loading meshes (sort orders, integer versions of the mesh
+/// arrays, compression buffers, LZMA state etc). The memory is kept by the
+/// context until it is freed, so that a context that is used for saving or
+/// loading many meshes does not need to allocate and free these arrays
+/// every time. Temporary arrays that do not fit in the reserved memory are
+/// allocated on the heap, as usual.
+///
+/// The scratch memory that would have been needed for avoiding heap
+/// allocations so far can be queried with ctmGetInteger(CTM_SCRATCH_PEAK),
+/// e.g. after saving or loading a typical mesh (since the arrays are not
+/// always freed in reverse order, a somewhat larger size may be needed).
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aSize The number of bytes to reserve (any previously reserved
+///            memory is freed first), or zero for no reserved memory (the
+///            default).
+CTMEXPORT void CTMCALL ctmScratchMemory(CTMcontext aContext, CTMuint aSize);
+
+/// Set the memory allocation functions of a context. All memory that the
+/// context allocates from then on (mesh arrays, UV and attribute maps,
+/// strings, chunks that are added with ctmAddChunk(), scratch memory and the
+/// temporary arrays of ctmSave()/ctmLoad(), including the LZMA encoder and
+/// decoder state) is allocated and freed with these functions instead of
+/// malloc() and free(). The functions may be called from several threads at
+/// the same time (see ctmThreadCount()).
+///
+/// The allocator must be set before the context has allocated any memory,
+/// i.e. directly after ctmNewContext(). The context structures themselves
+/// (including the internal contexts that are used for the tiles and levels
+/// of tiled and progressive files), and the buffer that is returned by
+/// ctmSaveToBuffer(), are always allocated with malloc().
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aAllocFn The allocation function, or NULL for malloc().
+/// @param[in] aFreeFn The free function, or NULL for free() (either both or
+///            none of the functions must be given).
+/// @param[in] aUserData A custom user data pointer that will be passed to the
+///            functions.
+/// @see CTMallocfn, CTMfreefn.
+CTMEXPORT void CTMCALL ctmSetAllocator(CTMcontext aContext,
+  CTMallocfn aAllocFn, CTMfreefn aFreeFn, void * aUserData);
+
+/// Set the size of the stream buffer. Files that are loaded or saved through
+/// a read() or write() function (including ctmLoad() and ctmSave()) are read
+/// ahead or written in blocks of this size, so that the function is called
+/// once per block instead of once per value.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aSize The size of the buffer in bytes, or zero for no buffer
+///            (every read or write is passed on to the stream function). The
+///            default size is 65536 bytes.
+/// @note When loading, up to \c aSize bytes after the end of the file may be
+///       read from the stream. If the stream can seek (ctmLoad() and
+///       ctmLoadSeekable()), it is moved back to the end of the file when
+///       loading is done. Loads from a stream that can not seek
+///       (ctmLoadCustom()) are therefore not buffered, unless a buffer size
+///       has been set with this function.
+CTMEXPORT void CTMCALL ctmStreamBuffer(CTMcontext aContext, CTMuint aSize);
+
 /// Set the vertex coordinate precision (only used by the MG2 compression
 /// method).
 /// @param[in] aContext An OpenCTM context that has been created by
@@ -545,6 +810,51 @@ CTMEXPORT void CTMCALL ctmAttribPrecision(CTMcontext aContext,
 CTMEXPORT void CTMCALL ctmFileComment(CTMcontext aContext,
   const char * aFileComment);
 
+/// Split the mesh into spatial tiles when it is saved. The bounding box of
+/// the mesh is divided into a grid of equally sized cells, and each triangle
+/// goes to the tile of the cell that holds its center. Every tile is then
+/// stored as a separate mesh (compressed with the selected method), and the
+/// file starts with an index of all the tiles. This lets readers load one
+/// tile at a time, or only the tiles they need (see ctmSelectTile()).
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aX The number of grid cells along the x axis (1 - 256).
+/// @param[in] aY The number of grid cells along the y axis (1 - 256).
+/// @param[in] aZ The number of grid cells along the z axis (1 - 256).
+/// @note The default grid is 1 x 1 x 1, which gives an ordinary (untiled)
+///       file. Empty cells are not stored, and the vertices that are shared
+///       by triangles in different tiles are stored once in each tile.
+CTMEXPORT void CTMCALL ctmTileGrid(CTMcontext aContext, CTMuint aX,
+  CTMuint aY, CTMuint aZ);
+
+/// Append a section directory to the file when it is saved. The directory
+/// lists the offset and size of every section of the file, so that readers
+/// can find the sections they need without walking the whole file (see
+/// ctmProbe()). Readers that do not know about the directory ignore it.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aEnable CTM_TRUE to write the section directory, or CTM_FALSE
+///            to leave it out (default).
+/// @note The directory is left out of files that are larger than 4 GB.
+CTMEXPORT void CTMCALL ctmSectionDirectory(CTMcontext aContext,
+  CTMint aEnable);
+
+/// Save the mesh as a progressive file, where the full resolution mesh is
+/// preceded by coarser versions of itself (levels). Each level has at most an
+/// eighth of the vertices of the next level, and is made by merging nearby
+/// vertices (vertex clustering). Readers can show the coarse levels while the
+/// rest of the file is loaded (see ctmLevelCallback()).
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aLevels The maximum number of coarse levels (0 - 16).
+/// @note The default is 0, which gives an ordinary (non-progressive) file.
+///       Fewer levels are stored if the mesh is too small to be reduced
+///       further. The coarse levels are stored in addition to the full mesh,
+///       which makes the file somewhat larger (usually by less than a third).
+/// @note Progressive levels are not used for tiled files (see ctmTileGrid()).
+CTMEXPORT void CTMCALL ctmProgressiveLevels(CTMcontext aContext,
+  CTMuint aLevels);
+
 /// Define a triangle mesh.
 /// @param[in] aContext An OpenCTM context that has been created by
 ///            ctmNewContext().
@@ -623,6 +933,192 @@ CTMEXPORT void CTMCALL ctmLoad(CTMcontext aContext, const char * aFileName);
 CTMEXPORT void CTMCALL ctmLoadCustom(CTMcontext aContext, CTMreadfn aReadFn,
   void * aUserData);
 
+/// Load an OpenCTM format file using custom stream read and seek functions.
+/// This works like ctmLoadCustom(), but sections that are not loaded (see
+/// ctmSelectTile() and ctmLoadSections()) are skipped with the seek function
+/// instead of being read.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aReadFn Pointer to a custom stream read function.
+/// @param[in] aSeekFn Pointer to a custom stream seek function (or NULL, in
+///            which case this is the same as ctmLoadCustom()).
+/// @param[in] aUserData Custom user data, which will be passed to the custom
+///            stream read and seek functions.
+/// @see CTMreadfn, CTMseekfn.
+CTMEXPORT void CTMCALL ctmLoadSeekable(CTMcontext aContext, CTMreadfn aReadFn,
+  CTMseekfn aSeekFn, void * aUserData);
+
+/// Load an OpenCTM format file from a memory buffer. The compressed data is
+/// uncompressed directly from the buffer (no intermediate copies are made).
+/// The mesh data can be retrieved with the various ctmGet functions.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aData Pointer to the OpenCTM file data.
+/// @param[in] aSize Size of the file data (in bytes).
+/// @note The buffer is only accessed during the call, and may be released
+///       when the function returns.
+CTMEXPORT void CTMCALL ctmLoadFromMemory(CTMcontext aContext,
+  const void * aData, size_t aSize);
+
+/// Load an OpenCTM format file by mapping it into memory (where supported by
+/// the system), and uncompressing the data directly from the mapped file. The
+/// mesh data can be retrieved with the various ctmGet functions.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext().
+/// @param[in] aFileName The name of the file to be loaded.
+/// @see ctmLoadFromMemory().
+CTMEXPORT void CTMCALL ctmLoadMapped(CTMcontext aContext,
+  const char * aFileName);
+
+/// Read the header information of an OpenCTM format file, without loading
+/// or uncompressing any mesh data. The file is mapped into memory (where
+/// supported by the system), and only the file header, the tile or level
+/// index, the MG2 header and the UV/attribute map descriptors are read.
+/// After the call, the counts, the compression method, the precisions, the
+/// file comment, the map names, file names and precisions, and the tile and
+/// level information can be retrieved with the various ctmGet functions, but
+/// no mesh arrays are available. The sizes of the sections of the file can be
+/// retrieved with ctmGetSectionInteger().
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aFileName The name of the file to be probed.
+/// @note For tiled and progressive files, the method, the precisions and the
+///       maps are those of the first tile and the full resolution level,
+///       respectively.
+/// @note The file stays mapped until the section directory has been read
+///       with ctmGetSectionInteger() (or CTM_SECTION_COUNT), or until the
+///       context is freed or used for loading or probing another file.
+CTMEXPORT void CTMCALL ctmProbe(CTMcontext aContext, const char * aFileName);
+
+/// Set a caller provided destination buffer for one of the mesh arrays. When
+/// a file is loaded (with any of the ctmLoad functions), the array is then
+/// decoded directly into the given buffer instead of into an internally
+/// allocated array, which saves both memory and a copy of the data. The
+/// buffer is never freed by OpenCTM, and ctmGetIntegerArray() /
+/// ctmGetFloatArray() will return the buffer pointer for the array.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aArray Which array to set the buffer for (CTM_INDICES,
+///            CTM_VERTICES, CTM_NORMALS, CTM_UV_MAP_1..CTM_UV_MAP_8 or
+///            CTM_ATTRIB_MAP_1..CTM_ATTRIB_MAP_8).
+/// @param[in] aBuffer The destination buffer, or NULL to go back to internal
+///            allocation for the array.
+/// @param[in] aCapacity The number of elements (triangles for CTM_INDICES,
+///            vertices for the other arrays) that fit in the buffer. If a
+///            loaded mesh does not fit, the load fails with the error
+///            CTM_OUT_OF_MEMORY.
+/// @param[in] aStride The distance, in bytes, from the start of one element
+///            to the start of the next (e.g. 12 for tightly packed vertices).
+///            Zero means tightly packed. The stride must be a multiple of four,
+///            and not smaller than the element size.
+/// @note The buffers remain in effect for all subsequent loads, until they are
+///       changed or removed. The buffers must stay valid as long as the mesh is
+///       accessed through the context.
+/// @note With a stride that is not tightly packed, each element only occupies
+///       the first bytes of its slot, and the remaining bytes are left
+///       untouched (this allows several arrays to share one interleaved
+///       buffer).
+CTMEXPORT void CTMCALL ctmLoadInto(CTMcontext aContext, CTMenum aArray,
+  void * aBuffer, CTMuint aCapacity, CTMuint aStride);
+
+/// Set an interleaved vertex buffer (e.g. a mapped GPU vertex buffer) that
+/// subsequent loads will fill in. The buffer holds one vertex every
+/// \c aStride bytes, and the position of each per vertex array within the
+/// vertex is described with ctmVertexLayoutArray(). Arrays that are not part
+/// of the layout are allocated internally, as usual.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aBuffer The vertex buffer, or NULL to remove the layout.
+/// @param[in] aCapacity The number of vertices that fit in the buffer. If a
+///            loaded mesh does not fit, the load fails with the error
+///            CTM_OUT_OF_MEMORY.
+/// @param[in] aStride The size of one vertex, in bytes (a non-zero multiple
+///            of four).
+/// @note This replaces any destination buffers that have been set for the
+///       per vertex arrays with ctmLoadInto() (index buffers are not
+///       affected).
+/// @see ctmVertexLayoutArray().
+CTMEXPORT void CTMCALL ctmVertexLayout(CTMcontext aContext, void * aBuffer,
+  CTMuint aCapacity, CTMuint aStride);
+
+/// Place a per vertex array within the vertex layout that was set with
+/// ctmVertexLayout().
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aArray Which array to place (CTM_VERTICES, CTM_NORMALS,
+///            CTM_UV_MAP_1..CTM_UV_MAP_8 or
+///            CTM_ATTRIB_MAP_1..CTM_ATTRIB_MAP_8).
+/// @param[in] aOffset The byte offset of the array element within the
+///            vertex. The element must fit within the vertex, and must be
+///            aligned to its component size (four bytes for 32-bit
+///            components, two bytes for 16-bit components).
+/// @param[in] aFormat The component format: CTM_FORMAT_FLOAT32, or (for
+///            CTM_NORMALS only) CTM_FORMAT_FLOAT16 or CTM_FORMAT_SNORM16.
+///            Normals are converted to 16-bit formats as they are restored,
+///            with rounding to nearest (snorm16 values are clamped to
+///            [-1, 1]).
+/// @note For normals in a 16-bit format, ctmGetFloatArray(CTM_NORMALS)
+///       returns a pointer to the first normal in the vertex buffer, which
+///       does not hold floats.
+CTMEXPORT void CTMCALL ctmVertexLayoutArray(CTMcontext aContext,
+  CTMenum aArray, CTMuint aOffset, CTMenum aFormat);
+
+/// Select which part of a tiled file (see ctmTileGrid()) subsequent loads
+/// will decode. Only one tile is held in memory at a time while the file is
+/// loaded.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aTile The tile number (0 to CTM_TILE_COUNT - 1), CTM_ALL_TILES
+///            to load all the tiles as one mesh (the default), or
+///            CTM_TILE_INDEX to only load the tile index (the loaded mesh is
+///            then empty, but the tiles can be queried with
+///            ctmGetTileInteger() and ctmGetTileBoundingBox()).
+/// @note Files that are not tiled are always loaded as a whole (with a
+///       CTM_TILE_COUNT of zero).
+/// @note When all tiles are loaded as one mesh, the tiles are simply
+///       concatenated, so vertices that are shared between tiles appear
+///       once for each tile.
+/// @note If the selected tile does not exist, the load fails with the error
+///       CTM_INVALID_ARGUMENT.
+CTMEXPORT void CTMCALL ctmSelectTile(CTMcontext aContext, CTMuint aTile);
+
+/// Set a function that is called each time a level of a progressive file
+/// (see ctmProgressiveLevels()) has been loaded. The coarse levels are loaded
+/// into the context one at a time, so that the caller can show a preview of
+/// the mesh long before the whole file has been read, and the last call hands
+/// over the full resolution mesh.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aCallback The level callback function, or NULL to disable the
+///            callback (the coarse levels are then skipped).
+/// @param[in] aUserData Custom user data that is passed to the callback.
+/// @note The mesh arrays of a level are only valid until the callback returns
+///       (they are replaced by the next level), and the callback must not
+///       load, save or free the context.
+/// @note Files that are not progressive are loaded as usual (with a
+///       CTM_LEVEL_COUNT of zero), and the callback is not called.
+/// @see CTMlevelfn.
+CTMEXPORT void CTMCALL ctmLevelCallback(CTMcontext aContext,
+  CTMlevelfn aCallback, void * aUserData);
+
+/// Select which of the optional mesh sections subsequent loads will decode.
+/// The vertices and the triangle indices are always loaded. Sections that are
+/// not selected are skipped without being uncompressed, and no memory is
+/// allocated for them, which makes loading considerably faster when e.g. only
+/// the geometry of the mesh is needed.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in import mode).
+/// @param[in] aSections A combination of CTM_LOAD_NORMALS, CTM_LOAD_UV_MAPS
+///            and CTM_LOAD_ATTRIB_MAPS (the default is CTM_LOAD_ALL), or zero
+///            to only load the vertices and the triangle indices.
+/// @note The loaded mesh appears as if the skipped sections were not in the
+///       file: CTM_HAS_NORMALS is CTM_FALSE if the normals are skipped, and
+///       CTM_UV_MAP_COUNT / CTM_ATTRIB_MAP_COUNT are zero if the UV maps /
+///       attribute maps are skipped.
+/// @note Sections at the end of the file that are not loaded are not read at
+///       all.
+CTMEXPORT void CTMCALL ctmLoadSections(CTMcontext aContext, CTMuint aSections);
+
 /// Save an OpenCTM format file. The mesh must have been defined by
 /// ctmDefineMesh().
 /// @param[in] aContext An OpenCTM context that has been created by
@@ -654,6 +1150,27 @@ CTMEXPORT void CTMCALL ctmFreeBuffer(void *buffer);
 CTMEXPORT void CTMCALL ctmSaveCustom(CTMcontext aContext, CTMwritefn aWriteFn,
   void * aUserData);
 
+/// Compress the current mesh (as defined by ctmDefineMesh(), ctmAddUVMap() and
+/// ctmAddAttribMap()) as the next chunk of a mesh that is saved in parts, and
+/// forget it. This lets a mesh that is produced piece by piece be saved
+/// without ever holding all of it: define a chunk, add it, and reuse the
+/// arrays for the next chunk. The next call to ctmSave(), ctmSaveCustom() or
+/// ctmSaveToBuffer() adds the current mesh (if one is defined) as the last
+/// chunk, and writes all the chunks as one tiled file (one tile per chunk, see
+/// ctmTileGrid()), which loads as the concatenation of the chunks.
+/// @param[in] aContext An OpenCTM context that has been created by
+///            ctmNewContext() (in export mode).
+/// @note The triangle indices of a chunk refer to the vertices of that chunk
+///       only. All the chunks must have the same number of UV maps and
+///       attribute maps, and either all or none of them must have normals.
+/// @note Only the compressed chunks are kept in memory until the file is
+///       saved (the tile index that starts the file needs their sizes). The
+///       chunks are released when the file has been saved.
+/// @note The compression settings in effect when a chunk is added are used
+///       for that chunk. The tile grid and the progressive levels are not
+///       used for a mesh that is saved in parts.
+CTMEXPORT void CTMCALL ctmAddChunk(CTMcontext aContext);
+
 #ifdef __cplusplus
 }
 #endif
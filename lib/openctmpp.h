@@ -199,6 +199,102 @@ class CTMimporter {
       return res;
     }
 
+    /// Wrapper for ctmGetTileInteger()
+    CTMuint GetTileInteger(CTMuint aTile, CTMenum aProperty)
+    {
+      CTMuint res = ctmGetTileInteger(mContext, aTile, aProperty);
+      CheckError();
+      return res;
+    }
+
+    /// Wrapper for ctmGetTileBoundingBox()
+    void GetTileBoundingBox(CTMuint aTile, CTMfloat * aMin, CTMfloat * aMax)
+    {
+      ctmGetTileBoundingBox(mContext, aTile, aMin, aMax);
+      CheckError();
+    }
+
+    /// Wrapper for ctmGetSectionInteger()
+    CTMuint GetSectionInteger(CTMuint aSection, CTMenum aProperty)
+    {
+      CTMuint res = ctmGetSectionInteger(mContext, aSection, aProperty);
+      CheckError();
+      return res;
+    }
+
+    /// Wrapper for ctmThreadCount()
+    void ThreadCount(CTMuint aCount)
+    {
+      ctmThreadCount(mContext, aCount);
+      CheckError();
+    }
+
+    /// Wrapper for ctmScratchMemory()
+    void ScratchMemory(CTMuint aSize)
+    {
+      ctmScratchMemory(mContext, aSize);
+      CheckError();
+    }
+
+    /// Wrapper for ctmSetAllocator()
+    void SetAllocator(CTMallocfn aAllocFn, CTMfreefn aFreeFn,
+      void * aUserData = 0)
+    {
+      ctmSetAllocator(mContext, aAllocFn, aFreeFn, aUserData);
+      CheckError();
+    }
+
+    /// Wrapper for ctmStreamBuffer()
+    void StreamBuffer(CTMuint aSize)
+    {
+      ctmStreamBuffer(mContext, aSize);
+      CheckError();
+    }
+
+    /// Wrapper for ctmLoadInto()
+    void LoadInto(CTMenum aArray, void * aBuffer, CTMuint aCapacity,
+      CTMuint aStride = 0)
+    {
+      ctmLoadInto(mContext, aArray, aBuffer, aCapacity, aStride);
+      CheckError();
+    }
+
+    /// Wrapper for ctmVertexLayout()
+    void VertexLayout(void * aBuffer, CTMuint aCapacity, CTMuint aStride)
+    {
+      ctmVertexLayout(mContext, aBuffer, aCapacity, aStride);
+      CheckError();
+    }
+
+    /// Wrapper for ctmVertexLayoutArray()
+    void VertexLayoutArray(CTMenum aArray, CTMuint aOffset,
+      CTMenum aFormat = CTM_FORMAT_FLOAT32)
+    {
+      ctmVertexLayoutArray(mContext, aArray, aOffset, aFormat);
+      CheckError();
+    }
+
+    /// Wrapper for ctmSelectTile()
+    void SelectTile(CTMuint aTile)
+    {
+      ctmSelectTile(mContext, aTile);
+      CheckError();
+    }
+
+    /// Wrapper for ctmLevelCallback()
+    void LevelCallback(CTMlevelfn aCallback, void * aUserData = 0)
+    {
+      ctmLevelCallback(mContext, aCallback, aUserData);
+      CheckError();
+    }
+
+    /// Wrapper for ctmLoadSections()
+    void LoadSections(CTMuint aSections)
+    {
+      ctmLoadSections(mContext, aSections);
+      CheckError();
+    }
+
     /// Wrapper for ctmLoad()
     void Load(const char * aFileName)
     {
@@ -213,6 +309,34 @@ class CTMimporter {
       CheckError();
     }
 
+    /// Wrapper for ctmLoadSeekable()
+    void LoadSeekable(CTMreadfn aReadFn, CTMseekfn aSeekFn, void * aUserData)
+    {
+      ctmLoadSeekable(mContext, aReadFn, aSeekFn, aUserData);
+      CheckError();
+    }
+
+    /// Wrapper for ctmLoadFromMemory()
+    void LoadFromMemory(const void * aData, size_t aSize)
+    {
+      ctmLoadFromMemory(mContext, aData, aSize);
+      CheckError();
+    }
+
+    /// Wrapper for ctmLoadMapped()
+    void LoadMapped(const char * aFileName)
+    {
+      ctmLoadMapped(mContext, aFileName);
+      CheckError();
+    }
+
+    /// Wrapper for ctmProbe()
+    void Probe(const char * aFileName)
+    {
+      ctmProbe(mContext, aFileName);
+      CheckError();
+    }
+
     // You can not copy nor assign from one CTMimporter object to another, since
     // the object contains hidden state. By declaring these dummy prototypes
     // without an implementation, you will at least get linker errors if you try
@@ -281,6 +405,50 @@ class CTMexporter {
       CheckError();
     }
 
+    /// Wrapper for ctmCompressionParameter()
+    void CompressionParameter(CTMenum aSection, CTMenum aParameter,
+      CTMint aValue)
+    {
+      ctmCompressionParameter(mContext, aSection, aParameter, aValue);
+      CheckError();
+    }
+
+    /// Wrapper for ctmCompressionCoding()
+    void CompressionCoding(CTMenum aArray, CTMenum aCoding)
+    {
+      ctmCompressionCoding(mContext, aArray, aCoding);
+      CheckError();
+    }
+
+    /// Wrapper for ctmThreadCount()
+    void ThreadCount(CTMuint aCount)
+    {
+      ctmThreadCount(mContext, aCount);
+      CheckError();
+    }
+
+    /// Wrapper for ctmScratchMemory()
+    void ScratchMemory(CTMuint aSize)
+    {
+      ctmScratchMemory(mContext, aSize);
+      CheckError();
+    }
+
+    /// Wrapper for ctmSetAllocator()
+    void SetAllocator(CTMallocfn aAllocFn, CTMfreefn aFreeFn,
+      void * aUserData = 0)
+    {
+      ctmSetAllocator(mContext, aAllocFn, aFreeFn, aUserData);
+      CheckError();
+    }
+
+    /// Wrapper for ctmStreamBuffer()
+    void StreamBuffer(CTMuint aSize)
+    {
+      ctmStreamBuffer(mContext, aSize);
+      CheckError();
+    }
+
     /// Wrapper for ctmVertexPrecision()
     void VertexPrecision(CTMfloat aPrecision)
     {
@@ -323,6 +491,27 @@ class CTMexporter {
       CheckError();
     }
 
+    /// Wrapper for ctmTileGrid()
+    void TileGrid(CTMuint aX, CTMuint aY, CTMuint aZ)
+    {
+      ctmTileGrid(mContext, aX, aY, aZ);
+      CheckError();
+    }
+
+    /// Wrapper for ctmSectionDirectory()
+    void SectionDirectory(CTMint aEnable)
+    {
+      ctmSectionDirectory(mContext, aEnable);
+      CheckError();
+    }
+
+    /// Wrapper for ctmProgressiveLevels()
+    void ProgressiveLevels(CTMuint aLevels)
+    {
+      ctmProgressiveLevels(mContext, aLevels);
+      CheckError();
+    }
+
     /// Wrapper for ctmDefineMesh()
     void DefineMesh(const CTMfloat * aVertices, CTMuint aVertexCount, 
       const CTMuint * aIndices, CTMuint aTriangleCount,
@@ -350,6 +539,13 @@ class CTMexporter {
       return res;
     }
 
+    /// Wrapper for ctmAddChunk()
+    void AddChunk()
+    {
+      ctmAddChunk(mContext);
+      CheckError();
+    }
+
     /// Wrapper for ctmSave()
     void Save(const char * aFileName)
     {
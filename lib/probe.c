@@ -0,0 +1,628 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        probe.c
+// Description: Probing of files - reading the header information of a file
+//              without loading the mesh data (see ctmProbe()), and the
+//              section directory of files (see ctmSectionDirectory()).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+// A probed file is always read from a memory stream (the file is mapped into
+// memory), so the packed data of a section is skipped by just moving the
+// stream position past it - the data itself is never touched.
+//
+// The file is walked twice at most: ctmProbe() reads the headers and the map
+// descriptors (and stops as soon as it has them), and the section directory
+// is made by a second walk through the whole file the first time it is asked
+// for. While the directory is made (mSections is not NULL), the map
+// descriptors are skipped instead of read. Files that were saved with a
+// section directory (at the end of the file) need no second walk.
+
+
+//-----------------------------------------------------------------------------
+// _ctmProbeSkip() - Skip aSize bytes of the memory stream.
+//-----------------------------------------------------------------------------
+static int _ctmProbeSkip(_CTMcontext * self, size_t aSize)
+{
+  if(aSize > self->mMemorySize - self->mMemoryPos)
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  self->mMemoryPos += aSize;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeTag() - Read the four character code of the next section, which
+// must be aID.
+//-----------------------------------------------------------------------------
+static int _ctmProbeTag(_CTMcontext * self, CTMuint aID)
+{
+  size_t offset = self->mMemoryPos;
+
+  if(_ctmStreamReadUINT(self) != aID)
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  _ctmAddSection(self, aID, offset, 0);
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeData() - Skip the data array of the current section (aUnpackedSize
+// bytes when uncompressed). RAW arrays are stored as is, and packed arrays
+// have a size field (and the LZMA props, unless they are MG3 arrays) first.
+//-----------------------------------------------------------------------------
+static int _ctmProbeData(_CTMcontext * self, size_t aUnpackedSize)
+{
+  size_t size;
+
+  if(self->mSections)
+    self->mSections[self->mSectionCount - 1].mUnpackedSize = aUnpackedSize;
+
+  if(self->mMethod == CTM_METHOD_RAW)
+    size = aUnpackedSize;
+  else
+  {
+    size = (size_t) _ctmStreamReadUINT(self);
+    if(self->mMethod != CTM_METHOD_MG3)
+      size += 5;
+  }
+  return _ctmProbeSkip(self, size);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeString() - Read a string into aValue, or skip it if aValue is NULL.
+//-----------------------------------------------------------------------------
+static int _ctmProbeString(_CTMcontext * self, char ** aValue)
+{
+  if(aValue)
+  {
+    _ctmStreamReadSTRING(self, aValue);
+    return CTM_TRUE;
+  }
+  return _ctmProbeSkip(self, (size_t) _ctmStreamReadUINT(self));
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeMap() - Read the descriptor of a UV map ("TEXC") or an attribute
+// map ("ATTR") into a new map (without values) that is linked in at aTail,
+// and skip the map data.
+//-----------------------------------------------------------------------------
+static int _ctmProbeMap(_CTMcontext * self, CTMuint aID, _CTMfloatmap ** aTail,
+  CTMuint aChannels)
+{
+  _CTMfloatmap * map = (_CTMfloatmap *) 0;
+  CTMfloat precision;
+
+  if(!_ctmProbeTag(self, aID))
+    return CTM_FALSE;
+
+  // The map descriptor is not needed for the section directory
+  if(!self->mSections)
+  {
+    map = (_CTMfloatmap *) _ctmCalloc(&self->mAllocator, sizeof(_CTMfloatmap));
+    if(!map)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      return CTM_FALSE;
+    }
+    map->mStride = aChannels;
+    *aTail = map;
+  }
+
+  if(!_ctmProbeString(self, map ? &map->mName : (char **) 0))
+    return CTM_FALSE;
+  if((aID == FOURCC("TEXC")) &&
+     !_ctmProbeString(self, map ? &map->mFileName : (char **) 0))
+    return CTM_FALSE;
+  if((self->mMethod == CTM_METHOD_MG2) || (self->mMethod == CTM_METHOD_MG3))
+  {
+    precision = _ctmStreamReadFLOAT(self);
+    if(precision <= 0.0f)
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return CTM_FALSE;
+    }
+    if(map)
+      map->mPrecision = precision;
+  }
+
+  return _ctmProbeData(self, (size_t) self->mVertexCount * aChannels * 4);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeMesh() - Walk through the sections of a single mesh file (the file
+// header has already been read). aFlags are the mesh flags of the file.
+//-----------------------------------------------------------------------------
+static int _ctmProbeMesh(_CTMcontext * self, CTMuint aFlags)
+{
+  _CTMfloatmap ** tail;
+  _CTMgrid grid;
+  size_t offset, vertexSize, indexSize;
+  CTMuint i, id, codingFlags = 0;
+  CTMint mg2;
+
+  vertexSize = (size_t) self->mVertexCount * 3 * 4;
+  indexSize = (size_t) self->mTriangleCount * 3 * 4;
+  mg2 = (self->mMethod == CTM_METHOD_MG2) || (self->mMethod == CTM_METHOD_MG3);
+
+  // MG2 header ("MG2H" or "MG2X")
+  if(mg2)
+  {
+    offset = self->mMemoryPos;
+    id = _ctmStreamReadUINT(self);
+    self->mMemoryPos = offset;
+    if(!_ctmReadHeader_MG2(self, &grid, &codingFlags))
+      return CTM_FALSE;
+    _ctmAddSection(self, id, offset, 0);
+  }
+
+  // That is all there is to know, unless there are map descriptors further on
+  // (or the section directory is being made)
+  if(!self->mSections && !self->mUVMapCount && !self->mAttribMapCount)
+    return CTM_TRUE;
+
+  if(mg2)
+  {
+    // Vertices and grid indices (no grid indices with parallelogram
+    // prediction)
+    if(!_ctmProbeTag(self, FOURCC("VERT")) || !_ctmProbeData(self, vertexSize))
+      return CTM_FALSE;
+    if(!(codingFlags & _CTM_MG2_PARALLELOGRAM_BIT) &&
+       (!_ctmProbeTag(self, FOURCC("GIDX")) ||
+        !_ctmProbeData(self, vertexSize / 3)))
+      return CTM_FALSE;
+
+    // Triangle indices (or connectivity codes, which are preceded by their
+    // count)
+    if(!_ctmProbeTag(self, FOURCC("INDX")))
+      return CTM_FALSE;
+    if(codingFlags & _CTM_MG2_CONNECTIVITY_BIT)
+      indexSize = (size_t) _ctmStreamReadUINT(self) * 4;
+    if(!_ctmProbeData(self, indexSize))
+      return CTM_FALSE;
+  }
+  else
+  {
+    // Triangle indices and vertices
+    if(!_ctmProbeTag(self, FOURCC("INDX")) || !_ctmProbeData(self, indexSize))
+      return CTM_FALSE;
+    if(!_ctmProbeTag(self, FOURCC("VERT")) || !_ctmProbeData(self, vertexSize))
+      return CTM_FALSE;
+  }
+
+  // Normals
+  if((aFlags & _CTM_HAS_NORMALS_BIT) &&
+     (!_ctmProbeTag(self, FOURCC("NORM")) || !_ctmProbeData(self, vertexSize)))
+    return CTM_FALSE;
+
+  // UV maps and attribute maps
+  tail = &self->mUVMaps;
+  for(i = 0; i < self->mUVMapCount; ++ i)
+  {
+    if(!_ctmProbeMap(self, FOURCC("TEXC"), tail, 2))
+      return CTM_FALSE;
+    if(*tail)
+      tail = &(*tail)->mNext;
+  }
+  tail = &self->mAttribMaps;
+  for(i = 0; i < self->mAttribMapCount; ++ i)
+  {
+    if(!_ctmProbeMap(self, FOURCC("ATTR"), tail, 4))
+      return CTM_FALSE;
+    if(*tail)
+      tail = &(*tail)->mNext;
+  }
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeSubMesh() - Probe the next sub mesh (aSize bytes) of the memory
+// stream, and take its method, precisions and map descriptors.
+//-----------------------------------------------------------------------------
+static int _ctmProbeSubMesh(_CTMcontext * self, CTMuint aSize,
+  CTMuint aVertexCount, CTMuint aTriangleCount)
+{
+  _CTMcontext * sub;
+  int result;
+
+  if((size_t) aSize > self->mMemorySize - self->mMemoryPos)
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  sub = (_CTMcontext *) ctmNewContext(CTM_IMPORT);
+  if(!sub)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  sub->mScratch = self->mScratch;
+  sub->mAllocator = self->mAllocator;
+  sub->mInSubMesh = CTM_TRUE;
+  sub->mSubMeshCounts[0] = aVertexCount;
+  sub->mSubMeshCounts[1] = aTriangleCount;
+  sub->mSubMeshCounts[2] = self->mUVMapCount;
+  sub->mSubMeshCounts[3] = self->mAttribMapCount;
+  sub->mMemory = self->mMemory + self->mMemoryPos;
+  sub->mMemorySize = aSize;
+  sub->mMemoryPos = 0;
+
+  result = _ctmProbeFile(sub);
+  if(result)
+  {
+    self->mMethod = sub->mMethod;
+    self->mVertexPrecision = sub->mVertexPrecision;
+    self->mNormalPrecision = sub->mNormalPrecision;
+    self->mUVMaps = sub->mUVMaps;
+    self->mAttribMaps = sub->mAttribMaps;
+    sub->mUVMaps = (_CTMfloatmap *) 0;
+    sub->mAttribMaps = (_CTMfloatmap *) 0;
+  }
+  else
+    self->mError = sub->mError;
+  sub->mMemory = (const unsigned char *) 0;
+  ctmFreeContext((CTMcontext) sub);
+
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeTiles() - Walk through the sections of a tiled file (the file header
+// has already been read). The first tile gives the method and the maps.
+//-----------------------------------------------------------------------------
+static int _ctmProbeTiles(_CTMcontext * self)
+{
+  CTMuint i;
+
+  if(!self->mSections)
+  {
+    if(!_ctmReadTileIndex(self))
+      return CTM_FALSE;
+    return _ctmProbeSubMesh(self, self->mTiles[0].mSize,
+                            self->mTiles[0].mVertexCount,
+                            self->mTiles[0].mTriangleCount);
+  }
+
+  // The tile index has already been read (it is 9 words per tile)
+  if(!_ctmProbeTag(self, FOURCC("TIDX")) ||
+     (_ctmStreamReadUINT(self) != self->mTileCount) ||
+     !_ctmProbeSkip(self, (size_t) self->mTileCount * 9 * 4))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  for(i = 0; i < self->mTileCount; ++ i)
+  {
+    _ctmAddSection(self, FOURCC("OCTM"), self->mMemoryPos, 0);
+    if(!_ctmProbeSkip(self, (size_t) self->mTiles[i].mSize))
+      return CTM_FALSE;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeLevels() - Walk through the sections of a progressive file (the
+// file header has already been read). The full resolution level gives the
+// method and the maps.
+//-----------------------------------------------------------------------------
+static int _ctmProbeLevels(_CTMcontext * self)
+{
+  CTMuint index[_CTM_LEVEL_MAX_COUNT * 3], count, i;
+  size_t offset;
+
+  offset = self->mMemoryPos;
+  count = _ctmReadLevelIndex(self, index);
+  if(!count)
+    return CTM_FALSE;
+  _ctmAddSection(self, FOURCC("LIDX"), offset, 0);
+  self->mLevelCount = count;
+
+  for(i = 0; i < count; ++ i)
+  {
+    if((i == count - 1) && !self->mSections)
+      return _ctmProbeSubMesh(self, index[i * 3 + 2], index[i * 3],
+                              index[i * 3 + 1]);
+    _ctmAddSection(self, FOURCC("OCTM"), self->mMemoryPos, 0);
+    if(!_ctmProbeSkip(self, (size_t) index[i * 3 + 2]))
+      return CTM_FALSE;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmProbeFile() - Read the header information of the file in the memory
+// stream of the context: the file header, the tile or level index, the MG2
+// header and the map descriptors (maps without values). No mesh data is
+// loaded. If mSections is not NULL, the section directory is made instead
+// (the header information must already be known).
+//-----------------------------------------------------------------------------
+int _ctmProbeFile(_CTMcontext * self)
+{
+  CTMuint method, flags;
+
+  if(!_ctmReadHeader(self, &method, &flags))
+    return CTM_FALSE;
+  self->mProbeFlags = flags;
+
+  if(method == FOURCC("TILE"))
+    return _ctmProbeTiles(self);
+  else if(method == FOURCC("PROG"))
+    return _ctmProbeLevels(self);
+  return _ctmProbeMesh(self, flags);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReadStoredSections() - Read the section directory that is stored at the
+// end of the file in the memory stream (see ctmSectionDirectory()), if there
+// is one.
+//-----------------------------------------------------------------------------
+static int _ctmReadStoredSections(_CTMcontext * self)
+{
+  _CTMsection * section;
+  size_t start, end;
+  CTMuint i, count;
+
+  // The directory ends with its own offset and the id "SDIR"
+  if(self->mMemorySize < 24)
+    return CTM_FALSE;
+  self->mMemoryPos = self->mMemorySize - 8;
+  start = (size_t) _ctmStreamReadUINT(self);
+  if((_ctmStreamReadUINT(self) != FOURCC("SDIR")) ||
+     (start > self->mMemorySize - 24))
+    return CTM_FALSE;
+  self->mMemoryPos = start;
+  if(_ctmStreamReadUINT(self) != FOURCC("SDIR"))
+    return CTM_FALSE;
+  count = _ctmStreamReadUINT(self);
+  if((count == 0) || ((size_t) count * 16 != self->mMemorySize - start - 16))
+    return CTM_FALSE;
+
+  self->mSections = (_CTMsection *) _ctmAlloc(&self->mAllocator,
+    sizeof(_CTMsection) * count);
+  if(!self->mSections)
+    return CTM_FALSE;
+  self->mSectionCapacity = count;
+
+  // The sections must follow each other, up to the directory
+  end = 0;
+  for(i = 0; i < count; ++ i)
+  {
+    section = &self->mSections[i];
+    section->mID = _ctmStreamReadUINT(self);
+    section->mOffset = (size_t) _ctmStreamReadUINT(self);
+    section->mSize = (size_t) _ctmStreamReadUINT(self);
+    section->mUnpackedSize = (size_t) _ctmStreamReadUINT(self);
+    if(((i > 0) && (section->mOffset != end)) ||
+       (section->mOffset > start) ||
+       (section->mSize > start - section->mOffset))
+      break;
+    end = section->mOffset + section->mSize;
+  }
+  if((i < count) || (end != start))
+  {
+    _ctmFree(&self->mAllocator, self->mSections);
+    self->mSections = (_CTMsection *) 0;
+    self->mSectionCapacity = 0;
+    return CTM_FALSE;
+  }
+  self->mSectionCount = count;
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReadSections() - Make the section directory of the probed file (unless
+// that has already been done). The directory that is stored at the end of the
+// file is used if there is one, otherwise the directory is made by walking
+// through the file. The probed file is unmapped afterwards.
+//-----------------------------------------------------------------------------
+int _ctmReadSections(_CTMcontext * self)
+{
+  CTMuint i;
+  size_t end;
+  int result;
+
+  if(self->mSections)
+    return CTM_TRUE;
+  if(!self->mProbeMap.mData)
+  {
+    self->mError = CTM_INVALID_OPERATION;
+    return CTM_FALSE;
+  }
+  self->mMemory = self->mProbeMap.mData;
+  self->mMemorySize = self->mProbeMap.mSize;
+
+  result = _ctmReadStoredSections(self);
+  if(!result)
+  {
+    // A single mesh file has at most five sections before the maps (MG2
+    // header, VERT, GIDX, INDX and NORM), and tiled and progressive files
+    // have one section per tile or level after the index
+    self->mSectionCapacity = 5 + self->mUVMapCount + self->mAttribMapCount +
+                             self->mTileCount + self->mLevelCount;
+    self->mSections = (_CTMsection *) _ctmAlloc(&self->mAllocator,
+      sizeof(_CTMsection) * self->mSectionCapacity);
+    if(self->mSections)
+    {
+      // Walk through the file again, and note where each section starts
+      self->mSectionCount = 0;
+      self->mMemoryPos = 0;
+      result = _ctmProbeFile(self);
+
+      // Each section ends where the next one starts
+      end = self->mProbeMap.mSize;
+      for(i = self->mSectionCount; i > 0; -- i)
+      {
+        self->mSections[i - 1].mSize = end - self->mSections[i - 1].mOffset;
+        end = self->mSections[i - 1].mOffset;
+      }
+    }
+    else
+      self->mError = CTM_OUT_OF_MEMORY;
+  }
+  self->mMemory = (const unsigned char *) 0;
+  self->mMemorySize = 0;
+  self->mMemoryPos = 0;
+
+  _ctmUnmapFile(&self->mProbeMap);
+  if(!result)
+  {
+    if(self->mSections)
+      _ctmFree(&self->mAllocator, self->mSections);
+    self->mSections = (_CTMsection *) 0;
+    self->mSectionCount = 0;
+    self->mSectionCapacity = 0;
+  }
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmAddSection() - Add a section that starts at aOffset to the section
+// directory (if it is being made). The directory grows as needed.
+//-----------------------------------------------------------------------------
+void _ctmAddSection(_CTMcontext * self, CTMuint aID, size_t aOffset,
+  size_t aUnpackedSize)
+{
+  _CTMsection * section;
+  CTMuint capacity;
+
+  if(!self->mSections)
+    return;
+  if(self->mSectionCount >= self->mSectionCapacity)
+  {
+    capacity = self->mSectionCapacity ? self->mSectionCapacity * 2 : 16;
+    section = (_CTMsection *) _ctmRealloc(&self->mAllocator, self->mSections,
+      sizeof(_CTMsection) * self->mSectionCapacity,
+      sizeof(_CTMsection) * capacity);
+    if(!section)
+    {
+      // Give up the directory (it would be incomplete)
+      _ctmFree(&self->mAllocator, self->mSections);
+      self->mSections = (_CTMsection *) 0;
+      self->mSectionCount = 0;
+      self->mSectionCapacity = 0;
+      self->mError = CTM_OUT_OF_MEMORY;
+      return;
+    }
+    self->mSections = section;
+    self->mSectionCapacity = capacity;
+  }
+  section = &self->mSections[self->mSectionCount ++];
+  section->mID = aID;
+  section->mOffset = aOffset;
+  section->mSize = 0;
+  section->mUnpackedSize = aUnpackedSize;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmBeginSections() - Start the section directory of a file that is about
+// to be saved (the sections are added as they are written).
+//-----------------------------------------------------------------------------
+int _ctmBeginSections(_CTMcontext * self)
+{
+  // Room for the sections of a single mesh (tiled and progressive files
+  // grow the directory as needed)
+  self->mSectionCapacity = 6 + self->mUVMapCount + self->mAttribMapCount;
+  self->mSections = (_CTMsection *) _ctmAlloc(&self->mAllocator,
+    sizeof(_CTMsection) * self->mSectionCapacity);
+  if(!self->mSections)
+  {
+    self->mSectionCapacity = 0;
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  self->mSectionCount = 0;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWriteSections() - Write the section directory at the end of a saved
+// file. The directory holds 32-bit offsets, so it is left out of
+// files that are larger than that.
+//-----------------------------------------------------------------------------
+int _ctmWriteSections(_CTMcontext * self)
+{
+  _CTMsection * section;
+  size_t start, end, size;
+  CTMuint i;
+
+  // Each section ends where the next one starts
+  start = end = self->mStreamPos;
+  size = 16 * (size_t) (self->mSectionCount + 1);
+  for(i = self->mSectionCount; i > 0; -- i)
+  {
+    self->mSections[i - 1].mSize = end - self->mSections[i - 1].mOffset;
+    end = self->mSections[i - 1].mOffset;
+  }
+
+  if(!self->mSectionCount || (start + size > 0xffffffff))
+    size = 0;
+  if(size)
+  {
+    _ctmStreamWrite(self, (void *) "SDIR", 4);
+    _ctmStreamWriteUINT(self, self->mSectionCount);
+    for(i = 0; i < self->mSectionCount; ++ i)
+    {
+      section = &self->mSections[i];
+      _ctmStreamWriteUINT(self, section->mID);
+      _ctmStreamWriteUINT(self, (CTMuint) section->mOffset);
+      _ctmStreamWriteUINT(self, (CTMuint) section->mSize);
+      _ctmStreamWriteUINT(self, section->mUnpackedSize > 0xffffffff ?
+        0xffffffff : (CTMuint) section->mUnpackedSize);
+    }
+    _ctmStreamWriteUINT(self, (CTMuint) start);
+    _ctmStreamWrite(self, (void *) "SDIR", 4);
+  }
+
+  if(self->mStreamPos != start + size)
+  {
+    self->mError = CTM_FILE_ERROR;
+    return CTM_FALSE;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFreeProbe() - Free the probed file and its section directory.
+//-----------------------------------------------------------------------------
+void _ctmFreeProbe(_CTMcontext * self)
+{
+  _ctmUnmapFile(&self->mProbeMap);
+  if(self->mSections)
+    _ctmFree(&self->mAllocator, self->mSections);
+  self->mSections = (_CTMsection *) 0;
+  self->mSectionCount = 0;
+  self->mSectionCapacity = 0;
+  self->mProbed = CTM_FALSE;
+  self->mProbeFlags = 0;
+}
@@ -0,0 +1,471 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        progressive.c
+// Description: Progressive files - meshes that are preceded by coarser
+//              versions of themselves, which can be shown while the rest of
+//              the file is loaded (see ctmProgressiveLevels()).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+// A progressive file has the ordinary file header (with the method "PROG",
+// and the counts of the full resolution mesh), followed by the level index
+// ("LIDX", the level count, and the vertex count, triangle count and data
+// size of each level), followed by the levels, from the coarsest level to the
+// full resolution mesh. Each level is a complete OpenCTM file of its own.
+//
+// The coarse levels are made by vertex clustering: the vertices are snapped
+// to the cells of an octree over the bounding box (each cluster is replaced
+// by the average of its vertices), and the triangles that collapse are
+// dropped. The vertices are sorted along a Morton curve once, so that the
+// clusters of every octree depth are runs of consecutive vertices.
+
+// Minimum number of vertices in a coarse level (smaller levels are too crude
+// to be useful)
+#define _CTM_LEVEL_MIN_VERTICES 64
+
+
+//-----------------------------------------------------------------------------
+// _ctmSpreadBits() - Spread the 8 lowest bits of aValue to every third bit.
+//-----------------------------------------------------------------------------
+static CTMuint _ctmSpreadBits(CTMuint aValue)
+{
+  CTMuint result = 0, i;
+  for(i = 0; i < 8; ++ i)
+    result |= ((aValue >> i) & 1) << (i * 3);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmHighBit() - Get the index of the highest set bit of aValue (non-zero).
+//-----------------------------------------------------------------------------
+static CTMuint _ctmHighBit(CTMuint aValue)
+{
+  CTMuint result = 0;
+  while(aValue >>= 1)
+    ++ result;
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSaveLevel() - Save the mesh clustered at octree depth aDepth to aBuf.
+// aRecords are the Morton sorted vertex records (high code, low code, vertex)
+// and aSplit[i] is the octree depth at which record i is split from record
+// i - 1. aCellSize is the size of the cells at depth 0.
+//-----------------------------------------------------------------------------
+static int _ctmSaveLevel(_CTMcontext * self, const CTMuint * aRecords,
+  const unsigned char * aSplit, CTMuint aDepth, CTMfloat aCellSize,
+  CTMuint * aVertexCount, CTMuint * aTriangleCount, _CTMmembuf * aBuf)
+{
+  CTMuint * cluster, * reps, * tris, * tri, clusterCount, triCount, i, j, c, t;
+  CTMfloat * vertices, precision;
+  double * sums, scale;
+  const CTMfloat * v;
+  int result = CTM_FALSE;
+
+  *aVertexCount = 0;
+  *aTriangleCount = 0;
+
+  // Count the clusters
+  clusterCount = 1;
+  for(i = 1; i < self->mVertexCount; ++ i)
+    if(aSplit[i] <= aDepth)
+      ++ clusterCount;
+
+  cluster = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * self->mVertexCount);
+  reps = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * clusterCount);
+  sums = (double *) _ctmScratchCalloc(self->mScratch,
+    (size_t) clusterCount * 4 * sizeof(double));
+  vertices = (CTMfloat *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMfloat) * 3 * clusterCount);
+  tris = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * 3 * self->mTriangleCount);
+  if(!cluster || !reps || !sums || !vertices || !tris)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+
+  // Assign the vertices to clusters, and average the cluster vertices (the
+  // other vertex attributes are taken from the first vertex of each cluster)
+  c = 0;
+  for(i = 0; i < self->mVertexCount; ++ i)
+  {
+    if((i > 0) && (aSplit[i] <= aDepth))
+      ++ c;
+    if((i == 0) || (aSplit[i] <= aDepth))
+      reps[c] = aRecords[i * 3 + 2];
+    cluster[aRecords[i * 3 + 2]] = c;
+    v = &self->mVertices[(size_t) aRecords[i * 3 + 2] * self->mVertexStride];
+    for(j = 0; j < 3; ++ j)
+      sums[c * 4 + j] += v[j];
+    sums[c * 4 + 3] += 1.0;
+  }
+  for(c = 0; c < clusterCount; ++ c)
+  {
+    scale = 1.0 / sums[c * 4 + 3];
+    for(j = 0; j < 3; ++ j)
+      vertices[c * 3 + j] = (CTMfloat) (sums[c * 4 + j] * scale);
+  }
+
+  // Map the triangles to clusters, and drop the collapsed triangles (each
+  // triangle is rotated so that its lowest index comes first)
+  triCount = 0;
+  for(i = 0; i < self->mTriangleCount; ++ i)
+  {
+    tri = &tris[triCount * 3];
+    for(j = 0; j < 3; ++ j)
+      tri[j] = cluster[self->mIndices[(size_t) i * self->mIndexStride + j]];
+    if((tri[0] == tri[1]) || (tri[1] == tri[2]) || (tri[0] == tri[2]))
+      continue;
+    while((tri[0] > tri[1]) || (tri[0] > tri[2]))
+    {
+      t = tri[0]; tri[0] = tri[1]; tri[1] = tri[2]; tri[2] = t;
+    }
+    ++ triCount;
+  }
+  if(triCount == 0)
+  {
+    result = CTM_TRUE;
+    goto cleanup;
+  }
+
+  // Drop the duplicate triangles (sort by the third index, and then by the
+  // first two - the sort is stable)
+  if(!_ctmRadixSort(self->mScratch, (void *) tris, triCount, 3, 2, 2, CTM_FALSE) ||
+     !_ctmRadixSort(self->mScratch, (void *) tris, triCount, 3, 0, 1, CTM_FALSE))
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+  t = 1;
+  for(i = 1; i < triCount; ++ i)
+  {
+    if((tris[i * 3] != tris[t * 3 - 3]) || (tris[i * 3 + 1] != tris[t * 3 - 2]) ||
+       (tris[i * 3 + 2] != tris[t * 3 - 1]))
+    {
+      for(j = 0; j < 3; ++ j)
+        tris[t * 3 + j] = tris[i * 3 + j];
+      ++ t;
+    }
+  }
+  triCount = t;
+
+  // Save the level (the cluster averages do not need the full precision, so
+  // a coarser fixed point precision is used for MG2 and MG3, relative to the
+  // cell size)
+  precision = aCellSize / (CTMfloat) (1 << aDepth) * (1.0f / 8.0f);
+  if(precision < self->mVertexPrecision)
+    precision = self->mVertexPrecision;
+  if(!_ctmSaveSubMesh(self, reps, clusterCount, vertices, tris, triCount,
+                      precision, (CTMfloat *) 0, (CTMfloat *) 0, aBuf))
+    goto cleanup;
+  *aVertexCount = clusterCount;
+  *aTriangleCount = triCount;
+  result = CTM_TRUE;
+
+cleanup:
+  _ctmScratchFree(self->mScratch, tris);
+  _ctmScratchFree(self->mScratch, vertices);
+  _ctmScratchFree(self->mScratch, sums);
+  _ctmScratchFree(self->mScratch, reps);
+  _ctmScratchFree(self->mScratch, cluster);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSaveLevels() - Save the mesh as a progressive file, with up to
+// mProgressiveLevels coarse levels before the full resolution mesh. The levels
+// are saved to memory first, since the size of each level must be known when
+// the level index is written.
+//-----------------------------------------------------------------------------
+int _ctmSaveLevels(_CTMcontext * self)
+{
+  CTMfloat min[3], max[3], size, scale;
+  CTMuint * records, counts[_CTM_LEVEL_MAX_DEPTH + 2];
+  CTMuint vertexCounts[_CTM_LEVEL_MAX_COUNT], triangleCounts[_CTM_LEVEL_MAX_COUNT];
+  CTMuint depths[_CTM_LEVEL_MAX_COUNT], target, levelCount, i, j, k, c, h, l;
+  CTMuint flags, levels;
+  unsigned char * split;
+  _CTMmembuf bufs[_CTM_LEVEL_MAX_COUNT];
+  _CTMsection * sections;
+  _CTMstreambuf streamBuf;
+  CTMwritefn writeFn;
+  void * userData;
+  size_t streamPos;
+  int result = CTM_FALSE;
+
+  memset(bufs, 0, sizeof(bufs));
+  for(l = 0; l < _CTM_LEVEL_MAX_COUNT; ++ l)
+    bufs[l].mAllocator = &self->mAllocator;
+  records = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * 3 * self->mVertexCount);
+  split = (unsigned char *) _ctmScratchAlloc(self->mScratch,
+    self->mVertexCount);
+  if(!records || !split)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+
+  // Calculate the Morton code of the finest octree cell of each vertex (in a
+  // cube that encloses the bounding box)
+  _ctmBoundingBox(self, self->mVertices, self->mVertexCount, min, max);
+  size = 0.0f;
+  for(j = 0; j < 3; ++ j)
+    if(max[j] - min[j] > size)
+      size = max[j] - min[j];
+  scale = (size > 0.0f) ? (CTMfloat) (1 << _CTM_LEVEL_MAX_DEPTH) / size : 0.0f;
+  for(i = 0; i < self->mVertexCount; ++ i)
+  {
+    records[i * 3] = records[i * 3 + 1] = 0;
+    for(j = 0; j < 3; ++ j)
+    {
+      c = (CTMuint) ((self->mVertices[(size_t) i * self->mVertexStride + j] -
+                      min[j]) * scale);
+      if(c > (1 << _CTM_LEVEL_MAX_DEPTH) - 1)
+        c = (1 << _CTM_LEVEL_MAX_DEPTH) - 1;
+      records[i * 3] |= _ctmSpreadBits(c >> 8) << j;
+      records[i * 3 + 1] |= _ctmSpreadBits(c & 255) << j;
+    }
+    records[i * 3 + 2] = i;
+  }
+  if(!_ctmRadixSort(self->mScratch, (void *) records, self->mVertexCount, 3, 0, 1, CTM_FALSE))
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+
+  // Find the depth at which each vertex is split from the previous vertex,
+  // and count the clusters at each depth
+  memset(counts, 0, sizeof(counts));
+  split[0] = 0;
+  for(i = 1; i < self->mVertexCount; ++ i)
+  {
+    if((c = records[i * 3] ^ records[i * 3 - 3]) != 0)
+      h = 24 + _ctmHighBit(c);
+    else if((c = records[i * 3 + 1] ^ records[i * 3 - 2]) != 0)
+      h = _ctmHighBit(c);
+    else
+      h = 0xffffffff;
+    split[i] = (h == 0xffffffff) ? _CTM_LEVEL_MAX_DEPTH + 1 :
+                                   (unsigned char) ((3 * _CTM_LEVEL_MAX_DEPTH + 2 - h) / 3);
+    ++ counts[split[i]];
+  }
+  counts[0] = 1;
+  for(k = 1; k <= _CTM_LEVEL_MAX_DEPTH; ++ k)
+    counts[k] += counts[k - 1];
+
+  // Pick the depth of each coarse level, from the finest level to the
+  // coarsest level: the deepest depth that has at most 1/8 of the vertices of
+  // the next level
+  levels = self->mProgressiveLevels;
+  levelCount = 0;
+  k = _CTM_LEVEL_MAX_DEPTH + 1;
+  target = self->mVertexCount;
+  for(l = 0; l < levels; ++ l)
+  {
+    target /= 8;
+    while((k > 1) && (counts[k - 1] > target))
+      -- k;
+    if((k <= 1) || (counts[k - 1] < _CTM_LEVEL_MIN_VERTICES))
+      break;
+    depths[levelCount ++] = -- k;
+  }
+
+  // Save the coarse levels, coarsest first (levels where all the triangles
+  // collapse are dropped)
+  j = 0;
+  for(l = levelCount; l -- > 0;)
+  {
+    if(!_ctmSaveLevel(self, records, split, depths[l], size,
+                      &vertexCounts[j], &triangleCounts[j], &bufs[j]))
+      goto cleanup;
+    if(triangleCounts[j] > 0)
+      ++ j;
+  }
+  levelCount = j;
+
+  // Save the full resolution mesh as the last level (directly to memory - its
+  // sections are not part of the section directory of the file, and the
+  // stream buffer is kept for the file)
+  writeFn = self->mWriteFn;
+  userData = self->mUserData;
+  streamPos = self->mStreamPos;
+  streamBuf = self->mStreamBuf;
+  sections = self->mSections;
+  self->mWriteFn = _ctmMemBufWrite;
+  self->mUserData = (void *) &bufs[levelCount];
+  memset(&self->mStreamBuf, 0, sizeof(_CTMstreambuf));
+  self->mSections = (_CTMsection *) 0;
+  i = _ctmSaveMesh(self);
+  self->mWriteFn = writeFn;
+  self->mUserData = userData;
+  self->mStreamPos = streamPos;
+  self->mStreamBuf = streamBuf;
+  self->mSections = sections;
+  if(!i)
+    goto cleanup;
+  if((bufs[levelCount].mSize == 0) || (bufs[levelCount].mSize > 0xffffffff))
+  {
+    self->mError = bufs[levelCount].mSize ? CTM_INVALID_MESH : CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+  vertexCounts[levelCount] = self->mVertexCount;
+  triangleCounts[levelCount] = self->mTriangleCount;
+  ++ levelCount;
+
+  // Write the file header (with the counts of the full resolution mesh)
+  flags = 0;
+  if(self->mNormals)
+    flags |= _CTM_HAS_NORMALS_BIT;
+  _ctmStreamWrite(self, (void *) "OCTM", 4);
+  _ctmStreamWriteUINT(self, _CTM_FORMAT_VERSION);
+  _ctmStreamWrite(self, (void *) "PROG", 4);
+  _ctmStreamWriteUINT(self, self->mVertexCount);
+  _ctmStreamWriteUINT(self, self->mTriangleCount);
+  _ctmStreamWriteUINT(self, self->mUVMapCount);
+  _ctmStreamWriteUINT(self, self->mAttribMapCount);
+  _ctmStreamWriteUINT(self, flags);
+  _ctmStreamWriteSTRING(self, self->mFileComment);
+
+  // Write the level index
+  _ctmStreamWriteSection(self, "LIDX", 0);
+  _ctmStreamWriteUINT(self, levelCount);
+  for(l = 0; l < levelCount; ++ l)
+  {
+    _ctmStreamWriteUINT(self, vertexCounts[l]);
+    _ctmStreamWriteUINT(self, triangleCounts[l]);
+    _ctmStreamWriteUINT(self, (CTMuint) bufs[l].mSize);
+  }
+
+  // Write the levels
+  for(l = 0; l < levelCount; ++ l)
+  {
+    _ctmAddSection(self, FOURCC("OCTM"), self->mStreamPos, 0);
+    if(_ctmStreamWrite(self, (void *) bufs[l].mData, (CTMuint) bufs[l].mSize) !=
+       (CTMuint) bufs[l].mSize)
+    {
+      self->mError = CTM_FILE_ERROR;
+      goto cleanup;
+    }
+  }
+  result = CTM_TRUE;
+
+cleanup:
+  for(l = 0; l < _CTM_LEVEL_MAX_COUNT; ++ l)
+    _ctmFree(&self->mAllocator, bufs[l].mData);
+  _ctmScratchFree(self->mScratch, split);
+  _ctmScratchFree(self->mScratch, records);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReadLevelIndex() - Read the level index of a progressive file (the file
+// header has already been read). aIndex receives the vertex count, triangle
+// count and data size of each level (room for _CTM_LEVEL_MAX_COUNT levels is
+// needed). The number of levels is returned (0 on error).
+//-----------------------------------------------------------------------------
+CTMuint _ctmReadLevelIndex(_CTMcontext * self, CTMuint * aIndex)
+{
+  CTMuint i, count;
+
+  if(_ctmStreamReadUINT(self) != FOURCC("LIDX"))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return 0;
+  }
+  count = _ctmStreamReadUINT(self);
+  if((count == 0) || (count > _CTM_LEVEL_MAX_COUNT))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return 0;
+  }
+  for(i = 0; i < count * 3; ++ i)
+    aIndex[i] = _ctmStreamReadUINT(self);
+
+  // The last level is the full resolution mesh of the file header
+  if((aIndex[count * 3 - 3] != self->mVertexCount) ||
+     (aIndex[count * 3 - 2] != self->mTriangleCount))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return 0;
+  }
+
+  return count;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLoadLevels() - Load the level index of a progressive file (the file
+// header has already been read), and then the levels. The coarse levels are
+// only loaded if a level callback has been set (see ctmLevelCallback()),
+// otherwise they are skipped.
+//-----------------------------------------------------------------------------
+int _ctmLoadLevels(_CTMcontext * self)
+{
+  CTMuint index[_CTM_LEVEL_MAX_COUNT * 3], count, i;
+  char * comment;
+  int result;
+
+  // Read the level index
+  count = _ctmReadLevelIndex(self, index);
+  if(!count)
+    return CTM_FALSE;
+  self->mLevelCount = count;
+
+  for(i = 0; i < count; ++ i)
+  {
+    // Skip the coarse levels if nobody is interested in them
+    if((i < count - 1) && !self->mLevelFn)
+    {
+      if(!_ctmStreamSkip(self, index[i * 3 + 2]))
+        return CTM_FALSE;
+      continue;
+    }
+
+    // Load the level into this context (keeping the file comment of the
+    // progressive file)
+    comment = self->mFileComment;
+    self->mFileComment = (char *) 0;
+    result = _ctmLoadSubMesh(self, self, index[i * 3 + 2], index[i * 3],
+                             index[i * 3 + 1]);
+    if(self->mFileComment)
+      _ctmFree(&self->mAllocator, self->mFileComment);
+    self->mFileComment = comment;
+    if(!result)
+      return CTM_FALSE;
+
+    // Hand the level over to the caller (who may stop the loading)
+    if(self->mLevelFn &&
+       !self->mLevelFn((CTMcontext) self, i, count, self->mLevelUserData))
+      break;
+  }
+
+  return CTM_TRUE;
+}
@@ -0,0 +1,326 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        scratch.c
+// Description: Memory management: the memory allocation functions of a
+//              context, and scratch memory for the temporary arrays that are
+//              needed while saving and loading meshes.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+// Size of the block header (keeps the blocks 16-byte aligned)
+#define _CTM_SCRATCH_HEADER 16
+
+// Block header value of mPrev for blocks that live on the heap
+#define _CTM_SCRATCH_HEAP ((size_t) -1)
+
+// Bit of mSize that marks a freed block (that is still on the stack)
+#define _CTM_SCRATCH_FREED 1
+
+
+//-----------------------------------------------------------------------------
+// _ctmAlloc() - Allocate memory with the allocation function of a context
+// (like malloc()).
+//-----------------------------------------------------------------------------
+void * _ctmAlloc(_CTMallocator * aAllocator, size_t aSize)
+{
+  if(aAllocator->mAllocFn)
+    return aAllocator->mAllocFn(aSize > 0 ? aSize : 1, aAllocator->mUserData);
+  return malloc(aSize > 0 ? aSize : 1);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmCalloc() - Allocate zero filled memory with the allocation function of
+// a context.
+//-----------------------------------------------------------------------------
+void * _ctmCalloc(_CTMallocator * aAllocator, size_t aSize)
+{
+  void * ptr = _ctmAlloc(aAllocator, aSize);
+  if(ptr)
+    memset(ptr, 0, aSize);
+  return ptr;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmRealloc() - Change the size of memory that was allocated with
+// _ctmAlloc() (like realloc(), but the old size must be given, since custom
+// allocators have no realloc function).
+//-----------------------------------------------------------------------------
+void * _ctmRealloc(_CTMallocator * aAllocator, void * aPtr, size_t aOldSize,
+  size_t aSize)
+{
+  void * ptr;
+
+  if(!aAllocator->mAllocFn)
+    return realloc(aPtr, aSize > 0 ? aSize : 1);
+  ptr = _ctmAlloc(aAllocator, aSize);
+  if(!ptr)
+    return (void *) 0;
+  if(aPtr)
+  {
+    memcpy(ptr, aPtr, aOldSize < aSize ? aOldSize : aSize);
+    _ctmFree(aAllocator, aPtr);
+  }
+  return ptr;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFree() - Free memory that was allocated with _ctmAlloc() (like free()).
+//-----------------------------------------------------------------------------
+void _ctmFree(_CTMallocator * aAllocator, void * aPtr)
+{
+  if(!aPtr)
+    return;
+  if(aAllocator->mFreeFn)
+    aAllocator->mFreeFn(aPtr, aAllocator->mUserData);
+  else
+    free(aPtr);
+}
+
+//-----------------------------------------------------------------------------
+// _CTMscratchblock - Header of a scratch memory block.
+//-----------------------------------------------------------------------------
+typedef struct {
+  size_t mPrev;  // Offset of the block below on the stack (or _CTM_SCRATCH_HEAP)
+  size_t mSize;  // Size of the block, including the header
+} _CTMscratchblock;
+
+//-----------------------------------------------------------------------------
+// _ctmScratchBlock() - Get the header of a scratch memory block.
+//-----------------------------------------------------------------------------
+static _CTMscratchblock * _ctmScratchBlock(void * aPtr)
+{
+  return (_CTMscratchblock *) ((unsigned char *) aPtr - _CTM_SCRATCH_HEADER);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmUpdatePeak() - Update the peak scratch memory usage (call with the lock
+// held).
+//-----------------------------------------------------------------------------
+static void _ctmUpdatePeak(_CTMscratch * aScratch)
+{
+  if(aScratch->mUsed + aScratch->mHeapUsed > aScratch->mPeak)
+    aScratch->mPeak = aScratch->mUsed + aScratch->mHeapUsed;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmInitScratch() - Initialize an empty scratch memory (no reserved
+// memory) that takes its memory from aAllocator. Returns CTM_FALSE if out of
+// memory.
+//-----------------------------------------------------------------------------
+int _ctmInitScratch(_CTMscratch * aScratch, _CTMallocator * aAllocator)
+{
+  memset(aScratch, 0, sizeof(_CTMscratch));
+  aScratch->mAllocator = aAllocator;
+  aScratch->mLock = _ctmNewLock();
+  return aScratch->mLock ? CTM_TRUE : CTM_FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFreeScratch() - Free the reserved memory and the lock of a scratch
+// memory (all blocks must have been freed).
+//-----------------------------------------------------------------------------
+void _ctmFreeScratch(_CTMscratch * aScratch)
+{
+  if(aScratch->mBase)
+    _ctmFree(aScratch->mAllocator, aScratch->mBase);
+  _ctmFreeLock(aScratch->mLock);
+  memset(aScratch, 0, sizeof(_CTMscratch));
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReserveScratch() - Replace the reserved memory of a scratch memory with
+// aSize bytes (zero frees it). This can only be done when no blocks are taken
+// from the reserved memory. Returns CTM_FALSE if out of memory (then there is
+// no reserved memory).
+//-----------------------------------------------------------------------------
+int _ctmReserveScratch(_CTMscratch * aScratch, size_t aSize)
+{
+  if(aScratch->mBase)
+    _ctmFree(aScratch->mAllocator, aScratch->mBase);
+  aScratch->mBase = (unsigned char *) 0;
+  aScratch->mSize = 0;
+  aScratch->mUsed = 0;
+  if(aSize > 0)
+  {
+    aScratch->mBase = (unsigned char *) _ctmAlloc(aScratch->mAllocator, aSize);
+    if(!aScratch->mBase)
+      return CTM_FALSE;
+    aScratch->mSize = aSize;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmScratchAlloc() - Allocate a block of scratch memory (like malloc()).
+// Several threads may allocate and free blocks concurrently.
+//-----------------------------------------------------------------------------
+void * _ctmScratchAlloc(_CTMscratch * aScratch, size_t aSize)
+{
+  _CTMscratchblock * block;
+  size_t size;
+
+  // Size of the block (including the header, rounded up to the alignment)
+  if(aSize > ((size_t) -1) - 2 * _CTM_SCRATCH_HEADER)
+    return (void *) 0;
+  size = _CTM_SCRATCH_HEADER + ((aSize + _CTM_SCRATCH_HEADER - 1) &
+         ~((size_t) _CTM_SCRATCH_HEADER - 1));
+
+  // Take the block from the reserved memory, if it fits
+  _ctmLock(aScratch->mLock);
+  if(size <= aScratch->mSize - aScratch->mUsed)
+  {
+    block = (_CTMscratchblock *) &aScratch->mBase[aScratch->mUsed];
+    block->mPrev = aScratch->mTop;
+    block->mSize = size;
+    aScratch->mTop = aScratch->mUsed;
+    aScratch->mUsed += size;
+    _ctmUpdatePeak(aScratch);
+    _ctmUnlock(aScratch->mLock);
+    return (void *) ((unsigned char *) block + _CTM_SCRATCH_HEADER);
+  }
+  _ctmUnlock(aScratch->mLock);
+
+  // ...otherwise allocate it on the heap
+  block = (_CTMscratchblock *) _ctmAlloc(aScratch->mAllocator, size);
+  if(!block)
+    return (void *) 0;
+  block->mPrev = _CTM_SCRATCH_HEAP;
+  block->mSize = size;
+  _ctmLock(aScratch->mLock);
+  aScratch->mHeapUsed += size;
+  _ctmUpdatePeak(aScratch);
+  _ctmUnlock(aScratch->mLock);
+  return (void *) ((unsigned char *) block + _CTM_SCRATCH_HEADER);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmScratchCalloc() - Allocate a zero filled block of scratch memory.
+//-----------------------------------------------------------------------------
+void * _ctmScratchCalloc(_CTMscratch * aScratch, size_t aSize)
+{
+  void * ptr = _ctmScratchAlloc(aScratch, aSize);
+  if(ptr)
+    memset(ptr, 0, aSize);
+  return ptr;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmScratchRealloc() - Change the size of a block of scratch memory (like
+// realloc()). The top block of the stack is resized in place.
+//-----------------------------------------------------------------------------
+void * _ctmScratchRealloc(_CTMscratch * aScratch, void * aPtr, size_t aSize)
+{
+  _CTMscratchblock * block;
+  size_t size, oldSize;
+  void * ptr;
+
+  if(!aPtr)
+    return _ctmScratchAlloc(aScratch, aSize);
+  if(aSize > ((size_t) -1) - 2 * _CTM_SCRATCH_HEADER)
+    return (void *) 0;
+  size = _CTM_SCRATCH_HEADER + ((aSize + _CTM_SCRATCH_HEADER - 1) &
+         ~((size_t) _CTM_SCRATCH_HEADER - 1));
+  block = _ctmScratchBlock(aPtr);
+  oldSize = block->mSize;
+
+  // Heap block?
+  if(block->mPrev == _CTM_SCRATCH_HEAP)
+  {
+    block = (_CTMscratchblock *) _ctmRealloc(aScratch->mAllocator,
+                                             (void *) block, oldSize, size);
+    if(!block)
+      return (void *) 0;
+    block->mSize = size;
+    _ctmLock(aScratch->mLock);
+    aScratch->mHeapUsed = aScratch->mHeapUsed - oldSize + size;
+    _ctmUpdatePeak(aScratch);
+    _ctmUnlock(aScratch->mLock);
+    return (void *) ((unsigned char *) block + _CTM_SCRATCH_HEADER);
+  }
+
+  // Top block of the stack (that fits in the reserved memory)?
+  _ctmLock(aScratch->mLock);
+  if(((unsigned char *) block == &aScratch->mBase[aScratch->mTop]) &&
+     (size <= aScratch->mSize - aScratch->mTop))
+  {
+    block->mSize = size;
+    aScratch->mUsed = aScratch->mTop + size;
+    _ctmUpdatePeak(aScratch);
+    _ctmUnlock(aScratch->mLock);
+    return aPtr;
+  }
+  _ctmUnlock(aScratch->mLock);
+
+  // Other blocks can only shrink in place
+  if(size <= oldSize)
+    return aPtr;
+  ptr = _ctmScratchAlloc(aScratch, aSize);
+  if(!ptr)
+    return (void *) 0;
+  memcpy(ptr, aPtr, oldSize - _CTM_SCRATCH_HEADER);
+  _ctmScratchFree(aScratch, aPtr);
+  return ptr;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmScratchFree() - Free a block of scratch memory (like free()). Blocks in
+// the reserved memory are given back when all blocks above them on the stack
+// have been freed too.
+//-----------------------------------------------------------------------------
+void _ctmScratchFree(_CTMscratch * aScratch, void * aPtr)
+{
+  _CTMscratchblock * block;
+
+  if(!aPtr)
+    return;
+  block = _ctmScratchBlock(aPtr);
+
+  // Heap block?
+  if(block->mPrev == _CTM_SCRATCH_HEAP)
+  {
+    _ctmLock(aScratch->mLock);
+    aScratch->mHeapUsed -= block->mSize;
+    _ctmUnlock(aScratch->mLock);
+    _ctmFree(aScratch->mAllocator, (void *) block);
+    return;
+  }
+
+  // Mark the block as freed, and pop all freed blocks from the top of the
+  // stack
+  _ctmLock(aScratch->mLock);
+  block->mSize |= _CTM_SCRATCH_FREED;
+  while(aScratch->mUsed > 0)
+  {
+    block = (_CTMscratchblock *) &aScratch->mBase[aScratch->mTop];
+    if(!(block->mSize & _CTM_SCRATCH_FREED))
+      break;
+    aScratch->mUsed = aScratch->mTop;
+    aScratch->mTop = block->mPrev;
+  }
+  _ctmUnlock(aScratch->mLock);
+}
@@ -0,0 +1,149 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        sort.c
+// Description: Stable LSD radix sorting of fixed size records (used for
+//              re-arranging vertices and triangles before compression).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+
+//-----------------------------------------------------------------------------
+// _ctmRadixKey() - Get the 32-bit sort key of a record word. Floats are mapped
+// to unsigned integers with the same ordering (with -0 and +0 being equal).
+//-----------------------------------------------------------------------------
+static CTMuint _ctmRadixKey(CTMuint aWord, CTMint aFloat)
+{
+  if(!aFloat)
+    return aWord;
+  if((aWord & 0x7fffffff) == 0)
+    return 0x80000000;
+  if(aWord & 0x80000000)
+    return ~aWord;
+  return aWord | 0x80000000;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmRadixSort() - Sort aCount records of aSize 32-bit words each. The
+// records are sorted by word aKey1 (unsigned integer), and secondly by word
+// aKey2 (unsigned integer, or float if aFloatKey2 is CTM_TRUE). The sort is
+// stable (records with equal keys keep their relative order), which gives
+// the same result as a stable comparison sort (e.g. the merge sort that
+// qsort() uses in glibc) regardless of the platform.
+// The temporary memory is taken from aScratch. Returns CTM_FALSE if it could
+// not be allocated, in which case the records are left untouched.
+//-----------------------------------------------------------------------------
+int _ctmRadixSort(_CTMscratch * aScratch, void * aRecords, CTMuint aCount,
+  CTMuint aSize, CTMuint aKey1, CTMuint aKey2, CTMint aFloatKey2)
+{
+  CTMuint * src, * dst, * tmp, * counts, * hist, * rec;
+  CTMuint keyWord[2], key, i, k, pass, shift, word, sum, c;
+  CTMint keyFloat[2], isFloat;
+
+  if(aCount < 2)
+    return CTM_TRUE;
+
+  // Key words (secondary key first)
+  keyWord[0] = aKey2;
+  keyWord[1] = aKey1;
+  keyFloat[0] = aFloatKey2;
+  keyFloat[1] = CTM_FALSE;
+
+  // Allocate the temporary record array and the digit histograms (eight
+  // 8-bit digits: four for the secondary key, then four for the primary key)
+  tmp = (CTMuint *) _ctmScratchAlloc(aScratch, sizeof(CTMuint) * aCount * aSize);
+  if(!tmp)
+    return CTM_FALSE;
+  counts = (CTMuint *) _ctmScratchCalloc(aScratch, sizeof(CTMuint) * 8 * 256);
+  if(!counts)
+  {
+    _ctmScratchFree(aScratch, tmp);
+    return CTM_FALSE;
+  }
+
+  // Build all histograms in a single pass
+  rec = (CTMuint *) aRecords;
+  for(i = 0; i < aCount; ++ i, rec += aSize)
+  {
+    for(k = 0; k < 2; ++ k)
+    {
+      key = _ctmRadixKey(rec[keyWord[k]], keyFloat[k]);
+      ++ counts[(k * 4 + 0) * 256 + (key & 255)];
+      ++ counts[(k * 4 + 1) * 256 + ((key >> 8) & 255)];
+      ++ counts[(k * 4 + 2) * 256 + ((key >> 16) & 255)];
+      ++ counts[(k * 4 + 3) * 256 + (key >> 24)];
+    }
+  }
+
+  // One counting sort pass per digit, least significant digit first
+  src = (CTMuint *) aRecords;
+  dst = tmp;
+  for(pass = 0; pass < 8; ++ pass)
+  {
+    hist = &counts[pass * 256];
+    shift = (pass & 3) * 8;
+    word = keyWord[pass >> 2];
+    isFloat = keyFloat[pass >> 2];
+
+    // Skip the pass if all records have the same digit
+    key = _ctmRadixKey(src[word], isFloat);
+    if(hist[(key >> shift) & 255] == aCount)
+      continue;
+
+    // Convert the histogram to bucket start offsets
+    sum = 0;
+    for(i = 0; i < 256; ++ i)
+    {
+      c = hist[i];
+      hist[i] = sum;
+      sum += c;
+    }
+
+    // Scatter the records
+    rec = src;
+    for(i = 0; i < aCount; ++ i, rec += aSize)
+    {
+      key = _ctmRadixKey(rec[word], isFloat);
+      memcpy(&dst[(size_t) hist[(key >> shift) & 255] ++ * aSize], rec,
+             sizeof(CTMuint) * aSize);
+    }
+
+    // Swap source and destination
+    rec = src;
+    src = dst;
+    dst = rec;
+  }
+
+  // Make sure that the result ends up in the caller array
+  if(src != (CTMuint *) aRecords)
+    memcpy(aRecords, src, sizeof(CTMuint) * aCount * aSize);
+
+  _ctmScratchFree(aScratch, counts);
+  _ctmScratchFree(aScratch, tmp);
+
+  return CTM_TRUE;
+}
@@ -28,6 +28,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <LzmaLib.h>
+#include <LzmaEnc.h>
+#include <LzmaDec.h>
 #include "openctm.h"
 #include "internal.h"
 
@@ -35,26 +37,249 @@
 #include <stdio.h>
 #endif
 
+// Smallest array (in bytes) that is worth a separate LZMA match finder thread
+#define _CTM_LZMA_MT_MIN_SIZE (1 << 20)
+
+//-----------------------------------------------------------------------------
+// _ctmStreamBegin() - Set up the stream buffer before a file is loaded or
+// saved through the read() or write() function of the caller (memory streams
+// and sub meshes are not buffered - sub meshes are read through the buffer of
+// their parent). A stream that can not seek is only read ahead if the caller
+// asked for it with ctmStreamBuffer(), since the data after the file would
+// otherwise be lost.
+//-----------------------------------------------------------------------------
+int _ctmStreamBegin(_CTMcontext * self)
+{
+  self->mStreamBuf.mData = (unsigned char *) 0;
+  self->mStreamBuf.mSize = 0;
+  self->mStreamBuf.mPos = 0;
+  self->mStreamBuf.mFill = 0;
+  if(self->mMemory || self->mInSubMesh || (self->mStreamBufSize == 0))
+    return CTM_TRUE;
+  if((self->mMode == CTM_IMPORT) && !self->mSeekFn && !self->mStreamBufSet)
+    return CTM_TRUE;
+
+  self->mStreamBuf.mData = (unsigned char *) _ctmAlloc(&self->mAllocator,
+    self->mStreamBufSize);
+  if(!self->mStreamBuf.mData)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  self->mStreamBuf.mSize = self->mStreamBufSize;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamFlush() - Write the contents of the stream buffer (export).
+//-----------------------------------------------------------------------------
+static int _ctmStreamFlush(_CTMcontext * self)
+{
+  CTMuint count = self->mStreamBuf.mFill;
+
+  self->mStreamBuf.mFill = 0;
+  if(count && (self->mWriteFn(self->mStreamBuf.mData, count,
+                              self->mUserData) != count))
+  {
+    self->mError = CTM_FILE_ERROR;
+    return CTM_FALSE;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamEnd() - Finish the stream after a file has been loaded or saved,
+// and free the stream buffer. Buffered data that has not been written is
+// written, and a stream that was read ahead is moved back to the end of the
+// loaded data (if it can seek).
+//-----------------------------------------------------------------------------
+int _ctmStreamEnd(_CTMcontext * self)
+{
+  int result = CTM_TRUE;
+
+  if(!self->mStreamBuf.mData)
+    return CTM_TRUE;
+
+  if(self->mMode == CTM_EXPORT)
+    result = _ctmStreamFlush(self);
+  else if(self->mSeekFn && (self->mStreamBuf.mPos < self->mStreamBuf.mFill))
+    self->mSeekFn(self->mStreamPos, self->mUserData);
+
+  _ctmFree(&self->mAllocator, self->mStreamBuf.mData);
+  self->mStreamBuf.mData = (unsigned char *) 0;
+  self->mStreamBuf.mSize = 0;
+  self->mStreamBuf.mPos = 0;
+  self->mStreamBuf.mFill = 0;
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamBufRead() - Read data through a stream buffer (aBuf->mData may be
+// NULL, in which case the data is read directly). Reads that are at least as
+// large as the buffer bypass it.
+//-----------------------------------------------------------------------------
+CTMuint _ctmStreamBufRead(_CTMstreambuf * aBuf, CTMreadfn aReadFn,
+  void * aUserData, void * aData, CTMuint aCount)
+{
+  unsigned char * dst = (unsigned char *) aData;
+  CTMuint count, total = 0;
+
+  if(!aBuf->mData)
+    return aReadFn(aData, aCount, aUserData);
+
+  while(aCount > 0)
+  {
+    // Take what is left in the buffer
+    if(aBuf->mPos < aBuf->mFill)
+    {
+      count = aBuf->mFill - aBuf->mPos;
+      if(count > aCount)
+        count = aCount;
+      memcpy(dst, &aBuf->mData[aBuf->mPos], count);
+      aBuf->mPos += count;
+      dst += count;
+      aCount -= count;
+      total += count;
+      continue;
+    }
+
+    // Large reads go straight to the destination
+    if(aCount >= aBuf->mSize)
+    {
+      total += aReadFn((void *) dst, aCount, aUserData);
+      break;
+    }
+
+    // Refill the buffer
+    aBuf->mPos = 0;
+    aBuf->mFill = aReadFn((void *) aBuf->mData, aBuf->mSize, aUserData);
+    if(aBuf->mFill == 0)
+      break;
+  }
+  return total;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamBufSeek() - Move a read stream from position aPos to aOffset (both
+// in bytes from the start of the file). Positions that are in the stream
+// buffer need no seek. Returns CTM_FALSE (and leaves the stream as it was) if
+// the stream can not seek.
+//-----------------------------------------------------------------------------
+int _ctmStreamBufSeek(_CTMstreambuf * aBuf, CTMseekfn aSeekFn,
+  void * aUserData, size_t aPos, size_t aOffset)
+{
+  size_t start = aPos - aBuf->mPos;
+
+  if((aOffset >= start) && (aOffset - start <= (size_t) aBuf->mFill))
+  {
+    aBuf->mPos = (CTMuint) (aOffset - start);
+    return CTM_TRUE;
+  }
+  if(!aSeekFn || !aSeekFn(aOffset, aUserData))
+    return CTM_FALSE;
+  aBuf->mPos = 0;
+  aBuf->mFill = 0;
+  return CTM_TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // _ctmStreamRead() - Read data from a stream.
 //-----------------------------------------------------------------------------
 CTMuint _ctmStreamRead(_CTMcontext * self, void * aBuf, CTMuint aCount)
 {
+  // Reading from a memory stream?
+  if(self->mMemory)
+  {
+    if((size_t) aCount > self->mMemorySize - self->mMemoryPos)
+      aCount = (CTMuint) (self->mMemorySize - self->mMemoryPos);
+    memcpy(aBuf, &self->mMemory[self->mMemoryPos], aCount);
+    self->mMemoryPos += aCount;
+    return aCount;
+  }
+
   if(!self->mUserData || !self->mReadFn)
     return 0;
 
-  return self->mReadFn(aBuf, aCount, self->mUserData);
+  aCount = _ctmStreamBufRead(&self->mStreamBuf, self->mReadFn,
+                             self->mUserData, aBuf, aCount);
+  self->mStreamPos += aCount;
+  return aCount;
 }
 
 //-----------------------------------------------------------------------------
-// _ctmStreamWrite() - Write data to a stream.
+// _ctmStreamSkip() - Skip aCount bytes of a stream (data that is not loaded).
+//-----------------------------------------------------------------------------
+int _ctmStreamSkip(_CTMcontext * self, CTMuint aCount)
+{
+  unsigned char buf[4096];
+  CTMuint count;
+
+  // Memory stream?
+  if(self->mMemory)
+  {
+    if(aCount > self->mMemorySize - self->mMemoryPos)
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return CTM_FALSE;
+    }
+    self->mMemoryPos += aCount;
+    return CTM_TRUE;
+  }
+
+  // Within the stream buffer, or a seekable stream? (other short distances
+  // are read, which is usually faster than a seek)
+  if(((aCount <= self->mStreamBuf.mFill - self->mStreamBuf.mPos) ||
+      (self->mSeekFn && (aCount > sizeof(buf)))) &&
+     _ctmStreamBufSeek(&self->mStreamBuf, self->mSeekFn, self->mUserData,
+                       self->mStreamPos, self->mStreamPos + aCount))
+  {
+    self->mStreamPos += aCount;
+    return CTM_TRUE;
+  }
+
+  while(aCount > 0)
+  {
+    count = aCount < sizeof(buf) ? aCount : (CTMuint) sizeof(buf);
+    if(_ctmStreamRead(self, (void *) buf, count) != count)
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return CTM_FALSE;
+    }
+    aCount -= count;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamWrite() - Write data to a stream (through the stream buffer, if
+// there is one - writes that do not fit in the buffer bypass it).
 //-----------------------------------------------------------------------------
 CTMuint _ctmStreamWrite(_CTMcontext * self, void * aBuf, CTMuint aCount)
 {
+  _CTMstreambuf * buf = &self->mStreamBuf;
+  CTMuint count;
+
   if(!self->mUserData || !self->mWriteFn)
     return 0;
 
-  return self->mWriteFn(aBuf, aCount, self->mUserData);
+  if(buf->mData && (aCount < buf->mSize))
+  {
+    if((aCount > buf->mSize - buf->mFill) && !_ctmStreamFlush(self))
+      return 0;
+    memcpy(&buf->mData[buf->mFill], aBuf, aCount);
+    buf->mFill += aCount;
+  }
+  else
+  {
+    if(buf->mFill && !_ctmStreamFlush(self))
+      return 0;
+    count = self->mWriteFn(aBuf, aCount, self->mUserData);
+    if(count != aCount)
+      self->mError = CTM_FILE_ERROR;
+    aCount = count;
+  }
+  self->mStreamPos += aCount;
+  return aCount;
 }
 
 //-----------------------------------------------------------------------------
@@ -85,6 +310,19 @@ void _ctmStreamWriteUINT(_CTMcontext * self, CTMuint aValue)
   _ctmStreamWrite(self, (void *) buf, 4);
 }
 
+//-----------------------------------------------------------------------------
+// _ctmStreamWriteSection() - Write the four character code that starts a
+// section (e.g. "VERT") to a stream, and add the section to the section
+// directory of the file, if one is written (see ctmSectionDirectory()).
+// aUnpackedSize is the size of the data array of the section (bytes).
+//-----------------------------------------------------------------------------
+void _ctmStreamWriteSection(_CTMcontext * self, const char * aID,
+  size_t aUnpackedSize)
+{
+  _ctmAddSection(self, FOURCC(aID), self->mStreamPos, aUnpackedSize);
+  _ctmStreamWrite(self, (void *) aID, 4);
+}
+
 //-----------------------------------------------------------------------------
 // _ctmStreamReadFLOAT() - Read a floating point value from a stream in a
 // machine endian independent manner (for portability).
@@ -113,6 +351,152 @@ void _ctmStreamWriteFLOAT(_CTMcontext * self, CTMfloat aValue)
   _ctmStreamWriteUINT(self, u.i);
 }
 
+//-----------------------------------------------------------------------------
+// _ctmLittleEndian() - CTM_TRUE if the host stores 32-bit words with the least
+// significant byte first (the byte order of the stream).
+//-----------------------------------------------------------------------------
+static int _ctmLittleEndian(void)
+{
+  const CTMuint one = 1;
+  return *((const unsigned char *) &one) == 1;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamReadArray() - Read aCount elements of aSize 32-bit words each
+// (integers or floats) from a stream, and store them in aData with aStride
+// words between the elements. On little endian hosts, a tightly packed array
+// is read directly into aData in one go; otherwise the words are read into a
+// small buffer and byte swapped/scattered from there.
+//-----------------------------------------------------------------------------
+int _ctmStreamReadArray(_CTMcontext * self, void * aData, CTMuint aCount,
+  CTMuint aSize, CTMuint aStride)
+{
+  unsigned char buf[4096], * dst = (unsigned char *) aData;
+  const unsigned char * src;
+  CTMuint count, i, j, w;
+
+  // Tightly packed array on a little endian host?
+  if(_ctmLittleEndian() && (aStride == aSize))
+  {
+    while(aCount > 0)
+    {
+      count = aCount < 0x40000000 / (aSize * 4) ? aCount :
+              0x40000000 / (aSize * 4);
+      if(_ctmStreamRead(self, (void *) dst, count * aSize * 4) !=
+         count * aSize * 4)
+      {
+        self->mError = CTM_BAD_FORMAT;
+        return CTM_FALSE;
+      }
+      dst += (size_t) count * aSize * 4;
+      aCount -= count;
+    }
+    return CTM_TRUE;
+  }
+
+  while(aCount > 0)
+  {
+    count = (CTMuint) sizeof(buf) / (aSize * 4);
+    if(count > aCount)
+      count = aCount;
+    if(_ctmStreamRead(self, (void *) buf, count * aSize * 4) !=
+       count * aSize * 4)
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return CTM_FALSE;
+    }
+    src = buf;
+    for(i = 0; i < count; ++ i)
+    {
+      for(j = 0; j < aSize; ++ j)
+      {
+        w = ((CTMuint) src[0]) | (((CTMuint) src[1]) << 8) |
+            (((CTMuint) src[2]) << 16) | (((CTMuint) src[3]) << 24);
+        memcpy(&dst[((size_t) i * aStride + j) * 4], &w, 4);
+        src += 4;
+      }
+    }
+    dst += (size_t) count * aStride * 4;
+    aCount -= count;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamSkipArray() - Skip aCount elements of aSize 32-bit words each of a
+// stream (an array that is not loaded). The array is skipped in parts, so
+// that the byte count of each part fits in a CTMuint.
+//-----------------------------------------------------------------------------
+int _ctmStreamSkipArray(_CTMcontext * self, CTMuint aCount, CTMuint aSize)
+{
+  CTMuint count;
+
+  while(aCount > 0)
+  {
+    count = aCount < 0x40000000 / (aSize * 4) ? aCount :
+            0x40000000 / (aSize * 4);
+    if(!_ctmStreamSkip(self, count * aSize * 4))
+      return CTM_FALSE;
+    aCount -= count;
+  }
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamWriteArray() - Write aCount elements of aSize 32-bit words each
+// (integers or floats) to a stream, taken from aData with aStride words
+// between the elements (see _ctmStreamReadArray()).
+//-----------------------------------------------------------------------------
+int _ctmStreamWriteArray(_CTMcontext * self, const void * aData,
+  CTMuint aCount, CTMuint aSize, CTMuint aStride)
+{
+  unsigned char buf[4096], * dst;
+  const unsigned char * src = (const unsigned char *) aData;
+  CTMuint count, i, j, w;
+
+  // Tightly packed array on a little endian host?
+  if(_ctmLittleEndian() && (aStride == aSize))
+  {
+    while(aCount > 0)
+    {
+      count = aCount < 0x40000000 / (aSize * 4) ? aCount :
+              0x40000000 / (aSize * 4);
+      if(_ctmStreamWrite(self, (void *) src, count * aSize * 4) !=
+         count * aSize * 4)
+        return CTM_FALSE;
+      src += (size_t) count * aSize * 4;
+      aCount -= count;
+    }
+    return CTM_TRUE;
+  }
+
+  while(aCount > 0)
+  {
+    count = (CTMuint) sizeof(buf) / (aSize * 4);
+    if(count > aCount)
+      count = aCount;
+    dst = buf;
+    for(i = 0; i < count; ++ i)
+    {
+      for(j = 0; j < aSize; ++ j)
+      {
+        memcpy(&w, &src[((size_t) i * aStride + j) * 4], 4);
+        dst[0] = w & 0x000000ff;
+        dst[1] = (w >> 8) & 0x000000ff;
+        dst[2] = (w >> 16) & 0x000000ff;
+        dst[3] = (w >> 24) & 0x000000ff;
+        dst += 4;
+      }
+    }
+    if(_ctmStreamWrite(self, (void *) buf, count * aSize * 4) !=
+       count * aSize * 4)
+      return CTM_FALSE;
+    src += (size_t) count * aStride * 4;
+    aCount -= count;
+  }
+  return CTM_TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // _ctmStreamReadSTRING() - Read a string value from a stream. The format of
 // the string in the stream is: an unsigned integer (string length) followed by
@@ -125,7 +509,7 @@ void _ctmStreamReadSTRING(_CTMcontext * self, char ** aValue)
   // Clear the old string
   if(*aValue)
   {
-    free(*aValue);
+    _ctmFree(&self->mAllocator, *aValue);
     *aValue = (char *) 0;
   }
 
@@ -135,7 +519,7 @@ void _ctmStreamReadSTRING(_CTMcontext * self, char ** aValue)
   // Read string
   if(len > 0)
   {
-    *aValue = (char *) malloc(len + 1);
+    *aValue = (char *) _ctmAlloc(&self->mAllocator, len + 1);
     if(*aValue)
     {
       _ctmStreamRead(self, (void *) *aValue, len);
@@ -167,6 +551,14 @@ void _ctmStreamWriteSTRING(_CTMcontext * self, const char * aValue)
     _ctmStreamWrite(self, (void *) aValue, len);
 }
 
+//-----------------------------------------------------------------------------
+// _ctmStreamSkipSTRING() - Skip a string value of a stream.
+//-----------------------------------------------------------------------------
+int _ctmStreamSkipSTRING(_CTMcontext * self)
+{
+  return _ctmStreamSkip(self, _ctmStreamReadUINT(self));
+}
+
 //-----------------------------------------------------------------------------
 // _ctmStreamReadPackedInts() - Read an compressed binary integer data array
 // from a stream, and uncompress it.
@@ -174,339 +566,496 @@ void _ctmStreamWriteSTRING(_CTMcontext * self, const char * aValue)
 int _ctmStreamReadPackedInts(_CTMcontext * self, CTMint * aData,
   CTMuint aCount, CTMuint aSize, CTMint aSignedInts)
 {
-  size_t packedSize, unpackedSize;
-  CTMuint i, k, x;
-  CTMint value;
-  unsigned char * packed, * tmp;
-  unsigned char props[5];
-  int lzmaRes;
-
-  // Read packed data size from the stream
-  packedSize = (size_t) _ctmStreamReadUINT(self);
-
-  // Read LZMA compression props from the stream
-  _ctmStreamRead(self, (void *) props, 5);
-
-  // Allocate memory and read the packed data from the stream
-  packed = (unsigned char *) malloc(packedSize);
-  if(!packed)
-  {
-    self->mError = CTM_OUT_OF_MEMORY;
+  _CTMpackjob job;
+  _ctmInitPackJob(self, &job, (void *) aData, aCount, aSize, aSignedInts,
+                  _CTM_DEST_COUNT);
+  if(!_ctmStreamReadPackJob(self, &job))
     return CTM_FALSE;
-  }
-  _ctmStreamRead(self, (void *) packed, packedSize);
-
-  // Allocate memory for interleaved array
-  tmp = (unsigned char *) malloc(aCount * aSize * 4);
-  if(!tmp)
+  if(!_ctmUnpackData(&job))
   {
-    free(packed);
-    self->mError = CTM_OUT_OF_MEMORY;
+    self->mError = job.mError;
     return CTM_FALSE;
   }
+  return CTM_TRUE;
+}
 
-  // Uncompress
-  unpackedSize = aCount * aSize * 4;
-  lzmaRes = LzmaUncompress(tmp, &unpackedSize, packed,
-                           &packedSize, props, 5);
+//-----------------------------------------------------------------------------
+// _ctmStreamWritePackedInts() - Compress a binary integer data array, and
+// write it to a stream (aSection selects the LZMA encoder parameters).
+//-----------------------------------------------------------------------------
+int _ctmStreamWritePackedInts(_CTMcontext * self, CTMint * aData,
+  CTMuint aCount, CTMuint aSize, CTMint aSignedInts, CTMuint aSection)
+{
+  _CTMpackjob job;
+  _ctmInitPackJob(self, &job, (void *) aData, aCount, aSize, aSignedInts,
+                  aSection);
+  return _ctmStreamWritePackJob(self, &job);
+}
 
-  // Free the packed array
-  free(packed);
+//-----------------------------------------------------------------------------
+// _ctmStreamReadPackedFloats() - Read an compressed binary float data array
+// from a stream, and uncompress it.
+//-----------------------------------------------------------------------------
+int _ctmStreamReadPackedFloats(_CTMcontext * self, CTMfloat * aData,
+  CTMuint aCount, CTMuint aSize)
+{
+  // Floats are packed as their raw IEEE 754 bit patterns
+  return _ctmStreamReadPackedInts(self, (CTMint *) aData, aCount, aSize, CTM_FALSE);
+}
 
-  // Error?
-  if((lzmaRes != SZ_OK) || (unpackedSize != aCount * aSize * 4))
+//-----------------------------------------------------------------------------
+// _ctmStreamWritePackedFloats() - Compress a binary float data array, and
+// write it to a stream (aSection selects the LZMA encoder parameters).
+//-----------------------------------------------------------------------------
+int _ctmStreamWritePackedFloats(_CTMcontext * self, CTMfloat * aData,
+  CTMuint aCount, CTMuint aSize, CTMuint aSection)
+{
+  _CTMpackjob job;
+
+  // Floats are packed as their raw IEEE 754 bit patterns
+  _ctmInitPackJob(self, &job, (void *) aData, aCount, aSize, CTM_FALSE,
+                  aSection);
+  return _ctmStreamWritePackJob(self, &job);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmInitPackJob() - Prepare a pack job for the given data array (aCount
+// elements of aSize 32-bit integers or floats each). aSection is the section
+// id (_CTM_DEST_* slot) that selects the LZMA encoder parameters, or
+// _CTM_DEST_COUNT for the default parameters (only used for packing).
+//-----------------------------------------------------------------------------
+void _ctmInitPackJob(_CTMcontext * self, _CTMpackjob * aJob, void * aData,
+  CTMuint aCount, CTMuint aSize, CTMint aSignedInts, CTMuint aSection)
+{
+  memset(aJob, 0, sizeof(_CTMpackjob));
+  aJob->mData = aData;
+  aJob->mCount = aCount;
+  aJob->mSize = aSize;
+  aJob->mStride = aSize;
+  aJob->mSignedInts = aSignedInts;
+  aJob->mScratch = self->mScratch;
+  aJob->mCoder = (self->mMethod == CTM_METHOD_MG3) ? _CTM_CODER_LZ : _CTM_CODER_LZMA;
+  aJob->mLevel = self->mCompressionLevel;
+  if(aSection < _CTM_DEST_COUNT)
+    aJob->mParams = self->mLZMAParams[aSection];
+  else
+    memset(&aJob->mParams, 0xff, sizeof(_CTMlzmaparams));
+
+  // Large arrays get a separate match finder thread, if the context allows
+  // more than one thread
+  aJob->mLzmaThreads = 1;
+  if((size_t) aCount * aSize * 4 >= _CTM_LZMA_MT_MIN_SIZE)
+    aJob->mLzmaThreads = _ctmSplitCount(self, 2, 1);
+
+  aJob->mError = CTM_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// Memory allocator for the LZMA encoder and decoder (takes the memory from the
+// scratch memory of the pack job).
+//-----------------------------------------------------------------------------
+typedef struct {
+  ISzAlloc mAlloc;
+  _CTMscratch * mScratch;
+} _CTMlzmaalloc;
+
+static void * _ctmLzmaAllocFn(void * p, size_t aSize)
+{
+  return _ctmScratchAlloc(((_CTMlzmaalloc *) p)->mScratch, aSize);
+}
+
+static void _ctmLzmaFreeFn(void * p, void * aAddress)
+{
+  _ctmScratchFree(((_CTMlzmaalloc *) p)->mScratch, aAddress);
+}
+
+static void _ctmInitLzmaAlloc(_CTMlzmaalloc * aAlloc, _CTMscratch * aScratch)
+{
+  aAlloc->mAlloc.Alloc = _ctmLzmaAllocFn;
+  aAlloc->mAlloc.Free = _ctmLzmaFreeFn;
+  aAlloc->mScratch = aScratch;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmPackDataLZ() - Compress the interleaved array aTmp of a pack job with
+// the fast LZ block coder. aTmp is freed.
+//-----------------------------------------------------------------------------
+static int _ctmPackDataLZ(_CTMpackjob * aJob, unsigned char * aTmp)
+{
+  size_t size, packedSize;
+  unsigned char * packed;
+
+  // Allocate memory for the packed data
+  size = (size_t) aJob->mCount * aJob->mSize * 4;
+  packed = (unsigned char *) _ctmScratchAlloc(aJob->mScratch, _ctmLZBlockBound(size));
+  if(!packed)
   {
-    self->mError = CTM_LZMA_ERROR;
-    free(tmp);
+    _ctmScratchFree(aJob->mScratch, aTmp);
+    aJob->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
 
-  // Convert interleaved array to integers
-  for(i = 0; i < aCount; ++ i)
+  // Compress
+  packedSize = _ctmLZBlockCompress(aJob->mScratch, packed, aTmp, size,
+                                   aJob->mLevel);
+  _ctmScratchFree(aJob->mScratch, aTmp);
+  if(packedSize == 0)
   {
-    for(k = 0; k < aSize; ++ k)
-    {
-      value = (CTMint) tmp[i + k * aCount + 3 * aCount * aSize] |
-              (((CTMint) tmp[i + k * aCount + 2 * aCount * aSize]) << 8) |
-              (((CTMint) tmp[i + k * aCount + aCount * aSize]) << 16) |
-              (((CTMint) tmp[i + k * aCount]) << 24);
-      // Convert signed magnitude to two's complement?
-      if(aSignedInts)
-      {
-        x = (CTMuint) value;
-        value = (x & 1) ? -(CTMint)((x + 1) >> 1) : (CTMint)(x >> 1);
-      }
-      aData[i * aSize + k] = value;
-    }
+    _ctmScratchFree(aJob->mScratch, packed);
+    aJob->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
   }
 
-  // Free the interleaved array
-  free(tmp);
+  // Give back the unused part of the packed buffer
+  aJob->mPacked = (unsigned char *) _ctmScratchRealloc(aJob->mScratch, packed, packedSize);
+  if(!aJob->mPacked)
+    aJob->mPacked = packed;
+  aJob->mPackedSize = packedSize;
 
   return CTM_TRUE;
 }
 
 //-----------------------------------------------------------------------------
-// _ctmStreamWritePackedInts() - Compress a binary integer data array, and
-// write it to a stream.
+// _ctmPackData() - Compress the data array of a pack job. The result is
+// stored in the job (the stream is not touched), which means that several
+// jobs can be packed concurrently.
 //-----------------------------------------------------------------------------
-int _ctmStreamWritePackedInts(_CTMcontext * self, CTMint * aData,
-  CTMuint aCount, CTMuint aSize, CTMint aSignedInts)
+int _ctmPackData(_CTMpackjob * aJob)
 {
-  int lzmaRes, lzmaAlgo;
-  CTMuint i, k;
-  CTMint value;
+  int lzmaRes;
+  CLzmaEncProps props;
+  _CTMlzmaalloc alloc;
+  CTMuint count, size;
   size_t bufSize, outPropsSize;
-  unsigned char * packed, outProps[5], *tmp;
-#ifdef __DEBUG_
-  CTMuint negCount = 0;  
-#endif
+  unsigned char * packed, * tmp;
+
+  count = aJob->mCount;
+  size = aJob->mSize;
 
   // Allocate memory for interleaved array
-  tmp = (unsigned char *) malloc(aCount * aSize * 4);
+  tmp = (unsigned char *) _ctmScratchAlloc(aJob->mScratch, count * size * 4);
   if(!tmp)
   {
-    self->mError = CTM_OUT_OF_MEMORY;
+    aJob->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
 
   // Convert integers to an interleaved array
-  for(i = 0; i < aCount; ++ i)
-  {
-    for(k = 0; k < aSize; ++ k)
-    {
-      value = aData[i * aSize + k];
-      // Convert two's complement to signed magnitude?
-      if(aSignedInts)
-        value = value < 0 ? -1 - (value << 1) : value << 1;
-#ifdef __DEBUG_
-      else if(value < 0)
-        ++ negCount;
-#endif
-      tmp[i + k * aCount + 3 * aCount * aSize] = value & 0x000000ff;
-      tmp[i + k * aCount + 2 * aCount * aSize] = (value >> 8) & 0x000000ff;
-      tmp[i + k * aCount + aCount * aSize] = (value >> 16) & 0x000000ff;
-      tmp[i + k * aCount] = (value >> 24) & 0x000000ff;
-    }
-  }
+  _ctmInterleaveWords(tmp, aJob->mData, count, size, aJob->mStride,
+                      aJob->mSignedInts);
+
+  // Fast LZ block coder?
+  if(aJob->mCoder == _CTM_CODER_LZ)
+    return _ctmPackDataLZ(aJob, tmp);
 
   // Allocate memory for the packed data
-  bufSize = 1000 + aCount * aSize * 4;
-  packed = (unsigned char *) malloc(bufSize);
+  bufSize = 1000 + count * size * 4;
+  packed = (unsigned char *) _ctmScratchAlloc(aJob->mScratch, bufSize);
   if(!packed)
   {
-    free(tmp);
-    self->mError = CTM_OUT_OF_MEMORY;
+    _ctmScratchFree(aJob->mScratch, tmp);
+    aJob->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
 
+  // LZMA encoder properties (values that have not been set by the user are
+  // given by the compression level)
+  LzmaEncProps_Init(&props);
+  props.level = aJob->mLevel;
+  props.algo = (aJob->mLevel < 1 ? 0 : 1);
+  props.dictSize = aJob->mParams.mDictSize > 0 ? (UInt32) aJob->mParams.mDictSize : 0;
+  props.lc = aJob->mParams.mLitContext;
+  props.lp = aJob->mParams.mLitPos;
+  props.pb = aJob->mParams.mPosBits;
+  props.fb = aJob->mParams.mFastBytes;
+  props.btMode = aJob->mParams.mMatchFinder;
+  props.numThreads = (int) aJob->mLzmaThreads;
+
   // Call LZMA to compress
   outPropsSize = 5;
-  lzmaAlgo = (self->mCompressionLevel < 1 ? 0 : 1);
-  lzmaRes = LzmaCompress(packed,
-                         &bufSize,
-                         (const unsigned char *) tmp,
-                         aCount * aSize * 4,
-                         outProps,
-                         &outPropsSize,
-                         self->mCompressionLevel, // Level (0-9)
-                         0, -1, -1, -1, -1, -1,   // Default values (set by level)
-                         lzmaAlgo                 // Algorithm (0 = fast, 1 = normal)
-                        );
+  _ctmInitLzmaAlloc(&alloc, aJob->mScratch);
+  lzmaRes = LzmaEncode(packed, &bufSize, (const unsigned char *) tmp,
+                       count * size * 4, &props, aJob->mProps, &outPropsSize,
+                       0, (ICompressProgress *) 0, &alloc.mAlloc,
+                       &alloc.mAlloc);
 
   // Free temporary array
-  free(tmp);
+  _ctmScratchFree(aJob->mScratch, tmp);
 
   // Error?
   if(lzmaRes != SZ_OK)
   {
-    self->mError = CTM_LZMA_ERROR;
-    free(packed);
+    aJob->mError = CTM_LZMA_ERROR;
+    _ctmScratchFree(aJob->mScratch, packed);
+    return CTM_FALSE;
+  }
+
+  // Give back the unused part of the packed buffer (several packed buffers
+  // may be alive at the same time)
+  aJob->mPacked = (unsigned char *) _ctmScratchRealloc(aJob->mScratch, packed,
+                                           bufSize > 0 ? bufSize : 1);
+  if(!aJob->mPacked)
+    aJob->mPacked = packed;
+  aJob->mPackedSize = bufSize;
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmPackTask() - Work item function for _ctmPackJobs().
+//-----------------------------------------------------------------------------
+static void _ctmPackTask(void * aItem)
+{
+  _ctmPackData((_CTMpackjob *) aItem);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmPackJobs() - Pack several jobs concurrently, if the context allows more
+// than one thread. In single threaded mode this does nothing, and each job is
+// instead packed on demand by _ctmStreamWritePackJob() (which keeps the
+// memory usage down).
+//-----------------------------------------------------------------------------
+void _ctmPackJobs(_CTMcontext * self, _CTMpackjob * aJobs, CTMuint aCount)
+{
+  if((self->mThreadCount != 1) && (aCount > 1))
+    _ctmRunTasks(self, _ctmPackTask, (void *) aJobs, aCount, sizeof(_CTMpackjob));
+}
+
+//-----------------------------------------------------------------------------
+// _ctmStreamWritePackJob() - Write a packed data array to a stream (the job is
+// packed first, unless that has already been done).
+//-----------------------------------------------------------------------------
+int _ctmStreamWritePackJob(_CTMcontext * self, _CTMpackjob * aJob)
+{
+  // Pack the data, if necessary
+  if(!aJob->mPacked && (aJob->mError == CTM_NONE))
+    _ctmPackData(aJob);
+
+  // Error?
+  if(aJob->mError != CTM_NONE)
+  {
+    self->mError = aJob->mError;
+    _ctmFreePackJob(aJob);
     return CTM_FALSE;
   }
 
 #ifdef __DEBUG_
-  printf("%d->%d bytes (%d negative words)\n", aCount * aSize * 4, (int) bufSize, negCount);
+  printf("%d->%d bytes\n", aJob->mCount * aJob->mSize * 4, (int) aJob->mPackedSize);
 #endif
 
   // Write packed data size to the stream
-  _ctmStreamWriteUINT(self, (CTMuint) bufSize);
+  _ctmStreamWriteUINT(self, (CTMuint) aJob->mPackedSize);
 
   // Write LZMA compression props to the stream
-  _ctmStreamWrite(self, (void *) outProps, 5);
+  if(aJob->mCoder == _CTM_CODER_LZMA)
+    _ctmStreamWrite(self, (void *) aJob->mProps, 5);
 
   // Write the packed data to the stream
-  _ctmStreamWrite(self, (void *) packed, (CTMuint) bufSize);
+  _ctmStreamWrite(self, (void *) aJob->mPacked, (CTMuint) aJob->mPackedSize);
 
   // Free the packed data
-  free(packed);
+  _ctmFreePackJob(aJob);
 
   return CTM_TRUE;
 }
 
 //-----------------------------------------------------------------------------
-// _ctmStreamReadPackedFloats() - Read an compressed binary float data array
-// from a stream, and uncompress it.
+// _ctmFreePackJob() - Free the packed data of a pack job.
 //-----------------------------------------------------------------------------
-int _ctmStreamReadPackedFloats(_CTMcontext * self, CTMfloat * aData,
-  CTMuint aCount, CTMuint aSize)
+void _ctmFreePackJob(_CTMpackjob * aJob)
 {
-  CTMuint i, k;
-  size_t packedSize, unpackedSize;
-  union {
-    CTMfloat f;
-    CTMint i;
-  } value;
-  unsigned char * packed, * tmp;
-  unsigned char props[5];
-  int lzmaRes;
+  if(aJob->mPacked)
+  {
+    if(!aJob->mPackedIsRef)
+      _ctmScratchFree(aJob->mScratch, aJob->mPacked);
+    aJob->mPacked = (unsigned char *) 0;
+  }
+  aJob->mPackedIsRef = CTM_FALSE;
+  aJob->mPackedSize = 0;
+}
 
+//-----------------------------------------------------------------------------
+// _ctmStreamReadPackJob() - Read the packed data of a pack job from a stream
+// (the data is not uncompressed, see _ctmUnpackData()). For memory streams,
+// the packed data is not copied: the job refers directly to the stream memory.
+//-----------------------------------------------------------------------------
+int _ctmStreamReadPackJob(_CTMcontext * self, _CTMpackjob * aJob)
+{
   // Read packed data size from the stream
-  packedSize = (size_t) _ctmStreamReadUINT(self);
+  aJob->mPackedSize = (size_t) _ctmStreamReadUINT(self);
 
   // Read LZMA compression props from the stream
-  _ctmStreamRead(self, (void *) props, 5);
+  if(aJob->mCoder == _CTM_CODER_LZMA)
+    _ctmStreamRead(self, (void *) aJob->mProps, 5);
+
+  // Memory stream? Then use the packed data in place
+  if(self->mMemory)
+  {
+    if(aJob->mPackedSize > self->mMemorySize - self->mMemoryPos)
+    {
+      self->mError = CTM_BAD_FORMAT;
+      aJob->mPackedSize = 0;
+      return CTM_FALSE;
+    }
+    aJob->mPacked = (unsigned char *) &self->mMemory[self->mMemoryPos];
+    aJob->mPackedIsRef = CTM_TRUE;
+    self->mMemoryPos += aJob->mPackedSize;
+    return CTM_TRUE;
+  }
 
   // Allocate memory and read the packed data from the stream
-  packed = (unsigned char *) malloc(packedSize);
-  if(!packed)
+  aJob->mPacked = (unsigned char *) _ctmScratchAlloc(aJob->mScratch,
+                   aJob->mPackedSize > 0 ? aJob->mPackedSize : 1);
+  if(!aJob->mPacked)
   {
     self->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
-  _ctmStreamRead(self, (void *) packed, packedSize);
-
-  // Allocate memory for interleaved array
-  tmp = (unsigned char *) malloc(aCount * aSize * 4);
-  if(!tmp)
+  if(_ctmStreamRead(self, (void *) aJob->mPacked, (CTMuint) aJob->mPackedSize) != aJob->mPackedSize)
   {
-    free(packed);
-    self->mError = CTM_OUT_OF_MEMORY;
+    self->mError = CTM_BAD_FORMAT;
+    _ctmFreePackJob(aJob);
     return CTM_FALSE;
   }
 
-  // Uncompress
-  unpackedSize = aCount * aSize * 4;
-  lzmaRes = LzmaUncompress(tmp, &unpackedSize, packed,
-                           &packedSize, props, 5);
+  return CTM_TRUE;
+}
 
-  // Free the packed array
-  free(packed);
+//-----------------------------------------------------------------------------
+// _ctmStreamSkipPacked() - Skip a packed data array of a stream, without
+// uncompressing it (the packed data size is stored before the data).
+//-----------------------------------------------------------------------------
+int _ctmStreamSkipPacked(_CTMcontext * self)
+{
+  CTMuint size;
 
-  // Error?
-  if((lzmaRes != SZ_OK) || (unpackedSize != aCount * aSize * 4))
-  {
-    self->mError = CTM_LZMA_ERROR;
-    free(tmp);
-    return CTM_FALSE;
-  }
+  size = _ctmStreamReadUINT(self);
 
-  // Convert interleaved array to floats
-  for(i = 0; i < aCount; ++ i)
+  // Skip the LZMA compression props too (not used by the MG3 coder)
+  if(self->mMethod != CTM_METHOD_MG3)
   {
-    for(k = 0; k < aSize; ++ k)
-    {
-      value.i = (CTMint) tmp[i + k * aCount + 3 * aCount * aSize] |
-                (((CTMint) tmp[i + k * aCount + 2 * aCount * aSize]) << 8) |
-                (((CTMint) tmp[i + k * aCount + aCount * aSize]) << 16) |
-                (((CTMint) tmp[i + k * aCount]) << 24);
-      aData[i * aSize + k] = value.f;
-    }
+    if(!_ctmStreamSkip(self, 5))
+      return CTM_FALSE;
   }
 
-  // Free the interleaved array
-  free(tmp);
-
-  return CTM_TRUE;
+  return _ctmStreamSkip(self, size);
 }
 
 //-----------------------------------------------------------------------------
-// _ctmStreamWritePackedFloats() - Compress a binary float data array, and
-// write it to a stream.
+// _ctmUnpackData() - Uncompress the packed data of a pack job into the data
+// array of the job. The packed data is freed. Only the job is touched, which
+// means that several jobs can be unpacked concurrently.
 //-----------------------------------------------------------------------------
-int _ctmStreamWritePackedFloats(_CTMcontext * self, CTMfloat * aData,
-  CTMuint aCount, CTMuint aSize)
+int _ctmUnpackData(_CTMpackjob * aJob)
 {
-  int lzmaRes, lzmaAlgo;
-  CTMuint i, k;
-  union {
-    CTMfloat f;
-    CTMint i;
-  } value;
-  size_t bufSize, outPropsSize;
-  unsigned char * packed, outProps[5], *tmp;
+  size_t packedSize, unpackedSize;
+  CTMuint count, size;
+  unsigned char * tmp;
+  int lzmaRes;
+  ELzmaStatus status;
+  _CTMlzmaalloc alloc;
+
+  count = aJob->mCount;
+  size = aJob->mSize;
 
   // Allocate memory for interleaved array
-  tmp = (unsigned char *) malloc(aCount * aSize * 4);
+  tmp = (unsigned char *) _ctmScratchAlloc(aJob->mScratch, count * size * 4);
   if(!tmp)
   {
-    self->mError = CTM_OUT_OF_MEMORY;
+    _ctmFreePackJob(aJob);
+    aJob->mError = CTM_OUT_OF_MEMORY;
     return CTM_FALSE;
   }
 
-  // Convert floats to an interleaved array
-  for(i = 0; i < aCount; ++ i)
+  // Uncompress
+  unpackedSize = count * size * 4;
+  if(aJob->mCoder == _CTM_CODER_LZ)
   {
-    for(k = 0; k < aSize; ++ k)
+    if(!_ctmLZBlockUncompress(tmp, unpackedSize, aJob->mPacked,
+                              aJob->mPackedSize))
+      aJob->mError = CTM_BAD_FORMAT;
+
+    // Free the packed array
+    _ctmFreePackJob(aJob);
+
+    // Error?
+    if(aJob->mError != CTM_NONE)
     {
-      value.f = aData[i * aSize + k];
-      tmp[i + k * aCount + 3 * aCount * aSize] = value.i & 0x000000ff;
-      tmp[i + k * aCount + 2 * aCount * aSize] = (value.i >> 8) & 0x000000ff;
-      tmp[i + k * aCount + aCount * aSize] = (value.i >> 16) & 0x000000ff;
-      tmp[i + k * aCount] = (value.i >> 24) & 0x000000ff;
+      _ctmScratchFree(aJob->mScratch, tmp);
+      return CTM_FALSE;
     }
   }
-
-  // Allocate memory for the packed data
-  bufSize = 1000 + aCount * aSize * 4;
-  packed = (unsigned char *) malloc(bufSize);
-  if(!packed)
+  else
   {
-    free(tmp);
-    self->mError = CTM_OUT_OF_MEMORY;
-    return CTM_FALSE;
+    // The decoder state is taken from the scratch memory too
+    packedSize = aJob->mPackedSize;
+    _ctmInitLzmaAlloc(&alloc, aJob->mScratch);
+    lzmaRes = LzmaDecode(tmp, &unpackedSize, aJob->mPacked, &packedSize,
+                         aJob->mProps, 5, LZMA_FINISH_ANY, &status,
+                         &alloc.mAlloc);
+
+    // Free the packed array
+    _ctmFreePackJob(aJob);
+
+    // Error?
+    if((lzmaRes != SZ_OK) || (unpackedSize != count * size * 4))
+    {
+      aJob->mError = CTM_LZMA_ERROR;
+      _ctmScratchFree(aJob->mScratch, tmp);
+      return CTM_FALSE;
+    }
   }
 
-  // Call LZMA to compress
-  outPropsSize = 5;
-  lzmaAlgo = (self->mCompressionLevel < 1 ? 0 : 1);
-  lzmaRes = LzmaCompress(packed,
-                         &bufSize,
-                         (const unsigned char *) tmp,
-                         aCount * aSize * 4,
-                         outProps,
-                         &outPropsSize,
-                         self->mCompressionLevel, // Level (0-9)
-                         0, -1, -1, -1, -1, -1,   // Default values (set by level)
-                         lzmaAlgo                 // Algorithm (0 = fast, 1 = normal)
-                        );
-
-  // Free temporary array
-  free(tmp);
+  // Convert interleaved array to integers
+  _ctmDeinterleaveWords(aJob->mData, tmp, count, size, aJob->mStride,
+                        aJob->mSignedInts);
 
-  // Error?
-  if(lzmaRes != SZ_OK)
-  {
-    self->mError = CTM_LZMA_ERROR;
-    free(packed);
-    return CTM_FALSE;
-  }
+  // Free the interleaved array
+  _ctmScratchFree(aJob->mScratch, tmp);
 
-#ifdef __DEBUG_
-  printf("%d->%d bytes\n", aCount * aSize * 4, (int) bufSize);
-#endif
+  return CTM_TRUE;
+}
 
-  // Write packed data size to the stream
-  _ctmStreamWriteUINT(self, (CTMuint) bufSize);
+//-----------------------------------------------------------------------------
+// _ctmUnpackTask() - Work item function for _ctmUnpackJobs().
+//-----------------------------------------------------------------------------
+static void _ctmUnpackTask(void * aItem)
+{
+  _ctmUnpackData((_CTMpackjob *) aItem);
+}
 
-  // Write LZMA compression props to the stream
-  _ctmStreamWrite(self, (void *) outProps, 5);
+//-----------------------------------------------------------------------------
+// _ctmUnpackJobs() - Unpack several jobs (concurrently, if the context allows
+// more than one thread). Returns CTM_FALSE and sets the context error to the
+// first failing job's error if any of the jobs failed.
+//-----------------------------------------------------------------------------
+int _ctmUnpackJobs(_CTMcontext * self, _CTMpackjob * aJobs, CTMuint aCount)
+{
+  CTMuint i;
 
-  // Write the packed data to the stream
-  _ctmStreamWrite(self, (void *) packed, (CTMuint) bufSize);
+  _ctmRunTasks(self, _ctmUnpackTask, (void *) aJobs, aCount, sizeof(_CTMpackjob));
 
-  // Free the packed data
-  free(packed);
+  for(i = 0; i < aCount; ++ i)
+  {
+    if(aJobs[i].mError != CTM_NONE)
+    {
+      self->mError = aJobs[i].mError;
+      return CTM_FALSE;
+    }
+  }
 
   return CTM_TRUE;
 }
+
+//-----------------------------------------------------------------------------
+// _ctmFreePackJobs() - Free an array of pack jobs (including any packed data,
+// but not the unpacked data arrays). The array is taken from the scratch
+// memory of the context.
+//-----------------------------------------------------------------------------
+void _ctmFreePackJobs(_CTMcontext * self, _CTMpackjob * aJobs, CTMuint aCount)
+{
+  CTMuint i;
+  for(i = 0; i < aCount; ++ i)
+    _ctmFreePackJob(&aJobs[i]);
+  _ctmScratchFree(self->mScratch, (void *) aJobs);
+}
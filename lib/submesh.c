@@ -0,0 +1,343 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        submesh.c
+// Description: Sub meshes - complete meshes that are embedded in the stream of
+//              another file (the tiles of tiled files and the levels of
+//              progressive files).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+
+//-----------------------------------------------------------------------------
+// _CTMsubstream - A read stream that is limited to the data of one sub mesh.
+// It reads through the stream buffer of the parent context (which is handed
+// over to the sub stream while the sub mesh is loaded).
+//-----------------------------------------------------------------------------
+typedef struct {
+  CTMreadfn mReadFn;
+  CTMseekfn mSeekFn;
+  void * mUserData;
+  _CTMstreambuf mBuffer;
+  size_t mBase;
+  CTMuint mSize;
+  CTMuint mRemaining;
+} _CTMsubstream;
+
+//-----------------------------------------------------------------------------
+// _ctmMemBufWrite() - Stream write function for _CTMmembuf.
+//-----------------------------------------------------------------------------
+CTMuint CTMCALL _ctmMemBufWrite(const void * aBuf, CTMuint aCount,
+  void * aUserData)
+{
+  _CTMmembuf * buf = (_CTMmembuf *) aUserData;
+  unsigned char * data;
+  size_t capacity;
+
+  // Grow the buffer if necessary
+  if(aCount > buf->mCapacity - buf->mSize)
+  {
+    capacity = buf->mCapacity ? buf->mCapacity * 2 : 65536;
+    while(capacity - buf->mSize < aCount)
+      capacity *= 2;
+    data = (unsigned char *) _ctmRealloc(buf->mAllocator, buf->mData,
+                                         buf->mCapacity, capacity);
+    if(!data)
+      return 0;
+    buf->mData = data;
+    buf->mCapacity = capacity;
+  }
+
+  memcpy(&buf->mData[buf->mSize], aBuf, aCount);
+  buf->mSize += aCount;
+  return aCount;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSubStreamRead() - Stream read function for _CTMsubstream.
+//-----------------------------------------------------------------------------
+static CTMuint CTMCALL _ctmSubStreamRead(void * aBuf, CTMuint aCount,
+  void * aUserData)
+{
+  _CTMsubstream * stream = (_CTMsubstream *) aUserData;
+  CTMuint count;
+
+  if(aCount > stream->mRemaining)
+    aCount = stream->mRemaining;
+  count = _ctmStreamBufRead(&stream->mBuffer, stream->mReadFn,
+                            stream->mUserData, aBuf, aCount);
+  stream->mRemaining -= count;
+  return count;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSubStreamSeek() - Stream seek function for _CTMsubstream.
+//-----------------------------------------------------------------------------
+static CTMint CTMCALL _ctmSubStreamSeek(size_t aOffset, void * aUserData)
+{
+  _CTMsubstream * stream = (_CTMsubstream *) aUserData;
+
+  if(aOffset > (size_t) stream->mSize)
+    return CTM_FALSE;
+  if(!_ctmStreamBufSeek(&stream->mBuffer, stream->mSeekFn, stream->mUserData,
+                        stream->mBase + (stream->mSize - stream->mRemaining),
+                        stream->mBase + aOffset))
+    return CTM_FALSE;
+  stream->mRemaining = stream->mSize - (CTMuint) aOffset;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmCopyString() - Make a copy of a string (NULL is copied as NULL).
+//-----------------------------------------------------------------------------
+int _ctmCopyString(_CTMcontext * self, char ** aDst, const char * aSrc)
+{
+  *aDst = (char *) 0;
+  if(!aSrc)
+    return CTM_TRUE;
+  *aDst = (char *) _ctmAlloc(&self->mAllocator, strlen(aSrc) + 1);
+  if(!*aDst)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  strcpy(*aDst, aSrc);
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSaveSubMesh() - Save a mesh that is made of the vertices aVertexMap[0..
+// aVertexCount-1] of this mesh and the triangles aIndices[0..aTriangleCount-1]
+// (which index aVertexMap) as a complete file to aBuf. If aVertices is not
+// NULL, it replaces the vertex coordinates. If aMin and aMax are not NULL,
+// they receive the bounding box of the sub mesh vertices.
+//-----------------------------------------------------------------------------
+int _ctmSaveSubMesh(_CTMcontext * self, const CTMuint * aVertexMap,
+  CTMuint aVertexCount, const CTMfloat * aVertices, const CTMuint * aIndices,
+  CTMuint aTriangleCount, CTMfloat aVertexPrecision, CTMfloat * aMin,
+  CTMfloat * aMax, _CTMmembuf * aBuf)
+{
+  _CTMcontext * sub;
+  _CTMfloatmap * map, * subMap;
+  CTMuint i, j, k;
+  CTMfloat * vertices, * normals, * values;
+  int result = CTM_FALSE;
+
+  // Gather the sub mesh vertices and normals
+  sub = (_CTMcontext *) 0;
+  normals = (CTMfloat *) 0;
+  vertices = (CTMfloat *) _ctmAlloc(&self->mAllocator,
+                                    sizeof(CTMfloat) * 3 * aVertexCount);
+  if(!vertices)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  for(i = 0; i < aVertexCount; ++ i)
+    for(j = 0; j < 3; ++ j)
+      vertices[i * 3 + j] = aVertices ? aVertices[i * 3 + j] :
+        self->mVertices[(size_t) aVertexMap[i] * self->mVertexStride + j];
+  if(self->mNormals)
+  {
+    normals = (CTMfloat *) _ctmAlloc(&self->mAllocator,
+                                     sizeof(CTMfloat) * 3 * aVertexCount);
+    if(!normals)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+    for(i = 0; i < aVertexCount; ++ i)
+      for(j = 0; j < 3; ++ j)
+        normals[i * 3 + j] = self->mNormals[(size_t) aVertexMap[i] * self->mNormalStride + j];
+  }
+
+  // Set up a context for the sub mesh, with the same settings as this context
+  sub = (_CTMcontext *) ctmNewContext(CTM_EXPORT);
+  if(!sub)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+  sub->mMethod = self->mMethod;
+  sub->mCompressionLevel = self->mCompressionLevel;
+  sub->mIndexCoding = self->mIndexCoding;
+  sub->mVertexCoding = self->mVertexCoding;
+  sub->mNormalCoding = self->mNormalCoding;
+  memcpy(sub->mLZMAParams, self->mLZMAParams, sizeof(self->mLZMAParams));
+  sub->mVertexPrecision = aVertexPrecision;
+  sub->mNormalPrecision = self->mNormalPrecision;
+  sub->mThreadCount = self->mThreadCount;
+  sub->mScratch = self->mScratch;
+  sub->mAllocator = self->mAllocator;
+  sub->mStreamBufSize = 0;  // Saved to memory (no stream buffer needed)
+  ctmDefineMesh(sub, vertices, aVertexCount, aIndices, aTriangleCount, normals);
+
+  // Gather the UV and attribute maps (the map arrays are owned by us, since
+  // the sub mesh context is in export mode)
+  for(k = 0; k < 2; ++ k)
+  {
+    for(map = k ? self->mAttribMaps : self->mUVMaps; map; map = map->mNext)
+    {
+      values = (CTMfloat *) _ctmAlloc(&self->mAllocator,
+                                      sizeof(CTMfloat) * (k ? 4 : 2) * aVertexCount);
+      if(!values)
+      {
+        self->mError = CTM_OUT_OF_MEMORY;
+        goto cleanup;
+      }
+      for(i = 0; i < aVertexCount; ++ i)
+        for(j = 0; j < (k ? 4U : 2U); ++ j)
+          values[i * (k ? 4 : 2) + j] = map->mValues[(size_t) aVertexMap[i] * map->mStride + j];
+      if(k)
+        ctmAddAttribMap(sub, values, map->mName);
+      else
+        ctmAddUVMap(sub, values, map->mName, map->mFileName);
+      if(sub->mError)
+      {
+        _ctmFree(&self->mAllocator, values);
+        self->mError = sub->mError;
+        goto cleanup;
+      }
+    }
+  }
+  for(k = 0; k < 2; ++ k)
+  {
+    subMap = k ? sub->mAttribMaps : sub->mUVMaps;
+    for(map = k ? self->mAttribMaps : self->mUVMaps; map; map = map->mNext)
+    {
+      subMap->mPrecision = map->mPrecision;
+      subMap = subMap->mNext;
+    }
+  }
+
+  // Save the sub mesh
+  ctmSaveCustom(sub, _ctmMemBufWrite, (void *) aBuf);
+  if(sub->mError)
+  {
+    self->mError = sub->mError;
+    goto cleanup;
+  }
+  if((aBuf->mSize == 0) || (aBuf->mSize > 0xffffffff))
+  {
+    self->mError = aBuf->mSize ? CTM_INVALID_MESH : CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+
+  if(aMin && aMax)
+    _ctmBoundingBox(self, vertices, aVertexCount, aMin, aMax);
+  result = CTM_TRUE;
+
+cleanup:
+  if(sub)
+  {
+    for(k = 0; k < 2; ++ k)
+      for(map = k ? sub->mAttribMaps : sub->mUVMaps; map; map = map->mNext)
+        _ctmFree(&self->mAllocator, map->mValues);
+    ctmFreeContext(sub);
+  }
+  _ctmFree(&self->mAllocator, normals);
+  _ctmFree(&self->mAllocator, vertices);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLoadSubMesh() - Load the next sub mesh (aSize bytes) of the stream of
+// this context into aTarget (which may be this context). The sub mesh must
+// have the given counts, and the same map counts as this context. The stream
+// is always advanced to the end of the sub mesh.
+//-----------------------------------------------------------------------------
+int _ctmLoadSubMesh(_CTMcontext * self, _CTMcontext * aTarget, CTMuint aSize,
+  CTMuint aVertexCount, CTMuint aTriangleCount)
+{
+  CTMreadfn readFn = self->mReadFn;
+  CTMseekfn seekFn = self->mSeekFn;
+  void * userData = self->mUserData;
+  size_t streamPos = self->mStreamPos;
+  const unsigned char * memory = self->mMemory;
+  size_t memorySize = self->mMemorySize, memoryPos = self->mMemoryPos;
+  _CTMsubstream stream;
+
+  aTarget->mInSubMesh = CTM_TRUE;
+  aTarget->mSubMeshCounts[0] = aVertexCount;
+  aTarget->mSubMeshCounts[1] = aTriangleCount;
+  aTarget->mSubMeshCounts[2] = self->mUVMapCount + self->mSkipUVMaps;
+  aTarget->mSubMeshCounts[3] = self->mAttribMapCount + self->mSkipAttribMaps;
+
+  if(memory)
+  {
+    // Load directly from the memory stream
+    if(aSize > memorySize - memoryPos)
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return CTM_FALSE;
+    }
+    aTarget->mMemory = memory + memoryPos;
+    aTarget->mMemorySize = aSize;
+    aTarget->mMemoryPos = 0;
+    ctmLoadCustom((CTMcontext) aTarget, (CTMreadfn) 0, (void *) 0);
+    aTarget->mMemory = (const unsigned char *) 0;
+    self->mReadFn = readFn;
+    self->mUserData = userData;
+    self->mMemory = memory;
+    self->mMemorySize = memorySize;
+    self->mMemoryPos = memoryPos + aSize;
+  }
+  else
+  {
+    // Load through a stream that ends with the sub mesh (and that can seek
+    // within the sub mesh, if this stream can seek)
+    stream.mReadFn = readFn;
+    stream.mSeekFn = seekFn;
+    stream.mUserData = userData;
+    stream.mBuffer = self->mStreamBuf;
+    memset(&self->mStreamBuf, 0, sizeof(_CTMstreambuf));
+    stream.mBase = streamPos;
+    stream.mSize = aSize;
+    stream.mRemaining = aSize;
+    ctmLoadSeekable((CTMcontext) aTarget, _ctmSubStreamRead,
+      (seekFn || stream.mBuffer.mData) ? _ctmSubStreamSeek : (CTMseekfn) 0,
+      (void *) &stream);
+    self->mReadFn = readFn;
+    self->mSeekFn = seekFn;
+    self->mUserData = userData;
+    self->mStreamBuf = stream.mBuffer;
+    self->mStreamPos = streamPos + (aSize - stream.mRemaining);
+    if(!_ctmStreamSkip(self, stream.mRemaining))
+    {
+      aTarget->mInSubMesh = CTM_FALSE;
+      return CTM_FALSE;
+    }
+  }
+  aTarget->mInSubMesh = CTM_FALSE;
+
+  if(aTarget->mError != CTM_NONE)
+  {
+    self->mError = aTarget->mError;
+    return CTM_FALSE;
+  }
+  return CTM_TRUE;
+}
@@ -0,0 +1,132 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        loadcheck.c
+// Description: Regression check for loading damaged files: headers with
+//              vertex or triangle counts that are too large for the file
+//              must fail with an error code instead of overflowing the mesh
+//              arrays.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+
+// Largest allocation that the test allocator grants (larger requests fail, so
+// that oversized counts give CTM_OUT_OF_MEMORY without touching the memory)
+#define _CHECK_ALLOC_LIMIT (64 * 1024 * 1024)
+
+//-----------------------------------------------------------------------------
+// _checkAlloc() - Allocation function with a size limit. The largest request
+// is stored in the user data.
+//-----------------------------------------------------------------------------
+static void * CTMCALL _checkAlloc(size_t aSize, void * aUserData)
+{
+  size_t * largest = (size_t *) aUserData;
+  if(aSize > *largest)
+    *largest = aSize;
+  if(aSize > _CHECK_ALLOC_LIMIT)
+    return (void *) 0;
+  return malloc(aSize);
+}
+
+//-----------------------------------------------------------------------------
+// _checkFree() - Free function of the test allocator.
+//-----------------------------------------------------------------------------
+static void CTMCALL _checkFree(void * aPtr, void * aUserData)
+{
+  (void) aUserData;
+  free(aPtr);
+}
+
+//-----------------------------------------------------------------------------
+// _putUINT() - Store a little endian 32-bit integer.
+//-----------------------------------------------------------------------------
+static unsigned char * _putUINT(unsigned char * aBuf, CTMuint aValue)
+{
+  aBuf[0] = (unsigned char) (aValue & 0xff);
+  aBuf[1] = (unsigned char) ((aValue >> 8) & 0xff);
+  aBuf[2] = (unsigned char) ((aValue >> 16) & 0xff);
+  aBuf[3] = (unsigned char) ((aValue >> 24) & 0xff);
+  return aBuf + 4;
+}
+
+//-----------------------------------------------------------------------------
+// _checkTruncatedRAW() - Load a RAW file that ends after its header, with the
+// given vertex and triangle counts. Returns 1 if the load failed with
+// CTM_OUT_OF_MEMORY or CTM_BAD_FORMAT.
+//-----------------------------------------------------------------------------
+static int _checkTruncatedRAW(CTMuint aVertexCount, CTMuint aTriangleCount)
+{
+  unsigned char buf[100], * p;
+  CTMcontext context;
+  CTMenum err;
+  size_t largest = 0;
+
+  // Header: magic, version, method, counts, flags and an empty comment
+  memset(buf, 0, sizeof(buf));
+  p = buf;
+  memcpy(p, "OCTM", 4); p += 4;
+  p = _putUINT(p, 5);
+  memcpy(p, "RAW\0", 4); p += 4;
+  p = _putUINT(p, aVertexCount);
+  p = _putUINT(p, aTriangleCount);
+  p = _putUINT(p, 0);
+  p = _putUINT(p, 0);
+  p = _putUINT(p, 0);
+  p = _putUINT(p, 0);
+  memcpy(p, "INDX", 4); p += 4;
+
+  context = ctmNewContext(CTM_IMPORT);
+  if(!context)
+    return 0;
+  ctmSetAllocator(context, _checkAlloc, _checkFree, (void *) &largest);
+  ctmLoadFromMemory(context, (const void *) buf, (CTMuint) sizeof(buf));
+  err = ctmGetError(context);
+  ctmFreeContext(context);
+
+  printf("RAW vertices 0x%08x, triangles 0x%08x: %s (largest allocation %lu)\n",
+         aVertexCount, aTriangleCount, ctmErrorString(err),
+         (unsigned long) largest);
+  return (err == CTM_OUT_OF_MEMORY) || (err == CTM_BAD_FORMAT);
+}
+
+//-----------------------------------------------------------------------------
+// main()
+//-----------------------------------------------------------------------------
+int main(void)
+{
+  int ok = 1;
+
+  // Counts whose array sizes wrap around in 32-bit arithmetic
+  ok &= _checkTruncatedRAW(0x15555556, 1);
+  ok &= _checkTruncatedRAW(3, 0x80000422);
+  ok &= _checkTruncatedRAW(0xffffffff, 0xffffffff);
+
+  // Counts that are simply too large for the file
+  ok &= _checkTruncatedRAW(0x00100000, 1);
+  ok &= _checkTruncatedRAW(3, 0x00100000);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,321 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        thread.c
+// Description: Minimal threading support (runs independent work items on a
+//              set of worker threads).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include "openctm.h"
+#include "internal.h"
+
+#if defined(OPENCTM_NO_THREADS)
+  // Threading support disabled at build time
+#elif defined(_WIN32)
+  #include <windows.h>
+  #define _CTM_WIN32_THREADS
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+  #define _CTM_POSIX_THREADS
+#endif
+
+// Upper limit for the number of worker threads
+#define _CTM_MAX_THREADS 64
+
+
+//-----------------------------------------------------------------------------
+// _CTMtaskqueue - Shared state for a set of work items.
+//-----------------------------------------------------------------------------
+typedef struct {
+  _CTMtaskfn mFunc;      // Function to call for each work item
+  char * mItems;         // Work item array
+  size_t mItemSize;      // Size of one work item (in bytes)
+  CTMuint mCount;        // Number of work items
+  CTMuint mNext;         // Next work item to be processed
+#if defined(_CTM_WIN32_THREADS)
+  CRITICAL_SECTION mLock;
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_t mLock;
+#endif
+} _CTMtaskqueue;
+
+//-----------------------------------------------------------------------------
+// _ctmNextTask() - Grab the next unprocessed work item from the queue (or
+// NULL if all items have been grabbed).
+//-----------------------------------------------------------------------------
+static void * _ctmNextTask(_CTMtaskqueue * aQueue)
+{
+  void * item = (void *) 0;
+
+#if defined(_CTM_WIN32_THREADS)
+  EnterCriticalSection(&aQueue->mLock);
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_lock(&aQueue->mLock);
+#endif
+
+  if(aQueue->mNext < aQueue->mCount)
+  {
+    item = (void *) &aQueue->mItems[aQueue->mNext * aQueue->mItemSize];
+    ++ aQueue->mNext;
+  }
+
+#if defined(_CTM_WIN32_THREADS)
+  LeaveCriticalSection(&aQueue->mLock);
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_unlock(&aQueue->mLock);
+#endif
+
+  return item;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWorker() - Process work items until the queue is empty.
+//-----------------------------------------------------------------------------
+static void _ctmWorker(_CTMtaskqueue * aQueue)
+{
+  void * item;
+  while((item = _ctmNextTask(aQueue)) != (void *) 0)
+    aQueue->mFunc(item);
+}
+
+#if defined(_CTM_WIN32_THREADS)
+static DWORD WINAPI _ctmThreadMain(LPVOID aArg)
+{
+  _ctmWorker((_CTMtaskqueue *) aArg);
+  return 0;
+}
+#elif defined(_CTM_POSIX_THREADS)
+static void * _ctmThreadMain(void * aArg)
+{
+  _ctmWorker((_CTMtaskqueue *) aArg);
+  return (void *) 0;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// _ctmProcessorCount() - Get the number of online processors in the system.
+//-----------------------------------------------------------------------------
+CTMuint _ctmProcessorCount(void)
+{
+  long count = 1;
+#if defined(_CTM_WIN32_THREADS)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  count = (long) info.dwNumberOfProcessors;
+#elif defined(_CTM_POSIX_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+  count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(count < 1)
+    count = 1;
+  if(count > _CTM_MAX_THREADS)
+    count = _CTM_MAX_THREADS;
+  return (CTMuint) count;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSplitCount() - Get the number of parts that aCount elements should be
+// split into for concurrent processing (at most one part per thread that has
+// been selected for the context, and at least aMinSize elements per part).
+//-----------------------------------------------------------------------------
+CTMuint _ctmSplitCount(_CTMcontext * self, CTMuint aCount, CTMuint aMinSize)
+{
+  CTMuint parts = 1;
+#if defined(_CTM_WIN32_THREADS) || defined(_CTM_POSIX_THREADS)
+  parts = self->mThreadCount ? self->mThreadCount : _ctmProcessorCount();
+  if(parts > _CTM_MAX_THREADS)
+    parts = _CTM_MAX_THREADS;
+  if(parts > aCount / aMinSize)
+    parts = aCount / aMinSize;
+  if(parts < 1)
+    parts = 1;
+#else
+  (void) self;
+  (void) aCount;
+  (void) aMinSize;
+#endif
+  return parts;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmRunTasks() - Call aFunc once for each of the aCount work items in the
+// aItems array (each item is aItemSize bytes), using up to the number of
+// threads that has been selected for the context. The calling thread takes
+// part in the work, and the function returns when all items are done. If no
+// worker threads can be started, all work is done by the calling thread.
+//-----------------------------------------------------------------------------
+void _ctmRunTasks(_CTMcontext * self, _CTMtaskfn aFunc, void * aItems,
+  CTMuint aCount, size_t aItemSize)
+{
+  _CTMtaskqueue queue;
+  CTMuint threadCount;
+#if defined(_CTM_WIN32_THREADS)
+  HANDLE threads[_CTM_MAX_THREADS];
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_t threads[_CTM_MAX_THREADS];
+#endif
+  CTMuint i, started = 0;
+
+  queue.mFunc = aFunc;
+  queue.mItems = (char *) aItems;
+  queue.mItemSize = aItemSize;
+  queue.mCount = aCount;
+  queue.mNext = 0;
+
+  // How many threads do we need? (the calling thread counts as one)
+  threadCount = self->mThreadCount ? self->mThreadCount : _ctmProcessorCount();
+  if(threadCount > aCount)
+    threadCount = aCount;
+  if(threadCount > _CTM_MAX_THREADS)
+    threadCount = _CTM_MAX_THREADS;
+
+#if defined(_CTM_WIN32_THREADS) || defined(_CTM_POSIX_THREADS)
+  if(threadCount > 1)
+  {
+#if defined(_CTM_WIN32_THREADS)
+    InitializeCriticalSection(&queue.mLock);
+#else
+    pthread_mutex_init(&queue.mLock, (pthread_mutexattr_t *) 0);
+#endif
+
+    // Start the worker threads
+    for(i = 0; i < threadCount - 1; ++ i)
+    {
+#if defined(_CTM_WIN32_THREADS)
+      threads[started] = CreateThread(NULL, 0, _ctmThreadMain, (LPVOID) &queue, 0, NULL);
+      if(threads[started] == NULL)
+        break;
+#else
+      if(pthread_create(&threads[started], (pthread_attr_t *) 0, _ctmThreadMain, (void *) &queue) != 0)
+        break;
+#endif
+      ++ started;
+    }
+
+    // Do our share of the work
+    _ctmWorker(&queue);
+
+    // Wait for all worker threads to finish
+    for(i = 0; i < started; ++ i)
+    {
+#if defined(_CTM_WIN32_THREADS)
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+#else
+      pthread_join(threads[i], (void **) 0);
+#endif
+    }
+
+#if defined(_CTM_WIN32_THREADS)
+    DeleteCriticalSection(&queue.mLock);
+#else
+    pthread_mutex_destroy(&queue.mLock);
+#endif
+    return;
+  }
+#else
+  (void) threadCount;
+  (void) started;
+#endif
+
+  // Single threaded operation
+  for(i = 0; i < aCount; ++ i)
+    aFunc((void *) &queue.mItems[i * aItemSize]);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmNewLock() - Create a lock (mutex) for data that is shared between
+// threads. Returns NULL if out of memory. Without threading support, a dummy
+// (non-NULL) lock is returned.
+//-----------------------------------------------------------------------------
+void * _ctmNewLock(void)
+{
+#if defined(_CTM_WIN32_THREADS)
+  CRITICAL_SECTION * lock;
+  lock = (CRITICAL_SECTION *) malloc(sizeof(CRITICAL_SECTION));
+  if(lock)
+    InitializeCriticalSection(lock);
+  return (void *) lock;
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_t * lock;
+  lock = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t));
+  if(lock && (pthread_mutex_init(lock, (pthread_mutexattr_t *) 0) != 0))
+  {
+    free(lock);
+    lock = (pthread_mutex_t *) 0;
+  }
+  return (void *) lock;
+#else
+  static char dummy;
+  return (void *) &dummy;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFreeLock() - Free a lock that was created with _ctmNewLock().
+//-----------------------------------------------------------------------------
+void _ctmFreeLock(void * aLock)
+{
+  if(!aLock)
+    return;
+#if defined(_CTM_WIN32_THREADS)
+  DeleteCriticalSection((CRITICAL_SECTION *) aLock);
+  free(aLock);
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_destroy((pthread_mutex_t *) aLock);
+  free(aLock);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLock() - Acquire a lock.
+//-----------------------------------------------------------------------------
+void _ctmLock(void * aLock)
+{
+#if defined(_CTM_WIN32_THREADS)
+  EnterCriticalSection((CRITICAL_SECTION *) aLock);
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_lock((pthread_mutex_t *) aLock);
+#else
+  (void) aLock;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// _ctmUnlock() - Release a lock.
+//-----------------------------------------------------------------------------
+void _ctmUnlock(void * aLock)
+{
+#if defined(_CTM_WIN32_THREADS)
+  LeaveCriticalSection((CRITICAL_SECTION *) aLock);
+#elif defined(_CTM_POSIX_THREADS)
+  pthread_mutex_unlock((pthread_mutex_t *) aLock);
+#else
+  (void) aLock;
+#endif
+}
@@ -0,0 +1,676 @@
+//-----------------------------------------------------------------------------
+// Product:     OpenCTM
+// File:        tiles.c
+// Description: Tiled files - meshes that are split into spatial tiles, which
+//              can be loaded one at a time (see ctmTileGrid()), or that are
+//              saved in parts (see ctmAddChunk()).
+//-----------------------------------------------------------------------------
+// Copyright (c) 2009-2010 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "openctm.h"
+#include "internal.h"
+
+// A tiled file has the ordinary file header (with the method "TILE", and the
+// total counts of all the tiles), followed by the tile index ("TIDX", the tile
+// count, and one _CTMtile entry per tile), followed by the tiles. Each tile is
+// a complete OpenCTM file of its own.
+
+
+//-----------------------------------------------------------------------------
+// _ctmSaveTile() - Save the triangles aTriangles[0..aCount-1] (records of a
+// cell and a triangle number) as a separate mesh to aBuf. aRemap is a vertex
+// map with all entries set to ~0, which is restored before returning.
+//-----------------------------------------------------------------------------
+static int _ctmSaveTile(_CTMcontext * self, const CTMuint * aTriangles,
+  CTMuint aCount, CTMuint * aRemap, _CTMtile * aTile, _CTMmembuf * aBuf)
+{
+  CTMuint * indices, * vertexMap, i, j, v, vertexCount;
+  int result;
+
+  // Map the vertices that the triangles use to tile vertices, in the order
+  // of first use
+  indices = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * 3 * aCount);
+  vertexMap = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * 3 * aCount);
+  if(!indices || !vertexMap)
+  {
+    _ctmScratchFree(self->mScratch, indices);
+    _ctmScratchFree(self->mScratch, vertexMap);
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  vertexCount = 0;
+  for(i = 0; i < aCount; ++ i)
+  {
+    for(j = 0; j < 3; ++ j)
+    {
+      v = self->mIndices[(size_t) aTriangles[i * 2 + 1] * self->mIndexStride + j];
+      if(aRemap[v] == 0xffffffff)
+      {
+        aRemap[v] = vertexCount;
+        vertexMap[vertexCount ++] = v;
+      }
+      indices[i * 3 + j] = aRemap[v];
+    }
+  }
+  for(i = 0; i < vertexCount; ++ i)
+    aRemap[vertexMap[i]] = 0xffffffff;
+
+  // Save the tile, and fill out the tile index entry
+  result = _ctmSaveSubMesh(self, vertexMap, vertexCount, (CTMfloat *) 0,
+                           indices, aCount, self->mVertexPrecision,
+                           aTile->mMin, aTile->mMax, aBuf);
+  if(result)
+  {
+    aTile->mVertexCount = vertexCount;
+    aTile->mTriangleCount = aCount;
+    if((self->mMethod == CTM_METHOD_MG2) || (self->mMethod == CTM_METHOD_MG3))
+    {
+      // Make room for the fixed point rounding of the vertices
+      for(j = 0; j < 3; ++ j)
+      {
+        aTile->mMin[j] -= self->mVertexPrecision;
+        aTile->mMax[j] += self->mVertexPrecision;
+      }
+    }
+    aTile->mSize = (CTMuint) aBuf->mSize;
+  }
+
+  _ctmScratchFree(self->mScratch, vertexMap);
+  _ctmScratchFree(self->mScratch, indices);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmWriteTiledFile() - Write a tiled file that is made of the tiles
+// aTiles[0..aCount-1] (saved to aBufs). The header gets the total counts, the
+// map counts and the mesh flags of the concatenated tiles.
+//-----------------------------------------------------------------------------
+static int _ctmWriteTiledFile(_CTMcontext * self, const _CTMtile * aTiles,
+  const _CTMmembuf * aBufs, CTMuint aCount, CTMuint aVertexCount,
+  CTMuint aTriangleCount, CTMuint aUVMapCount, CTMuint aAttribMapCount,
+  CTMuint aFlags)
+{
+  CTMuint i, j;
+
+  // Write the file header
+  _ctmStreamWrite(self, (void *) "OCTM", 4);
+  _ctmStreamWriteUINT(self, _CTM_FORMAT_VERSION);
+  _ctmStreamWrite(self, (void *) "TILE", 4);
+  _ctmStreamWriteUINT(self, aVertexCount);
+  _ctmStreamWriteUINT(self, aTriangleCount);
+  _ctmStreamWriteUINT(self, aUVMapCount);
+  _ctmStreamWriteUINT(self, aAttribMapCount);
+  _ctmStreamWriteUINT(self, aFlags);
+  _ctmStreamWriteSTRING(self, self->mFileComment);
+
+  // Write the tile index
+  _ctmStreamWriteSection(self, "TIDX", 0);
+  _ctmStreamWriteUINT(self, aCount);
+  for(i = 0; i < aCount; ++ i)
+  {
+    _ctmStreamWriteUINT(self, aTiles[i].mVertexCount);
+    _ctmStreamWriteUINT(self, aTiles[i].mTriangleCount);
+    for(j = 0; j < 3; ++ j)
+      _ctmStreamWriteFLOAT(self, aTiles[i].mMin[j]);
+    for(j = 0; j < 3; ++ j)
+      _ctmStreamWriteFLOAT(self, aTiles[i].mMax[j]);
+    _ctmStreamWriteUINT(self, aTiles[i].mSize);
+  }
+
+  // Write the tiles
+  for(i = 0; i < aCount; ++ i)
+  {
+    _ctmAddSection(self, FOURCC("OCTM"), self->mStreamPos, 0);
+    if(_ctmStreamWrite(self, (void *) aBufs[i].mData, aTiles[i].mSize) !=
+       aTiles[i].mSize)
+    {
+      self->mError = CTM_FILE_ERROR;
+      return CTM_FALSE;
+    }
+  }
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSaveTiles() - Split the mesh into tiles according to the tile grid,
+// and save it as a tiled file. The tiles are saved to memory first, since
+// the size of each tile must be known when the tile index is written.
+//-----------------------------------------------------------------------------
+int _ctmSaveTiles(_CTMcontext * self)
+{
+  CTMfloat min[3], max[3], scale[3], center;
+  CTMuint * records, * remap, * tri, cellCount, tileCount, i, j, first, cell;
+  CTMuint vertexCount, flags;
+  CTMint c;
+  _CTMtile * tiles;
+  _CTMmembuf * bufs;
+  int result = CTM_FALSE;
+
+  // Calculate the tile grid cell of each triangle (from the triangle center)
+  _ctmBoundingBox(self, self->mVertices, self->mVertexCount, min, max);
+  for(j = 0; j < 3; ++ j)
+    scale[j] = (max[j] > min[j]) ? self->mTileGrid[j] / (max[j] - min[j]) : 0.0f;
+  records = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * 2 * self->mTriangleCount);
+  if(!records)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  for(i = 0; i < self->mTriangleCount; ++ i)
+  {
+    tri = &self->mIndices[(size_t) i * self->mIndexStride];
+    cell = 0;
+    for(j = 3; j -- > 0;)
+    {
+      center = (self->mVertices[(size_t) tri[0] * self->mVertexStride + j] +
+                self->mVertices[(size_t) tri[1] * self->mVertexStride + j] +
+                self->mVertices[(size_t) tri[2] * self->mVertexStride + j]) *
+               (1.0f / 3.0f);
+      c = (CTMint) ((center - min[j]) * scale[j]);
+      if(c < 0)
+        c = 0;
+      else if(c >= (CTMint) self->mTileGrid[j])
+        c = (CTMint) self->mTileGrid[j] - 1;
+      cell = cell * self->mTileGrid[j] + (CTMuint) c;
+    }
+    records[i * 2] = cell;
+    records[i * 2 + 1] = i;
+  }
+
+  // Group the triangles by cell (keeping the triangle order within each cell)
+  if(!_ctmRadixSort(self->mScratch, (void *) records, self->mTriangleCount, 2, 0, 1, CTM_FALSE))
+  {
+    _ctmScratchFree(self->mScratch, records);
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  cellCount = 1;
+  for(i = 1; i < self->mTriangleCount; ++ i)
+    if(records[i * 2] != records[i * 2 - 2])
+      ++ cellCount;
+
+  // Allocate the tile index, the tile buffers and the vertex map
+  tiles = (_CTMtile *) _ctmScratchAlloc(self->mScratch,
+    sizeof(_CTMtile) * cellCount);
+  bufs = (_CTMmembuf *) _ctmScratchCalloc(self->mScratch,
+    cellCount * sizeof(_CTMmembuf));
+  remap = (CTMuint *) _ctmScratchAlloc(self->mScratch,
+    sizeof(CTMuint) * self->mVertexCount);
+  if(!tiles || !bufs || !remap)
+  {
+    self->mError = CTM_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+  for(i = 0; i < cellCount; ++ i)
+    bufs[i].mAllocator = &self->mAllocator;
+  memset(remap, 0xff, sizeof(CTMuint) * self->mVertexCount);
+
+  // Save each non-empty cell as a tile
+  tileCount = 0;
+  vertexCount = 0;
+  for(first = 0; first < self->mTriangleCount; first = i)
+  {
+    for(i = first + 1; (i < self->mTriangleCount) &&
+        (records[i * 2] == records[first * 2]); ++ i);
+    if(!_ctmSaveTile(self, &records[first * 2], i - first, remap,
+                     &tiles[tileCount], &bufs[tileCount]))
+      goto cleanup;
+    if(tiles[tileCount].mVertexCount > 0xffffffff - vertexCount)
+    {
+      self->mError = CTM_INVALID_MESH;
+      goto cleanup;
+    }
+    vertexCount += tiles[tileCount].mVertexCount;
+    ++ tileCount;
+  }
+
+  // Write the file
+  flags = 0;
+  if(self->mNormals)
+    flags |= _CTM_HAS_NORMALS_BIT;
+  if(!_ctmWriteTiledFile(self, tiles, bufs, tileCount, vertexCount,
+                         self->mTriangleCount, self->mUVMapCount,
+                         self->mAttribMapCount, flags))
+    goto cleanup;
+  result = CTM_TRUE;
+
+cleanup:
+  if(bufs)
+  {
+    for(i = 0; i < cellCount; ++ i)
+      _ctmFree(&self->mAllocator, bufs[i].mData);
+    _ctmScratchFree(self->mScratch, bufs);
+  }
+  _ctmScratchFree(self->mScratch, remap);
+  _ctmScratchFree(self->mScratch, tiles);
+  _ctmScratchFree(self->mScratch, records);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmAppendTile() - Copy a loaded tile into the mesh of this context, at
+// vertex aVertexBase and triangle aTriangleBase. The tile maps must be
+// compatible with the maps of this context.
+//-----------------------------------------------------------------------------
+static int _ctmAppendTile(_CTMcontext * self, _CTMcontext * aTile,
+  CTMuint aVertexBase, CTMuint aTriangleBase, CTMint aFirst)
+{
+  _CTMfloatmap * map, * tileMap;
+  CTMuint i, j, k, channels;
+  CTMuint * tri;
+  CTMfloat * dst;
+
+  // Vertices and normals
+  for(i = 0; i < aTile->mVertexCount; ++ i)
+  {
+    dst = &self->mVertices[(size_t) (aVertexBase + i) * self->mVertexStride];
+    for(j = 0; j < 3; ++ j)
+      dst[j] = aTile->mVertices[(size_t) i * aTile->mVertexStride + j];
+    if(self->mNormals)
+      _ctmWriteNormal(self, aVertexBase + i,
+                      &aTile->mNormals[(size_t) i * aTile->mNormalStride]);
+  }
+
+  // Indices
+  for(i = 0; i < aTile->mTriangleCount; ++ i)
+  {
+    tri = &self->mIndices[(size_t) (aTriangleBase + i) * self->mIndexStride];
+    for(j = 0; j < 3; ++ j)
+      tri[j] = aTile->mIndices[(size_t) i * aTile->mIndexStride + j] + aVertexBase;
+  }
+
+  // UV and attribute maps (the names and precisions are taken from the first
+  // tile)
+  for(k = 0; k < 2; ++ k)
+  {
+    channels = k ? 4 : 2;
+    tileMap = k ? aTile->mAttribMaps : aTile->mUVMaps;
+    for(map = k ? self->mAttribMaps : self->mUVMaps; map; map = map->mNext)
+    {
+      if(aFirst)
+      {
+        if(!_ctmCopyString(self, &map->mName, tileMap->mName) ||
+           !_ctmCopyString(self, &map->mFileName, tileMap->mFileName))
+          return CTM_FALSE;
+        map->mPrecision = tileMap->mPrecision;
+      }
+      for(i = 0; i < aTile->mVertexCount; ++ i)
+      {
+        dst = &map->mValues[(size_t) (aVertexBase + i) * map->mStride];
+        for(j = 0; j < channels; ++ j)
+          dst[j] = tileMap->mValues[(size_t) i * tileMap->mStride + j];
+      }
+      tileMap = tileMap->mNext;
+    }
+  }
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmReadTileIndex() - Read the tile index of a tiled file (the file header
+// has already been read) into mTiles.
+//-----------------------------------------------------------------------------
+int _ctmReadTileIndex(_CTMcontext * self)
+{
+  _CTMtile * entry;
+  CTMuint i, j, vertexBase, triangleBase;
+
+  if(_ctmStreamReadUINT(self) != FOURCC("TIDX"))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  self->mTileCount = _ctmStreamReadUINT(self);
+  if((self->mTileCount == 0) || (self->mTileCount > self->mTriangleCount))
+  {
+    self->mTileCount = 0;
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+  self->mTiles = (_CTMtile *) _ctmAlloc(&self->mAllocator,
+    sizeof(_CTMtile) * self->mTileCount);
+  if(!self->mTiles)
+  {
+    self->mTileCount = 0;
+    self->mError = CTM_OUT_OF_MEMORY;
+    return CTM_FALSE;
+  }
+  vertexBase = triangleBase = 0;
+  for(i = 0; i < self->mTileCount; ++ i)
+  {
+    entry = &self->mTiles[i];
+    entry->mVertexCount = _ctmStreamReadUINT(self);
+    entry->mTriangleCount = _ctmStreamReadUINT(self);
+    for(j = 0; j < 3; ++ j)
+      entry->mMin[j] = _ctmStreamReadFLOAT(self);
+    for(j = 0; j < 3; ++ j)
+      entry->mMax[j] = _ctmStreamReadFLOAT(self);
+    entry->mSize = _ctmStreamReadUINT(self);
+
+    // The tile counts must add up to the counts in the file header
+    if((entry->mVertexCount == 0) || (entry->mTriangleCount == 0) ||
+       (entry->mVertexCount > self->mVertexCount - vertexBase) ||
+       (entry->mTriangleCount > self->mTriangleCount - triangleBase))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      return CTM_FALSE;
+    }
+    vertexBase += entry->mVertexCount;
+    triangleBase += entry->mTriangleCount;
+  }
+  if((vertexBase != self->mVertexCount) ||
+     (triangleBase != self->mTriangleCount))
+  {
+    self->mError = CTM_BAD_FORMAT;
+    return CTM_FALSE;
+  }
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmLoadTiles() - Load the tile index of a tiled file (the file header has
+// already been read), and then the tile(s) selected with ctmSelectTile().
+//-----------------------------------------------------------------------------
+int _ctmLoadTiles(_CTMcontext * self, CTMuint aFlags)
+{
+  _CTMcontext * tile;
+  _CTMtile * entry;
+  CTMuint i, skip, vertexBase, triangleBase;
+  char * comment;
+  int result;
+
+  // Read the tile index
+  if(!_ctmReadTileIndex(self))
+    return CTM_FALSE;
+
+  // Only load the tile index?
+  if(self->mTileSelect == CTM_TILE_INDEX)
+  {
+    self->mVertexCount = 0;
+    self->mTriangleCount = 0;
+    self->mUVMapCount = 0;
+    self->mAttribMapCount = 0;
+    return CTM_TRUE;
+  }
+
+  // Load a single tile?
+  if(self->mTileSelect != CTM_ALL_TILES)
+  {
+    if(self->mTileSelect >= self->mTileCount)
+    {
+      self->mError = CTM_INVALID_ARGUMENT;
+      return CTM_FALSE;
+    }
+    // Skip the tiles before it (in as few steps as possible, so that a
+    // seekable stream can go straight to the tile)
+    skip = 0;
+    for(i = 0; i < self->mTileSelect; ++ i)
+    {
+      if(self->mTiles[i].mSize > 0xffffffff - skip)
+      {
+        if(!_ctmStreamSkip(self, skip))
+          return CTM_FALSE;
+        skip = 0;
+      }
+      skip += self->mTiles[i].mSize;
+    }
+    if(!_ctmStreamSkip(self, skip))
+      return CTM_FALSE;
+
+    // Load the tile into this context (keeping the file comment of the tiled
+    // file)
+    comment = self->mFileComment;
+    self->mFileComment = (char *) 0;
+    entry = &self->mTiles[self->mTileSelect];
+    result = _ctmLoadSubMesh(self, self, entry->mSize, entry->mVertexCount,
+                             entry->mTriangleCount);
+    if(self->mFileComment)
+      _ctmFree(&self->mAllocator, self->mFileComment);
+    self->mFileComment = comment;
+    return result;
+  }
+
+  // Load all the tiles, one at a time, and concatenate them (the mesh arrays
+  // are allocated when the first tile has been checked against the header)
+  vertexBase = triangleBase = 0;
+  for(i = 0; i < self->mTileCount; ++ i)
+  {
+    entry = &self->mTiles[i];
+    tile = (_CTMcontext *) ctmNewContext(CTM_IMPORT);
+    if(!tile)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      return CTM_FALSE;
+    }
+    tile->mThreadCount = self->mThreadCount;
+    tile->mScratch = self->mScratch;
+    tile->mAllocator = self->mAllocator;
+    tile->mLoadSections = self->mLoadSections;
+    result = _ctmLoadSubMesh(self, tile, entry->mSize, entry->mVertexCount,
+                             entry->mTriangleCount);
+
+    // The tile must have normals if the file header says so (the counts have
+    // already been checked by _ctmLoadSubMesh())
+    if(result && (!(tile->mNormals || tile->mSkipNormals) !=
+                  !(aFlags & _CTM_HAS_NORMALS_BIT)))
+    {
+      self->mError = CTM_BAD_FORMAT;
+      result = CTM_FALSE;
+    }
+    if(result)
+    {
+      if(i == 0)
+      {
+        result = _ctmAllocateMesh(self, aFlags);
+        self->mMethod = tile->mMethod;
+        self->mVertexPrecision = tile->mVertexPrecision;
+        self->mNormalPrecision = tile->mNormalPrecision;
+      }
+      if(result)
+        result = _ctmAppendTile(self, tile, vertexBase, triangleBase, i == 0);
+    }
+    ctmFreeContext(tile);
+    if(!result)
+      return CTM_FALSE;
+    vertexBase += entry->mVertexCount;
+    triangleBase += entry->mTriangleCount;
+  }
+
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFreeTiles() - Free the tile index.
+//-----------------------------------------------------------------------------
+void _ctmFreeTiles(_CTMcontext * self)
+{
+  if(self->mTiles)
+    _ctmFree(&self->mAllocator, self->mTiles);
+  self->mTiles = (_CTMtile *) 0;
+  self->mTileCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmAddChunk() - Save the current mesh to memory as the next chunk of a
+// mesh that is saved in parts (see ctmAddChunk()). All the chunks must have
+// the same map counts and mesh flags, since they are concatenated when the
+// file is loaded.
+//-----------------------------------------------------------------------------
+int _ctmAddChunk(_CTMcontext * self)
+{
+  _CTMchunks * chunks = &self->mChunks;
+  _CTMtile * tiles, * tile;
+  _CTMmembuf * bufs, * buf;
+  CTMwritefn writeFn;
+  void * userData;
+  size_t streamPos;
+  char * comment;
+  const CTMfloat * v;
+  CTMuint flags, capacity, i, j;
+  int result;
+
+  flags = 0;
+  if(self->mNormals)
+    flags |= _CTM_HAS_NORMALS_BIT;
+  if((chunks->mCount > 0) &&
+     ((flags != chunks->mFlags) ||
+      (self->mUVMapCount != chunks->mUVMapCount) ||
+      (self->mAttribMapCount != chunks->mAttribMapCount)))
+  {
+    self->mError = CTM_INVALID_MESH;
+    return CTM_FALSE;
+  }
+  if((self->mVertexCount > 0xffffffff - chunks->mVertexCount) ||
+     (self->mTriangleCount > 0xffffffff - chunks->mTriangleCount))
+  {
+    self->mError = CTM_INVALID_MESH;
+    return CTM_FALSE;
+  }
+
+  // Grow the chunk arrays as needed
+  if(chunks->mCount >= chunks->mCapacity)
+  {
+    capacity = chunks->mCapacity ? chunks->mCapacity * 2 : 16;
+    tiles = (_CTMtile *) _ctmRealloc(&self->mAllocator, chunks->mTiles,
+      sizeof(_CTMtile) * chunks->mCapacity, sizeof(_CTMtile) * capacity);
+    if(!tiles)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      return CTM_FALSE;
+    }
+    chunks->mTiles = tiles;
+    bufs = (_CTMmembuf *) _ctmRealloc(&self->mAllocator, chunks->mBufs,
+      sizeof(_CTMmembuf) * chunks->mCapacity, sizeof(_CTMmembuf) * capacity);
+    if(!bufs)
+    {
+      self->mError = CTM_OUT_OF_MEMORY;
+      return CTM_FALSE;
+    }
+    chunks->mBufs = bufs;
+    chunks->mCapacity = capacity;
+  }
+  tile = &chunks->mTiles[chunks->mCount];
+  buf = &chunks->mBufs[chunks->mCount];
+  memset(buf, 0, sizeof(_CTMmembuf));
+  buf->mAllocator = &self->mAllocator;
+
+  // Save the mesh to memory (the file comment is only written to the header
+  // of the file)
+  writeFn = self->mWriteFn;
+  userData = self->mUserData;
+  streamPos = self->mStreamPos;
+  comment = self->mFileComment;
+  self->mWriteFn = _ctmMemBufWrite;
+  self->mUserData = (void *) buf;
+  self->mStreamPos = 0;
+  self->mFileComment = (char *) 0;
+  result = _ctmSaveMesh(self);
+  self->mWriteFn = writeFn;
+  self->mUserData = userData;
+  self->mStreamPos = streamPos;
+  self->mFileComment = comment;
+  if(result && ((buf->mSize == 0) || (buf->mSize > 0xffffffff)))
+  {
+    self->mError = buf->mSize ? CTM_INVALID_MESH : CTM_OUT_OF_MEMORY;
+    result = CTM_FALSE;
+  }
+  if(!result)
+  {
+    _ctmFree(&self->mAllocator, buf->mData);
+    return CTM_FALSE;
+  }
+
+  // Fill out the tile index entry of the chunk
+  tile->mVertexCount = self->mVertexCount;
+  tile->mTriangleCount = self->mTriangleCount;
+  tile->mSize = (CTMuint) buf->mSize;
+  for(i = 0; i < self->mVertexCount; ++ i)
+  {
+    v = &self->mVertices[(size_t) i * self->mVertexStride];
+    for(j = 0; j < 3; ++ j)
+    {
+      if((i == 0) || (v[j] < tile->mMin[j]))
+        tile->mMin[j] = v[j];
+      if((i == 0) || (v[j] > tile->mMax[j]))
+        tile->mMax[j] = v[j];
+    }
+  }
+  if((self->mMethod == CTM_METHOD_MG2) || (self->mMethod == CTM_METHOD_MG3))
+  {
+    // Make room for the fixed point rounding of the vertices
+    for(j = 0; j < 3; ++ j)
+    {
+      tile->mMin[j] -= self->mVertexPrecision;
+      tile->mMax[j] += self->mVertexPrecision;
+    }
+  }
+
+  if(chunks->mCount == 0)
+  {
+    chunks->mUVMapCount = self->mUVMapCount;
+    chunks->mAttribMapCount = self->mAttribMapCount;
+    chunks->mFlags = flags;
+  }
+  chunks->mVertexCount += self->mVertexCount;
+  chunks->mTriangleCount += self->mTriangleCount;
+  ++ chunks->mCount;
+  return CTM_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// _ctmSaveChunks() - Save the chunks of a mesh that is saved in parts as a
+// tiled file (one tile per chunk, in the order that they were added).
+//-----------------------------------------------------------------------------
+int _ctmSaveChunks(_CTMcontext * self)
+{
+  _CTMchunks * chunks = &self->mChunks;
+
+  return _ctmWriteTiledFile(self, chunks->mTiles, chunks->mBufs,
+                            chunks->mCount, chunks->mVertexCount,
+                            chunks->mTriangleCount, chunks->mUVMapCount,
+                            chunks->mAttribMapCount, chunks->mFlags);
+}
+
+//-----------------------------------------------------------------------------
+// _ctmFreeChunks() - Free the chunks of a mesh that is saved in parts.
+//-----------------------------------------------------------------------------
+void _ctmFreeChunks(_CTMcontext * self)
+{
+  CTMuint i;
+
+  for(i = 0; i < self->mChunks.mCount; ++ i)
+    _ctmFree(&self->mAllocator, self->mChunks.mBufs[i].mData);
+  if(self->mChunks.mTiles)
+    _ctmFree(&self->mAllocator, self->mChunks.mTiles);
+  if(self->mChunks.mBufs)
+    _ctmFree(&self->mAllocator, self->mChunks.mBufs);
+  memset(&self->mChunks, 0, sizeof(_CTMchunks));
+}
@@ -47,6 +47,11 @@ Options::Options()
 
   mMethod = CTM_METHOD_MG2;
   mLevel = 1;
+  mTiles = 1;
+  mLevels = 0;
+  mConnectivity = false;
+  mParallelogram = false;
+  mOctahedral = false;
   mVertexPrecision = 0.0f;
   mVertexPrecisionRel = 0.01f;
   mNormalPrecision = 1.0f / 256.0f;
@@ -139,8 +144,10 @@ void Options::GetFromArgs(int argc, char **argv, int aStartIdx)
         mMethod = CTM_METHOD_MG1;
       else if(method == string("MG2"))
         mMethod = CTM_METHOD_MG2;
+      else if(method == string("MG3"))
+        mMethod = CTM_METHOD_MG3;
       else
-        throw runtime_error("Invalid method (use RAW, MG1 or MG2).");
+        throw runtime_error("Invalid method (use RAW, MG1, MG2 or MG3).");
     }
     else if((cmd == string("--level")) && (i < (argc - 1)))
     {
@@ -150,6 +157,34 @@ void Options::GetFromArgs(int argc, char **argv, int aStartIdx)
       mLevel = CTMuint(val);
       ++ i;
     }
+    else if((cmd == string("--tiles")) && (i < (argc - 1)))
+    {
+      CTMint val = GetIntArg(argv[i + 1]);
+      if( (val < 1) || (val > 256) )
+        throw runtime_error("Invalid tile count (it must be in the range 1 - 256).");
+      mTiles = CTMuint(val);
+      ++ i;
+    }
+    else if((cmd == string("--levels")) && (i < (argc - 1)))
+    {
+      CTMint val = GetIntArg(argv[i + 1]);
+      if( (val < 0) || (val > 16) )
+        throw runtime_error("Invalid level count (it must be in the range 0 - 16).");
+      mLevels = CTMuint(val);
+      ++ i;
+    }
+    else if(cmd == string("--connectivity"))
+    {
+      mConnectivity = true;
+    }
+    else if(cmd == string("--parallelogram"))
+    {
+      mParallelogram = true;
+    }
+    else if(cmd == string("--octahedral"))
+    {
+      mOctahedral = true;
+    }
     else if((cmd == string("--vprec")) && (i < (argc - 1)))
     {
       mVertexPrecision = GetFloatArg(argv[i + 1]);
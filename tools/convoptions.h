@@ -54,6 +54,11 @@ class Options {
 
     CTMenum mMethod;
     CTMuint mLevel;
+    CTMuint mTiles;
+    CTMuint mLevels;
+    bool mConnectivity;
+    bool mParallelogram;
+    bool mOctahedral;
 
     CTMfloat mVertexPrecision;
     CTMfloat mVertexPrecisionRel;
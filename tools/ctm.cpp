@@ -159,6 +159,20 @@ void Export_CTM(const char * aFileName, Mesh * aMesh, Options &aOptions)
   ctm.CompressionMethod(aOptions.mMethod);
   ctm.CompressionLevel(aOptions.mLevel);
 
+  // Set the tile grid
+  ctm.TileGrid(aOptions.mTiles, aOptions.mTiles, aOptions.mTiles);
+
+  // Set the number of progressive levels
+  ctm.ProgressiveLevels(aOptions.mLevels);
+
+  // Select the index, vertex and normal codings
+  if(aOptions.mConnectivity)
+    ctm.CompressionCoding(CTM_INDICES, CTM_CODING_CONNECTIVITY);
+  if(aOptions.mParallelogram)
+    ctm.CompressionCoding(CTM_VERTICES, CTM_CODING_PARALLELOGRAM);
+  if(aOptions.mOctahedral)
+    ctm.CompressionCoding(CTM_NORMALS, CTM_CODING_OCTAHEDRAL);
+
   // Set vertex precision
   if(aOptions.mVertexPrecision > 0.0f)
     ctm.VertexPrecision(aOptions.mVertexPrecision);
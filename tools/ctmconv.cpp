@@ -165,9 +165,14 @@ int main(int argc, char ** argv)
     cout << "  --no-texcoords  Do not export texture coordinates." << endl;
     cout << "  --no-colors     Do not export vertex colors." << endl;
     cout << endl << " OpenCTM output" << endl;
-    cout << "  --method arg    Select compression method (RAW, MG1, MG2)" << endl;
+    cout << "  --method arg    Select compression method (RAW, MG1, MG2, MG3)" << endl;
     cout << "  --level arg     Set the compression level (0 - 9)" << endl;
-    cout << endl << " OpenCTM MG2 method" << endl;
+    cout << "  --tiles arg     Split the mesh into arg x arg x arg spatial tiles" << endl;
+    cout << "  --levels arg    Store up to arg coarse progressive levels (0 - 16)" << endl;
+    cout << endl << " OpenCTM MG2/MG3 methods" << endl;
+    cout << "  --connectivity  Code the triangle indices by mesh connectivity" << endl;
+    cout << "  --parallelogram Predict the vertices by mesh connectivity" << endl;
+    cout << "  --octahedral    Store the normals as octahedral coordinates" << endl;
     cout << "  --vprec arg     Set vertex precision" << endl;
     cout << "  --vprecrel arg  Set vertex precision, relative method" << endl;
     cout << "  --nprec arg     Set normal precision" << endl;